@@ -393,6 +393,8 @@ public:
 
 
         slider->getProperties().set("svgpath", cAttr.getStringProp(CabbageIDs::svgpath));
+        slider->getProperties().set("filmstrip", cAttr.getStringProp(CabbageIDs::filmstrip));
+        slider->getProperties().set("filmstripframes", cAttr.getNumProp(CabbageIDs::filmstripframes));
         slider->toFront(true);
         slider->addMouseListener(this, false);
         textLabel->setColour(Label::textColourId, Colour::fromString(textColour));
@@ -466,6 +468,12 @@ public:
     {
     }
 
+    //relative filmstrip paths are found from here by the look and feel
+    void setBaseDirectory(String dir)
+    {
+        slider->getProperties().set("csdDirectory", dir);
+    }
+
     void setupMinMaxValue()
     {
         slider->setMinAndMaxValues(min, max);
@@ -873,6 +873,8 @@ CabbageGUIClass::CabbageGUIClass(String compStr, int ID):
         cabbageIdentifiers.set(CabbageIDs::name, "form");
         cabbageIdentifiers.set(CabbageIDs::type, "form");
         cabbageIdentifiers.set(CabbageIDs::guirefresh, 100);
+        cabbageIdentifiers.set(CabbageIDs::sleep, 0);
+        cabbageIdentifiers.set(CabbageIDs::sleepthreshold, -80);
         cabbageIdentifiers.set(CabbageIDs::identchannel, "");
         cabbageIdentifiers.set(CabbageIDs::visible, 1);
         cabbageIdentifiers.set(CabbageIDs::scrollbars, 1);
@@ -1156,6 +1158,13 @@ void CabbageGUIClass::parse(String inStr, String identifier)
                 cabbageIdentifiers.set(CabbageIDs::svgpath, strTokens[0].trim());
             }
 
+            else if(identArray[indx].equalsIgnoreCase("filmstrip"))
+            {
+                cabbageIdentifiers.set(CabbageIDs::filmstrip, strTokens[0].trim());
+                if(strTokens.size()>1)
+                    cabbageIdentifiers.set(CabbageIDs::filmstripframes, strTokens[1].trim().getIntValue());
+            }
+
             else if(identArray[indx].equalsIgnoreCase("fillcolour"))
             {
                 cabbageIdentifiers.set(CabbageIDs::fillcolour, getColourFromText(strTokens.joinIntoString(",")).toString());
@@ -1571,6 +1580,14 @@ void CabbageGUIClass::parse(String inStr, String identifier)
                 cabbageIdentifiers.set(CabbageIDs::guirefresh, strTokens[0].trim().getFloatValue());
             }
 
+            //sleep(tailSeconds, thresholdDb)
+            else if(identArray[indx].equalsIgnoreCase("sleep"))
+            {
+                cabbageIdentifiers.set(CabbageIDs::sleep, strTokens[0].trim().getFloatValue());
+                if(strTokens.size()>1)
+                    cabbageIdentifiers.set(CabbageIDs::sleepthreshold, strTokens[1].trim().getFloatValue());
+            }
+
             else if(identArray[indx].equalsIgnoreCase("textbox"))
             {
                 cabbageIdentifiers.set(CabbageIDs::textbox, strTokens[0].trim().getFloatValue());
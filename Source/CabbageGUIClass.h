@@ -55,6 +55,7 @@ public:
         add("max");
         add("value");
         add("guirefresh");
+        add("sleep");
         add("outlinethickness");
         add("linethickness");
         add("trackerthickness");
@@ -85,6 +86,7 @@ public:
         add("logger");
         add("file");
         add("svgpath");
+        add("filmstrip");
         add("outlinecolour");
         add("shape");
         add("rotate");
@@ -171,6 +173,8 @@ static const Identifier comborange = "comborange";
 static const Identifier populate = "populate";
 static const Identifier popup = "popup";
 static const Identifier svgpath = "svgpath";
+static const Identifier filmstrip = "filmstrip";
+static const Identifier filmstripframes = "filmstripframes";
 static const Identifier plant = "plant";
 static const Identifier trackerthickness = "trackerthickness";
 static const Identifier outlinethickness = "outlinethickness";
@@ -208,6 +212,8 @@ static const Identifier workingdir = "workingdir";
 static const Identifier author = "author";
 static const Identifier xychannel = "xychannel";
 static const Identifier guirefresh = "guirefresh";
+static const Identifier sleep = "sleep";
+static const Identifier sleepthreshold = "sleepthreshold";
 static const Identifier identchannel = "identchannel";
 static const Identifier identchannelmessage = "identchannelmessage";
 static const Identifier visible = "visible";
@@ -50,6 +50,136 @@ static TextLayout layoutTooltipText (const String& text, Colour colour) noexcept
     return tl;
 }
 }
+//==============================================================================
+// Sprite cache shared by all Cabbage look and feel objects
+//==============================================================================
+static bool spriteCacheEnabled = true;
+
+CabbageSpriteCache::CabbageSpriteCache(): cachedBytes(0), useCount(0)
+{
+}
+
+CabbageSpriteCache::~CabbageSpriteCache()
+{
+}
+
+void CabbageSpriteCache::setEnabled (bool shouldBeEnabled)
+{
+    spriteCacheEnabled = shouldBeEnabled;
+}
+
+bool CabbageSpriteCache::isEnabled()
+{
+    return spriteCacheEnabled;
+}
+
+void CabbageSpriteCache::clear()
+{
+    sprites.clear();
+    spriteStore.clear();
+    cachedBytes = 0;
+}
+
+String CabbageSpriteCache::getKey (const String& type, int width, int height, Colour colour, const String& extra) const
+{
+    return type+"|"+String(width)+"x"+String(height)+"|"+colour.toString()+"|"+extra;
+}
+
+//finds or creates the sprite for a key, and marks it as the most recently used
+CabbageSpriteCache::Sprite* CabbageSpriteCache::getSprite (const String& key, int numFrames)
+{
+    Sprite* sprite = sprites[key];
+    if(sprite==nullptr)
+    {
+        sprite = spriteStore.add(new Sprite());
+        sprite->key = key;
+        sprite->frames.insertMultiple(0, Image(), numFrames);
+        sprites.set(key, sprite);
+    }
+    sprite->lastUsed = ++useCount;
+    return sprite;
+}
+
+//if a new frame would take us over budget the least recently used sprites are
+//dropped until it fits, never the one it is being added to
+void CabbageSpriteCache::addFrame (Sprite& sprite, int index, const Image& img)
+{
+    const int64 bytes = (int64)img.getWidth()*img.getHeight()*4;
+    while(cachedBytes+bytes > maxCacheBytes && spriteStore.size()>1)
+    {
+        int oldest = -1;
+        for(int i=0; i<spriteStore.size(); i++)
+            if(spriteStore[i]!=&sprite && (oldest<0 || spriteStore[i]->lastUsed<spriteStore[oldest]->lastUsed))
+                oldest = i;
+
+        cachedBytes -= spriteStore[oldest]->bytes;
+        sprites.remove(spriteStore[oldest]->key);
+        spriteStore.remove(oldest);
+    }
+
+    sprite.frames.set(index, img);
+    sprite.bytes += bytes;
+    cachedBytes += bytes;
+}
+
+Image CabbageSpriteCache::getTextButtonImage (int width, int height, bool isButtonDown, Colour colour, const String& svgPath)
+{
+    if(!isEnabled())
+        return cUtils::drawTextButtonImage (width, height, isButtonDown, colour, svgPath);
+
+    Sprite* sprite = getSprite(getKey("button", width, height, colour, String((int)isButtonDown)+svgPath), 1);
+    if(sprite->frames.getReference(0).isNull())
+        addFrame(*sprite, 0, cUtils::drawTextButtonImage (width, height, isButtonDown, colour, svgPath));
+    return sprite->frames.getReference(0);
+}
+
+Image CabbageSpriteCache::getToggleImage (int width, int height, Colour colour, bool isRect, const String& svgPath)
+{
+    if(!isEnabled())
+        return cUtils::drawToggleImage (width, height, true, colour, isRect, svgPath);
+
+    Sprite* sprite = getSprite(getKey("toggle", width, height, colour, String((int)isRect)+svgPath), 1);
+    if(sprite->frames.getReference(0).isNull())
+        addFrame(*sprite, 0, cUtils::drawToggleImage (width, height, true, colour, isRect, svgPath));
+    return sprite->frames.getReference(0);
+}
+
+bool CabbageSpriteCache::drawRotaryFrame (Graphics& g, int x, int y, int width, int height, float sliderPos, const RotaryStyle& style)
+{
+    if(!isEnabled() || width<1 || height<1)
+        return false;
+
+    //render at device resolution so sprites stay sharp on scaled displays
+    const float scale = jmax(1.f, g.getInternalContext().getPhysicalPixelScaleFactor());
+    const int frameWidth = roundToInt(width*scale);
+    const int frameHeight = roundToInt(height*scale);
+    if(frameWidth*frameHeight > maxRotaryFramePixels)
+        return false;
+
+    String extra;
+    extra << style.outlineColour.toString() << "|" << style.thumbColour.toString() << "|"
+          << style.rotaryStartAngle << "|" << style.rotaryEndAngle << "|"
+          << (int)style.isMouseOver << (int)style.isEnabled;
+    Sprite* rotary = getSprite(getKey("rotary", frameWidth, frameHeight, style.trackColour, extra), numRotaryFrames);
+
+    //only the frames that are actually shown are ever allocated
+    const int frame = jlimit(0, (int)numRotaryFrames-1, roundToInt(sliderPos*(numRotaryFrames-1)));
+    if(rotary->frames.getReference(frame).isNull())
+    {
+        Image img(Image::ARGB, frameWidth, frameHeight, true);
+        {
+            Graphics sg(img);
+            sg.addTransform(AffineTransform::scale(scale));
+            const float angle = style.rotaryStartAngle + (frame/float(numRotaryFrames-1))*(style.rotaryEndAngle-style.rotaryStartAngle);
+            CabbageLookAndFeel::drawRotaryKnob(sg, 0, 0, width, height, angle, style);
+        }
+        addFrame(*rotary, frame, img);
+    }
+
+    g.drawImage(rotary->frames.getReference(frame), x, y, width, height, 0, 0, frameWidth, frameHeight, false);
+    return true;
+}
+
 //main Cabbage look and feel class
 CabbageLookAndFeel::CabbageLookAndFeel()
 {
@@ -480,6 +610,37 @@ int CabbageLookAndFeel::getSliderPopupPlacement (Slider&)
 //=========== Rotary Sliders ==============================================================================
 void CabbageLookAndFeel::drawRotarySlider (Graphics& g, int x, int y, int width, int height, float sliderPos,
         const float rotaryStartAngle, const float rotaryEndAngle, Slider& slider)
+{
+    //user supplied filmstrips take precedence over the default knob
+    const String filmstrip = slider.getProperties().getWithDefault("filmstrip", "").toString();
+    if(filmstrip.isNotEmpty())
+    {
+        const int numFrames = slider.getProperties().getWithDefault("filmstripframes", 0);
+        const String path(File::isAbsolutePath(filmstrip) ? filmstrip
+                          : cUtils::returnFullPathForFile(filmstrip, slider.getProperties().getWithDefault("csdDirectory", "").toString()));
+        if(drawFilmstripFrame(g, ImageCache::getFromFile(File(path)), numFrames, x, y, width, height, sliderPos))
+            return;
+    }
+
+    CabbageSpriteCache::RotaryStyle style;
+    style.trackColour = slider.findColour (Slider::trackColourId);
+    style.outlineColour = slider.findColour (Slider::rotarySliderOutlineColourId);
+    style.thumbColour = slider.findColour (Slider::thumbColourId);
+    style.rotaryStartAngle = rotaryStartAngle;
+    style.rotaryEndAngle = rotaryEndAngle;
+    style.isMouseOver = slider.isMouseOverOrDragging() && slider.isEnabled();
+    style.isEnabled = slider.isEnabled();
+
+    if(spriteCache->drawRotaryFrame(g, x, y, width, height, sliderPos, style))
+        return;
+
+    const float angle = rotaryStartAngle + sliderPos * (rotaryEndAngle - rotaryStartAngle);
+    drawRotaryKnob(g, x, y, width, height, angle, style);
+}
+
+//=========== Rotary knob, used directly and for rendering sprite frames ==================================
+void CabbageLookAndFeel::drawRotaryKnob (Graphics& g, float x, float y, int width, int height, float angle,
+        const CabbageSpriteCache::RotaryStyle& style)
 {
     const float radius = jmin (width / 2, height / 2) - 2.0f;
     const float diameter = radius*2.f;
@@ -488,34 +649,32 @@ void CabbageLookAndFeel::drawRotarySlider (Graphics& g, int x, int y, int width,
     const float rx = centreX - radius;
     const float ry = centreY - radius;
     const float rw = radius * 2.0f;
-    const float angle = rotaryStartAngle + sliderPos * (rotaryEndAngle - rotaryStartAngle);
-    const bool isMouseOver = slider.isMouseOverOrDragging() && slider.isEnabled();
 
     if (radius > 12.0f)
     {
-        //if (slider.isEnabled())
-        g.setColour (slider.findColour (Slider::trackColourId).withAlpha (isMouseOver ? 1.0f : 0.9f));
+        //if (style.isEnabled)
+        g.setColour (style.trackColour.withAlpha (style.isMouseOver ? 1.0f : 0.9f));
         //else
         //    g.setColour (Colour (0x80808080));
 
         const float thickness = 0.7f;
         {
             Path filledArc;
-            filledArc.addPieSegment (rx, ry, rw, rw, rotaryStartAngle, angle, thickness);
+            filledArc.addPieSegment (rx, ry, rw, rw, style.rotaryStartAngle, angle, thickness);
             g.fillPath (filledArc);
         }
 
 
-        //if (slider.isEnabled())
-        g.setColour (slider.findColour (Slider::rotarySliderOutlineColourId));
+        //if (style.isEnabled)
+        g.setColour (style.outlineColour);
         //else
         //    g.setColour (Colour (0x80808080));
 
         Path outlineArc;
-        outlineArc.addPieSegment (rx, ry, rw, rw, rotaryStartAngle, rotaryEndAngle, thickness);
+        outlineArc.addPieSegment (rx, ry, rw, rw, style.rotaryStartAngle, style.rotaryEndAngle, thickness);
         outlineArc.closeSubPath();
 
-        g.strokePath (outlineArc, PathStrokeType (slider.isEnabled() ? (isMouseOver ? 2.0f : 1.2f) : 0.3f));
+        g.strokePath (outlineArc, PathStrokeType (style.isEnabled ? (style.isMouseOver ? 2.0f : 1.2f) : 0.3f));
 
 
         Path newPolygon;
@@ -537,23 +696,23 @@ void CabbageLookAndFeel::drawRotarySlider (Graphics& g, int x, int y, int width,
             newPolygon.addEllipse (-radius*.2, -radius*.2, radius * .3f, radius * .3f);
 
 
-        g.setColour (slider.findColour (Slider::thumbColourId));
+        g.setColour (style.thumbColour);
 
-        Colour thumbColour = slider.findColour (Slider::thumbColourId).withAlpha (isMouseOver ? 1.0f : 0.9f);
+        Colour thumbColour = style.thumbColour.withAlpha (style.isMouseOver ? 1.0f : 0.9f);
         ColourGradient cg = ColourGradient (Colours::white, 0, 0, thumbColour, diameter*0.6, diameter*0.4, false);
-        if(slider.findColour (Slider::thumbColourId)!=Colour(0.f,0.f,0.f,0.f))
+        if(style.thumbColour!=Colour(0.f,0.f,0.f,0.f))
             g.setGradientFill (cg);
         g.fillPath (newPolygon);
     }
     else
     {
         Path p;
-        g.setColour (slider.findColour (Slider::thumbColourId).withAlpha (isMouseOver ? 1.0f : 0.7f));
+        g.setColour (style.thumbColour.withAlpha (style.isMouseOver ? 1.0f : 0.7f));
         p.addEllipse (-0.4f * rw, -0.4f * rw, rw * 0.8f, rw * 0.8f);
         g.fillPath(p, AffineTransform::rotation (angle).translated (centreX, centreY));
 
-        //if (slider.isEnabled())
-        g.setColour (slider.findColour (Slider::rotarySliderOutlineColourId).withAlpha (isMouseOver ? 0.7f : 0.5f));
+        //if (style.isEnabled)
+        g.setColour (style.outlineColour.withAlpha (style.isMouseOver ? 0.7f : 0.5f));
         //else
         //    g.setColour (Colour (0x80808080));
 
@@ -568,6 +727,90 @@ void CabbageLookAndFeel::drawRotarySlider (Graphics& g, int x, int y, int width,
 
 }
 
+//=========== Draw one frame of a user filmstrip, either vertical or horizontal ===========================
+bool CabbageLookAndFeel::drawFilmstripFrame (Graphics& g, const Image& filmstrip, int numFrames,
+        int x, int y, int width, int height, float sliderPos)
+{
+    if(!filmstrip.isValid())
+        return false;
+
+    const bool isVertical = filmstrip.getHeight() >= filmstrip.getWidth();
+    //if the number of frames is not given assume square frames
+    if(numFrames<1)
+        numFrames = isVertical ? filmstrip.getHeight()/jmax(1, filmstrip.getWidth())
+                    : filmstrip.getWidth()/jmax(1, filmstrip.getHeight());
+    if(numFrames<1)
+        return false;
+
+    const int frameWidth = isVertical ? filmstrip.getWidth() : filmstrip.getWidth()/numFrames;
+    const int frameHeight = isVertical ? filmstrip.getHeight()/numFrames : filmstrip.getHeight();
+    const int frame = jlimit(0, numFrames-1, roundToInt(sliderPos*(numFrames-1)));
+
+    g.drawImage(filmstrip, x, y, width, height,
+                isVertical ? 0 : frame*frameWidth, isVertical ? frame*frameHeight : 0,
+                frameWidth, frameHeight, false);
+    return true;
+}
+
+//=========== Times direct painting against sprite blitting for a set of offscreen controls =================
+String CabbageLookAndFeel::benchmarkControlRendering (int numControls, int numRepaints)
+{
+    CabbageLookAndFeel lookAndFeel;
+    OwnedArray<Slider> sliders;
+    OwnedArray<TextButton> buttons;
+    OwnedArray<ToggleButton> toggles;
+
+    for(int i=0; i<numControls; i++)
+    {
+        Slider* slider = sliders.add(new Slider());
+        slider->setLookAndFeel(&lookAndFeel);
+        slider->setSliderStyle(Slider::RotaryVerticalDrag);
+        slider->setColour(Slider::trackColourId, Colour(0, 118, 38));
+        slider->setColour(Slider::thumbColourId, Colours::whitesmoke);
+        slider->setColour(Slider::rotarySliderOutlineColourId, Colours::black.brighter(.3f));
+        slider->setSize(60, 60);
+
+        TextButton* button = buttons.add(new TextButton());
+        button->setLookAndFeel(&lookAndFeel);
+        button->setSize(80, 30);
+
+        ToggleButton* toggle = toggles.add(new ToggleButton());
+        toggle->setLookAndFeel(&lookAndFeel);
+        toggle->setColour(TextButton::buttonOnColourId, Colours::lime);
+        toggle->setSize(20, 20);
+    }
+
+    Image canvas(Image::ARGB, 80, 60, true);
+    String report;
+
+    for(int pass=0; pass<2; pass++)
+    {
+        const bool useSprites = (pass==1);
+        CabbageSpriteCache::setEnabled(useSprites);
+        const int64 startTicks = Time::getHighResolutionTicks();
+
+        for(int frame=0; frame<numRepaints; frame++)
+        {
+            Graphics g(canvas);
+            for(int i=0; i<numControls; i++)
+            {
+                const float sliderPos = ((frame*7+i)%CabbageSpriteCache::numRotaryFrames)/float(CabbageSpriteCache::numRotaryFrames-1);
+                lookAndFeel.drawRotarySlider(g, 0, 0, 60, 60, sliderPos, float_Pi*1.2f, float_Pi*2.8f, *sliders[i]);
+                lookAndFeel.drawButtonBackground(g, *buttons[i], Colours::black, false, (frame&1)!=0);
+                toggles[i]->setToggleState((frame&1)!=0, dontSendNotification);
+                lookAndFeel.drawToggleButton(g, *toggles[i], false, false);
+            }
+        }
+
+        const double msPerFrame = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks()-startTicks)*1000.0/jmax(1, numRepaints);
+        report << (useSprites ? "sprites: " : "direct:  ") << String(msPerFrame, 3) << " ms per frame ("
+               << numControls << " rotary sliders, buttons and toggles)\n";
+    }
+
+    CabbageSpriteCache::setEnabled(true);
+    return report;
+}
+
 
 //=========== Linear Slider Background ===========================================================================
 void CabbageLookAndFeel::drawLinearSliderBackground (Graphics &g, int x, int y, int width, int height, float sliderPos,
@@ -833,9 +1076,9 @@ void CabbageLookAndFeel::drawToggleButton (Graphics &g, ToggleButton &button, bo
     //----- Creating the image
     Image newButton;
     if(!button.getToggleState())
-        newButton = cUtils::drawToggleImage (destWidth, destHeight, true, button.findColour(TextButton::buttonColourId), isRECT, svgPath);
+        newButton = spriteCache->getToggleImage (destWidth, destHeight, button.findColour(TextButton::buttonColourId), isRECT, svgPath);
     else
-        newButton = cUtils::drawToggleImage (destWidth, destHeight, true, button.findColour(TextButton::buttonOnColourId), isRECT, svgPath);
+        newButton = spriteCache->getToggleImage (destWidth, destHeight, button.findColour(TextButton::buttonOnColourId), isRECT, svgPath);
 
 
 
@@ -867,9 +1110,9 @@ void CabbageLookAndFeel::drawButtonBackground (Graphics& g, Button& button, cons
     float height = button.getHeight();
     String svgPath = button.getProperties().getWithDefault("svgpath", "");
     if(!button.getToggleState())
-        newButton = cUtils::drawTextButtonImage (width, height, isButtonDown, button.findColour(TextButton::buttonColourId), svgPath);
+        newButton = spriteCache->getTextButtonImage (width, height, isButtonDown, button.findColour(TextButton::buttonColourId), svgPath);
     else
-        newButton = cUtils::drawTextButtonImage (width, height, isButtonDown, button.findColour(TextButton::buttonOnColourId), svgPath);
+        newButton = spriteCache->getTextButtonImage (width, height, isButtonDown, button.findColour(TextButton::buttonOnColourId), svgPath);
 
     g.drawImage (newButton, 0, 0, width, height, 0, 0, width, height, false);
 }
@@ -2294,9 +2537,9 @@ void CabbageLookAndFeelBasic::drawToggleButton (Graphics &g, ToggleButton &butto
     //----- Creating the image
     Image newButton;
     if(!button.getToggleState())
-        newButton = cUtils::drawToggleImage (destWidth, destHeight, true, button.findColour(TextButton::buttonColourId), isRECT, svgPath);
+        newButton = spriteCache->getToggleImage (destWidth, destHeight, button.findColour(TextButton::buttonColourId), isRECT, svgPath);
     else
-        newButton = cUtils::drawToggleImage (destWidth, destHeight, true, button.findColour(TextButton::buttonOnColourId), isRECT, svgPath);
+        newButton = spriteCache->getToggleImage (destWidth, destHeight, button.findColour(TextButton::buttonOnColourId), isRECT, svgPath);
 
 
 
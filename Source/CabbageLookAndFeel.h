@@ -33,6 +33,72 @@
 //#include "BinaryData.h"
 
 
+/*
+  ====================================================================================
+
+	Control sprite cache
+
+	Buttons, toggles and rotary sliders are rendered once for each size, colour
+	and state and then blitted on every later paint. Rotary sliders have up to
+	numRotaryFrames frames, each rendered the first time it is needed. When the
+	cache is full the least recently used sprites are dropped, one at a time. A
+	single cache is shared by all look and feel objects in the process.
+
+  ====================================================================================
+*/
+class CabbageSpriteCache
+{
+public:
+    CabbageSpriteCache();
+    ~CabbageSpriteCache();
+
+    enum
+    {
+        numRotaryFrames = 128,
+        maxRotaryFramePixels = 200*200,
+        maxCacheBytes = 64*1024*1024
+    };
+
+    struct RotaryStyle
+    {
+        Colour trackColour, outlineColour, thumbColour;
+        float rotaryStartAngle, rotaryEndAngle;
+        bool isMouseOver, isEnabled;
+    };
+
+    Image getTextButtonImage (int width, int height, bool isButtonDown, Colour colour, const String& svgPath);
+    Image getToggleImage (int width, int height, Colour colour, bool isRect, const String& svgPath);
+    //returns false if the knob is too big to be worth caching
+    bool drawRotaryFrame (Graphics& g, int x, int y, int width, int height, float sliderPos, const RotaryStyle& style);
+
+    void clear();
+
+    //sprites can be switched off globally, used by the benchmark and for debugging
+    static void setEnabled (bool shouldBeEnabled);
+    static bool isEnabled();
+
+private:
+    //one frame for buttons and toggles, numRotaryFrames for rotary sliders
+    struct Sprite
+    {
+        Sprite() : bytes(0), lastUsed(0) {}
+        String key;
+        Array<Image> frames;
+        int64 bytes, lastUsed;
+    };
+
+    String getKey (const String& type, int width, int height, Colour colour, const String& extra) const;
+    Sprite* getSprite (const String& key, int numFrames);
+    void addFrame (Sprite& sprite, int index, const Image& img);
+
+    HashMap<String, Sprite*> sprites;
+    OwnedArray<Sprite> spriteStore;
+    int64 cachedBytes, useCount;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CabbageSpriteCache);
+};
+
+
 class CabbageLookAndFeel	:	public LookAndFeel_V2
 {
 public:
@@ -181,10 +247,17 @@ public:
         return 18;
     }
 
+    static void drawRotaryKnob (Graphics& g, float x, float y, int width, int height, float angle,
+                                const CabbageSpriteCache::RotaryStyle& style);
+    static bool drawFilmstripFrame (Graphics& g, const Image& filmstrip, int numFrames,
+                                    int x, int y, int width, int height, float sliderPos);
+    static String benchmarkControlRendering (int numControls, int numRepaints);
+
     juce_UseDebuggingNewOperator
 
 
 private:
+    SharedResourcePointer<CabbageSpriteCache> spriteCache;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CabbageLookAndFeel);
 
 
@@ -284,6 +357,7 @@ public:
 
 
 private:
+    SharedResourcePointer<CabbageSpriteCache> spriteCache;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CabbageLookAndFeelBasic);
 
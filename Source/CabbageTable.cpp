@@ -190,38 +190,26 @@ void Table::setGlobalAmpRange(float globalMaxAmp, float globalMinAmp, float glob
 }
 
 //====================================================
-void Table::createAmpOverviews (Array<float, CriticalSection> csndInputData)
+void Table::createAmpOverviews (Array<float, CriticalSection>& csndInputData)
 {
-    //This method creates smaller amp overview arrays using the
-    //original table data...
-    tableData.amps.clear();
+    //This method keeps a peak pyramid of the original table data
+    //up to date. Only the region that differs from the previous
+    //data is rescanned.
+    const Range<int> changed = PeakPyramid::findChangedRegion(tableData.amps.getRawDataPointer(), tableData.amps.size(),
+                                                              csndInputData.getRawDataPointer(), csndInputData.size());
     tableData.y.clear();
-    overview.maxAmps.clear();
-    overview.minAmps.clear();
-
     tableData.amps = csndInputData;
+    overview.peaks.update(tableData.amps.getRawDataPointer(), tableData.amps.size(), changed.getStart(), changed.getEnd());
 
     //Logger::writeToLog(String(tableData.amps.size()));
     zeroAmpPosition = convertAmpToPixel(0);
+    if(getWidth()<=0)
+        return;
 
-    // Filling overview arrays. The original table data is broken into
-    //separate blocks. The max and min values are then stored from each block.
-    //Block size is dependent on the max zoom level we use for overviews.
-    float incr = (float)tableSize / (getWidth()*maxZoomForOverview);
-    float maxBlockValue, minBlockValue;
-    for (float i=0; i<tableSize; i+=incr)
-    {
-        maxBlockValue = minBlockValue = tableData.amps[(int)i+0.5];
-        for (int j=0; j<(int)incr+0.5; j++)   //loop for current block
-        {
-            if (tableData.amps[(int)i+j+0.5] > maxBlockValue)
-                maxBlockValue = tableData.amps[(int)i+j+0.5];
-            if (tableData.amps[(int)i+j+0.5] < minBlockValue)
-                minBlockValue = tableData.amps[(int)i+j+0.5];
-        }
-        overview.maxAmps.add (maxBlockValue);
-        overview.minAmps.add (minBlockValue);
-    }
+    // The overview is made of blocks whose size is dependent on the
+    //max zoom level we use for overviews.
+    overview.samplesPerEntry = (double)tableSize / (getWidth()*maxZoomForOverview);
+    overview.numEntries = jmax(1, (int)std::ceil(tableSize/overview.samplesPerEntry));
     setDataSource (zoom);
     //if(drawOriginalTableData==false)
     //createEnvPath();
@@ -232,31 +220,27 @@ void Table::createAmpOverviews (Array<float, CriticalSection> csndInputData)
 void Table::setDataSource (int zoomValue)
 {
     //If current zoom <= max zoom for overview, then the
-    //overview arrays are used and converted to y coordinates.
-    //Otherwise the initial table data is used.
+    //peaks of each group of overview blocks are looked up and
+    //converted to y coordinates. Otherwise the initial table
+    //data is used.
     if (zoomValue <= maxZoomForOverview)
     {
-        int incrSize = maxZoomForOverview/zoomValue;
-        float maxBlockValue, minBlockValue;
-
-        overview.maxY.clear();
-        overview.minY.clear();
-        for (int i=0; i<overview.maxAmps.size(); i+=incrSize)
+        const int incrSize = maxZoomForOverview/zoomValue;
+        const int numPoints = (overview.numEntries+incrSize-1)/incrSize;
+        HeapBlock<float> mins(numPoints), maxs(numPoints);
+        overview.peaks.getPeaks(tableData.amps.getRawDataPointer(), 0, overview.samplesPerEntry*incrSize,
+                                numPoints, mins, maxs);
+
+        overview.maxY.clearQuick();
+        overview.minY.clearQuick();
+        overview.maxY.ensureStorageAllocated(numPoints);
+        overview.minY.ensureStorageAllocated(numPoints);
+        for (int i=0; i<numPoints; i++)
         {
-            maxBlockValue = overview.maxAmps[i];
-            minBlockValue = overview.minAmps[i];
-            for (int j=0; j<incrSize; j++)   //loop for current block
-            {
-                if (overview.maxAmps[i+j] > maxBlockValue)
-                    maxBlockValue = overview.maxAmps[i+j];
-                if (overview.minAmps[i+j]  < minBlockValue)
-                    minBlockValue = overview.minAmps[i+j];
-            }
-
-            overview.maxY.add (convertAmpToPixel(maxBlockValue));
-            overview.minY.add (convertAmpToPixel(minBlockValue));
-            useOverview = true;
+            overview.maxY.add (convertAmpToPixel(maxs[i]));
+            overview.minY.add (convertAmpToPixel(mins[i]));
         }
+        useOverview = numPoints>0;
     }
     // Else we use original table data for painting
     else
@@ -958,15 +942,10 @@ void CabbageTableManager::fillTable (int tableIndex, Array<float, CriticalSectio
             globalMaxAmp = globalMinAmp = 0;
 
         // Getting the min and max amplitude values....
-        currTableMinAmp = currTableMaxAmp = csndInputData.getFirst();
-        for (int i=0; i<csndInputData.size(); ++i)
-        {
-            //Logger::writeToLog(String(csndInputData[i]));
-            if (csndInputData[i] > currTableMaxAmp)
-                currTableMaxAmp = csndInputData[i];
-            if (csndInputData[i] < currTableMinAmp)
-                currTableMinAmp = csndInputData[i];
-        }
+        const Range<float> amps = (csndInputData.size()>0 ? FloatVectorOperations::findMinAndMax(csndInputData.getRawDataPointer(), csndInputData.size())
+                                   : Range<float>());
+        currTableMinAmp = amps.getStart();
+        currTableMaxAmp = amps.getEnd();
 
 
         //if min and max amps are the same value....
@@ -1143,4 +1122,4 @@ void CabbageTableManager::mouseDown (const MouseEvent& e)
 
     }
 
-}
\ No newline at end of file
+}
\ No newline at end of file
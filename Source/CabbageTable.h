@@ -3,6 +3,7 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "CabbageUtils.h"
+#include "PeakPyramid.h"
 #include "./Plugin/CabbagePluginProcessor.h"
 
 #define HANDLESIZE 8
@@ -67,7 +68,11 @@ public:
 class OverviewData
 {
 public:
-    Array<double> minAmps, maxAmps, minY, maxY;
+    OverviewData() : samplesPerEntry(1), numEntries(0) {}
+    PeakPyramid peaks;
+    double samplesPerEntry;
+    int numEntries;
+    Array<double> minY, maxY;
 };
 
 /*
@@ -88,7 +93,7 @@ public:
     void resized();
     void setOriginalWidth(int w);
     void setGlobalAmpRange (float globalMax, float globalMin, float globalRange);
-    void createAmpOverviews (Array<float, CriticalSection> csndInputData);
+    void createAmpOverviews (Array<float, CriticalSection>& csndInputData);
     void setDataSource (int zoomValue);
     float convertAmpToPixel (float ampValue);
     float convertPixelToAmp(float pixelYValue);
@@ -306,10 +306,49 @@ void CsoundCodeEditor::setAllText(String text)
 //==============================================================================
 void CsoundCodeEditor::highlightLine(String line)
 {
-    String temp = editor[currentEditor]->getDocument().getAllContent();
-    Range<int> range;
-    editor[currentEditor]->moveCaretTo(CodeDocument::Position (editor[currentEditor]->getDocument(), temp.indexOf(line)+line.length()), false);
-    editor[currentEditor]->moveCaretTo(CodeDocument::Position (editor[currentEditor]->getDocument(), temp.indexOf(line)), true);
+    CodeDocument& document = editor[currentEditor]->getDocument();
+    const int lineNumber = editor[currentEditor]->findLine(line);
+
+    //text that isn't a whole line has to be searched for
+    const int start = lineNumber>=0 ? CodeDocument::Position (document, lineNumber, 0).getPosition()
+                      : document.getAllContent().indexOf(line);
+
+    editor[currentEditor]->moveCaretTo(CodeDocument::Position (document, start+line.length()), false);
+    editor[currentEditor]->moveCaretTo(CodeDocument::Position (document, start), true);
+}
+//==============================================================================
+// replaces only the part of a line that differs, such as a widget's bounds(),
+// so the rest of the document isn't touched
+//==============================================================================
+void CsoundCodeEditor::setLineText(int lineNumber, const String& text)
+{
+    CodeDocument& document = editor[0]->getDocument();
+    if(!isPositiveAndBelow(lineNumber, document.getNumLines()))
+        return;
+
+    const String oldText(document.getLine(lineNumber).trimCharactersAtEnd("\r\n"));
+    const int oldLength = oldText.length(), newLength = text.length();
+
+    String::CharPointerType oldChars(oldText.getCharPointer()), newChars(text.getCharPointer());
+    int start = 0;
+    while(start<oldLength && start<newLength && *oldChars==*newChars)
+    {
+        ++oldChars;
+        ++newChars;
+        start++;
+    }
+
+    if(start==oldLength && start==newLength)
+        return;
+
+    String::CharPointerType oldEnd(oldText.getCharPointer().findTerminatingNull());
+    String::CharPointerType newEnd(text.getCharPointer().findTerminatingNull());
+    int end = 0;
+    while(end<oldLength-start && end<newLength-start && *--oldEnd==*--newEnd)
+        end++;
+
+    const int lineStart = CodeDocument::Position(document, lineNumber, 0).getPosition();
+    document.replaceSection(lineStart+start, lineStart+oldLength-end, text.substring(start, newLength-end));
 }
 //==============================================================================
 void CsoundCodeEditor::closeCurrentFile()
@@ -541,8 +580,12 @@ void CsoundCodeEditor::actionListenerCallback(const juce::String& message)
 
 //==============================================================================
 CsoundCodeEditorComponenet::CsoundCodeEditorComponenet(String type, CodeDocument &document, CodeTokeniser *codeTokeniser)
-    : CodeEditorComponent(document, codeTokeniser), type(type), columnEditMode(false), fontSize(15)
+    : CodeEditorComponent(document, codeTokeniser), type(type), columnEditMode(false), fontSize(15),
+      csoundTokeniser(dynamic_cast<CsoundTokeniser*>(codeTokeniser)),
+      symbolIndex(document),
+      lineIndex(document)
 {
+    symbolIndex.addChangeListener(this);
 
 #if defined(WIN32)
     font = "Consolas";
@@ -604,6 +647,12 @@ bool CsoundCodeEditorComponenet::keyPressed (const KeyPress& key)
         this->getParentComponent()->repaint();
 
 
+    if (key == KeyPress (KeyPress::spaceKey, ModifierKeys::ctrlModifier, 0))
+    {
+        showAutoComplete();
+        return true;
+    }
+
     if (! TextEditorKeyMapper<CodeEditorComponent>::invokeKeyFunction (*this, key))
     {
 
@@ -1024,39 +1073,71 @@ String CsoundCodeEditorComponenet::getInstrumentText()
     return selectedText;
 }
 //==============================================================================
-void CsoundCodeEditorComponenet::codeDocumentTextInserted(const juce::String &,int)
+void CsoundCodeEditorComponenet::codeDocumentTextInserted(const juce::String &/*text*/,int)
 {
 
     pos1 = getDocument().findWordBreakBefore(getCaretPos());
     String lineFromCsd = getDocument().getLine(pos1.getLineNumber());
 
-    String opcodeHelpString;
-    StringArray syntaxTokens, csdLineTokens;
-    csdLineTokens.clear();
+    //typing on an opcode's definition line updates its highlighting straight
+    //away, anything else is picked up by the symbol index in the background
+    if(CsoundTokeniser::isUserDefinedOpcodeLine(lineFromCsd))
+        updateUserDefinedOpcodes();
+    symbolIndex.documentChanged();
+
+    StringArray csdLineTokens;
     csdLineTokens.addTokens(lineFromCsd, " ,\t", "");
 
-    for(int i=0; i<opcodeStrings.size(); i++)
+    //help for the first opcode on the line
+    for(int x=0; x<csdLineTokens.size(); x++)
     {
-        opcodeHelpString = opcodeStrings[i];
-        syntaxTokens.clear();
-        syntaxTokens.addTokens(opcodeHelpString, ";", "\"");
-        if(syntaxTokens.size()>3)
-            for(int x=0; x<csdLineTokens.size(); x++)
-            {
-                //Logger::writeToLog(csdLineTokens[x]);
-                if(syntaxTokens[0].removeCharacters("\"")==csdLineTokens[x].trim())
-                {
-                    if(syntaxTokens[0].length()>3)
-                    {
-                        //Logger::writeToLog(syntaxTokens[0]);
-                        sendActionMessage("helpDisplay"+syntaxTokens[2]);
-                        opcodeTokens = syntaxTokens;
-                        x=csdLineTokens.size();
-                        i=opcodeStrings.size();
-                    }
-                }
-            }
+        const OpcodeHelp* help = OpcodeDatabase::getInstance().find(csdLineTokens[x].trim());
+        if(help!=nullptr && help->name.length()>3)
+        {
+            opcodeTokens.clear();
+            opcodeTokens.add(help->name);
+            opcodeTokens.add(help->category);
+            opcodeTokens.add(help->description);
+            opcodeTokens.add(help->syntax);
+            sendActionMessage("helpDisplay"+help->description);
+            break;
+        }
+    }
+}
+//==============================================================================
+// completes the word before the caret from the opcodes, and from the
+// instruments, opcodes and channels in the document
+//==============================================================================
+void CsoundCodeEditorComponenet::showAutoComplete()
+{
+    const CodeDocument::Position caret(getCaretPos());
+    const String line(caret.getLineText());
+    int start = caret.getIndexInLine();
+    while(start>0 && (CharacterFunctions::isLetterOrDigit(line[start-1]) || line[start-1]=='_'))
+        start--;
+
+    const String prefix(line.substring(start, caret.getIndexInLine()));
+    if(prefix.isEmpty())
+        return;
+
+    StringArray completions(symbolIndex.getCompletions(prefix, 20));
+    completions.addArray(OpcodeDatabase::getInstance().getCompletions(prefix, 30));
+    completions.removeDuplicates(false);
+    completions.removeString(prefix);
+    if(completions.size()==0)
+        return;
+
+    int choice = 1;
+    if(completions.size()>1)
+    {
+        PopupMenu menu;
+        for(int i=0; i<completions.size(); i++)
+            menu.addItem(i+1, completions[i]);
+        choice = menu.showAt(getCharacterBounds(caret).translated(getScreenX(), getScreenY()));
     }
+
+    if(choice>0)
+        insertTextAtCaret(completions[choice-1].substring(prefix.length()));
 }
 //==============================================================================
 bool CsoundCodeEditorComponenet::deleteBackwards (const bool moveInWholeWordSteps)
@@ -1313,7 +1394,25 @@ bool CsoundCodeEditorComponenet::moveCaretRight (const bool moveInWholeWordSteps
     return true;
 }
 //==============================================================================
-void CsoundCodeEditorComponenet::codeDocumentTextDeleted(int start,int end)
+void CsoundCodeEditorComponenet::codeDocumentTextDeleted(int start,int /*end*/)
 {
-
+    //whole opcode definitions that were deleted are found by the symbol index
+    const CodeDocument::Position position(getDocument(), start);
+    if(CsoundTokeniser::isUserDefinedOpcodeLine(getDocument().getLine(position.getLineNumber())))
+        updateUserDefinedOpcodes();
+    symbolIndex.documentChanged();
+}
+//==============================================================================
+void CsoundCodeEditorComponenet::changeListenerCallback(juce::ChangeBroadcaster* source)
+{
+    //the symbol index has found different user defined opcodes
+    if(source==&symbolIndex && csoundTokeniser
+       && csoundTokeniser->setUserDefinedOpcodeNames(symbolIndex.getUserDefinedOpcodes()))
+        resized();
+}
+//==============================================================================
+void CsoundCodeEditorComponenet::updateUserDefinedOpcodes()
+{
+    if(csoundTokeniser)
+        csoundTokeniser->setUserDefinedOpcodes(getDocument().getAllContent());
 }
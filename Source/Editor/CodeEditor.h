@@ -23,6 +23,8 @@
 #include "../../JuceLibraryCode/JuceHeader.h"
 #include "CsoundTokeniser.h"
 #include "PythonTokeniser.h"
+#include "OpcodeIndex.h"
+#include "CsdLineIndex.h"
 #include "CommandManager.h"
 #include "../CabbageUtils.h"
 
@@ -37,6 +39,7 @@ class SearchReplaceComp;
 class CsoundCodeEditorComponenet : public CodeEditorComponent,
     public ActionBroadcaster,
     public ChangeBroadcaster,
+    public ChangeListener,
     public CodeDocument::Listener
 {
 public:
@@ -91,13 +94,19 @@ public:
     void highlightLines(int firstLine, int lastLine);
     void codeDocumentTextDeleted(int,int);
     void codeDocumentTextInserted(const juce::String &,int);
+    void updateUserDefinedOpcodes();
     bool pasteFromClipboard();
     void insertNewLine(String text);
     void changeListenerCallback(juce::ChangeBroadcaster* source);
     void enableColumnEditMode(bool enable);
     void setOpcodeStrings(String opcodes)
     {
-        opcodeStrings.addLines(opcodes);
+        OpcodeDatabase::getInstance().setOpcodes(opcodes);
+    }
+    void showAutoComplete();
+    int findLine(const String& lineText)
+    {
+        return lineIndex.findLine(lineText);
     }
 
     void insertTextAtCaret (const String &textToInsert);
@@ -119,8 +128,10 @@ private:
     int fontSize;
     String font;
     String type;
-    StringArray opcodeStrings;
     StringArray opcodeTokens;
+    CsoundTokeniser* csoundTokeniser;
+    DocumentSymbolIndex symbolIndex;
+    CsdLineIndex lineIndex;
 
 };
 
@@ -151,6 +162,7 @@ public:
     void changeListenerCallback(juce::ChangeBroadcaster* source);
     String getAllText();
     void setAllText(String text);
+    void setLineText(int lineNumber, const String& text);
     void highlightLine(String line);
     void showTab(String name);
     void showInstrs(bool show);
@@ -0,0 +1,151 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __CSDLINEINDEX_H__
+#define __CSDLINEINDEX_H__
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+// Finds the line a piece of csd text is on, ignoring case and tabs, without
+// searching the document. When attached to a CodeDocument it keeps itself up
+// to date: edits within a line only touch that line's entry, while edits that
+// add or remove lines rebuild the index the next time it's used.
+//==============================================================================
+class CsdLineIndex : private CodeDocument::Listener
+{
+public:
+    CsdLineIndex(CodeDocument& doc)
+        : document(&doc), needsRebuild(true)
+    {
+        document->addListener(this);
+    }
+
+    //for text that isn't open in an editor
+    CsdLineIndex(const String& text)
+        : document(nullptr), needsRebuild(false)
+    {
+        lines.addLines(text);
+        indexLines();
+    }
+
+    ~CsdLineIndex()
+    {
+        if(document!=nullptr)
+            document->removeListener(this);
+    }
+
+    //the first line with this text, or -1
+    int findLine(const String& lineText)
+    {
+        if(needsRebuild)
+            rebuild();
+
+        const String key(getKey(lineText));
+        return firstLines.contains(key) ? firstLines[key] : -1;
+    }
+
+private:
+    static String getKey(const String& lineText)
+    {
+        return lineText.trimCharactersAtEnd("\r\n").replaceCharacter('\t', ' ').toLowerCase();
+    }
+
+    void rebuild()
+    {
+        lines.clearQuick();
+        for(int i=0; i<document->getNumLines(); i++)
+            lines.add(document->getLine(i));
+        indexLines();
+        needsRebuild = false;
+    }
+
+    void indexLines()
+    {
+        firstLines.clear();
+        lineCounts.clear();
+        for(int i=0; i<lines.size(); i++)
+            addLine(getKey(lines[i]), i);
+    }
+
+    void addLine(const String& key, int lineNumber)
+    {
+        lineCounts.set(key, lineCounts[key]+1);
+        if(!firstLines.contains(key) || firstLines[key]>lineNumber)
+            firstLines.set(key, lineNumber);
+    }
+
+    //returns false if the index can't be patched, and has to be rebuilt
+    bool removeLine(const String& key, int lineNumber)
+    {
+        const int count = lineCounts[key];
+        if(count<=1)
+        {
+            lineCounts.remove(key);
+            firstLines.remove(key);
+            return true;
+        }
+
+        //another line has the same text, and might now be the first
+        lineCounts.set(key, count-1);
+        return firstLines[key]!=lineNumber;
+    }
+
+    void documentEdited(int startIndex)
+    {
+        if(needsRebuild)
+            return;
+
+        if(document->getNumLines()!=lines.size())
+        {
+            needsRebuild = true;
+            return;
+        }
+
+        const int lineNumber = CodeDocument::Position(*document, startIndex).getLineNumber();
+        const String newText(document->getLine(lineNumber));
+        if(!removeLine(getKey(lines[lineNumber]), lineNumber))
+        {
+            needsRebuild = true;
+            return;
+        }
+
+        lines.set(lineNumber, newText);
+        addLine(getKey(newText), lineNumber);
+    }
+
+    void codeDocumentTextInserted(const String&, int insertIndex)
+    {
+        documentEdited(insertIndex);
+    }
+
+    void codeDocumentTextDeleted(int startIndex, int)
+    {
+        documentEdited(startIndex);
+    }
+
+    CodeDocument* const document;
+    StringArray lines;
+    HashMap<String, int> firstLines, lineCounts;
+    bool needsRebuild;
+
+    JUCE_DECLARE_NON_COPYABLE (CsdLineIndex)
+};
+
+#endif   // __CSDLINEINDEX_H__
@@ -0,0 +1,119 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __KEYWORDHASHTABLE_H__
+#define __KEYWORDHASHTABLE_H__
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+// A set of words that can be searched for without allocating. The words are
+// packed into one block of text, and an open addressed table, at most half
+// full, holds each word's hash and position in it. A lookup is one hash of the
+// token and, nearly always, a single compare.
+//==============================================================================
+class KeywordHashTable
+{
+public:
+    KeywordHashTable() : mask(0) {}
+
+    void setWords(const StringArray& words)
+    {
+        StringArray unique(words);
+        unique.trim();
+        unique.removeEmptyStrings();
+        unique.removeDuplicates(false);
+
+        int numSlots = 16;
+        while(numSlots<unique.size()*2)
+            numSlots *= 2;
+
+        slots.clear();
+        slots.insertMultiple(0, Slot(), numSlots);
+        mask = (uint32)numSlots-1;
+        text.reset();
+
+        for(int i=0; i<unique.size(); i++)
+        {
+            const char* const word = unique[i].toRawUTF8();
+            const int length = (int)strlen(word);
+            const uint32 hash = getHash(word, length);
+
+            uint32 index = hash & mask;
+            while(slots.getReference((int)index).length!=0)
+                index = (index+1) & mask;
+
+            Slot& slot = slots.getReference((int)index);
+            slot.hash = hash;
+            slot.offset = (int)text.getDataSize();
+            slot.length = length;
+            text.write(word, (size_t)length);
+        }
+    }
+
+    bool contains(const char* word, int length) const noexcept
+    {
+        if(slots.size()==0 || length<=0)
+            return false;
+
+        const uint32 hash = getHash(word, length);
+        const char* const words = (const char*)text.getData();
+
+        for(uint32 index = hash & mask;; index = (index+1) & mask)
+        {
+            const Slot& slot = slots.getReference((int)index);
+            if(slot.length==0)
+                return false;
+
+            if(slot.hash==hash && slot.length==length && memcmp(words+slot.offset, word, (size_t)length)==0)
+                return true;
+        }
+    }
+
+    bool contains(const String& word) const noexcept
+    {
+        const char* const utf8 = word.toRawUTF8();
+        return contains(utf8, (int)strlen(utf8));
+    }
+
+private:
+    struct Slot
+    {
+        Slot() : hash(0), offset(0), length(0) {}
+        uint32 hash;
+        int offset, length;
+    };
+
+    //FNV-1a
+    static uint32 getHash(const char* word, int length) noexcept
+    {
+        uint32 hash = 2166136261u;
+        for(int i=0; i<length; i++)
+            hash = (hash ^ (uint8)word[i]) * 16777619u;
+        return hash;
+    }
+
+    Array<Slot> slots;
+    MemoryOutputStream text;
+    uint32 mask;
+
+    JUCE_DECLARE_NON_COPYABLE (KeywordHashTable)
+};
+
+#endif   // __KEYWORDHASHTABLE_H__
@@ -0,0 +1,296 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __OPCODEINDEX_H__
+#define __OPCODEINDEX_H__
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+// Words kept in sorted order, so that all the words starting with a prefix sit
+// next to each other and can be found with a binary search
+//==============================================================================
+class PrefixIndex
+{
+public:
+    PrefixIndex() {}
+
+    void setWords(const StringArray& words)
+    {
+        sorted = words;
+        sorted.removeEmptyStrings();
+        sorted.removeDuplicates(false);
+        sorted.sort(false);
+    }
+
+    StringArray getWordsStartingWith(const String& prefix, int maxResults) const
+    {
+        StringArray results;
+        if(prefix.isEmpty())
+            return results;
+
+        int start = 0, end = sorted.size();
+        while(start<end)
+        {
+            const int middle = (start+end)/2;
+            if(sorted[middle].compare(prefix)<0)
+                start = middle+1;
+            else
+                end = middle;
+        }
+
+        for(int i=start; i<sorted.size() && results.size()<maxResults && sorted[i].startsWith(prefix); i++)
+            results.add(sorted[i]);
+        return results;
+    }
+
+private:
+    StringArray sorted;
+};
+
+//==============================================================================
+// The help for each opcode, parsed once from opcodes.txt, where each line is
+//   "name"; "category"; "description"; "syntax"
+//==============================================================================
+struct OpcodeHelp
+{
+    String name, category, description, syntax;
+};
+
+class OpcodeDatabase
+{
+public:
+    OpcodeDatabase() {}
+
+    //shared by every code editor
+    static OpcodeDatabase& getInstance()
+    {
+        static OpcodeDatabase database;
+        return database;
+    }
+
+    void setOpcodes(const String& opcodesText)
+    {
+        StringArray lines, names;
+        lines.addLines(opcodesText);
+        opcodes.clearQuick();
+        index.clear();
+
+        for(int i=0; i<lines.size(); i++)
+        {
+            StringArray fields;
+            fields.addTokens(lines[i], ";", "\"");
+            if(fields.size()<4)
+                continue;
+
+            OpcodeHelp help;
+            help.name = fields[0].trim().removeCharacters("\"");
+            help.category = fields[1].trim().removeCharacters("\"");
+            help.description = fields[2].trim().removeCharacters("\"");
+            help.syntax = fields[3].trim().removeCharacters("\"");
+
+            if(help.name.isNotEmpty() && !index.contains(help.name))
+            {
+                index.set(help.name, opcodes.size());
+                opcodes.add(help);
+                names.add(help.name);
+            }
+        }
+        completions.setWords(names);
+    }
+
+    const OpcodeHelp* find(const String& name) const
+    {
+        return index.contains(name) ? &opcodes.getReference(index[name]) : nullptr;
+    }
+
+    StringArray getCompletions(const String& prefix, int maxResults) const
+    {
+        return completions.getWordsStartingWith(prefix, maxResults);
+    }
+
+private:
+    Array<OpcodeHelp> opcodes;
+    HashMap<String, int> index;
+    PrefixIndex completions;
+
+    JUCE_DECLARE_NON_COPYABLE (OpcodeDatabase)
+};
+
+//==============================================================================
+// The instruments, user defined opcodes and channels named in a csd. A short
+// while after the document stops changing its text is handed to a background
+// thread, which indexes it without holding up typing. A change message is sent
+// whenever the user defined opcodes it finds are different.
+//==============================================================================
+class DocumentSymbolIndex : public ChangeBroadcaster,
+    private Thread,
+    private Timer
+{
+public:
+    DocumentSymbolIndex(CodeDocument& doc)
+        : Thread("csd symbol index"), document(doc), hasPendingText(false)
+    {}
+
+    ~DocumentSymbolIndex()
+    {
+        stopTimer();
+        signalThreadShouldExit();
+        notify();
+        stopThread(1000);
+    }
+
+    void documentChanged()
+    {
+        startTimer(500);
+    }
+
+    StringArray getCompletions(const String& prefix, int maxResults) const
+    {
+        const ScopedLock sl(lock);
+        return symbols.getWordsStartingWith(prefix, maxResults);
+    }
+
+    StringArray getUserDefinedOpcodes() const
+    {
+        const ScopedLock sl(lock);
+        return opcodeNames;
+    }
+
+    static StringArray findSymbols(const String& csdText, StringArray* userDefinedOpcodes = nullptr)
+    {
+        StringArray lines, found;
+        lines.addLines(csdText);
+
+        for(int i=0; i<lines.size(); i++)
+        {
+            const String line(lines[i].upToFirstOccurrenceOf(";", false, false).trim());
+            StringArray tokens;
+            tokens.addTokens(line, " \t,", "");
+            tokens.removeEmptyStrings();
+
+            //named instruments, and opcodes
+            if(tokens[0]=="instr")
+            {
+                for(int y=1; y<tokens.size(); y++)
+                    if(!tokens[y].containsOnly("0123456789"))
+                        found.add(tokens[y]);
+            }
+            else if(tokens[0]=="opcode")
+            {
+                found.add(tokens[1]);
+                if(userDefinedOpcodes!=nullptr)
+                    userDefinedOpcodes->add(tokens[1]);
+            }
+
+            //channels, named in channel("...") or as the first string given
+            //to chnget/chnset and friends
+            else if(line.contains("channel("))
+                addQuotedStrings(found, line.fromFirstOccurrenceOf("channel(", false, false)
+                                 .upToFirstOccurrenceOf(")", false, false), -1);
+            else
+            {
+                for(int y=0; y<tokens.size(); y++)
+                    if(tokens[y].startsWith("chn"))
+                    {
+                        const String opcode(tokens[y].upToFirstOccurrenceOf("\"", false, false));
+                        addQuotedStrings(found, line.substring(line.indexOfWholeWord(opcode)+opcode.length()), 1);
+                        break;
+                    }
+            }
+        }
+        return found;
+    }
+
+private:
+    //maxStrings of -1 adds every one
+    static void addQuotedStrings(StringArray& found, const String& text, int maxStrings)
+    {
+        for(int start = text.indexOfChar('"'); start>=0 && maxStrings!=0; maxStrings--)
+        {
+            const int end = text.indexOfChar(start+1, '"');
+            if(end<0)
+                break;
+            found.add(text.substring(start+1, end));
+            start = text.indexOfChar(end+1, '"');
+        }
+    }
+
+    void timerCallback()
+    {
+        stopTimer();
+        {
+            const ScopedLock sl(lock);
+            pendingText = document.getAllContent();
+            hasPendingText = true;
+        }
+
+        if(!isThreadRunning())
+            startThread(1);
+        notify();
+    }
+
+    void run()
+    {
+        while(!threadShouldExit())
+        {
+            String text;
+            bool hasText;
+            {
+                const ScopedLock sl(lock);
+                text = pendingText;
+                hasText = hasPendingText;
+                pendingText = String::empty;
+                hasPendingText = false;
+            }
+
+            if(!hasText)
+            {
+                wait(-1);
+                continue;
+            }
+
+            StringArray newOpcodeNames;
+            PrefixIndex newSymbols;
+            newSymbols.setWords(findSymbols(text, &newOpcodeNames));
+
+            bool opcodesChanged;
+            {
+                const ScopedLock sl(lock);
+                symbols = newSymbols;
+                opcodesChanged = newOpcodeNames!=opcodeNames;
+                opcodeNames = newOpcodeNames;
+            }
+
+            if(opcodesChanged)
+                sendChangeMessage();
+        }
+    }
+
+    CodeDocument& document;
+    CriticalSection lock;
+    String pendingText;
+    bool hasPendingText;
+    PrefixIndex symbols;
+    StringArray opcodeNames;
+
+    JUCE_DECLARE_NON_COPYABLE (DocumentSymbolIndex)
+};
+
+#endif   // __OPCODEINDEX_H__
@@ -22,17 +22,13 @@
 
 
 #define BUTTON_SIZE 25
-WaveformDisplay::WaveformDisplay(AudioFormatManager& formatManager, BufferingAudioSource *source, int sr, Colour col):
-    thumbnailCache(15),
-    thumbnail (16, formatManager, thumbnailCache),
-    source(source),
+WaveformDisplay::WaveformDisplay(AudioFilePlaybackProcessor* processor, Colour col):
+    processor(processor),
     tableColour(col),
-    sampleRate(sr),
     scrollbar(false),
     currentPlayPosition(0),
     gainEnvelope(Colours::cornflowerblue, -1, -1)
 {
-    thumbnail.addChangeListener(this);
     addAndMakeVisible(gainEnvelope);
     currentPositionMarker.setFill (Colours::lime);
     addAndMakeVisible(currentPositionMarker);
@@ -60,7 +56,6 @@ void WaveformDisplay::resized()
 void WaveformDisplay::setScrubberPos(double pos)
 {
     currentPositionMarker.setVisible (true);
-    //pos = (pos/(thumbnail.getTotalLength()*sampleRate))*thumbnail.getTotalLength();
     currentPositionMarker.setRectangle (Rectangle<float> (timeToX (pos) - 0.75f, 0,
                                         1.5f, (float) (getHeight() - (scrollbar.getHeight()+5))));
 
@@ -81,37 +76,37 @@ void WaveformDisplay::showGainEnvelope(bool show)
 
 void WaveformDisplay::setFile (const File& file)
 {
-    AudioFormatManager format;
-    format.registerBasicFormats();
-    AudioFormatReader* reader = format.createReaderFor(file);
-
-    if(reader)
+    //peaks are shared with every other waveform showing this file and are
+    //filled in on a background thread, see PeakFileCache
+    if(samplePeaks.setFile(file, this))
     {
-        AudioSampleBuffer buffer(reader->numChannels, reader->lengthInSamples);
-        buffer.clear();
-        buffer.setSize(reader->numChannels, reader->lengthInSamples);
-        reader->read(&buffer,0, buffer.getNumSamples(), 0, true, true);
-        setWaveform(buffer, reader->numChannels);
+        const Range<double> newRange (0.0, getTotalLength());
+        scrollbar.setRangeLimits (newRange);
+        setRange (newRange);
     }
-
-    delete reader;
 }
 
 void WaveformDisplay::setWaveform(AudioSampleBuffer buffer, int channels)
 {
-    thumbnail.clear();
-    thumbnail.reset(channels, 44100, buffer.getNumSamples());
-    thumbnail.addBlock(0, buffer, 0, buffer.getNumSamples());
-    const Range<double> newRange (0.0, thumbnail.getTotalLength());
+    if(buffer.getNumChannels()>channels && channels>0)
+        samplePeaks.setBuffer(AudioSampleBuffer(buffer.getArrayOfWritePointers(), channels, buffer.getNumSamples()));
+    else
+        samplePeaks.setBuffer(buffer);
+    const Range<double> newRange (0.0, getTotalLength());
     scrollbar.setRangeLimits (newRange);
     setRange (newRange);
 }
 
+double WaveformDisplay::getTotalLength() const
+{
+    return samplePeaks.getNumSamples()/processor->getFileSampleRate();
+}
+
 void WaveformDisplay::setZoomFactor (double amount)
 {
-    if (thumbnail.getTotalLength() > 0)
+    if (getTotalLength() > 0)
     {
-        const double newScale = jmax (0.001, thumbnail.getTotalLength() * (1.0 - jlimit (0.0, 0.99, amount)));
+        const double newScale = jmax (0.001, getTotalLength() * (1.0 - jlimit (0.0, 0.99, amount)));
         const double timeAtCentre = xToTime (getWidth() / 2.0f);
         setRange (Range<double> (timeAtCentre - newScale * 0.5, timeAtCentre + newScale * 0.5));
     }
@@ -126,8 +121,8 @@ void WaveformDisplay::setRange (Range<double> newRange)
     const double visibleEnd = visibleRange.getEnd();
     const double visibleLength = visibleRange.getLength();
 
-    const double newWidth = double(getWidth())*(double(thumbnail.getTotalLength())/visibleLength);
-    const double leftOffset = newWidth*(visibleStart/(double)thumbnail.getTotalLength());
+    const double newWidth = double(getWidth())*(double(getTotalLength())/visibleLength);
+    const double leftOffset = newWidth*(visibleStart/(double)getTotalLength());
     gainEnvelope.setSize(newWidth, gainEnvelope.getHeight());
     gainEnvelope.setTopLeftPosition(-leftOffset, 0);
 
@@ -142,12 +137,13 @@ void WaveformDisplay::paint (Graphics& g)
 
     //cUtils::debug("repainting");
 
-    if (thumbnail.getTotalLength() > 0)
+    if (getTotalLength() > 0)
     {
         Rectangle<int> thumbArea (getLocalBounds());
         thumbArea.removeFromBottom (scrollbar.getHeight() + 4);
-        thumbnail.drawChannels (g, thumbArea.reduced (2),
-                                visibleRange.getStart(), visibleRange.getEnd(), 1.0f);
+        samplePeaks.drawChannels (g, thumbArea.reduced (2),
+                                  visibleRange.getStart()*processor->getFileSampleRate(),
+                                  visibleRange.getEnd()*processor->getFileSampleRate(), 1.0f);
     }
     else
     {
@@ -159,18 +155,18 @@ void WaveformDisplay::paint (Graphics& g)
 
 void WaveformDisplay::timerCallback()
 {
-    if(thumbnail.getTotalLength()>0 && getEditor()->getFilter()->isSourcePlaying==true)
+    if(getTotalLength()>0 && processor->isSourcePlaying==true)
     {
-        currentPlayPosition = source->getNextReadPosition()/sampleRate;
+        currentPlayPosition = processor->getPlaybackPosition()/processor->getFileSampleRate();
         setScrubberPos(currentPlayPosition);
     }
 }
 
 void WaveformDisplay::mouseDown (const MouseEvent& e)
 {
-    if(thumbnail.getTotalLength()>0)
+    if(getTotalLength()>0)
     {
-        source->setNextReadPosition (jmax (0.0, xToTime ((float) e.x)*sampleRate));
+        processor->setPlaybackPosition ((int64) (jmax (0.0, xToTime ((float) e.x))*processor->getFileSampleRate()));
         currentPlayPosition = jmax (0.0, xToTime ((float) e.x));
         setScrubberPos(currentPlayPosition);
     }
@@ -178,9 +174,9 @@ void WaveformDisplay::mouseDown (const MouseEvent& e)
 
 void WaveformDisplay::mouseDrag (const MouseEvent& e)
 {
-    if(thumbnail.getTotalLength()>0)
+    if(getTotalLength()>0)
     {
-        source->setNextReadPosition (jmax (0.0, xToTime ((float) e.x)*sampleRate));
+        processor->setPlaybackPosition ((int64) (jmax (0.0, xToTime ((float) e.x))*processor->getFileSampleRate()));
         currentPlayPosition = jmax (0.0, xToTime ((float) e.x));
         setScrubberPos(currentPlayPosition);
     }
@@ -228,14 +224,11 @@ AudioFilePlaybackEditor::AudioFilePlaybackEditor (AudioFilePlaybackProcessor* ow
     gainEnvelopeButton("gainEnvelopeButton", DrawableButton::ImageOnButtonBackground),
     zoom(0)
 {
-    AudioFormatManager formatManager;
-    formatManager.registerBasicFormats();
-
     tableColour = Colour(Random::getSystemRandom().nextInt(255),
                          Random::getSystemRandom().nextInt(255),
                          Random::getSystemRandom().nextInt(255));
 
-    waveformDisplay = new WaveformDisplay(formatManager, getFilter()->bufferingAudioFileSource, getFilter()->sourceSampleRate, tableColour);
+    waveformDisplay = new WaveformDisplay(getFilter(), tableColour);
 
 
     setOpaque(true);
@@ -431,12 +424,8 @@ void AudioFilePlaybackEditor::itemDropped (const DragAndDropTarget::SourceDetail
     if(FileTreeComponent* fileComp = dynamic_cast<FileTreeComponent*>(dragSourceDetails.sourceComponent.get()))
     {
         getFilter()->setupAudioFile(fileComp->getSelectedFile());
-        getFilter()->prepareToPlay(0, 512);
-        if(getFilter()->bufferingAudioFileSource)
-        {
-            waveformDisplay->source = getFilter()->bufferingAudioFileSource;
+        if(getFilter()->hasAudioFile())
             waveformDisplay->setFile(fileComp->getSelectedFile());
-        }
     }
 }
 
@@ -451,7 +440,7 @@ void AudioFilePlaybackEditor::buttonClicked(Button *button)
 
     if(button->getName()=="playButton")
     {
-        if(getFilter()->bufferingAudioFileSource)
+        if(getFilter()->hasAudioFile())
         {
             if(!getFilter()->isSourcePlaying)
                 waveformDisplay->startTimer(50);
@@ -488,14 +477,13 @@ void AudioFilePlaybackEditor::buttonClicked(Button *button)
 
     else if(button->getName()=="stopButton")
     {
-        if(getFilter()->bufferingAudioFileSource)
+        if(getFilter()->hasAudioFile())
         {
             playButton.setToggleState(false, dontSendNotification);
             waveformDisplay->stopTimer();
             getFilter()->isSourcePlaying=false;
-            getFilter()->resetGainEnv();
             waveformDisplay->resetPlaybackPosition();
-            getFilter()->setBufferingReadPosition(0);
+            getFilter()->setPlaybackPosition(0);
         }
     }
 
@@ -506,12 +494,8 @@ void AudioFilePlaybackEditor::buttonClicked(Button *button)
         if (fc.browseForFileToOpen())
         {
             getFilter()->setupAudioFile(fc.getResult());
-            getFilter()->prepareToPlay(0, 512);
-            if(getFilter()->bufferingAudioFileSource)
-            {
-                waveformDisplay->source = getFilter()->bufferingAudioFileSource;
+            if(getFilter()->hasAudioFile())
                 waveformDisplay->setFile(fc.getResult());
-            }
 
         }
     }
@@ -521,8 +505,7 @@ void AudioFilePlaybackEditor::buttonClicked(Button *button)
         if(button->getToggleState()==true)
         {
             waveformDisplay->resetPlaybackPosition();
-            getFilter()->setBufferingReadPosition(0);
-            getFilter()->resetGainEnv();
+            getFilter()->setPlaybackPosition(0);
             playButton.setToggleState(false, dontSendNotification);
             button->setToggleState(false, dontSendNotification);
             getFilter()->linkToMasterTransport(false);
@@ -533,9 +516,8 @@ void AudioFilePlaybackEditor::buttonClicked(Button *button)
         else
         {
             waveformDisplay->resetPlaybackPosition();
-            getFilter()->resetGainEnv();
             waveformDisplay->startTimer(50);
-            getFilter()->setBufferingReadPosition(0);
+            getFilter()->setPlaybackPosition(0);
             playButton.setToggleState(false, dontSendNotification);
             button->setToggleState(true, dontSendNotification);
             getFilter()->linkToMasterTransport(true);
@@ -23,6 +23,7 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "AudioFilePlaybackProcessor.h"
 #include "../CabbageLookAndFeel.h"
+#include "../WaveformPeaks.h"
 #include "BreakpointEnvelope.h"
 
 class AudioFilePlaybackEditor;
@@ -33,7 +34,7 @@ class WaveformDisplay : public Component,
     private ScrollBar::Listener
 {
 public:
-    WaveformDisplay(AudioFormatManager& formatManager, BufferingAudioSource *source, int sr, Colour col);
+    WaveformDisplay(AudioFilePlaybackProcessor* processor, Colour col);
     ~WaveformDisplay();
 
 
@@ -53,7 +54,7 @@ public:
     void resetPlaybackPosition();
     void resized() override;
 
-    BufferingAudioSource* source;
+    AudioFilePlaybackProcessor* processor;
 
     AudioFilePlaybackEditor* getEditor()
     {
@@ -64,12 +65,10 @@ private:
     Range<double> visibleRange;
     //Slider& zoomSlider;
     ScrollBar scrollbar;
-    AudioThumbnailCache thumbnailCache;
-
-    AudioThumbnail thumbnail;
+    WaveformPeaks samplePeaks;
+    double getTotalLength() const;
     double startTime, endTime;
     Rectangle<int> localBounds;
-    float sampleRate;
     double currentPlayPosition;
     Colour tableColour;
     DrawableRectangle currentPositionMarker;
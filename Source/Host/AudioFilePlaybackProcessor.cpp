@@ -15,190 +15,267 @@
 
 //==============================================================================
 AudioFilePlaybackProcessor::AudioFilePlaybackProcessor():
-    thread("audio file playback"),
     isSourcePlaying(false),
     shouldLoop(false),
     isLinkedToMasterTransport(false),
-    sourceSampleRate(44100),
+    thread("audio file playback"),
     rmsLeft(0),
     rmsRight(0),
-    updateCounter(0),
+    rmsChanged(0),
     beatOffset(0),
+    showGainEnv(false),
+    lastGain(1),
     gain(.5f),
-    pan(.5f),
-    envPointIncr(0),
-    gainSampleIndex(0),
-    gainOutputValue(1)
+    pan(.5f)
 {
-    //setupAudioFile(File("/home/rory/Documents/BeesInMarch4.wav"));
-    bufferingAudioFileSource = nullptr;
+    formatManager.registerBasicFormats();
     parameterNames.add("Gain");
     parameterNames.add("Pan");
+    //meters are sent from here rather than from the audio thread
+    startTimer(50);
 }
 
 AudioFilePlaybackProcessor::~AudioFilePlaybackProcessor()
 {
-    thread.stopThread(10);
+    stopTimer();
     isSourcePlaying = false;
-    delete bufferingAudioFileSource;
-    fileSource= nullptr;
+    {
+        const SpinLock::ScopedLockType sl(streamerLock);
+        streamer = nullptr;
+    }
+    thread.stopThread(100);
 }
 
 void AudioFilePlaybackProcessor::setupAudioFile (File soundfile)
 {
-    if(soundfile.exists())
+    if(!soundfile.existsAsFile())
+        return;
+
+    //the new file is opened and its buffers sized before the audio thread sees it
+    ScopedPointer<AudioFileStreamer> newStreamer(new AudioFileStreamer(thread));
+    if(!newStreamer->open(soundfile, formatManager))
+        return;
+
+    newStreamer->prepare(getSampleRate(), getBlockSize());
+    newStreamer->setLooping(shouldLoop);
+
     {
-        AudioFormatManager formatManager;
-        formatManager.registerBasicFormats();
-        AudioFormatReader* reader = formatManager.createReaderFor(soundfile);
-        if (reader != 0)
-        {
-            fileSource = new AudioFormatReaderSource (reader, true);
-            numFileChannels = reader->numChannels;
-            //setting up buffer with two channels, regardless of the number of channels in our soundfile
-            bufferingAudioFileSource = new BufferingAudioSource(fileSource, thread, true, 32768, 2);
-            samplingRate =reader->sampleRate;
-            thread.startThread();
-            currentFile = soundfile.getFullPathName();
-            totalLength = bufferingAudioFileSource->getTotalLength();
-        }
+        const SpinLock::ScopedLockType sl(streamerLock);
+        streamer.swapWith(newStreamer);
+        gainBuffer.setSize(1, streamer->getMaxBlockSize());
     }
+
+    thread.startThread();
+    streamer->start();
+    currentFile = soundfile.getFullPathName();
+}
+
+int64 AudioFilePlaybackProcessor::getPlaybackPosition()
+{
+    const SpinLock::ScopedLockType sl(streamerLock);
+    return streamer!=nullptr ? streamer->getPosition() : 0;
+}
+
+void AudioFilePlaybackProcessor::setPlaybackPosition(int64 position)
+{
+    const SpinLock::ScopedLockType sl(streamerLock);
+    if(streamer!=nullptr)
+        streamer->seek(position);
+}
+
+double AudioFilePlaybackProcessor::getFileSampleRate()
+{
+    const SpinLock::ScopedLockType sl(streamerLock);
+    return streamer!=nullptr ? streamer->getFileSampleRate() : 44100;
+}
+
+int AudioFilePlaybackProcessor::getNumUnderruns()
+{
+    const SpinLock::ScopedLockType sl(streamerLock);
+    return streamer!=nullptr ? streamer->getNumUnderruns() : 0;
 }
 //==============================================================================
 void AudioFilePlaybackProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    if(sampleRate==0)
-        sampleRate = samplingRate;
-
-    if(bufferingAudioFileSource)
-        bufferingAudioFileSource->prepareToPlay(samplesPerBlock, sampleRate);
+    const SpinLock::ScopedLockType sl(streamerLock);
+    if(streamer!=nullptr)
+    {
+        streamer->prepare(sampleRate, samplesPerBlock);
+        gainBuffer.setSize(1, streamer->getMaxBlockSize());
+    }
 }
 //==============================================================================
 void AudioFilePlaybackProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
 {
-    if(bufferingAudioFileSource)
+    //the message thread only holds the lock while it swaps files
+    const GenericScopedTryLock<SpinLock> sl(streamerLock);
+    if(!sl.isLocked() || streamer==nullptr)
     {
-        if(isLinkedToMasterTransport)
+        buffer.clear();
+        return;
+    }
+
+    if(isLinkedToMasterTransport)
+    {
+        if (getPlayHead() != 0 && getPlayHead()->getCurrentPosition(hostInfo))
         {
-            if (getPlayHead() != 0 && getPlayHead()->getCurrentPosition(hostInfo))
+            if(!hostInfo.isPlaying && hostInfo.ppqPosition==0)
             {
-                if((!hostInfo.isPlaying && hostInfo.ppqPosition==0))
-                {
-                    bufferingAudioFileSource->setNextReadPosition(0);
-                    isSourcePlaying=true;
-                    gainSampleIndex=0;
-                }
-
-                if(hostInfo.isPlaying && hostInfo.ppqPosition>=beatOffset)
-                {
-                    if(isSourcePlaying)
-                        playSoundFile(buffer);
-                }
-                else
-                {
-                    for (int i = getNumInputChannels(); i < getNumOutputChannels(); ++i)
-                    {
-                        buffer.clear (i, 0, buffer.getNumSamples());
-                    }
-                }
+                if(streamer->getPosition()!=0)
+                    streamer->seek(0);
+                isSourcePlaying=true;
+            }
 
+            if(hostInfo.isPlaying && hostInfo.ppqPosition>=beatOffset && isSourcePlaying)
+            {
+                playSoundFile(buffer);
+                return;
             }
         }
-        else
-        {
-            if(isSourcePlaying)
-                playSoundFile(buffer, false);
-        }
-
+        buffer.clear();
     }
+    else if(isSourcePlaying)
+        playSoundFile(buffer);
     else
         buffer.clear();
 }
 //==============================================================================
-void AudioFilePlaybackProcessor::playSoundFile(AudioSampleBuffer& buffer, bool isLinked)
+void AudioFilePlaybackProcessor::playSoundFile(AudioSampleBuffer& buffer)
 {
-    float *audioFileBuffer, *audioOutputBuffer;
-    if(bufferingAudioFileSource)
+    const int numOutputs = buffer.getNumChannels();
+    const int numFileChannels = streamer->getNumChannels();
+    const float channelGains[2] = { gain*2*pan, gain*2*(1.f-pan) };
+
+    for(int start=0; start<buffer.getNumSamples();)
     {
-        AudioSampleBuffer fillBuffer (2, buffer.getNumSamples());
-        sourceChannelInfo.buffer = &fillBuffer;
-        sourceChannelInfo.startSample = 0;
-        sourceChannelInfo.numSamples = fillBuffer.getNumSamples();
+        const int numSamples = jmin(buffer.getNumSamples()-start, streamer->getMaxBlockSize());
+        int64 position;
+        const bool stillPlaying = streamer->renderNextBlock(numSamples, position);
+        const AudioSampleBuffer& fileOutput = streamer->getOutput();
 
-        if(bufferingAudioFileSource->getNextReadPosition()>=bufferingAudioFileSource->getTotalLength())
+        //if the editor is changing the envelope, hold the last gain for a block
+        bool useEnvelope = true;
         {
-            envPointIncr=0;
-            gainSampleIndex=0;
-            bufferingAudioFileSource->setNextReadPosition(0);
-            if(!shouldLoop)
-                isSourcePlaying=false;
+            const GenericScopedTryLock<SpinLock> envelopeLock(envLock);
+            if(!envelopeLock.isLocked())
+                FloatVectorOperations::fill(gainBuffer.getWritePointer(0), lastGain, numSamples);
+            else if(envPoints.size()>0)
+            {
+                fillGainEnvelope(gainBuffer.getWritePointer(0), numSamples, position,
+                                 streamer->getResamplingRatio(), streamer->getLength());
+                lastGain = gainBuffer.getSample(0, numSamples-1);
+            }
+            else
+            {
+                useEnvelope = false;
+                lastGain = 1.f;
+            }
         }
 
-
-        bufferingAudioFileSource->getNextAudioBlock(sourceChannelInfo);
-        for(int i=0; i<buffer.getNumSamples(); i++)
+        //a mono file goes to every output, otherwise file channels wrap around the outputs
+        for(int out=0; out<numOutputs; out++)
         {
-            float gainValue = getGainEnvelop(gainSampleIndex)*(gain*2);
-            for (int channel = 0; channel < fillBuffer.getNumChannels(); ++channel)
+            bool written = false;
+            for(int channel=0; channel<numFileChannels; channel++)
             {
-                audioFileBuffer = fillBuffer.getWritePointer(channel, 0);
-                audioOutputBuffer = buffer.getWritePointer(channel, 0);
-                audioOutputBuffer[i] = audioFileBuffer[i]*gainValue*(channel==0.f ? pan : 1.f-pan);
+                if(numFileChannels==1 || channel%numOutputs==out)
+                {
+                    if(written)
+                        buffer.addFrom(out, start, fileOutput, channel, 0, numSamples);
+                    else
+                        buffer.copyFrom(out, start, fileOutput, channel, 0, numSamples);
+                    written = true;
+                }
             }
 
-            gainSampleIndex++;
-        }
+            if(!written)
+            {
+                buffer.clear(out, start, numSamples);
+                continue;
+            }
 
-        for (int i = getNumInputChannels(); i < getNumOutputChannels(); ++i)
-        {
-            buffer.clear (i, 0, buffer.getNumSamples());
+            float* const data = buffer.getWritePointer(out, start);
+            if(useEnvelope)
+                FloatVectorOperations::multiply(data, gainBuffer.getReadPointer(0), numSamples);
+            FloatVectorOperations::multiply(data, out<2 ? channelGains[out] : gain*2, numSamples);
         }
 
+        start += numSamples;
 
-        rmsLeft = buffer.getRMSLevel(0, 0, buffer.getNumSamples());
-        rmsRight = buffer.getRMSLevel(1, 0, buffer.getNumSamples());
-
+        if(!stillPlaying)
+        {
+            buffer.clear(start, buffer.getNumSamples()-start);
+            streamer->seek(0);
+            isSourcePlaying=false;
+            break;
+        }
+    }
 
-        if(updateCounter==0)
-            sendActionMessage("rmsValues "+String(rmsLeft)+" "+String(rmsRight));
+    rmsLeft = buffer.getRMSLevel(0, 0, buffer.getNumSamples());
+    rmsRight = buffer.getRMSLevel(jmin(1, numOutputs-1), 0, buffer.getNumSamples());
+    rmsChanged.set(1);
+}
 
-        updateCounter++;
-        if(updateCounter>5)
-            updateCounter=0;
-    }
+void AudioFilePlaybackProcessor::timerCallback()
+{
+    if(rmsChanged.compareAndSetBool(0, 1))
+        sendActionMessage("rmsValues "+String(rmsLeft)+" "+String(rmsRight));
 }
 //==============================================================================
-float AudioFilePlaybackProcessor::getGainEnvelop(int& index)
+//the envelope points are placed at x*length in the file, with an amplitude of
+//1-y, and are held flat before the first and after the last. Each stretch of
+//the block that falls between two points is filled as a single ramp.
+void AudioFilePlaybackProcessor::fillGainEnvelope(float* dest, int numSamples, int64 startPosition, double ratio, int64 length)
 {
-    const int duration = envPoints[envPointIncr+1].getX()*totalLength-envPoints[envPointIncr].getX()*totalLength;;
+    const int numPoints = envPoints.size();
+    double position = (double)startPosition;
 
-    if(envPointIncr<envPoints.size()-1)
+    for(int i=0; i<numSamples;)
     {
-        if(index<duration)
+        if(position>=length)
+            position -= length;
+
+        int next = 0;
+        while(next<numPoints && envPoints.getReference(next).getX()*length<=position)
+            next++;
+
+        float value, step;
+        double segmentEnd;
+        if(next==0 || next==numPoints)
         {
-            const float amp1 = 1.f-envPoints[envPointIncr].getY();
-            const float amp2 = 1.f-envPoints[envPointIncr+1].getY();
-            float scale =  (float(index)/float(duration));
-            gainOutputValue = amp1 + (float(index)/float(duration))*(amp2-amp1);
-            return gainOutputValue;
+            value = 1.f-(float)envPoints.getReference(next==0 ? 0 : numPoints-1).getY();
+            step = 0;
+            segmentEnd = (next==0 ? envPoints.getReference(0).getX()*length : (double)length);
         }
         else
         {
-            envPointIncr++;
-            index=0;
-            return gainOutputValue;
+            const Point<double>& previous = envPoints.getReference(next-1);
+            const Point<double>& point = envPoints.getReference(next);
+            const double segmentStart = previous.getX()*length;
+            segmentEnd = point.getX()*length;
+            const double slope = (previous.getY()-point.getY())/(segmentEnd-segmentStart);
+            value = (float)(1.0-previous.getY()+(position-segmentStart)*slope);
+            step = (float)(slope*ratio);
         }
+
+        const int count = jlimit(1, numSamples-i, (int)std::ceil((segmentEnd-position)/ratio));
+        for(int k=0; k<count; k++)
+            dest[i+k] = value+k*step;
+
+        i += count;
+        position += count*ratio;
     }
-    else return 0.f;
 }
 
 void AudioFilePlaybackProcessor::addEnvDataPoint(Point<double> point)
 {
+    const SpinLock::ScopedLockType sl(envLock);
     envPoints.add(point);
 }
 
 void AudioFilePlaybackProcessor::updateEnvPoints(Array<Point<double>> points)
 {
+    const SpinLock::ScopedLockType sl(envLock);
     envPoints.swapWith(points);
 }
 
@@ -360,7 +437,7 @@ void AudioFilePlaybackProcessor::setStateInformation (const void* data, int size
         gain = xmlState->getDoubleAttribute("gain");
         pan = xmlState->getDoubleAttribute("pan");
         isLinkedToMasterTransport = (bool)xmlState->getIntAttribute("isLinkedToMasterTransport");
-        shouldLoop = (bool)xmlState->getIntAttribute("shouldLoop");
+        setLooping((bool)xmlState->getIntAttribute("shouldLoop"));
         beatOffset = xmlState->getIntAttribute("beatOffset");
         showGainEnv = (bool)xmlState->getIntAttribute("showGainEnv");
         StringArray points;
@@ -369,7 +446,7 @@ void AudioFilePlaybackProcessor::setStateInformation (const void* data, int size
         for(int i=0; i<points.size(); i+=2)
         {
             Point<double> data(points[i].getDoubleValue(), points[i+1].getDoubleValue());
-            envPoints.add(data);
+            addEnvDataPoint(data);
         }
 
     }
@@ -12,6 +12,7 @@
 #define __AUDIOFILEPLUGINPROCESSOR_H_99BF5AFC__
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "AudioFileStreamer.h"
 
 
 //==============================================================================
@@ -19,7 +20,8 @@
 */
 class AudioFilePlaybackProcessor  : public AudioProcessor,
     public ActionBroadcaster,
-    public ChangeListener
+    public ChangeListener,
+    private Timer
 {
 public:
     //==============================================================================
@@ -62,6 +64,9 @@ public:
     void setLooping(bool loop)
     {
         shouldLoop = loop;
+        const SpinLock::ScopedLockType sl(streamerLock);
+        if(streamer!=nullptr)
+            streamer->setLooping(loop);
     }
 
     bool getLooping()
@@ -79,11 +84,6 @@ public:
         showGainEnv = val;
     }
 
-    void resetGainEnv()
-    {
-        gainSampleIndex=0;
-    }
-
     int getNumParameters();
 
     float getParameter (int index);
@@ -126,22 +126,27 @@ public:
     }
 
     void setupAudioFile (File soundfile);
-    BufferingAudioSource* bufferingAudioFileSource;
 
-    void setBufferingReadPosition(int pos)
+    bool hasAudioFile()
     {
-        if(bufferingAudioFileSource)
-            bufferingAudioFileSource->setNextReadPosition(pos);
+        const SpinLock::ScopedLockType sl(streamerLock);
+        return streamer!=nullptr;
     }
 
+    //position and rate are those of the file, not the device
+    int64 getPlaybackPosition();
+    void setPlaybackPosition(int64 position);
+    double getFileSampleRate();
+    int getNumUnderruns();
+
     AudioPlayHead::CurrentPositionInfo hostInfo;
-    void playSoundFile(AudioSampleBuffer& buffer, bool isLinked=true);
-    float getGainEnvelop(int& index);
+    void playSoundFile(AudioSampleBuffer& buffer);
     void addEnvDataPoint(Point<double> point);
     void updateEnvPoints(Array<Point<double>> points);
 
     void clearEnvDataPoint()
     {
+        const SpinLock::ScopedLockType sl(envLock);
         envPoints.clear();
     }
 
@@ -156,31 +161,30 @@ public:
     }
 
     bool isSourcePlaying;
-    int sourceSampleRate;
 
 private:
-    AudioSourceChannelInfo sourceChannelInfo;
-    PositionableAudioSource* fileSource;
+    void timerCallback();
+    void fillGainEnvelope(float* dest, int numSamples, int64 startPosition, double ratio, int64 length);
+
     bool shouldLoop;
     bool isLinkedToMasterTransport;
 
-    AudioSampleBuffer* audioBuffer;
-    int samplingRate;
     TimeSliceThread thread;
+    AudioFormatManager formatManager;
+    SpinLock streamerLock;
+    ScopedPointer<AudioFileStreamer> streamer;
+    AudioSampleBuffer gainBuffer;
     float rmsLeft, rmsRight;
+    Atomic<int> rmsChanged;
     int beatOffset;
     String currentFile;
-    int updateCounter;
-    int numFileChannels;
-    int totalLength;
     bool showGainEnv;
-    float gainOutputValue;
+    float lastGain;
 
     StringArray parameterNames;
     float gain, pan;
+    SpinLock envLock;
     Array<Point<double>> envPoints;
-    int envPointIncr, gainSampleIndex;
-    //PositionableAudioSource* currentAudioFileSource;
 
 
 private:
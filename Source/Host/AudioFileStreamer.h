@@ -0,0 +1,417 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __AUDIOFILESTREAMER_H__
+#define __AUDIOFILESTREAMER_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+// Streams a sound file of any channel count from disk at the device's sample
+// rate. A TimeSliceThread reads the file into a ring buffer that holds a second
+// or so of audio, and the audio thread takes what it needs from the ring in
+// renderNextBlock(). Nothing is allocated once prepare() has been called.
+//
+// Uncompressed files are memory mapped, so reading them is a copy and any page
+// faults are taken by the reading thread. When the file and device rates
+// differ the audio thread resamples with a Lagrange interpolator; when
+// downsampling, the reading thread low-passes the file below the new Nyquist
+// frequency first.
+//
+// The ring positions are guarded by a SpinLock that is only held while they
+// are read or moved, never while samples are copied. A seek discards the ring
+// and bumps a generation count, so a read or write that was already under way
+// when the seek happened is thrown away rather than committed.
+//==============================================================================
+class AudioFileStreamer : public TimeSliceClient
+{
+public:
+    enum { readChunkSize = 8192 };
+
+    AudioFileStreamer(TimeSliceThread& readingThread)
+        : thread(readingThread),
+          fileSampleRate(44100),
+          deviceSampleRate(44100),
+          ratio(1.0),
+          numChannels(0),
+          length(0),
+          maxBlockSize(0),
+          ringSize(0),
+          isMemoryMapped(false),
+          readPos(0),
+          writePos(0),
+          nextWriteFilePos(0),
+          readFilePos(0),
+          generation(0),
+          writerAtEnd(false),
+          antiAliasing(false),
+          writeGeneration(-1),
+          filtering(false),
+          renderGeneration(-1),
+          looping(0),
+          numUnderruns(0)
+    {
+    }
+
+    ~AudioFileStreamer()
+    {
+        thread.removeTimeSliceClient(this);
+    }
+
+    //==========================================================================
+    // message thread
+    //==========================================================================
+    bool open(const File& file, AudioFormatManager& formatManager)
+    {
+        if(AudioFormat* format = formatManager.findFormatForFileExtension(file.getFileExtension()))
+        {
+            ScopedPointer<MemoryMappedAudioFormatReader> mappedReader(format->createMemoryMappedReader(file));
+            if(mappedReader!=nullptr && mappedReader->mapEntireFile())
+            {
+                reader = mappedReader.release();
+                isMemoryMapped = true;
+            }
+        }
+
+        if(reader==nullptr)
+            reader = formatManager.createReaderFor(file);
+
+        if(reader==nullptr || reader->numChannels<1 || reader->lengthInSamples<1)
+        {
+            reader = nullptr;
+            return false;
+        }
+
+        fileSampleRate = reader->sampleRate>0 ? reader->sampleRate : 44100;
+        numChannels = (int)reader->numChannels;
+        length = reader->lengthInSamples;
+
+        ringSize = nextPowerOfTwo(jmax(65536, (int)(fileSampleRate*1.5)));
+        ring.setSize(numChannels, ringSize);
+        ring.clear();
+        readBuffer.setSize(numChannels, readChunkSize);
+
+        for(int i=0; i<numChannels; i++)
+        {
+            interpolators.add(new LagrangeInterpolator());
+            for(int f=0; f<2; f++)
+                antiAliasFilters.add(new IIRFilter());
+        }
+
+        prepare(fileSampleRate, 512);
+        return true;
+    }
+
+    //size the audio thread's buffers for the device. Must not be called while
+    //renderNextBlock() might be running.
+    void prepare(double newDeviceSampleRate, int newMaxBlockSize)
+    {
+        if(reader==nullptr)
+            return;
+
+        deviceSampleRate = newDeviceSampleRate>0 ? newDeviceSampleRate : fileSampleRate;
+        ratio = fileSampleRate/deviceSampleRate;
+        maxBlockSize = jmax(1, newMaxBlockSize);
+
+        fileBlock.setSize(numChannels, (int)std::ceil(maxBlockSize*ratio)+8);
+        output.setSize(numChannels, maxBlockSize);
+
+        {
+            const SpinLock::ScopedLockType sl(lock);
+            antiAliasing = ratio>1.0;
+            if(antiAliasing)
+                antiAliasCoefficients = IIRCoefficients::makeLowPass(fileSampleRate, deviceSampleRate*0.45);
+        }
+
+        //refill the ring with the filter that suits the new rate
+        seek(getPosition());
+    }
+
+    void start()
+    {
+        thread.addTimeSliceClient(this);
+        thread.moveToFrontOfQueue(this);
+    }
+
+    double getFileSampleRate() const
+    {
+        return fileSampleRate;
+    }
+
+    int getNumChannels() const
+    {
+        return numChannels;
+    }
+
+    int64 getLength() const
+    {
+        return length;
+    }
+
+    int getMaxBlockSize() const
+    {
+        return maxBlockSize;
+    }
+
+    //ratio of file samples to device samples
+    double getResamplingRatio() const
+    {
+        return ratio;
+    }
+
+    bool isUsingMemoryMappedReader() const
+    {
+        return isMemoryMapped;
+    }
+
+    //==========================================================================
+    // any thread
+    //==========================================================================
+    //jump to a position in file samples. Only the message thread wakes the
+    //reading thread straight away; from the audio thread it picks the new
+    //position up the next time it runs.
+    void seek(int64 newPosition)
+    {
+        {
+            const SpinLock::ScopedLockType sl(lock);
+            generation++;
+            readPos = writePos = 0;
+            nextWriteFilePos = readFilePos = jlimit((int64)0, jmax((int64)0, length-1), newPosition);
+            writerAtEnd = false;
+        }
+
+        MessageManager* const messageManager = MessageManager::getInstanceWithoutCreating();
+        if(messageManager!=nullptr && messageManager->isThisTheMessageThread())
+            thread.moveToFrontOfQueue(this);
+    }
+
+    int64 getPosition()
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        return readFilePos;
+    }
+
+    void setLooping(bool shouldLoop)
+    {
+        looping.set(shouldLoop ? 1 : 0);
+    }
+
+    //blocks in which the ring did not hold enough audio, since the file was opened
+    int getNumUnderruns() const
+    {
+        return numUnderruns.get();
+    }
+
+    //==========================================================================
+    // audio thread
+    //==========================================================================
+    //resample the next numSamples samples, up to getMaxBlockSize(), into
+    //getOutput(). startPosition is set to the file position of the first of
+    //them. Returns false once a file that isn't looping has played to the end.
+    bool renderNextBlock(int numSamples, int64& startPosition)
+    {
+        numSamples = jmin(numSamples, maxBlockSize);
+
+        int currentGeneration;
+        int64 start, available;
+        bool atEnd;
+        {
+            const SpinLock::ScopedLockType sl(lock);
+            currentGeneration = generation;
+            start = readPos;
+            available = writePos-readPos;
+            atEnd = writerAtEnd;
+            startPosition = readFilePos;
+        }
+
+        if(currentGeneration!=renderGeneration)
+        {
+            for(int i=0; i<numChannels; i++)
+                interpolators.getUnchecked(i)->reset();
+            renderGeneration = currentGeneration;
+        }
+
+        const bool resampling = ratio!=1.0;
+        const int needed = resampling ? jmin(fileBlock.getNumSamples(), (int)std::ceil(numSamples*ratio)+4) : numSamples;
+
+        if(available<needed && !atEnd)
+        {
+            ++numUnderruns;
+            output.clear(0, numSamples);
+            return true;
+        }
+
+        const int numToRead = (int)jmin(available, (int64)needed);
+        AudioSampleBuffer& source = resampling ? fileBlock : output;
+        readFromRing(source, start, numToRead);
+        if(numToRead<needed)
+            source.clear(numToRead, needed-numToRead);
+
+        int consumed = numToRead;
+        if(resampling)
+            for(int i=0; i<numChannels; i++)
+                consumed = interpolators.getUnchecked(i)->process(ratio, fileBlock.getReadPointer(i),
+                           output.getWritePointer(i), numSamples);
+
+        consumed = jmin(consumed, numToRead);
+
+        const SpinLock::ScopedLockType sl(lock);
+        if(generation!=currentGeneration)
+            return true;
+
+        readPos += consumed;
+        readFilePos += consumed;
+        if(readFilePos>=length)
+            readFilePos -= length;
+
+        return !(writerAtEnd && readPos==writePos);
+    }
+
+    const AudioSampleBuffer& getOutput() const
+    {
+        return output;
+    }
+
+    //==========================================================================
+    // reading thread
+    //==========================================================================
+    int useTimeSlice()
+    {
+        int currentGeneration;
+        int64 start, filePosition;
+        int space;
+        {
+            const SpinLock::ScopedLockType sl(lock);
+            if(nextWriteFilePos>=length)
+            {
+                if(looping.get()==0)
+                {
+                    writerAtEnd = true;
+                    return 50;
+                }
+                nextWriteFilePos = 0;
+                writerAtEnd = false;
+            }
+
+            currentGeneration = generation;
+            start = writePos;
+            filePosition = nextWriteFilePos;
+            space = ringSize-(int)(writePos-readPos);
+
+            if(currentGeneration!=writeGeneration)
+            {
+                for(int i=0; i<antiAliasFilters.size(); i++)
+                {
+                    antiAliasFilters.getUnchecked(i)->setCoefficients(antiAliasCoefficients);
+                    antiAliasFilters.getUnchecked(i)->reset();
+                }
+                filtering = antiAliasing;
+                writeGeneration = currentGeneration;
+            }
+        }
+
+        const int numToRead = (int)jmin((int64)jmin(space, (int)readChunkSize), length-filePosition);
+        if(numToRead<=0)
+            return 10;
+
+        reader->read((int**)readBuffer.getArrayOfWritePointers(), numChannels, filePosition, numToRead, false);
+        for(int i=0; i<numChannels; i++)
+        {
+            float* data = readBuffer.getWritePointer(i);
+            if(!reader->usesFloatingPointData)
+                FloatVectorOperations::convertFixedToFloat(data, (const int*)data, 1.0f/0x7fffffff, numToRead);
+
+            if(filtering)
+            {
+                antiAliasFilters.getUnchecked(i*2)->processSamples(data, numToRead);
+                antiAliasFilters.getUnchecked(i*2+1)->processSamples(data, numToRead);
+            }
+        }
+
+        writeToRing(start, numToRead);
+
+        const SpinLock::ScopedLockType sl(lock);
+        if(generation==currentGeneration)
+        {
+            writePos += numToRead;
+            nextWriteFilePos += numToRead;
+        }
+
+        return numToRead<space ? 0 : 10;
+    }
+
+private:
+    //the region written here is beyond writePos, so the audio thread never reads it
+    void writeToRing(int64 start, int numSamples)
+    {
+        const int offset = (int)(start & (ringSize-1));
+        const int firstPart = jmin(numSamples, ringSize-offset);
+        for(int i=0; i<numChannels; i++)
+        {
+            ring.copyFrom(i, offset, readBuffer, i, 0, firstPart);
+            if(firstPart<numSamples)
+                ring.copyFrom(i, 0, readBuffer, i, firstPart, numSamples-firstPart);
+        }
+    }
+
+    void readFromRing(AudioSampleBuffer& dest, int64 start, int numSamples)
+    {
+        const int offset = (int)(start & (ringSize-1));
+        const int firstPart = jmin(numSamples, ringSize-offset);
+        for(int i=0; i<numChannels; i++)
+        {
+            dest.copyFrom(i, 0, ring, i, offset, firstPart);
+            if(firstPart<numSamples)
+                dest.copyFrom(i, firstPart, ring, i, 0, numSamples-firstPart);
+        }
+    }
+
+    TimeSliceThread& thread;
+    ScopedPointer<AudioFormatReader> reader;
+    double fileSampleRate, deviceSampleRate, ratio;
+    int numChannels;
+    int64 length;
+    int maxBlockSize, ringSize;
+    bool isMemoryMapped;
+
+    //guarded by lock
+    SpinLock lock;
+    int64 readPos, writePos, nextWriteFilePos, readFilePos;
+    int generation;
+    bool writerAtEnd, antiAliasing;
+    IIRCoefficients antiAliasCoefficients;
+
+    //reading thread only
+    AudioSampleBuffer readBuffer;
+    OwnedArray<IIRFilter> antiAliasFilters;
+    int writeGeneration;
+    bool filtering;
+
+    //audio thread only
+    AudioSampleBuffer fileBlock, output;
+    OwnedArray<LagrangeInterpolator> interpolators;
+    int renderGeneration;
+
+    AudioSampleBuffer ring;
+    Atomic<int> looping, numUnderruns;
+
+    JUCE_DECLARE_NON_COPYABLE (AudioFileStreamer)
+};
+
+#endif   // __AUDIOFILESTREAMER_H__
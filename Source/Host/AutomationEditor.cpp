@@ -384,19 +384,10 @@ void AutomationEditor::buttonClicked(Button* button)
     if(button->getName()=="playButton")
     {
         if(button->getToggleState()==true)
-        {
-            processor.suspendProcessing(false);
             startTimer(100);
-            getFilter()->messageQueue.addOutgoingChannelMessageToQueue("isPlaying", 1.0, "");
-        }
         else
-        {
-            getFilter()->messageQueue.addOutgoingChannelMessageToQueue("isPlaying", 0.0, "");
-            //processor.suspendProcessing(true);
             stopTimer();
 
-        }
-
         getFilter()->isSourcePlaying=!getFilter()->isSourcePlaying;
     }
 
@@ -406,8 +397,8 @@ void AutomationEditor::buttonClicked(Button* button)
         if(playButton.getToggleState()==true)
             playButton.setToggleState(false, dontSendNotification);
 
-        getFilter()->messageQueue.addOutgoingChannelMessageToQueue("isPlaying", 0.0, "");
-        getFilter()->isSourcePlaying=false;
+        getFilter()->stop();
+        automationDisplay.resetPlaybackPosition();
 
     }
 
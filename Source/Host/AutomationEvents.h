@@ -0,0 +1,101 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __AUTOMATIONEVENTS_H__
+#define __AUTOMATIONEVENTS_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+// a parameter change that falls at a sample within the current block
+struct AutomationEvent
+{
+    int nodeId, parameterIndex, sampleOffset;
+    float value;
+};
+
+//==============================================================================
+// fixed size list of events, filled and read on the audio thread. Events are
+// kept in sample order, and ones that don't fit are dropped rather than
+// allocating.
+class AutomationEventQueue
+{
+public:
+    AutomationEventQueue() : capacity(0), numEvents(0) {}
+
+    void ensureSize(int minimumCapacity)
+    {
+        if(minimumCapacity>capacity)
+        {
+            events.realloc(minimumCapacity);
+            capacity = minimumCapacity;
+        }
+        numEvents = 0;
+    }
+
+    void clear()
+    {
+        numEvents = 0;
+    }
+
+    bool add(const AutomationEvent& event)
+    {
+        if(numEvents>=capacity)
+            return false;
+
+        //events mostly arrive in order, so this rarely moves anything
+        int i = numEvents++;
+        for(; i>0 && events[i-1].sampleOffset>event.sampleOffset; --i)
+            events[i] = events[i-1];
+
+        events[i] = event;
+        return true;
+    }
+
+    int getNumEvents() const
+    {
+        return numEvents;
+    }
+
+    const AutomationEvent& getEvent(int index) const
+    {
+        return events[index];
+    }
+
+private:
+    HeapBlock<AutomationEvent> events;
+    int capacity, numEvents;
+
+    JUCE_DECLARE_NON_COPYABLE (AutomationEventQueue)
+};
+
+//==============================================================================
+// a node that drives the parameters of other nodes. The graph renderer asks
+// each source for its events before any node in the block is processed, then
+// splits the blocks of the nodes they target at each event's sample offset.
+class AutomationSource
+{
+public:
+    virtual ~AutomationSource() {}
+
+    //add the changes for the next numSamples samples, in sample order
+    virtual void renderAutomation(int numSamples, AutomationEventQueue& queue) = 0;
+};
+
+#endif   // __AUTOMATIONEVENTS_H__
@@ -22,45 +22,13 @@
 
 
 //==============================================================================
-AutomationProcessor::AutomationProcessor(FilterGraph* filterGraph):
-    graph(filterGraph),
-    newTableAdded(false),
-    updateCount(0),
-    envSampleIndex(0),
-    totalLength(10.f),
+AutomationProcessor::AutomationProcessor():
+    automationCurveValue(0),
     isSourcePlaying(false),
-    shouldLoop(false),
-    isLinkedToMasterTransport(false)
+    scrubberPosition(0),
+    playPosition(0),
+    rewindRequested(0)
 {
-    csound = new Csound();
-    csound->SetHostData(this);
-    csoundParams = new CSOUND_PARAMS();
-    csoundParams->nchnls_override = this->getNumOutputChannels();
-    csoundParams->displays = 0;
-    csound->SetParams(csoundParams);
-
-    String csd = File::getSpecialLocation(File::currentExecutableFile).getParentDirectory().getFullPathName()+"/AutomationTrack.csd";
-
-    File csdFile(csd);
-
-    csCompileResult = csound->Compile(const_cast<char*>(csdFile.getFullPathName().toUTF8().getAddress()));
-
-    if(csCompileResult==OK)
-    {
-        Logger::writeToLog("compiled Ok");
-        csdKsmps = csound->GetKsmps();
-        if(csound->GetSpout()==nullptr);
-        CSspout = csound->GetSpout();
-        CSspin = csound->GetSpin();
-        cs_scale = csound->Get0dBFS();
-        csndIndex = csound->GetKsmps();
-        this->setLatencySamples(csound->GetKsmps());
-        updateHostDisplay();
-        csoundStatus = true;
-    }
-
-    suspendProcessing(true);
-
 }
 
 AutomationProcessor::~AutomationProcessor()
@@ -83,34 +51,23 @@ AutomationEditor* AutomationProcessor::getEditor()
 void AutomationProcessor::addAutomatableNode(String nodeName,
         String parameterName,
         int32 id,
-        int index,
-        int gen,
-        String statement)
+        int index)
 {
     const String tableNumber(String(id)+String::formatted("%03d", index));
-    if(statement.isEmpty())
-    {
-        statement = "f"+tableNumber+" 0 4096 -7 0 4096 0";
-    }
-    const String channel("auto_"+tableNumber);
     AutomationProcessor::AutomatableNode node(nodeName, parameterName, id, index);
-    node.fStatement = statement;
-    node.channelName = channel;
-    node.genRoutine = -7;
     node.fTableNumber = tableNumber.getIntValue();
 
-    automatableNodes.add(node);
-    newTableAdded = true;
-    envelopes.add(AbstractEnvelope());
+    {
+        const SpinLock::ScopedLockType sl(laneLock);
+        automatableNodes.add(node);
+        envelopes.add(AbstractEnvelope());
+    }
 
     if(AutomationEditor* editor = getEditor())
     {
         editor->updateComboBoxItems();
+        editor->addTable(cUtils::getRandomColour(), node.fTableNumber);
     }
-
-    messageQueue.addOutgoingTableUpdateMessageToQueue(statement, tableNumber.getIntValue());
-    sendOutgoingMessagesToCsound();
-
 }
 
 AutomationProcessor::AutomatableNode AutomationProcessor::getAutomatableNode(int index)
@@ -125,192 +82,105 @@ int AutomationProcessor::getNumberOfAutomatableNodes()
 
 void AutomationProcessor::updateEnvPoints(int env, Array<Point<double>> points)
 {
-    envelopes.getReference(env).envPoints.clear();
+    Array<double> envPoints;
     for(int i=0; i<points.size(); i++)
     {
-        envelopes.getReference(env).envPoints.add(points[i].getX());
-        envelopes.getReference(env).envPoints.add(points[i].getY());
+        envPoints.add(points[i].getX());
+        envPoints.add(points[i].getY());
     }
 
-    //envelopes.getReference(env).envPoints.swapWith(points);
+    const SpinLock::ScopedLockType sl(laneLock);
+    if(isPositiveAndBelow(env, envelopes.size()))
+    {
+        envelopes.getReference(env).envPoints.swapWith(envPoints);
+        envelopes.getReference(env).lastValue = -1.f;
+    }
 }
 
 void AutomationProcessor::changeListenerCallback(ChangeBroadcaster* source)
 {
     if(BreakpointEnvelope* env = (BreakpointEnvelope*)source)
-    {
         updateEnvPoints(env->getUid(), env->getHandlePoints());
-        updatefTableData(env);
-    }
 }
 
-void AutomationProcessor::updateAutomationValues()
+//==============================================================================
+//value of the envelope at a position between 0 and 1 along the lane. Handles
+//store their height from the top, so the value is 1-y.
+float AutomationProcessor::getLaneValue(const AbstractEnvelope& envelope, double position) const
 {
-    //put the brakes on this. No need to update that often...
-    updateCount = (updateCount>100 ? 0:updateCount+1);
-    scrubberPosition = csound->GetChannel("scrubberPosition");
+    const Array<double>& points = envelope.envPoints;
+    const int numPoints = points.size()/2;
 
-    if(updateCount==0)
-    {
-        for(int i=0; i<automatableNodes.size(); i++)
-        {
-            graph->updateAutomatedNodes(automatableNodes.getReference(i).nodeID,
-                                        automatableNodes.getReference(i).parameterIndex,
-                                        csound->GetChannel(automatableNodes.getReference(i).channelName.toUTF8().getAddress()));
-        }
-    }
-}
+    if(position<=points[0])
+        return 1.f-(float)points[1];
 
-void AutomationProcessor::updatefTableData(BreakpointEnvelope* table)
-{
-#ifndef Cabbage_No_Csound
-    int genRoutine = -7;
-    Array<double> pFields = table->getEnvelopeAsPfields();
-    if( genRoutine==-7)
+    for(int i=1; i<numPoints; i++)
     {
-        FUNC *ftpp;
-        EVTBLK  evt;
-        memset(&evt, 0, sizeof(EVTBLK));
-        evt.pcnt = 5+pFields.size();
-        evt.opcod = 'f';
-        evt.p[0]=0;
-
-        //setting table number to 0.
-        evt.p[1]=0;
-        evt.p[2]=0;
-        evt.p[3]=4096;
-        evt.p[4]=genRoutine;
-        if(genRoutine==5)
+        const double x = points.getUnchecked(i*2);
+        if(position<x)
         {
-            for(int i=0; i<pFields.size()-1; i++)
-                evt.p[5+i]= jmax(0.00001, pFields[i+1]);
+            const double previousX = points.getUnchecked(i*2-2);
+            const double previousY = points.getUnchecked(i*2-1);
+            const double proportion = (position-previousX)/jmax(1.0e-9, x-previousX);
+            return 1.f-(float)(previousY+(points.getUnchecked(i*2+1)-previousY)*proportion);
         }
-        else if(genRoutine==-7)
-        {
-            for(int i=0; i<pFields.size()-1; i++)
-                evt.p[5+i]= pFields[i+1];
-        }
-        else
-        {
-            for(int i=0; i<pFields.size(); i++)
-                evt.p[5+i] = pFields[i];
-        }
-
-
-        StringArray fStatement;
-        int pCnt=0;
-        for(int i=0; i<evt.pcnt-1; i++)
-        {
-            fStatement.add(String(evt.p[i]));
-            //cUtils::debug(i, fStatement[i]);
-            pCnt=i;
-        }
-
-        //now set table number and set score char to f
-        fStatement.set(1, String(table->getTableNumber()));
-        fStatement.set(0, "f");
-
-        //Logger::writeToLog(fStatement.joinIntoString(" "));
-        messageQueue.addOutgoingTableUpdateMessageToQueue(fStatement.joinIntoString(" "), table->getUid());
-        sendOutgoingMessagesToCsound();
     }
-#endif
+
+    return 1.f-(float)points[numPoints*2-1];
 }
 
-void AutomationProcessor::sendOutgoingMessagesToCsound()
+void AutomationProcessor::renderAutomation(int numSamples, AutomationEventQueue& queue)
 {
-    if(csCompileResult==OK)
-    {
-        if (getPlayHead() != 0 && getPlayHead()->getCurrentPosition (hostInfo))
-        {
-            csound->SetChannel(CabbageIDs::hostbpm.toUTF8(), hostInfo.bpm);
-            csound->SetChannel(CabbageIDs::timeinseconds.toUTF8(), hostInfo.timeInSeconds);
-            csound->SetChannel(CabbageIDs::isplaying.toUTF8(), hostInfo.isPlaying);
-            csound->SetChannel(CabbageIDs::isrecording.toUTF8(), hostInfo.isRecording);
-            csound->SetChannel(CabbageIDs::hostppqpos.toUTF8(), hostInfo.ppqPosition);
-            csound->SetChannel(CabbageIDs::timeinsamples.toUTF8(), hostInfo.timeInSamples);
-            csound->SetChannel(CabbageIDs::timeSigDenom.toUTF8(), hostInfo.timeSigDenominator);
-            csound->SetChannel(CabbageIDs::timeSigNum.toUTF8(), hostInfo.timeSigNumerator);
-        }
-        for(int i=0; i<messageQueue.getNumberOfOutgoingChannelMessagesInQueue(); i++)
-        {
-            //update Csound function tables with values from table widget
-            if(messageQueue.getOutgoingChannelMessageFromQueue(i).type=="updateTable")
-            {
-                //Logger::writeToLog(messageQueue.getOutgoingChannelMessageFromQueue(i).fStatement.toUTF8());
-                const int tableNum = messageQueue.getOutgoingChannelMessageFromQueue(i).tableNumber;
-                //update table data for saving...
-                cUtils::debug("fstatement", messageQueue.getOutgoingChannelMessageFromQueue(i).fStatement);
-                updateAutomatableNodefStatement(tableNum, messageQueue.getOutgoingChannelMessageFromQueue(i).fStatement);
-                csound->InputMessage(messageQueue.getOutgoingChannelMessageFromQueue(i).fStatement.getCharPointer());
-            }
-            //catch string messags
-            else if(messageQueue.getOutgoingChannelMessageFromQueue(i).type==CabbageIDs::stringchannel)
-            {
-                Logger::writeToLog(messageQueue.getOutgoingChannelMessageFromQueue(i).channelName);
-                Logger::writeToLog(messageQueue.getOutgoingChannelMessageFromQueue(i).stringVal);
-                csound->SetChannel(messageQueue.getOutgoingChannelMessageFromQueue(i).channelName.getCharPointer(),
-                                   messageQueue.getOutgoingChannelMessageFromQueue(i).stringVal.toUTF8().getAddress());
-            }
-            else
-                csound->SetChannel(messageQueue.getOutgoingChannelMessageFromQueue(i).channelName.getCharPointer(),
-                                   messageQueue.getOutgoingChannelMessageFromQueue(i).value);
-        }
-        messageQueue.flushOutgoingChannelMessages();
-    }
+    const double sampleRate = getSampleRate()>0 ? getSampleRate() : 44100;
+    const int64 laneLength = jmax((int64)controlInterval, (int64)(laneLengthSeconds*sampleRate));
 
-    if(newTableAdded == true)
+    if(rewindRequested.compareAndSetBool(0, 1))
     {
-        //call performKsmps to instantiate new tables...
-        const String iStatement("i1 0 36000 "+String(automatableNodes.getReference(automatableNodes.size()-1).fTableNumber));
-        csound->InputMessage(iStatement.toUTF8().getAddress());
-        csound->PerformKsmps();
-        const int gen = automatableNodes.getReference(automatableNodes.size()-1).genRoutine;
-        const int tableNum = automatableNodes.getReference(automatableNodes.size()-1).fTableNumber;
-        if(AutomationEditor* editor = getEditor())
-        {
-
-            editor->addTable(cUtils::getRandomColour(), tableNum);
-        }
-
-        newTableAdded = false;
+        playPosition = 0;
+        scrubberPosition = 0;
     }
-}
 
-void AutomationProcessor::updateAutomatableNodefStatement(int tableNumber, String newStatement)
-{
-    for(int i=0; i<automatableNodes.size(); i++)
-    {
-        if(automatableNodes.getReference(i).fTableNumber==tableNumber)
-            automatableNodes.getReference(i).fStatement = newStatement;
-    }
-}
-//==============================================================================
-void AutomationProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
-{
-    int numSamples = buffer.getNumSamples();
-    if(isSuspended()==false)
+    if(!isSourcePlaying)
+        return;
+
+    const GenericScopedTryLock<SpinLock> sl(laneLock);
+    if(sl.isLocked())
     {
-        if(csCompileResult==OK)
+        //every lane is evaluated on the same grid, tick by tick, so the queue
+        //stays in sample order
+        const int64 endPosition = playPosition+numSamples;
+        for(int64 tick=((playPosition+controlInterval-1)/controlInterval)*controlInterval; tick<endPosition; tick+=controlInterval)
         {
-            for(int i=0; i<numSamples; i++, csndIndex++)
+            const double lanePosition = (tick%laneLength)/(double)laneLength;
+            for(int i=0; i<automatableNodes.size() && i<envelopes.size(); i++)
             {
-                if(csndIndex == csdKsmps)
+                AbstractEnvelope& envelope = envelopes.getReference(i);
+                if(envelope.envPoints.size()<2)
+                    continue;
+
+                const float value = getLaneValue(envelope, lanePosition);
+                if(value!=envelope.lastValue)
                 {
-                    getCallbackLock().enter();
-                    sendOutgoingMessagesToCsound();
-                    updateAutomationValues();
-                    csCompileResult = csound->PerformKsmps();
-                    getCallbackLock().exit();
-                    csndIndex = 0;
+                    const AutomatableNode& node = automatableNodes.getReference(i);
+                    const AutomationEvent event = { (int)node.nodeID, node.parameterIndex, (int)(tick-playPosition), value };
+                    queue.add(event);
+                    envelope.lastValue = value;
+                    automationCurveValue = value;
                 }
-
-                buffer.clear();
             }
-
         }
     }
 
+    playPosition += numSamples;
+    if(playPosition>=laneLength)
+        playPosition -= laneLength;
+    scrubberPosition = playPosition*10.0/laneLength;
+}
+//==============================================================================
+void AutomationProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
+{
+    //the lanes are rendered through renderAutomation()
+    buffer.clear();
 }
 //==============================================================================
 void AutomationProcessor::getStateInformation (MemoryBlock& destData)
@@ -322,7 +192,6 @@ void AutomationProcessor::getStateInformation (MemoryBlock& destData)
         xml.addChildElement (createAutomationXML (automatableNodes.getReference(i), i));
     }
 
-    xml.writeToFile(File("/home/rory/Desktop/automationProc.txt"), String::empty);
     copyXmlToBinary (xml, destData);
 }
 //==============================================================================
@@ -334,17 +203,14 @@ XmlElement* AutomationProcessor::createAutomationXML(AutomationProcessor::Automa
     innerXml->setAttribute("parameterName", node.parametername);
     innerXml->setAttribute("nodeId", node.nodeID);
     innerXml->setAttribute("parameterId", node.parameterIndex);
-    innerXml->setAttribute("genRoutine", node.genRoutine);
-    innerXml->setAttribute("fStatement", node.fStatement);
 
-    cUtils::debug(index);
-    cUtils::debug(this->getNumberOfEnvelopes());
     StringArray points;
     //add envelop points if there are any
-    for(int i=0; i<envelopes.getReference(index).envPoints.size(); i+=2)
+    const AbstractEnvelope envelope = getEnvelope(index);
+    for(int i=0; i<envelope.envPoints.size(); i+=2)
     {
-        points.add(String(envelopes.getReference(index).envPoints[i]));
-        points.add(String(envelopes.getReference(index).envPoints[i+1]));
+        points.add(String(envelope.envPoints[i]));
+        points.add(String(envelope.envPoints[i+1]));
     }
 
     innerXml->setAttribute("envPoints", points.joinIntoString(" "));
@@ -364,13 +230,13 @@ void AutomationProcessor::setStateInformation (const void* data, int sizeInBytes
         {
             if (e->hasTagName ("NODES"))
             {
+                //older sessions also hold the Csound f-statement for each
+                //lane, which is no longer needed
                 const String nodeName = e->getStringAttribute("nodeName");
                 const String parametername = e->getStringAttribute("parameterName");
                 const int nodeID = e->getIntAttribute("nodeId");
                 const int parameterIndex = e->getIntAttribute("parameterId");
-                const int genRoutine = e->getIntAttribute("genRoutine");
-                const String fStatement = e->getStringAttribute("fStatement");
-                addAutomatableNode(nodeName, parametername, nodeID, parameterIndex, genRoutine, fStatement);
+                addAutomatableNode(nodeName, parametername, nodeID, parameterIndex);
 
                 Array<Point<double>> envPoints;
                 StringArray points;
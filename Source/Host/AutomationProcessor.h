@@ -21,22 +21,32 @@
 #define AUTOMATIONPLUGINPROCESSOR_H_INCLUDED
 
 #include "../JuceLibraryCode/JuceHeader.h"
-#include "FilterGraph.h"
-#include <csound.hpp>
-#include "../CabbageMessageSystem.h"
+#include "AutomationEvents.h"
 #include "BreakpointEnvelope.h"
 
 
 
 class AutomationEditor;
 //==============================================================================
-/**
-*/
+// Plays breakpoint envelopes into the parameters of other nodes. Each lane is
+// evaluated on the audio thread every controlInterval samples of its timeline
+// and a change is only sent when the value moves. The graph renderer applies
+// the changes at their exact sample in the target node's block, without
+// notifying any listeners from the audio thread. The node itself outputs
+// silence.
+//
+// The lanes are edited on the message thread under a SpinLock that the audio
+// thread only ever tries to take; if it can't, the lanes send nothing for that
+// block.
+//==============================================================================
 class AutomationProcessor  : public AudioProcessor,
+    public AutomationSource,
     public ChangeBroadcaster,
     public ChangeListener
 {
 public:
+    //the display's 10 units span laneLengthSeconds, and the timeline loops
+    enum { controlInterval = 32, laneLengthSeconds = 100 };
 
     class AutomatableNode
     {
@@ -44,40 +54,35 @@ public:
         int32 nodeID;
         int parameterIndex;
         int fTableNumber;
-        int genRoutine;
         String nodeName;
         String parametername;
-        String fStatement;
-        int size;
-        String channelName;
-        float value;
 
         AutomatableNode(String node, String name, int32 id, int index):
-            nodeID(id), parameterIndex(index), nodeName(node), parametername(name),
-            size(4096)
+            nodeID(id), parameterIndex(index), fTableNumber(0), nodeName(node), parametername(name)
         {}
     };
 
     class AbstractEnvelope
     {
     public:
-        AbstractEnvelope():shape(1), currentPointIndex(0), currentSampleIndex(0)
+        AbstractEnvelope():lastValue(-1.f)
         {
         }
+        //x, y pairs as relative handle positions, y increasing downwards
         Array<double> envPoints;
-        int shape, currentPointIndex, currentSampleIndex;
+        float lastValue;
     };
 
     //==============================================================================
-    AutomationProcessor(FilterGraph* filterGraph);
+    AutomationProcessor();
     ~AutomationProcessor();
 
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
-    void generateEnvelope(AudioSampleBuffer& buffer);
     void releaseResources() override;
     XmlElement* createAutomationXML(AutomationProcessor::AutomatableNode node, int index);
     void processBlock (AudioSampleBuffer&, MidiBuffer&) override;
+    void renderAutomation(int numSamples, AutomationEventQueue& queue) override;
 
     //==============================================================================
     AudioProcessorEditor* createEditor() override;
@@ -113,18 +118,14 @@ public:
     //==============================================================================
     void getStateInformation (MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
-    void sendOutgoingMessagesToCsound();
     AutomatableNode getAutomatableNode(int index);
     int getNumberOfAutomatableNodes();
-    void updateAutomationValues();
-    void updatefTableData(BreakpointEnvelope* table);
-    void updateAutomatableNodefStatement(int tableNumber, String newStatement);
     void updateEnvPoints(int env, Array<Point<double>> points);
     void changeListenerCallback(ChangeBroadcaster* source);
-    float getGainEnvelop(int envIndex);
 
     const AbstractEnvelope getEnvelope(int index)
     {
+        const SpinLock::ScopedLockType sl(laneLock);
         return envelopes.getReference(index);
     }
 
@@ -135,56 +136,35 @@ public:
 
     float getAutomationValue()
     {
-        const ScopedLock sl (getCallbackLock());
         return automationCurveValue;
     }
 
-    CSOUND* getCsoundStruct()
+    //rewind the timeline the next time the audio thread runs
+    void stop()
     {
-        return csound->GetCsound();
+        isSourcePlaying = false;
+        rewindRequested.set(1);
     }
 
     AutomationEditor* getEditor();
     float automationCurveValue;
-    void addAutomatableNode(String nodeName, String parameterString, int32 id, int index, int gen=-1, String statement="");
+    void addAutomatableNode(String nodeName, String parameterString, int32 id, int index);
 
     const double getScrubberPosition()
     {
-        //const MessageManagerLock lock;
         return scrubberPosition;
     }
 
     bool isSourcePlaying;
-    CabbageMessageQueue messageQueue;
 private:
-    bool shouldLoop;
-    bool isLinkedToMasterTransport;
-    FilterGraph* graph;
-    int sourceSampleRate;
-    ScopedPointer<XmlElement> xmlState;
+    float getLaneValue(const AbstractEnvelope& envelope, double position) const;
+
     double scrubberPosition;
+    SpinLock laneLock;
     Array<AutomatableNode> automatableNodes;
-    AudioPlayHead::CurrentPositionInfo hostInfo;
-    bool newTableAdded;
-    float totalLength;
-    int updateCount;
-    int envSampleIndex;
     Array<AbstractEnvelope> envelopes;
-
-    //=== Csound stuff ======
-    std::vector<MYFLT> temp;
-    bool csoundStatus;
-    int csCompileResult;
-    ScopedPointer<CSOUND_PARAMS> csoundParams;
-    MYFLT cs_scale;
-    ScopedPointer<Csound> csound; //Csound instance
-    MYFLT *CSspin, *CSspout; //Csound audio IO pointers
-    int csndIndex; //Csound sample counter
-    int csdKsmps;
-    int CSCompResult; //result of Csound performKsmps
-    int pos;
-    controlChannelInfo_s* csoundChanList;
-    int numCsoundChannels; //number of Csound channels
+    int64 playPosition;
+    Atomic<int> rewindRequested;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AutomationProcessor)
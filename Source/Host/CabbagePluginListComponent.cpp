@@ -163,6 +163,12 @@ CabbagePluginListComponent::CabbagePluginListComponent (AudioPluginFormatManager
       propertiesToUse (props),
       numThreads (0)
 {
+    const File cacheFile (deadMansPedalFile != File::nonexistent
+                          ? deadMansPedalFile.getSiblingFile ("PluginScanCache.xml")
+                          : File::getSpecialLocation (File::userApplicationDataDirectory)
+                            .getChildFile ("Cabbage").getChildFile ("PluginScanCache.xml"));
+    scanCache = new PluginScanCache (cacheFile);
+
     tableModel = new TableModel (*this, listToEdit);
 
     TableHeaderComponent& header = table.getHeader();
@@ -258,8 +264,57 @@ void CabbagePluginListComponent::showSelectedFolder()
 void CabbagePluginListComponent::removeMissingPlugins()
 {
     for (int i = list.getNumTypes(); --i >= 0;)
-        if (! formatManager.doesPluginStillExist (*list.getType (i)))
+    {
+        const PluginDescription* const desc = list.getType (i);
+
+        // Cabbage instruments aren't loaded through a format, so just check the .csd is there
+        if (desc->pluginFormatName == "Cabbage" ? ! File::createFileWithoutCheckingPath (desc->fileOrIdentifier).existsAsFile()
+                                                : ! formatManager.doesPluginStillExist (*desc))
+            list.removeType (i);
+    }
+}
+
+bool CabbagePluginListComponent::addCabbageInstrument (const File& file)
+{
+    PluginScanCache::Status status;
+    OwnedArray<PluginDescription> types;
+
+    if (! scanCache->lookup ("Cabbage", file, status, types))
+    {
+        PluginDescription desc;
+
+        if (PluginScanCache::indexCabbageFile (file, desc))
+            types.add (new PluginDescription (desc));
+
+        scanCache->store ("Cabbage", file, types.size() > 0 ? PluginScanCache::scanOk
+                                                            : PluginScanCache::scanFoundNothing, types);
+    }
+
+    if (types.size() == 0)
+        return false;
+
+    // replace any earlier listing, as the instrument may have been renamed since
+    for (int i = list.getNumTypes(); --i >= 0;)
+        if (list.getType (i)->pluginFormatName == "Cabbage"
+             && list.getType (i)->fileOrIdentifier == file.getFullPathName())
             list.removeType (i);
+
+    list.addType (*types.getFirst());
+    return true;
+}
+
+void CabbagePluginListComponent::indexCabbageInstruments (const FileSearchPath& folders)
+{
+    for (int i = 0; i < folders.getNumPaths(); ++i)
+    {
+        Array<File> csdFiles;
+        folders[i].findChildFiles (csdFiles, File::findFiles, true, "*.csd");
+
+        for (int j = 0; j < csdFiles.size(); ++j)
+            addCabbageInstrument (csdFiles.getReference (j));
+    }
+
+    scanCache->save();
 }
 
 void CabbagePluginListComponent::optionsMenuStaticCallback (int result, CabbagePluginListComponent* pluginList)
@@ -286,6 +341,10 @@ void CabbagePluginListComponent::optionsMenuCallback (int result)
     case 4:
         removeMissingPlugins();
         break;
+    case 5:
+        if (propertiesToUse != nullptr)
+            indexCabbageInstruments (FileSearchPath (propertiesToUse->getValue ("CabbageFilePaths")));
+        break;
 
     default:
         if (AudioPluginFormat* format = formatManager.getFormat (result - 10))
@@ -305,6 +364,7 @@ void CabbagePluginListComponent::buttonClicked (Button* button)
         menu.addItem (3, TRANS("Show folder containing selected plug-in"), canShowSelectedFolder());
         menu.addItem (4, TRANS("Remove any plug-ins whose files no longer exist"));
         menu.addSeparator();
+        menu.addItem (5, TRANS("Add Cabbage instruments from the Cabbage file folders"), propertiesToUse != nullptr);
 
         for (int i = 0; i < formatManager.getNumFormats(); ++i)
         {
@@ -326,8 +386,22 @@ bool CabbagePluginListComponent::isInterestedInFileDrag (const StringArray& /*fi
 
 void CabbagePluginListComponent::filesDropped (const StringArray& files, int, int)
 {
-    OwnedArray <PluginDescription> typesFound;
-    list.scanAndAddDragAndDroppedFiles (formatManager, files, typesFound);
+    StringArray pluginFiles;
+
+    for (int i = 0; i < files.size(); ++i)
+    {
+        const File f (File::createFileWithoutCheckingPath (files[i]));
+
+        if (PluginScanCache::isCabbageFile (f))
+            addCabbageInstrument (f);
+        else
+            pluginFiles.add (files[i]);
+    }
+
+    scanCache->save();
+
+    if (pluginFiles.size() > 0 && currentScanner == nullptr)
+        scanFiles (pluginFiles);
 }
 
 FileSearchPath CabbagePluginListComponent::getLastSearchPath (PropertiesFile& properties, AudioPluginFormat& format)
@@ -347,18 +421,18 @@ class CabbagePluginListComponent::Scanner    : private Timer
 {
 public:
     Scanner (CabbagePluginListComponent& plc, AudioPluginFormat& format, PropertiesFile* properties, int threads)
-        : owner (plc), formatToScan (format), propertiesToUse (properties),
+        : owner (plc), formatToScan (&format), propertiesToUse (properties),
           pathChooserWindow (TRANS("Select folders to scan..."), String::empty, AlertWindow::NoIcon),
           progressWindow (TRANS("Scanning for plug-ins..."),
                           TRANS("Searching for all possible plug-in files..."), AlertWindow::NoIcon),
-          progress (0.0), numThreads (threads), finished (false)
+          progress (0.0), numThreads (jmax (1, threads)), finished (false), nextItem (0), numItemsDone (0)
     {
-        FileSearchPath path (formatToScan.getDefaultLocationsToSearch());
+        FileSearchPath path (formatToScan->getDefaultLocationsToSearch());
 
         if (path.getNumPaths() > 0) // if the path is empty, then paths aren't used for this format.
         {
             if (propertiesToUse != nullptr)
-                path = getLastSearchPath (*propertiesToUse, formatToScan);
+                path = getLastSearchPath (*propertiesToUse, *formatToScan);
 
             pathList.setSize (500, 300);
             pathList.setPath (path);
@@ -380,6 +454,32 @@ public:
         }
     }
 
+    // scans a set of files and folders, with every format that might load them
+    Scanner (CabbagePluginListComponent& plc, const StringArray& files, int threads)
+        : owner (plc), formatToScan (nullptr), propertiesToUse (nullptr),
+          pathChooserWindow (String::empty, String::empty, AlertWindow::NoIcon),
+          progressWindow (TRANS("Scanning for plug-ins..."),
+                          TRANS("Searching for all possible plug-in files..."), AlertWindow::NoIcon),
+          progress (0.0), numThreads (jmax (1, threads)), finished (false), nextItem (0), numItemsDone (0)
+    {
+        for (int i = 0; i < owner.formatManager.getNumFormats(); ++i)
+        {
+            AudioPluginFormat* const format = owner.formatManager.getFormat (i);
+
+            for (int j = 0; j < files.size(); ++j)
+            {
+                const File f (File::createFileWithoutCheckingPath (files[j]));
+
+                if (format->fileMightContainThisPluginType (files[j]))
+                    addItem (format->getName(), files[j]);
+                else if (f.isDirectory())
+                    addItems (format->getName(), format->searchPathsForPlugins (FileSearchPath (f.getFullPathName()), true));
+            }
+        }
+
+        beginScanning();
+    }
+
     ~Scanner()
     {
         if (pool != nullptr)
@@ -390,10 +490,20 @@ public:
     }
 
 private:
+    enum { scanTimeoutMs = 20000 };
+
+    struct ScanResult
+    {
+        ScanResult (int itemIndex) : item (itemIndex), status (PluginScanCache::scanCrashed) {}
+
+        int item;
+        PluginScanCache::Status status;
+        OwnedArray<PluginDescription> types;
+    };
+
     CabbagePluginListComponent& owner;
-    AudioPluginFormat& formatToScan;
+    AudioPluginFormat* formatToScan;
     PropertiesFile* propertiesToUse;
-    ScopedPointer<PluginDirectoryScanner> scanner;
     AlertWindow pathChooserWindow, progressWindow;
     FileSearchPathListComponent pathList;
     String pluginBeingScanned;
@@ -402,6 +512,13 @@ private:
     bool finished;
     ScopedPointer<ThreadPool> pool;
 
+    // the files that weren't found in the cache, and need probing
+    StringArray itemFormats, itemFiles, failedFiles;
+    Atomic<int> nextItem;
+    int numItemsDone;
+    CriticalSection resultsLock;
+    OwnedArray<ScanResult> results;
+
     static void startScanCallback (int result, AlertWindow* alert, Scanner* scanner)
     {
         if (alert != nullptr && scanner != nullptr)
@@ -483,63 +600,134 @@ private:
     {
         pathChooserWindow.setVisible (false);
 
-        scanner = new PluginDirectoryScanner (owner.list, formatToScan, pathList.getPath(),
-                                              true, owner.deadMansPedalFile);
+        addItems (formatToScan->getName(), formatToScan->searchPathsForPlugins (pathList.getPath(), true));
 
         if (propertiesToUse != nullptr)
         {
-            setLastSearchPath (*propertiesToUse, formatToScan, pathList.getPath());
+            setLastSearchPath (*propertiesToUse, *formatToScan, pathList.getPath());
             propertiesToUse->saveIfNeeded();
         }
 
+        beginScanning();
+    }
+
+    void addItems (const String& formatName, const StringArray& files)
+    {
+        for (int i = 0; i < files.size(); ++i)
+            addItem (formatName, files[i]);
+    }
+
+    // files whose last scan is still valid are added straight from the cache.
+    // Blacklisted files are skipped, as are crashes the user hasn't cleared.
+    void addItem (const String& formatName, const String& fileOrIdentifier)
+    {
+        if (owner.list.getBlacklistedFiles().contains (fileOrIdentifier))
+            return;
+
+        PluginScanCache::Status status;
+        OwnedArray<PluginDescription> types;
+
+        if (owner.scanCache->lookup (formatName, File::createFileWithoutCheckingPath (fileOrIdentifier), status, types)
+            && (status == PluginScanCache::scanOk || status == PluginScanCache::scanFoundNothing))
+        {
+            for (int i = 0; i < types.size(); ++i)
+                owner.list.addType (*types.getUnchecked (i));
+
+            return;
+        }
+
+        itemFormats.add (formatName);
+        itemFiles.add (fileOrIdentifier);
+    }
+
+    void beginScanning()
+    {
         progressWindow.addButton (TRANS("Cancel"), 0, KeyPress (KeyPress::escapeKey));
         progressWindow.addProgressBarComponent (progress);
         progressWindow.enterModalState();
 
-        if (numThreads > 0)
-        {
-            pool = new ThreadPool (numThreads);
+        pool = new ThreadPool (numThreads);
 
-            for (int i = numThreads; --i >= 0;)
-                pool->addJob (new ScanJob (*this), true);
-        }
+        for (int i = jmin (numThreads, itemFiles.size()); --i >= 0;)
+            pool->addJob (new ScanJob (*this), true);
 
         startTimer (20);
     }
 
     void finishedScan()
     {
-        owner.scanFinished (scanner != nullptr ? scanner->getFailedFiles()
-                            : StringArray());
+        owner.scanCache->save();
+        owner.scanFinished (failedFiles);
     }
 
     void timerCallback() override
     {
-        if (pool == nullptr)
-        {
-            if (doNextScan())
-                startTimer (20);
-        }
+        applyResults();
 
         if (! progressWindow.isCurrentlyModal())
             finished = true;
 
         if (finished)
+        {
             finishedScan();
+        }
         else
+        {
+            const ScopedLock sl (resultsLock);
             progressWindow.setMessage (TRANS("Testing") + ":\n\n" + pluginBeingScanned);
+        }
     }
 
-    bool doNextScan()
+    // the list and cache are only changed here, on the message thread
+    void applyResults()
     {
-        if (scanner->scanNextFile (true, pluginBeingScanned))
+        OwnedArray<ScanResult> newResults;
+
         {
-            progress = scanner->getProgress();
-            return true;
+            const ScopedLock sl (resultsLock);
+            newResults.swapWith (results);
         }
 
-        finished = true;
-        return false;
+        for (int i = 0; i < newResults.size(); ++i)
+        {
+            const ScanResult& r = *newResults.getUnchecked (i);
+            const String& file = itemFiles[r.item];
+
+            owner.scanCache->store (itemFormats[r.item], File::createFileWithoutCheckingPath (file), r.status, r.types);
+
+            for (int j = 0; j < r.types.size(); ++j)
+                owner.list.addType (*r.types.getUnchecked (j));
+
+            if (r.status != PluginScanCache::scanOk)
+                failedFiles.add (file);
+
+            if (r.status == PluginScanCache::scanCrashed || r.status == PluginScanCache::scanTimedOut)
+                owner.list.addToBlacklist (file);
+        }
+
+        numItemsDone += newResults.size();
+        progress = itemFiles.size() > 0 ? numItemsDone / (double) itemFiles.size() : 1.0;
+
+        if (numItemsDone >= itemFiles.size())
+            finished = true;
+    }
+
+    void scanItem (int item, ThreadPoolJob* job)
+    {
+        {
+            const ScopedLock sl (resultsLock);
+            pluginBeingScanned = itemFiles[item];
+        }
+
+        ScopedPointer<ScanResult> result (new ScanResult (item));
+        result->status = PluginScanCache::scanOutOfProcess (itemFormats[item], itemFiles[item],
+                                                            scanTimeoutMs, result->types, job);
+
+        if (job->shouldExit())
+            return;
+
+        const ScopedLock sl (resultsLock);
+        results.add (result.release());
     }
 
     struct ScanJob  : public ThreadPoolJob
@@ -548,8 +736,15 @@ private:
 
         JobStatus runJob()
         {
-            while (scanner.doNextScan() && ! shouldExit())
-            {}
+            while (! shouldExit())
+            {
+                const int item = (++scanner.nextItem) - 1;
+
+                if (item >= scanner.itemFiles.size())
+                    break;
+
+                scanner.scanItem (item, this);
+            }
 
             return jobHasFinished;
         }
@@ -567,6 +762,11 @@ void CabbagePluginListComponent::scanFor (AudioPluginFormat& format)
     currentScanner = new Scanner (*this, format, propertiesToUse, numThreads);
 }
 
+void CabbagePluginListComponent::scanFiles (const StringArray& files)
+{
+    currentScanner = new Scanner (*this, files, numThreads);
+}
+
 bool CabbagePluginListComponent::isScanning() const noexcept
 {
     return currentScanner != nullptr;
@@ -27,6 +27,7 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "../CabbageUtils.h"
+#include "PluginScanCache.h"
 
 //==============================================================================
 /**
@@ -43,7 +44,8 @@ public:
     /**
         Creates the list component.
 
-        For info about the deadMansPedalFile, see the PluginDirectoryScanner constructor.
+        Plugins are probed by a helper process, and the results are cached in a file
+        next to the deadMansPedalFile so that unchanged files aren't probed again.
         The properties file, if supplied, is used to store the user's last search paths.
     */
     CabbagePluginListComponent (AudioPluginFormatManager& formatManager,
@@ -57,8 +59,8 @@ public:
     /** Changes the text in the panel's options button. */
     void setOptionsButtonText (const String& newText);
 
-    /** Sets how many threads to simultaneously scan for plugins.
-        If this is 0, then all scanning happens on the message threapathChooserWindowd (this is the default)
+    /** Sets how many helper processes to run at once when scanning for plugins.
+        The default of 0 runs one at a time.
     */
     void setNumberOfThreadsForScanning (int numThreads);
 
@@ -71,6 +73,12 @@ public:
     /** Triggers an asynchronous scan for the given format. */
     void scanFor (AudioPluginFormat&);
 
+    /** Triggers an asynchronous scan of the given files, with every format that might load them. */
+    void scanFiles (const StringArray&);
+
+    /** Adds the Cabbage instruments found in the given folders to the list. */
+    void indexCabbageInstruments (const FileSearchPath&);
+
     /** Returns true if there's currently a scan in progress. */
     bool isScanning() const noexcept;
 
@@ -83,6 +91,7 @@ private:
     TextButton optionsButton;
     PropertiesFile* propertiesToUse;
     int numThreads;
+    ScopedPointer<PluginScanCache> scanCache;
 
     class TableModel;
     friend class TableModel;
@@ -102,6 +111,7 @@ private:
     bool canShowSelectedFolder() const;
     void removeSelected();
     void removeMissingPlugins();
+    bool addCabbageInstrument (const File&);
 
     void resized() override;
     bool isInterestedInFileDrag (const StringArray&) override;
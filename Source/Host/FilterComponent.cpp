@@ -151,10 +151,15 @@ FilterComponent::FilterComponent (FilterGraph& graph_, const uint32 filterID_)
     //addAndMakeVisible(mute);
     //addAndMakeVisible(bypass);
 
+    zerostruct(dspLoad);
+    graph.getRenderer().getProfiler().addChangeListener(this);
+    if(graph.getRenderer().getProfiler().isEnabled())
+        startTimer(100);
 }
 //================================================================================
 FilterComponent::~FilterComponent()
 {
+    graph.getRenderer().getProfiler().removeChangeListener(this);
     mute = nullptr;
     bypass = nullptr;
     deleteAllChildren();
@@ -238,6 +243,15 @@ void FilterComponent::mouseDown (const MouseEvent& e)
             m.addItem (9, "Export as VSTi");
         }
 
+        if(pluginType!=INTERNAL && pluginType!=AUTOMATION)
+        {
+            m.addSeparator();
+            if(graph.isFrozen(filterID))
+                m.addItem (11, "Unfreeze");
+            else
+                m.addItem (10, "Freeze...");
+        }
+
         //m.addItem (6, "Test state save/load");
 
         const int r = m.show();
@@ -286,6 +300,34 @@ void FilterComponent::mouseDown (const MouseEvent& e)
         {
             exportPlugin(r==8 ? String("VST") : String("VSTi"), false);
         }
+        else if(r==10 || r==11)
+        {
+            if(r==10)
+            {
+                AlertWindow alert("Freeze", "Seconds of audio to render", AlertWindow::NoIcon);
+                alert.addTextEditor("seconds", "30");
+                alert.addButton("Freeze", 1, KeyPress(KeyPress::returnKey));
+                alert.addButton("Cancel", 0, KeyPress(KeyPress::escapeKey));
+                if(alert.runModalLoop()==0)
+                    return;
+
+                codeWindow = nullptr;
+                if(!graph.freezeNode(filterID, alert.getTextEditorContents("seconds").getDoubleValue()))
+                    return;
+            }
+            else
+            {
+                getGraphDocument()->removeComponentFromBottomPanel("Soundfile Player:"+String(filterID));
+                graph.unfreezeNode(filterID);
+            }
+
+            //the node has a new processor, so the pins are rebuilt straight away
+            GraphDocumentComponent* const graphDocument = getGraphDocument();
+            numInputs = numOutputs = -1;
+            update();
+            graphDocument->refreshPluginsInSidebarPanel();
+            return;
+        }
 
         else
         {
@@ -439,6 +481,19 @@ void FilterComponent::changeListenerCallback(ChangeBroadcaster* source)
     //so far only automation tracks call this change method so it's ok to old-style cast.
     //cUtils::debug(((AutomationProcessor*)source)->getAutomationValue());
 
+    //profiling has been switched on or off
+    if(source == &graph.getRenderer().getProfiler())
+    {
+        if(graph.getRenderer().getProfiler().isEnabled())
+            startTimer(100);
+        else
+        {
+            zerostruct(dspLoad);
+            if(codeWindow==nullptr)
+                stopTimer();
+            repaint();
+        }
+    }
 }
 //================================================================================
 void FilterComponent::actionListenerCallback (const String &message)
@@ -455,7 +510,8 @@ void FilterComponent::actionListenerCallback (const String &message)
         enableEditMode(false);
         getGraphDocument()->disableWidetPropertiesInSidebarPanel();
         codeWindow = nullptr;
-        stopTimer();
+        if(!graph.getRenderer().getProfiler().isEnabled())
+            stopTimer();
     }
     else if(message == "enableEditMode")
     {
@@ -549,6 +605,9 @@ void FilterComponent::timerCallback()
         }
     }
 
+    if(graph.getRenderer().getProfiler().isEnabled()
+            && graph.getRenderer().getProfiler().getStats(filterID, dspLoad))
+        repaint(4, pinSize, getWidth()-8, 8);
 }
 //================================================================================
 void FilterComponent::paint (Graphics& g)
@@ -586,6 +645,27 @@ void FilterComponent::paint (Graphics& g)
         }
         drawBypassIcon(g, bypassButton, isBypassed);
         drawMuteIcon(g, muteButton, isMuted);
+
+        if(graph.getRenderer().getProfiler().isEnabled())
+            drawLoadBar(g, x+8, y+3, w-16, 3);
+    }
+}
+
+//mean load across the bar, with a tick at the 99th percentile
+void FilterComponent::drawLoadBar (Graphics& g, float x, float y, float width, float height)
+{
+    const float mean = jlimit(0.f, 1.f, (float)dspLoad.mean);
+    const float p99 = jlimit(0.f, 1.f, (float)dspLoad.p99);
+
+    g.setColour(Colours::lightblue.withAlpha(0.1f));
+    g.fillRect(x, y, width, height);
+    g.setColour(mean < .5f ? Colours::lime.withAlpha(0.7f) : mean < .8f ? Colours::orange : Colours::red);
+    g.fillRect(x, y, width*mean, height);
+
+    if(dspLoad.numOverruns > 0 || p99 > mean)
+    {
+        g.setColour(dspLoad.numOverruns > 0 ? Colours::red : Colours::whitesmoke);
+        g.fillRect(x+width*p99-1.f, y-1.f, 2.f, height+2.f);
     }
 }
 
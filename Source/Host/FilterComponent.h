@@ -63,6 +63,7 @@ public:
     void getPinPos (const int index, const bool isInput, float& x, float& y);
     void update();
     void drawLevelMeter (Graphics& g, float x, float y, int width, int height, float level);
+    void drawLoadBar (Graphics& g, float x, float y, float width, float height);
     void drawMuteIcon(Graphics& g, Rectangle<float> rect, bool state);
     void drawBypassIcon(Graphics& g, Rectangle<float> rect, bool isActive);
     void timerCallback();
@@ -87,6 +88,7 @@ private:
     bool filterIsPartofSelectedGroup;
     Point<int> originalPos;
     float rmsLeft, rmsRight;
+    NodeLoadProfiler::Stats dspLoad;
     void resized();
     Font font;
     int numIns, numOuts;
@@ -33,6 +33,237 @@
 #include "AutomationProcessor.h"
 
 
+//==============================================================================
+// Loads a session without blocking the message thread. Cabbage nodes and
+// soundfile players are built on a pool of worker threads, everything else is
+// created on the message thread, one node per timer tick. Each node is added
+// to the graph as soon as it's ready, along with any connection whose ends
+// both exist, so the first nodes can be heard before the rest have compiled.
+//
+// Csound resolves a csd's relative paths against the current working
+// directory, which every Cabbage node sets to its own folder, so the nodes are
+// compiled one folder at a time. The very first one is compiled on its own so
+// Csound's one-off library setup never runs on two threads at once. Anything
+// global a Cabbage node needs from the message thread, the screen size and
+// its log file, is seen to before the jobs start and as each node is added.
+//==============================================================================
+class FilterGraph::SessionLoader  : private Timer
+{
+public:
+    SessionLoader (FilterGraph& graphToLoad, const XmlElement& xml)
+        : owner (graphToLoad), sessionXml (xml),
+          progressWindow (TRANS("Loading session..."), String::empty, AlertWindow::NoIcon),
+          pool (jlimit (1, 8, SystemStats::getNumCpus())),
+          progress (0.0), numNodes (0), numNodesAdded (0), numJobsRunning (0), firstCompile (true)
+    {
+        forEachXmlChildElementWithTagName (sessionXml, e, "FILTER")
+        {
+            const PluginDescription desc (FilterGraph::getDescriptionFromXml (*e));
+
+            if (! FilterGraph::canCreateOnBackgroundThread (desc))
+                messageThreadNodes.add (e);
+            else
+            {
+                const String folder (desc.pluginFormatName == "Cabbage"
+                                     ? File (desc.fileOrIdentifier).getParentDirectory().getFullPathName()
+                                     : String::empty);
+                folders.addIfNotAlreadyThere (folder);
+                folderForNode.add (folder);
+                backgroundNodes.add (e);
+            }
+
+            numNodes++;
+        }
+
+        forEachXmlChildElementWithTagName (sessionXml, e, "CONNECTION")
+            pendingConnections.add (e);
+
+        //so the workers see the real size rather than the default
+        CabbagePluginAudioProcessor::getScreenArea();
+
+        progressWindow.addProgressBarComponent (progress);
+        progressWindow.addButton (TRANS("Cancel"), 0, KeyPress (KeyPress::escapeKey));
+        progressWindow.enterModalState();
+
+        startTimer (20);
+    }
+
+    ~SessionLoader()
+    {
+        stopTimer();
+        //a compile can't be interrupted, but the jobs that haven't started yet
+        //won't, and the ones that have are waited for however long they take
+        pool.removeAllJobs (true, -1);
+
+        const ScopedLock sl (readyLock);
+        for (int i = 0; i < ready.size(); ++i)
+            delete ready.getReference (i).processor;
+    }
+
+private:
+    struct ReadyNode
+    {
+        const XmlElement* xml;
+        AudioProcessor* processor;
+    };
+
+    class CreateJob  : public ThreadPoolJob
+    {
+    public:
+        CreateJob (SessionLoader& l, const XmlElement& x)
+            : ThreadPoolJob ("Session node"), loader (l), xml (x) {}
+
+        JobStatus runJob() override
+        {
+            if (shouldExit())
+                return jobHasFinished;
+
+            const PluginDescription desc (FilterGraph::getDescriptionFromXml (xml));
+            String errorMessage;
+            ReadyNode node = { &xml, loader.owner.createProcessor (&desc, errorMessage) };
+
+            const ScopedLock sl (loader.readyLock);
+            loader.ready.add (node);
+            return jobHasFinished;
+        }
+
+    private:
+        SessionLoader& loader;
+        const XmlElement& xml;
+    };
+
+    void timerCallback() override
+    {
+        if (! progressWindow.isCurrentlyModal())
+        {
+            finish();
+            return;
+        }
+
+        //add whatever the workers have finished
+        Array<ReadyNode> newNodes;
+        {
+            const ScopedLock sl (readyLock);
+            newNodes.swapWith (ready);
+        }
+
+        for (int i = 0; i < newNodes.size(); ++i)
+        {
+            addNode (*newNodes.getReference (i).xml, newNodes.getReference (i).processor);
+            numJobsRunning--;
+        }
+
+        if (newNodes.size() == 0 && messageThreadNodes.size() > 0)
+        {
+            const XmlElement* xml = messageThreadNodes.remove (0);
+            const PluginDescription desc (FilterGraph::getDescriptionFromXml (*xml));
+            String errorMessage;
+            addNode (*xml, owner.createProcessor (&desc, errorMessage));
+        }
+
+        if (numJobsRunning == 0)
+            startNextFolder();
+
+        progress = numNodes > 0 ? numNodesAdded / (double) numNodes : 1.0;
+        progressWindow.setMessage (TRANS("Loaded") + " " + String (numNodesAdded) + " / " + String (numNodes));
+
+        if (numNodesAdded >= numNodes)
+            finish();
+    }
+
+    void startNextFolder()
+    {
+        if (folders.size() == 0)
+            return;
+
+        const String folder (folders[0]);
+        //soundfile players have no folder and never start Csound
+        const bool compileOnItsOwn = firstCompile && folder.isNotEmpty();
+
+        for (int i = 0; i < backgroundNodes.size(); ++i)
+        {
+            if (folderForNode[i] != folder)
+                continue;
+
+            pool.addJob (new CreateJob (*this, *backgroundNodes.getUnchecked (i)), true);
+            numJobsRunning++;
+            backgroundNodes.remove (i);
+            folderForNode.remove (i--);
+
+            if (compileOnItsOwn)
+                break;
+        }
+
+        if (compileOnItsOwn)
+            firstCompile = false;
+        else
+            folders.remove (0);
+    }
+
+    void addNode (const XmlElement& xml, AudioProcessor* processor)
+    {
+        numNodesAdded++;
+        const PluginDescription desc (FilterGraph::getDescriptionFromXml (xml));
+
+        //a node built by a worker couldn't set its log file up itself
+        if (CabbagePluginAudioProcessor* cabbageProcessor = dynamic_cast<CabbagePluginAudioProcessor*> (processor))
+            cabbageProcessor->installFileLogger();
+
+        if (AudioProcessorGraph::Node* node = owner.addNodeForProcessor (processor, &desc, xml.getIntAttribute ("uid")))
+        {
+            owner.restoreNodeFromXml (*node, xml, desc);
+            addReadyConnections();
+            owner.changed();
+        }
+    }
+
+    void addReadyConnections()
+    {
+        for (int i = pendingConnections.size(); --i >= 0;)
+        {
+            const XmlElement* e = pendingConnections.getUnchecked (i);
+            const uint32 source = (uint32) e->getIntAttribute ("srcFilter");
+            const uint32 dest = (uint32) e->getIntAttribute ("dstFilter");
+
+            if (owner.getNodeForId (source) != nullptr && owner.getNodeForId (dest) != nullptr)
+            {
+                owner.addConnection (source, e->getIntAttribute ("srcChannel"),
+                                     dest, e->getIntAttribute ("dstChannel"));
+                pendingConnections.remove (i);
+            }
+        }
+    }
+
+    //deletes this loader, so nothing may touch it afterwards
+    void finish()
+    {
+        stopTimer();
+        progressWindow.exitModalState (0);
+        progressWindow.setVisible (false);
+
+        owner.graph.removeIllegalConnections();
+        owner.restoreMidiMappingsFromXml (sessionXml);
+        owner.setChangedFlag (false);
+        owner.sessionLoader = nullptr;
+    }
+
+    FilterGraph& owner;
+    const XmlElement sessionXml;
+    AlertWindow progressWindow;
+    ThreadPool pool;
+    double progress;
+
+    Array<const XmlElement*> messageThreadNodes, backgroundNodes, pendingConnections;
+    StringArray folders, folderForNode;
+    int numNodes, numNodesAdded, numJobsRunning;
+    bool firstCompile;
+
+    CriticalSection readyLock;
+    Array<ReadyNode> ready;
+
+    JUCE_DECLARE_NON_COPYABLE (SessionLoader)
+};
+
 //==============================================================================
 const int FilterGraph::midiChannelNumber = 0x1000;
 
@@ -42,25 +273,21 @@ FilterGraph::FilterGraph (AudioPluginFormatManager& formatManager_)
                          "Load a filter graph",
                          "Save a filter graph"),
     formatManager (formatManager_),
+    renderer (graph),
     lastUID (0),
-    audioPlayHead(),
-    timeInSeconds(0),
-    currentBPM(60),
-    playPosition(0),
-    PPQN(24),
-    ppqPosition(1),
-    automationNodeID(-1),
-    subTicks(0)
-{
-    startTimer(0);
-    stopTimer();
+    automationNodeID(-1)
+{
+    addChangeListener (&renderer);
+    renderer.setMidiLearnTable (&midiLearnTable);
     setChangedFlag (false);
     setBPM(60);
 }
 
 FilterGraph::~FilterGraph()
 {
-    stopTimer();
+    sessionLoader = nullptr;
+    removeChangeListener (&renderer);
+    renderer.setMidiLearnTable (nullptr);
     graph.clear();
 }
 
@@ -87,29 +314,27 @@ const AudioProcessorGraph::Node::Ptr FilterGraph::getNodeForId (const uint32 uid
 //==============================================================================
 void FilterGraph::addNodesToAutomationTrack(int32 id, int index)
 {
-    /*
-        //if there is an automation device, otherwise create one. Only one permitted in each patch..
-        if(getNodeForId(automationNodeID))
-        {
-            automationAdded=true;
-            AutomationProcessor* node = (AutomationProcessor*)graph.getNodeForId(automationNodeID)->getProcessor();
-            node->addAutomatableNode(graph.getNodeForId(id)->getProcessor()->getName(), graph.getNodeForId(id)->getProcessor()->getParameterName(index), id, index);
-        }
-        else
-        {
-            PluginDescription descript;
-            descript.descriptiveName = "Automation track";
-            descript.name = "AutomationTrack";
-            descript.pluginFormatName = "AutomationTrack";
-            descript.numInputChannels = 2;
-            descript.numOutputChannels = 2;
-            addFilter(&descript, 0.50f, 0.5f);
+    //if there is an automation device, otherwise create one. Only one permitted in each patch..
+    if(getNodeForId(automationNodeID))
+    {
+        automationAdded=true;
+        AutomationProcessor* node = (AutomationProcessor*)graph.getNodeForId(automationNodeID)->getProcessor();
+        node->addAutomatableNode(graph.getNodeForId(id)->getProcessor()->getName(), graph.getNodeForId(id)->getProcessor()->getParameterName(index), id, index);
+    }
+    else
+    {
+        PluginDescription descript;
+        descript.descriptiveName = "Automation track";
+        descript.name = "AutomationTrack";
+        descript.pluginFormatName = "AutomationTrack";
+        descript.numInputChannels = 2;
+        descript.numOutputChannels = 2;
+        addFilter(&descript, 0.50f, 0.5f);
 
-            AutomationProcessor* node = (AutomationProcessor*)graph.getNodeForId(automationNodeID)->getProcessor();
-            node->addAutomatableNode(graph.getNodeForId(id)->getProcessor()->getName(), graph.getNodeForId(id)->getProcessor()->getParameterName(index), id, index);
+        AutomationProcessor* node = (AutomationProcessor*)graph.getNodeForId(automationNodeID)->getProcessor();
+        node->addAutomatableNode(graph.getNodeForId(id)->getProcessor()->getName(), graph.getNodeForId(id)->getProcessor()->getParameterName(index), id, index);
 
-        }
-    */
+    }
 }
 
 //==============================================================================
@@ -117,128 +342,56 @@ void FilterGraph::addNodesToAutomationTrack(int32 id, int index)
 //==============================================================================
 void FilterGraph::setIsPlaying(bool value, bool reset)
 {
-    audioPlayHead.setIsPlaying(value);
-    if(value == true)
-    {
-        startTimer(100*(60.f/currentBPM));
-    }
-    else
-        stopTimer();
+    transport.setPlaying(value);
 
     if(reset==true)
-    {
-        timeInSeconds=0;
-        audioPlayHead.setPPQPosition(0);
-        audioPlayHead.setTimeInSeconds(0);
-        ppqPosition=0;
-        timeInSeconds=0;
-
-    }
+        transport.setPosition(0);
 }
 //------------------------------------------
 void FilterGraph::setBPM(int bpm)
 {
-    currentBPM = bpm;
-    audioPlayHead.setBpm(bpm);
-
-
-    if(isTimerRunning())
-    {
-        stopTimer();
-        startTimer(100*(60.f/currentBPM));
-    }
-}
-//------------------------------------------
-void FilterGraph::hiResTimerCallback()
-{
-    if(playPosition==0)
-    {
-        timeInSeconds++;
-        audioPlayHead.setTimeInSeconds(timeInSeconds);
-    }
-
-
-    if(subTicks==0)
-    {
-        audioPlayHead.setPPQPosition(ppqPosition);
-        ppqPosition++;
-    }
-
-    subTicks = (subTicks > 9 ? 0 : subTicks+1);
-    playPosition = (playPosition > 1 ? 0 : playPosition+((float)getTimerInterval()/1000.f));
+    transport.setTempo(bpm);
 }
 
 AudioProcessorGraph::Node::Ptr FilterGraph::createNode(const PluginDescription* desc, int uid)
 {
-    AudioProcessorGraph::Node* node = nullptr;
     String errorMessage;
+    return addNodeForProcessor(createProcessor(desc, errorMessage), desc, uid);
+}
 
+//Cabbage nodes and soundfile players can be built away from the message
+//thread, everything else is created through a plugin format
+bool FilterGraph::canCreateOnBackgroundThread(const PluginDescription& desc)
+{
+    return desc.pluginFormatName=="Cabbage" || desc.pluginFormatName=="SoundfilePlayer";
+}
 
+AudioProcessor* FilterGraph::createProcessor(const PluginDescription* desc, String& errorMessage)
+{
     if(desc->pluginFormatName=="AutomationTrack")
     {
-        if (AutomationProcessor* automation = new AutomationProcessor(this))
-        {
-            automation->setPlayConfigDetails(2,
-                                             2,
-                                             graph.getSampleRate(),
-                                             graph.getBlockSize());
-
-            if(uid!=-1)
-                node = graph.addNode (automation, uid);
-            else
-                node = graph.addNode (automation);
-
-            automationNodeID = node->nodeId;
-            node->properties.set("pluginType", "AutomationTrack");
-            node->properties.set("pluginName", "AutomationTrack");
-            ScopedPointer<XmlElement> xmlElem;
-            xmlElem = desc->createXml();
-            String xmlText = xmlElem->createDocument("");
-            node->properties.set("pluginType", "AutomationTrack");
-            node->properties.set("pluginDesc", xmlText);
-            node->getProcessor()->setPlayHead(&audioPlayHead);
-            return node;
-        }
+        AutomationProcessor* automation = new AutomationProcessor();
+        automation->setPlayConfigDetails(2,
+                                         2,
+                                         graph.getSampleRate(),
+                                         graph.getBlockSize());
+        return automation;
     }
 
     if(desc->pluginFormatName=="SoundfilePlayer")
     {
-        if (AudioFilePlaybackProcessor* soundfiler = new AudioFilePlaybackProcessor())
-        {
-            soundfiler->setPlayConfigDetails(2,
-                                             2,
-                                             graph.getSampleRate(),
-                                             graph.getBlockSize());
-
-            soundfiler->setupAudioFile(File(desc->fileOrIdentifier));
-
-            if(uid!=-1)
-                node = graph.addNode (soundfiler, uid);
-            else
-                node = graph.addNode (soundfiler);
-
-            node->properties.set("pluginType", "SoundfilePlayer");
-            node->properties.set("pluginName", "Soundfile Player");
-            ScopedPointer<XmlElement> xmlElem;
-            xmlElem = desc->createXml();
-            String xmlText = xmlElem->createDocument("");
-            node->properties.set("pluginDesc", xmlText);
-            node->getProcessor()->setPlayHead(&audioPlayHead);
-            return node;
-        }
+        AudioFilePlaybackProcessor* soundfiler = new AudioFilePlaybackProcessor();
+        soundfiler->setPlayConfigDetails(2,
+                                         2,
+                                         graph.getSampleRate(),
+                                         graph.getBlockSize());
+
+        soundfiler->setupAudioFile(File(desc->fileOrIdentifier));
+        return soundfiler;
     }
     else if(desc->pluginFormatName=="Internal")
     {
-        if (AudioPluginInstance* instance = formatManager.createPluginInstance (*desc, graph.getSampleRate(), graph.getBlockSize(), errorMessage))
-        {
-            if(uid!=-1)
-                node = graph.addNode (instance, uid);
-            else
-                node = graph.addNode (instance);
-
-            node->properties.set("pluginType", "Internal");
-            node->properties.set("pluginName", desc->name);
-        }
+        return formatManager.createPluginInstance (*desc, graph.getSampleRate(), graph.getBlockSize(), errorMessage);
     }
 
     else if(desc->pluginFormatName=="Cabbage")
@@ -251,20 +404,7 @@ AudioProcessorGraph::Node::Ptr FilterGraph::createNode(const PluginDescription*
                 numChannels,
                 cabbageNativePlugin->getCsoundSamplingRate(),
                 cabbageNativePlugin->getCsoundKsmpsSize());
-
-        if(uid!=-1)
-            node = graph.addNode (cabbageNativePlugin, uid);
-        else
-            node = graph.addNode (cabbageNativePlugin);
-
-        node->properties.set("pluginName", cabbageNativePlugin->getPluginName());
-        //native Cabbage plugins don't have plugin descriptors, so we create one here..
-        ScopedPointer<XmlElement> xmlElem;
-        xmlElem = desc->createXml();
-        String xmlText = xmlElem->createDocument("");
-        node->properties.set("pluginType", "Cabbage");
-        node->properties.set("pluginDesc", xmlText);
-        node->getProcessor()->setPlayHead(&audioPlayHead);
+        return cabbageNativePlugin;
     }
 
     else //all third party plugins get wrapped into a PluginWrapper...
@@ -276,18 +416,76 @@ AudioProcessorGraph::Node::Ptr FilterGraph::createNode(const PluginDescription*
                                             graph.getSampleRate(),
                                             graph.getBlockSize());
             instance->setPluginName(desc->name);
-            //cUtils::debug("num params", instance->getNumParameters());
-            if(uid!=-1)
-                node = graph.addNode (instance, uid);
-            else
-                node = graph.addNode (instance);
-
-            node->properties.set("pluginType", "ThirdParty");
-            node->getProcessor()->setPlayHead(&audioPlayHead);
-            node->properties.set("pluginName", desc->name);
+            return instance;
         }
     }
 
+    return nullptr;
+}
+
+AudioProcessorGraph::Node* FilterGraph::addNodeForProcessor(AudioProcessor* processor, const PluginDescription* desc, int uid)
+{
+    if(processor==nullptr)
+        return nullptr;
+
+    AudioProcessorGraph::Node* node = nullptr;
+    if(uid!=-1)
+        node = graph.addNode (processor, uid);
+    else
+        node = graph.addNode (processor);
+
+    if(node==nullptr)
+        return nullptr;
+
+    if(desc->pluginFormatName=="AutomationTrack")
+    {
+        automationNodeID = node->nodeId;
+        node->properties.set("pluginType", "AutomationTrack");
+        node->properties.set("pluginName", "AutomationTrack");
+        ScopedPointer<XmlElement> xmlElem;
+        xmlElem = desc->createXml();
+        String xmlText = xmlElem->createDocument("");
+        node->properties.set("pluginType", "AutomationTrack");
+        node->properties.set("pluginDesc", xmlText);
+        node->getProcessor()->setPlayHead(&transport);
+    }
+
+    else if(desc->pluginFormatName=="SoundfilePlayer")
+    {
+        node->properties.set("pluginType", "SoundfilePlayer");
+        node->properties.set("pluginName", "Soundfile Player");
+        ScopedPointer<XmlElement> xmlElem;
+        xmlElem = desc->createXml();
+        String xmlText = xmlElem->createDocument("");
+        node->properties.set("pluginDesc", xmlText);
+        node->getProcessor()->setPlayHead(&transport);
+    }
+    else if(desc->pluginFormatName=="Internal")
+    {
+        node->properties.set("pluginType", "Internal");
+        node->properties.set("pluginName", desc->name);
+    }
+
+    else if(desc->pluginFormatName=="Cabbage")
+    {
+        CabbagePluginAudioProcessor* cabbageNativePlugin = (CabbagePluginAudioProcessor*)processor;
+        node->properties.set("pluginName", cabbageNativePlugin->getPluginName());
+        //native Cabbage plugins don't have plugin descriptors, so we create one here..
+        ScopedPointer<XmlElement> xmlElem;
+        xmlElem = desc->createXml();
+        String xmlText = xmlElem->createDocument("");
+        node->properties.set("pluginType", "Cabbage");
+        node->properties.set("pluginDesc", xmlText);
+        node->getProcessor()->setPlayHead(&transport);
+    }
+
+    else
+    {
+        node->properties.set("pluginType", "ThirdParty");
+        node->getProcessor()->setPlayHead(&transport);
+        node->properties.set("pluginName", desc->name);
+    }
+
     return node;
 }
 
@@ -323,18 +521,34 @@ void FilterGraph::addFilter (const PluginDescription* desc, double x, double y)
 //==============================================================================
 String FilterGraph::findControllerForparameter(int32 nodeID, int paramIndex)
 {
+    const String key(String(nodeID)+":"+String(paramIndex));
+    if(!mappingForParameter.contains(key))
+        return String::empty;
+
+    const CabbageMidiMapping& mapping = midiMappings.getReference(mappingForParameter[key]);
+    const String type(mapping.type==MidiLearnTable::nrpn ? "NRPN:"
+                      : mapping.type==MidiLearnTable::controller14Bit ? "CC14:" : "CC:");
+    return type+String(mapping.controller)+" Chan:"+String(mapping.channel);
+}
+
+void FilterGraph::updateMidiLearnTable()
+{
+    Array<MidiLearnTable::Mapping> mappings;
+    mappingForParameter.clear();
+
     for(int i=0; i<midiMappings.size(); i++)
     {
-        //cUtils::debug(midiMappings.getReference(i).nodeId);
-        //cUtils::debug(midiMappings.getReference(i).parameterIndex);
-
-        if(midiMappings.getReference(i).nodeId==nodeID && midiMappings.getReference(i).parameterIndex==paramIndex)
-        {
-            String midiInfo = "CC:"+String(midiMappings.getReference(i).controller)+" Chan:"+String(midiMappings.getReference(i).channel);
-            return midiInfo;
-        }
+        const CabbageMidiMapping& m = midiMappings.getReference(i);
+        //a frozen node's parameters belong to the player standing in for it
+        if(isFrozen(m.nodeId))
+            continue;
+
+        MidiLearnTable::Mapping mapping = { m.channel, m.controller, m.type, m.nodeId, m.parameterIndex, m.smoothing };
+        mappings.add(mapping);
+        mappingForParameter.set(String(m.nodeId)+":"+String(m.parameterIndex), i);
     }
-    return String::empty;
+
+    midiLearnTable.setMappings(mappings);
 }
 
 
@@ -343,6 +557,8 @@ void FilterGraph::removeFilter (const uint32 id)
 {
     PluginWindow::closeCurrentlyOpenWindowsFor (id);
 
+    //a saved session may still use a frozen node's render, so it is left for
+    //removeUnusedFrozenAudio()
     if (graph.removeNode (id))
         changed();
 }
@@ -435,9 +651,12 @@ void FilterGraph::removeConnection (uint32 sourceFilterUID, int sourceFilterChan
 
 void FilterGraph::clear()
 {
+    sessionLoader = nullptr;
     PluginWindow::closeAllCurrentlyOpenWindows();
 
     graph.clear();
+    midiMappings.clear();
+    updateMidiLearnTable();
     changed();
 }
 
@@ -459,7 +678,8 @@ Result FilterGraph::loadDocument (const File& file)
     if (xml == nullptr || ! xml->hasTagName ("FILTERGRAPH"))
         return Result::fail ("Not a valid filter graph file");
 
-    restoreFromXml (*xml);
+    restoreFromXml (*xml, true);
+    removeUnusedFrozenAudio();
     return Result::ok();
 }
 
@@ -470,6 +690,7 @@ Result FilterGraph::saveDocument (const File& file)
     if (! xml->writeToFile (file, String::empty))
         return Result::fail ("Couldn't write to the file");
 
+    removeUnusedFrozenAudio();
     return Result::ok();
 }
 
@@ -531,11 +752,14 @@ static XmlElement* createNodeXml (AudioProcessorGraph::Node* const node) noexcep
     state->addTextElement (m.toBase64Encoding());
     e->addChildElement (state);
 
+    if (node->properties.contains ("frozen"))
+        e->addChildElement (XmlDocument::parse (node->properties ["frozen"].toString()));
+
     return e;
 }
 
 //==============================================================================
-void FilterGraph::createNodeFromXml (const XmlElement& xml)
+PluginDescription FilterGraph::getDescriptionFromXml (const XmlElement& xml)
 {
     PluginDescription desc;
 
@@ -545,25 +769,35 @@ void FilterGraph::createNodeFromXml (const XmlElement& xml)
             break;
     }
 
-    AudioProcessorGraph::Node::Ptr node = nullptr;
+    return desc;
+}
 
-    String errorMessage;
-    node = createNode(&desc, xml.getIntAttribute ("uid"));
+void FilterGraph::createNodeFromXml (const XmlElement& xml)
+{
+    const PluginDescription desc (getDescriptionFromXml (xml));
 
+    if (AudioProcessorGraph::Node* node = createNode(&desc, xml.getIntAttribute ("uid")))
+        restoreNodeFromXml (*node, xml, desc);
+}
+
+void FilterGraph::restoreNodeFromXml (AudioProcessorGraph::Node& node, const XmlElement& xml, const PluginDescription& desc)
+{
     if (const XmlElement* const state = xml.getChildByName ("STATE"))
     {
         MemoryBlock m;
         m.fromBase64Encoding (state->getAllSubText());
 
-        node->getProcessor()->setStateInformation (m.getData(), (int) m.getSize());
+        node.getProcessor()->setStateInformation (m.getData(), (int) m.getSize());
     }
 
-    node->properties.set ("x", xml.getDoubleAttribute ("x"));
-    node->properties.set ("y", xml.getDoubleAttribute ("y"));
-    node->properties.set ("uiLastX", xml.getIntAttribute ("uiLastX"));
-    node->properties.set ("uiLastY", xml.getIntAttribute ("uiLastY"));
-    node->properties.set("pluginName", desc.name);
+    node.properties.set ("x", xml.getDoubleAttribute ("x"));
+    node.properties.set ("y", xml.getDoubleAttribute ("y"));
+    node.properties.set ("uiLastX", xml.getIntAttribute ("uiLastX"));
+    node.properties.set ("uiLastY", xml.getIntAttribute ("uiLastY"));
+    node.properties.set("pluginName", desc.name);
 
+    if (const XmlElement* const frozen = xml.getChildByName ("FROZEN"))
+        node.properties.set ("frozen", frozen->createDocument (String::empty));
 }
 
 //==============================================================================
@@ -597,6 +831,8 @@ XmlElement* FilterGraph::createXml() const
         e->setAttribute ("ParameterIndex", midiMappings.getReference(i).parameterIndex);
         e->setAttribute ("Channel", midiMappings.getReference(i).channel);
         e->setAttribute ("Controller", midiMappings.getReference(i).controller);
+        e->setAttribute ("Type", midiMappings.getReference(i).type);
+        e->setAttribute ("Smoothing", midiMappings.getReference(i).smoothing);
 
         xml->addChildElement (e);
     }
@@ -604,10 +840,16 @@ XmlElement* FilterGraph::createXml() const
     return xml;
 }
 
-void FilterGraph::restoreFromXml (const XmlElement& xml)
+void FilterGraph::restoreFromXml (const XmlElement& xml, bool loadInBackground)
 {
     clear();
 
+    if (loadInBackground)
+    {
+        sessionLoader = new SessionLoader (*this, xml);
+        return;
+    }
+
     forEachXmlChildElementWithTagName (xml, e, "FILTER")
     {
         createNodeFromXml (*e);
@@ -623,21 +865,335 @@ void FilterGraph::restoreFromXml (const XmlElement& xml)
                        e->getIntAttribute ("dstChannel"));
     }
     graph.removeIllegalConnections();
+    restoreMidiMappingsFromXml (xml);
+}
 
+void FilterGraph::restoreMidiMappingsFromXml (const XmlElement& xml)
+{
     forEachXmlChildElementWithTagName (xml, e, "MIDI_MAPPINGS")
     {
         midiMappings.add(CabbageMidiMapping(e->getIntAttribute ("NodeId"),
                                             e->getIntAttribute ("ParameterIndex"),
                                             e->getIntAttribute ("Channel"),
-                                            e->getIntAttribute ("Controller")));
+                                            e->getIntAttribute ("Controller"),
+                                            e->getIntAttribute ("Type", MidiLearnTable::controller7Bit),
+                                            e->getDoubleAttribute ("Smoothing")));
     }
+    updateMidiLearnTable();
 }
 
-void FilterGraph::updateAutomatedNodes(int nodeId, int parameterIndex, float value)
+//==============================================================================
+// freezing: a node and everything feeding it is rendered to a sound file by a
+// copy of that part of the graph, then played back in the node's place
+//==============================================================================
+class FrozenNodeRenderer  : public ThreadWithProgressWindow
 {
-    graph.getNodeForId(nodeId)->getProcessor()->setParameterNotifyingHost(parameterIndex, value);
+public:
+    FrozenNodeRenderer (FilterGraph& liveGraph, AudioPluginFormatManager& formatManager,
+                        const Array<uint32>& nodeIds, const File& file, double secondsToRender)
+        : ThreadWithProgressWindow (TRANS("Freezing..."), true, true),
+          offline (formatManager),
+          audioFile (file),
+          sampleRate (liveGraph.getGraph().getSampleRate() > 0 ? liveGraph.getGraph().getSampleRate() : 44100.0),
+          blockSize (512),
+          seconds (secondsToRender),
+          succeeded (false)
+    {
+        AudioProcessorGraph& graph = offline.getGraph();
+        graph.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+
+        //copies of the nodes are made from their saved state, so the live
+        //graph carries on playing while this renders
+        for (int i = 0; i < nodeIds.size(); ++i)
+        {
+            const AudioProcessorGraph::Node::Ptr node (liveGraph.getNodeForId (nodeIds[i]));
+            ScopedPointer<XmlElement> xml (createNodeXml (node));
+            offline.createNodeFromXml (*xml);
+        }
+
+        for (int i = 0; i < liveGraph.getNumConnections(); ++i)
+        {
+            const AudioProcessorGraph::Connection* const c = liveGraph.getConnection (i);
+            if (nodeIds.contains (c->sourceNodeId) && nodeIds.contains (c->destNodeId))
+                graph.addConnection (c->sourceNodeId, c->sourceChannelIndex, c->destNodeId, c->destChannelIndex);
+        }
+
+        InternalPluginFormat internalFormat;
+        const AudioProcessorGraph::Node::Ptr output (offline.createNode (internalFormat.getDescriptionFor (InternalPluginFormat::audioOutputFilter)));
+        if (const AudioProcessorGraph::Node::Ptr frozen = offline.getNodeForId (nodeIds[0]))
+        {
+            const int numOutputs = frozen->getProcessor()->getNumOutputChannels();
+            for (int ch = 0; ch < 2 && numOutputs > 0; ++ch)
+                graph.addConnection (frozen->nodeId, jmin (ch, numOutputs - 1), output->nodeId, ch);
+        }
+
+        const Array<HostTransport::TempoChange> tempoMap (liveGraph.getTransport().getTempoMap());
+        for (int i = 0; i < tempoMap.size(); ++i)
+            offline.getTransport().addTempoChange (tempoMap.getReference (i));
+        offline.getTransport().setSampleRate (sampleRate);
+        offline.getTransport().setPlaying (true);
+
+        graph.setNonRealtime (true);
+        graph.prepareToPlay (sampleRate, blockSize);
+        offline.getRenderer().rebuild();
+    }
+
+    ~FrozenNodeRenderer()
+    {
+        offline.getGraph().releaseResources();
+    }
+
+    void run() override
+    {
+        ScopedPointer<FileOutputStream> stream (audioFile.createOutputStream());
+        if (stream == nullptr)
+            return;
+
+        WavAudioFormat wavFormat;
+        ScopedPointer<AudioFormatWriter> writer (wavFormat.createWriterFor (stream, sampleRate, 2, 24, StringPairArray(), 0));
+        if (writer == nullptr)
+            return;
+        stream.release();
+
+        AudioProcessorGraph& graph = offline.getGraph();
+        HostTransport& transport = offline.getTransport();
+        AudioSampleBuffer buffer (2, blockSize);
+        MidiBuffer midi;
+
+        const int64 numSamples = (int64) (seconds * sampleRate);
+        int64 samplesDone = 0;
+
+        while (samplesDone < numSamples && ! threadShouldExit())
+        {
+            buffer.clear();
+            midi.clear();
+            transport.beginBlock (blockSize);
+
+            {
+                const ScopedLock sl (graph.getCallbackLock());
+                offline.getRenderer().processBlock (buffer, midi);
+            }
+
+            transport.advance (blockSize);
+
+            const int numToWrite = (int) jmin ((int64) blockSize, numSamples - samplesDone);
+            if (! writer->writeFromAudioSampleBuffer (buffer, 0, numToWrite))
+                return;
+
+            samplesDone += numToWrite;
+            setProgress (samplesDone / (double) numSamples);
+        }
+
+        succeeded = samplesDone >= numSamples;
+    }
+
+    bool hasSucceeded() const noexcept
+    {
+        return succeeded;
+    }
+
+private:
+    FilterGraph offline;
+    const File audioFile;
+    const double sampleRate;
+    const int blockSize;
+    const double seconds;
+    bool succeeded;
+
+    JUCE_DECLARE_NON_COPYABLE (FrozenNodeRenderer)
+};
+
+File FilterGraph::getFrozenAudioDirectory()
+{
+    const File dir (File::getSpecialLocation (File::userApplicationDataDirectory)
+                    .getChildFile ("Cabbage").getChildFile ("FrozenNodes"));
+    dir.createDirectory();
+    return dir;
 }
 
+//the renders named by FROZEN elements, including those of nodes that were
+//frozen along with another one
+static void addFrozenAudioFiles (const XmlElement& xml, Array<File>& files)
+{
+    if (xml.hasTagName ("FROZEN"))
+        files.addIfNotAlreadyThere (File (xml.getStringAttribute ("file")));
+
+    forEachXmlChildElement (xml, e)
+        addFrozenAudioFiles (*e, files);
+}
+
+//renders are only deleted once no session that could still be opened from
+//the recent files list, nor the graph as it is now, refers to them
+void FilterGraph::removeUnusedFrozenAudio()
+{
+    Array<File> used;
+    for (int i = 0; i < graph.getNumNodes(); ++i)
+        if (graph.getNode (i)->properties.contains ("frozen"))
+            if (ScopedPointer<XmlElement> frozen = XmlDocument::parse (graph.getNode (i)->properties["frozen"].toString()))
+                addFrozenAudioFiles (*frozen, used);
+
+    RecentlyOpenedFilesList recentFiles;
+    recentFiles.restoreFromString (getAppProperties().getUserSettings()
+                                   ->getValue ("recentFilterGraphFiles"));
+    if (getFile().existsAsFile())
+        recentFiles.addFile (getFile());
+
+    for (int i = 0; i < recentFiles.getNumFiles(); ++i)
+        if (ScopedPointer<XmlElement> session = XmlDocument::parse (recentFiles.getFile (i)))
+            addFrozenAudioFiles (*session, used);
+
+    Array<File> renders;
+    getFrozenAudioDirectory().findChildFiles (renders, File::findFiles, false, "*.wav");
+    for (int i = 0; i < renders.size(); ++i)
+        if (! used.contains (renders[i]))
+            renders[i].deleteFile();
+}
+
+bool FilterGraph::isFrozen (const uint32 id) const
+{
+    const AudioProcessorGraph::Node::Ptr node (graph.getNodeForId (id));
+    return node != nullptr && node->properties.contains ("frozen");
+}
+
+bool FilterGraph::freezeNode (const uint32 id, double seconds)
+{
+    const AudioProcessorGraph::Node::Ptr node (graph.getNodeForId (id));
+    if (node == nullptr || isFrozen (id) || seconds <= 0
+        || node->properties.getWithDefault ("pluginType", "") == "Internal")
+        return false;
+
+    //the node comes first, followed by everything upstream of it
+    Array<uint32> upstream;
+    upstream.add (id);
+    for (int i = 0; i < upstream.size(); ++i)
+        for (int c = 0; c < graph.getNumConnections(); ++c)
+            if (graph.getConnection (c)->destNodeId == upstream[i])
+                upstream.addIfNotAlreadyThere (graph.getConnection (c)->sourceNodeId);
+
+    //upstream nodes that feed nothing but the frozen node are frozen with it.
+    //The i/o nodes and the automation track always stay.
+    Array<uint32> stashed (upstream);
+    for (bool removedAny = true; removedAny;)
+    {
+        removedAny = false;
+        for (int i = stashed.size(); --i > 0;)
+        {
+            const AudioProcessorGraph::Node::Ptr n (graph.getNodeForId (stashed[i]));
+            const String type (n->properties.getWithDefault ("pluginType", "").toString());
+            bool feedsOtherNodes = (type == "Internal" || type == "AutomationTrack");
+
+            for (int c = 0; c < graph.getNumConnections() && ! feedsOtherNodes; ++c)
+                feedsOtherNodes = graph.getConnection (c)->sourceNodeId == stashed[i]
+                                  && ! stashed.contains (graph.getConnection (c)->destNodeId);
+
+            if (feedsOtherNodes)
+            {
+                stashed.remove (i);
+                removedAny = true;
+            }
+        }
+    }
+
+    const File audioFile (getFrozenAudioDirectory().getNonexistentChildFile ("Frozen", ".wav", false));
+    {
+        FrozenNodeRenderer renderer (*this, formatManager, upstream, audioFile, seconds);
+        if (! renderer.runThread() || ! renderer.hasSucceeded())
+        {
+            audioFile.deleteFile();
+            return false;
+        }
+    }
+
+    //everything needed to bring the frozen nodes back
+    XmlElement frozen ("FROZEN");
+    frozen.setAttribute ("file", audioFile.getFullPathName());
+
+    for (int i = 0; i < stashed.size(); ++i)
+        frozen.addChildElement (createNodeXml (graph.getNodeForId (stashed[i])));
+
+    for (int i = 0; i < graph.getNumConnections(); ++i)
+    {
+        const AudioProcessorGraph::Connection* const c = graph.getConnection (i);
+        if (stashed.contains (c->sourceNodeId) || stashed.contains (c->destNodeId))
+        {
+            XmlElement* e = frozen.createNewChildElement ("CONNECTION");
+            e->setAttribute ("srcFilter", (int) c->sourceNodeId);
+            e->setAttribute ("srcChannel", c->sourceChannelIndex);
+            e->setAttribute ("dstFilter", (int) c->destNodeId);
+            e->setAttribute ("dstChannel", c->destChannelIndex);
+        }
+    }
+
+    const var x (node->properties["x"]), y (node->properties["y"]);
+    PluginDescription desc;
+    desc.pluginFormatName = "SoundfilePlayer";
+    desc.name = node->properties.getWithDefault ("pluginName", "").toString() + " (frozen)";
+    desc.fileOrIdentifier = audioFile.getFullPathName();
+
+    for (int i = 0; i < stashed.size(); ++i)
+    {
+        PluginWindow::closeCurrentlyOpenWindowsFor (stashed[i]);
+        graph.removeNode (stashed[i]);
+    }
+
+    AudioProcessorGraph::Node* const player = createNode (&desc, (int) id);
+    if (player == nullptr)
+    {
+        restoreFrozenNodes (frozen);
+        audioFile.deleteFile();
+        return false;
+    }
+
+    player->properties.set ("x", x);
+    player->properties.set ("y", y);
+    player->properties.set ("pluginName", desc.name);
+    player->properties.set ("frozen", frozen.createDocument (String::empty));
+
+    //the render starts at the top of the transport and loops at unity gain
+    AudioFilePlaybackProcessor* const soundfiler = (AudioFilePlaybackProcessor*) player->getProcessor();
+    soundfiler->setParameter (0, 1.0f);
+    soundfiler->setLooping (true);
+    soundfiler->linkToMasterTransport (true);
+    soundfiler->isSourcePlaying = true;
+
+    forEachXmlChildElementWithTagName (frozen, e, "CONNECTION")
+        if (e->getIntAttribute ("srcFilter") == (int) id && e->getIntAttribute ("srcChannel") < 2
+            && ! stashed.contains ((uint32) e->getIntAttribute ("dstFilter")))
+            graph.addConnection (id, e->getIntAttribute ("srcChannel"),
+                                 (uint32) e->getIntAttribute ("dstFilter"), e->getIntAttribute ("dstChannel"));
+
+    updateMidiLearnTable();
+    changed();
+    return true;
+}
+
+void FilterGraph::unfreezeNode (const uint32 id)
+{
+    const AudioProcessorGraph::Node::Ptr node (graph.getNodeForId (id));
+    if (node == nullptr || ! isFrozen (id))
+        return;
+
+    ScopedPointer<XmlElement> frozen (XmlDocument::parse (node->properties["frozen"].toString()));
+    if (frozen == nullptr)
+        return;
+
+    PluginWindow::closeCurrentlyOpenWindowsFor (id);
+    graph.removeNode (id);
+
+    restoreFrozenNodes (*frozen);
+    updateMidiLearnTable();
+    changed();
+}
+
+void FilterGraph::restoreFrozenNodes (const XmlElement& frozen)
+{
+    forEachXmlChildElementWithTagName (frozen, e, "FILTER")
+        createNodeFromXml (*e);
+
+    forEachXmlChildElementWithTagName (frozen, e, "CONNECTION")
+        graph.addConnection ((uint32) e->getIntAttribute ("srcFilter"), e->getIntAttribute ("srcChannel"),
+                             (uint32) e->getIntAttribute ("dstFilter"), e->getIntAttribute ("dstChannel"));
+}
 
 void FilterGraph::changeListenerCallback(ChangeBroadcaster* source)
 {
@@ -666,6 +1222,114 @@ void FilterGraph::actionListenerCallback (const String &message)
 {
     sendActionMessage(message);
 }
+
+//==========================================================================
+// renders the same graph with AudioProcessorGraph's own serial render and
+// then with 0..n worker threads. Each pass builds a fresh graph so every
+// Csound instance starts from the same state, and its output is compared
+// against the graph's serial render.
+//==========================================================================
+String FilterGraph::benchmarkParallelRendering(AudioPluginFormatManager& formatManager,
+        const File& examplesDir, int numBlocks)
+{
+    const double sampleRate = 44100;
+    const int blockSize = 512;
+    const int maxNodes = 8;
+
+    StringArray csdFiles;
+    Array<File> files;
+    examplesDir.getChildFile("Effects").findChildFiles(files, File::findFiles, false, "*.csd");
+    for(int i=0; i<files.size(); i++)
+        csdFiles.add(files[i].getFullPathName());
+    csdFiles.sort(true);
+    csdFiles.removeRange(maxNodes, csdFiles.size());
+
+    if(csdFiles.size()==0)
+        return "No examples found in "+examplesDir.getFullPathName()+"/Effects\n";
+
+    String report = String(csdFiles.size())+" Effects examples in parallel, "
+                    +String(numBlocks)+" blocks of "+String(blockSize)+" samples\n";
+    AudioSampleBuffer reference;
+    double serialTime = 0;
+
+    //the first pass, with no workers at all, bypasses the renderer
+    for(int numWorkers=-1; numWorkers<=ParallelGraphRenderer::getDefaultNumWorkerThreads(); numWorkers++)
+    {
+        FilterGraph filterGraph(formatManager);
+        AudioProcessorGraph& graph = filterGraph.getGraph();
+        graph.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+
+        InternalPluginFormat internalFormat;
+        AudioProcessorGraph::Node::Ptr input = filterGraph.createNode(internalFormat.getDescriptionFor(InternalPluginFormat::audioInputFilter));
+        AudioProcessorGraph::Node::Ptr output = filterGraph.createNode(internalFormat.getDescriptionFor(InternalPluginFormat::audioOutputFilter));
+
+        for(int i=0; i<csdFiles.size(); i++)
+        {
+            PluginDescription desc;
+            desc.pluginFormatName = "Cabbage";
+            desc.fileOrIdentifier = csdFiles[i];
+            AudioProcessorGraph::Node::Ptr node = filterGraph.createNode(&desc);
+            if(node==nullptr)
+                continue;
+
+            for(int ch=0; ch<jmin(2, node->getProcessor()->getNumInputChannels()); ch++)
+                graph.addConnection(input->nodeId, ch, node->nodeId, ch);
+            for(int ch=0; ch<jmin(2, node->getProcessor()->getNumOutputChannels()); ch++)
+                graph.addConnection(node->nodeId, ch, output->nodeId, ch);
+        }
+
+        graph.prepareToPlay(sampleRate, blockSize);
+        ParallelGraphRenderer& renderer = filterGraph.getRenderer();
+        renderer.setNumWorkerThreads(jmax(0, numWorkers));
+        renderer.rebuild();
+
+        AudioSampleBuffer result(2, numBlocks*blockSize);
+        AudioSampleBuffer buffer(2, blockSize);
+        MidiBuffer midi;
+        Random random(1234);
+
+        const double startTime = Time::getMillisecondCounterHiRes();
+        for(int block=0; block<numBlocks; block++)
+        {
+            for(int ch=0; ch<2; ch++)
+                for(int i=0; i<blockSize; i++)
+                    buffer.setSample(ch, i, random.nextFloat()*0.2f-0.1f);
+
+            {
+                const ScopedLock sl(graph.getCallbackLock());
+                if(numWorkers<0)
+                    graph.processBlock(buffer, midi);
+                else
+                    renderer.processBlock(buffer, midi);
+            }
+            midi.clear();
+
+            for(int ch=0; ch<2; ch++)
+                result.copyFrom(ch, block*blockSize, buffer, ch, 0, blockSize);
+        }
+        const double elapsed = Time::getMillisecondCounterHiRes()-startTime;
+        graph.releaseResources();
+
+        if(numWorkers<0)
+        {
+            reference = result;
+            serialTime = elapsed;
+            report << "AudioProcessorGraph: " << String(elapsed, 1) << " ms\n";
+            continue;
+        }
+
+        bool identical = true;
+        for(int ch=0; ch<2; ch++)
+            identical = identical && memcmp(reference.getReadPointer(ch), result.getReadPointer(ch),
+                                            sizeof(float)*(size_t)result.getNumSamples())==0;
+
+        report << numWorkers << " worker threads: " << String(elapsed, 1) << " ms, speedup "
+               << String(serialTime/jmax(0.001, elapsed), 2)
+               << (identical ? ", output identical" : ", output differs") << "\n";
+    }
+
+    return report;
+}
 //==========================================================================
 // parameter callback for node, used to map midi messages to parameters
 //==========================================================================
@@ -28,23 +28,31 @@ class GraphDocumentComponent;
 #include "../Source/Plugin/CabbagePluginProcessor.h"
 #include "../Source/Plugin/CabbagePluginEditor.h"
 #include "../CabbagePropertiesDialog.h"
+#include "HostTransport.h"
+#include "ParallelGraphRenderer.h"
+#include "MidiLearnTable.h"
 
 
 const char* const filenameSuffix = ".filtergraph";
 const char* const filenameWildcard = "*.filtergraph";
 
-//simple class to hold midi mappings
+//simple class to hold midi mappings. For NRPN mappings the controller is the
+//NRPN number, and smoothing is the time in ms taken to ramp to each new value
 class CabbageMidiMapping
 {
 public:
-    CabbageMidiMapping(int nodeID, int paramIndex, int chan, int ctrl):
+    CabbageMidiMapping(int nodeID, int paramIndex, int chan, int ctrl,
+                       int mappingType=MidiLearnTable::controller7Bit, double smoothingMs=0):
         channel(chan),
         controller(ctrl),
         nodeId(nodeID),
         parameterIndex(paramIndex),
+        type(mappingType),
+        smoothing(smoothingMs),
         isController(true) {}
 
-    int channel, controller, nodeId, parameterIndex;
+    int channel, controller, nodeId, parameterIndex, type;
+    double smoothing;
     bool isController;
 
 };
@@ -55,7 +63,6 @@ public:
 */
 class FilterGraph   : public FileBasedDocument,
     public ChangeListener,
-    public HighResolutionTimer,
     public ActionBroadcaster,
     public ActionListener
 {
@@ -77,6 +84,11 @@ public:
 
     AudioProcessorGraph::Node::Ptr createNode(const PluginDescription* desc, int uid=-1);
 
+    //createNode() in two steps, so the processor can be built on another thread
+    static bool canCreateOnBackgroundThread(const PluginDescription& desc);
+    AudioProcessor* createProcessor(const PluginDescription* desc, String& errorMessage);
+    AudioProcessorGraph::Node* addNodeForProcessor(AudioProcessor* processor, const PluginDescription* desc, int uid=-1);
+
     void addNativeCabbageFilter (String fileName, double x, double y);
 
     void removeFilter (const uint32 filterUID);
@@ -122,12 +134,19 @@ public:
 
     String findControllerForparameter(int32 nodeID, int parameterIndex);
 
-    void updateAutomatedNodes(int nodeId, int parameterIndex, float value);
 
     //==============================================================================
 
     XmlElement* createXml() const;
-    void restoreFromXml (const XmlElement& xml);
+
+    //with loadInBackground the nodes are created on worker threads and added
+    //to the graph as each one is ready, behind a progress window
+    void restoreFromXml (const XmlElement& xml, bool loadInBackground=false);
+
+    bool isLoadingSession() const noexcept
+    {
+        return sessionLoader != nullptr;
+    }
 
     //==============================================================================
     String getDocumentTitle();
@@ -136,67 +155,53 @@ public:
     File getLastDocumentOpened();
     void setLastDocumentOpened (const File& file);
     void createNodeFromXml (const XmlElement& xml);
+    void restoreNodeFromXml (AudioProcessorGraph::Node& node, const XmlElement& xml, const PluginDescription& desc);
+    void restoreMidiMappingsFromXml (const XmlElement& xml);
+    static PluginDescription getDescriptionFromXml (const XmlElement& xml);
 
     void addNodesToAutomationTrack(int32 id, int index);
 
+    //render a node, and whatever feeds only it, to a sound file and play that
+    //back in its place. unfreezeNode() brings the original nodes back.
+    bool freezeNode (const uint32 nodeId, double seconds);
+    void unfreezeNode (const uint32 nodeId);
+    bool isFrozen (const uint32 nodeId) const;
+    static File getFrozenAudioDirectory();
+    //renders that neither this graph nor a recent session refers to
+    void removeUnusedFrozenAudio();
+
     static const int midiChannelNumber;
     Array<CabbageMidiMapping> midiMappings;
 
-    //------- play info and timer stuff ---------------
-    void hiResTimerCallback();
-
-    class AudioPlaybackHead: public AudioPlayHead
-    {
-    public:
-        bool getCurrentPosition (CurrentPositionInfo &result)
-        {
-            result = playHeadPositionInfo;
-            return true;
-        }
-
-        void setIsPlaying(bool val)
-        {
-            playHeadPositionInfo.isPlaying=val;
-        }
-
-        void setTimeInSeconds(int val)
-        {
-            playHeadPositionInfo.timeInSeconds=val;
-        }
-        int getTimeInSeconds()
-        {
-            return playHeadPositionInfo.timeInSeconds;
-        }
-
-        void setPPQPosition(int val)
-        {
-            playHeadPositionInfo.ppqPosition=val;
-        }
-        int getPPQPosition()
-        {
-            return playHeadPositionInfo.ppqPosition;
-        }
-        void setBpm(int bpm)
-        {
-            playHeadPositionInfo.bpm = bpm;
-        }
-
-
-    private:
-        AudioPlayHead::CurrentPositionInfo playHeadPositionInfo;
-    };
+    //compile midiMappings into the table the audio thread reads. Call
+    //whenever the mappings change.
+    void updateMidiLearnTable();
 
+    //------- transport, driven by the audio callback ---------------
     void setIsPlaying(bool value, bool reset=false);
     void setBPM(int bpm);
 
-    int getTimeInSeconds()
+    double getTimeInSeconds()
     {
-        return audioPlayHead.getTimeInSeconds();
+        return transport.getTimeInSeconds();
     }
-    int getPPQPosition()
+    double getPPQPosition()
     {
-        return audioPlayHead.getPPQPosition();
+        return transport.getPPQPosition();
     }
+    HostTransport& getTransport()
+    {
+        return transport;
+    }
+    ParallelGraphRenderer& getRenderer()
+    {
+        return renderer;
+    }
+
+    //render a graph of the Effects examples in parallel branches with each
+    //number of worker threads and report the timings
+    static String benchmarkParallelRendering(AudioPluginFormatManager& formatManager,
+            const File& examplesDir, int numBlocks);
     void setEditedNodeId(int id)
     {
         IdForNodeBeingEdited=id;
@@ -215,7 +220,10 @@ private:
     //==============================================================================
     AudioPluginFormatManager& formatManager;
     AudioProcessorGraph graph;
-    AudioPlaybackHead audioPlayHead;
+    ParallelGraphRenderer renderer;
+    MidiLearnTable midiLearnTable;
+    HashMap<String, int> mappingForParameter;
+    HostTransport transport;
     int32 automationNodeID;
 
     OwnedArray<NodeAudioProcessorListener> audioProcessorListeners;
@@ -228,9 +236,13 @@ private:
     uint32 lastNodeID;
     Array<String> pluginTypes;
     uint32 nodeId;
-    float PPQN, currentBPM, playPosition;
-    int ppqPosition, subTicks;
-    int timeInSeconds;
+
+    void restoreFrozenNodes (const XmlElement& frozen);
+
+    class SessionLoader;
+    friend class SessionLoader;
+    friend struct ContainerDeletePolicy<SessionLoader>;
+    ScopedPointer<SessionLoader> sessionLoader;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FilterGraph)
 };
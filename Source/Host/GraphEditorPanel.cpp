@@ -856,6 +856,8 @@ private:
 //==============================================================================
 GraphAudioProcessorPlayer::GraphAudioProcessorPlayer()
     : processor (nullptr),
+      transport (nullptr),
+      renderer (nullptr),
       sampleRate (0),
       blockSize (0),
       isPrepared (false),
@@ -1084,7 +1086,7 @@ void GraphAudioProcessorPlayer::audioDeviceIOCallback (const float** const input
 
             if (! processor->isSuspended())
             {
-                processor->processBlock(buffer, incomingMidi);
+                processGraph(buffer);
                 //apply gain control on output
                 buffer.applyGain(outputGainLevel);
                 for(int i=0; i<totalNumChans; i++)
@@ -1098,6 +1100,53 @@ void GraphAudioProcessorPlayer::audioDeviceIOCallback (const float** const input
         FloatVectorOperations::clear (outputChannelData[i], numSamples);
 }
 
+//==============================================================================
+// runs the graph over the block, moving the transport on by the samples that
+// were processed. The block is only split when it crosses the loop end, so
+// that each part sees the position it actually starts at.
+//==============================================================================
+void GraphAudioProcessorPlayer::processGraph (AudioSampleBuffer& buffer)
+{
+    const int numSamples = buffer.getNumSamples();
+
+    if (transport == nullptr)
+    {
+        renderGraph (buffer, incomingMidi);
+        return;
+    }
+
+    int samplesDone = transport->beginBlock (numSamples);
+    if (samplesDone >= numSamples)
+    {
+        renderGraph (buffer, incomingMidi);
+        transport->advance (numSamples);
+        return;
+    }
+
+    int start = 0;
+    while (start < numSamples)
+    {
+        const int num = jmax (1, samplesDone);
+        AudioSampleBuffer part (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, num);
+        blockMidi.clear();
+        blockMidi.addEvents (incomingMidi, start, num, -start);
+        renderGraph (part, blockMidi);
+        transport->advance (num);
+
+        start += num;
+        if (start < numSamples)
+            samplesDone = transport->beginBlock (numSamples - start);
+    }
+}
+
+void GraphAudioProcessorPlayer::renderGraph (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
+{
+    if (renderer != nullptr)
+        renderer->processBlock (buffer, midiMessages);
+    else
+        processor->processBlock (buffer, midiMessages);
+}
+
 void GraphAudioProcessorPlayer::audioDeviceAboutToStart (AudioIODevice* const device)
 {
     const double newSampleRate = device->getCurrentSampleRate();
@@ -1115,6 +1164,9 @@ void GraphAudioProcessorPlayer::audioDeviceAboutToStart (AudioIODevice* const de
     messageCollector.reset (sampleRate);
     channels.calloc ((size_t) jmax (numChansIn, numChansOut) + 2);
 
+    if (transport != nullptr)
+        transport->setSampleRate (sampleRate);
+
     if (processor != nullptr)
     {
         if (isPrepared)
@@ -1158,6 +1210,8 @@ GraphDocumentComponent::GraphDocumentComponent (AudioPluginFormatManager& format
     deviceManager->addChangeListener (graphPanel);
 
     graphPlayer.setProcessor (&graph.getGraph());
+    graphPlayer.setTransport (&graph.getTransport());
+    graphPlayer.setRenderer (&graph.getRenderer());
 
     graphPanel->setSize(6000, 6000);
     graphPanel->setTopLeftPosition(-2600,-2900);
@@ -1294,58 +1348,57 @@ void GraphDocumentComponent::showBottomPanel(bool show)
         bottomPanel->setVisible(false);
 }
 
-void GraphDocumentComponent::handleIncomingMidiMessage (MidiInput *source, const MidiMessage &message)
+//==============================================================================
+// hands a controller that arrived while learning over to the message thread
+class MidiLearnMessage : public CallbackMessage
 {
-    if(message.isController())
+public:
+    MidiLearnMessage(GraphDocumentComponent* owner, int chan, int ctrl, int val)
+        : component(owner), channel(chan), controller(ctrl), value(val) {}
+
+    void messageCallback() override
     {
-        //if MIDI learn is turned on
-        if(midiLearnEnabled)
-        {
-            int nodeId = graph.getLastMovedNodeId();
-            int parameterIndex = graph.getLastMovedNodeParameterIndex();
+        if(component!=nullptr)
+            component->learnController(channel, controller, value);
+    }
 
-            for(int i=0; i<graph.midiMappings.size(); i++)
-            {
-                if(doMidiMappingsMatch(i, message.getChannel(), message.getControllerNumber()))
-                {
-                    graph.midiMappings.getReference(i).nodeId = nodeId;
-                    graph.midiMappings.getReference(i).parameterIndex = parameterIndex;
+private:
+    Component::SafePointer<GraphDocumentComponent> component;
+    int channel, controller, value;
+};
 
-                    if(graph.getGraph().getNodeForId(nodeId))
-                    {
-                        graph.getGraph().getNodeForId(nodeId)->getProcessor()->setParameterNotifyingHost(parameterIndex, message.getControllerValue()/127.f);
-                        //graph.getGraph().getNodeForId(nodeId)->getProcessor()->setParameter(parameterIndex, message.getControllerValue()/127.f);
-                        //Logger::writeToLog("exists");
-                        addNewMapping=false;
-                    }
-                }
-            }
+//controllers are applied to their parameters on the audio thread by the
+//graph's MidiLearnTable, so only learning needs to happen here
+void GraphDocumentComponent::handleIncomingMidiMessage (MidiInput *source, const MidiMessage &message)
+{
+    if(midiLearnEnabled && message.isController())
+        (new MidiLearnMessage(this, message.getChannel(), message.getControllerNumber(), message.getControllerValue()))->post();
+}
 
-            if(addNewMapping)
-            {
-                if(nodeId>0)
-                    graph.midiMappings.add(CabbageMidiMapping(nodeId, parameterIndex, message.getChannel(), message.getControllerNumber()));
-            }
-        }
-        else
-        {
-            //mid learn disabled
-            for(int i=0; i<graph.midiMappings.size(); i++)
-            {
-                if(doMidiMappingsMatch(i, message.getChannel(), message.getControllerNumber()))
-                {
-                    if(graph.getGraph().getNodeForId(graph.midiMappings.getReference(i).nodeId))
-                    {
-                        graph.getGraph().getNodeForId(graph.midiMappings.getReference(i).nodeId)->getProcessor()->setParameterNotifyingHost(graph.midiMappings.getReference(i).parameterIndex, message.getControllerValue()/127.f);
-                        //graph.getGraph().getNodeForId(graph.midiMappings.getReference(i).nodeId)->getProcessor()->setParameter(graph.midiMappings.getReference(i).parameterIndex, message.getControllerValue()/127.f);
-                    }
-                }
+//map the controller to the parameter that was moved last
+void GraphDocumentComponent::learnController(int channel, int controller, int value)
+{
+    const int nodeId = graph.getLastMovedNodeId();
+    const int parameterIndex = graph.getLastMovedNodeParameterIndex();
+    bool addNewMapping = true;
 
-            }
+    for(int i=0; i<graph.midiMappings.size(); i++)
+    {
+        if(doMidiMappingsMatch(i, channel, controller))
+        {
+            graph.midiMappings.getReference(i).nodeId = nodeId;
+            graph.midiMappings.getReference(i).parameterIndex = parameterIndex;
+            addNewMapping = false;
         }
-
     }
-    addNewMapping=true;
+
+    if(addNewMapping && nodeId>0)
+        graph.midiMappings.add(CabbageMidiMapping(nodeId, parameterIndex, channel, controller));
+
+    if(graph.getGraph().getNodeForId(nodeId))
+        graph.getGraph().getNodeForId(nodeId)->getProcessor()->setParameterNotifyingHost(parameterIndex, value/127.f);
+
+    graph.updateMidiLearnTable();
 }
 
 void GraphDocumentComponent::showMidiMappings()
@@ -1368,6 +1421,8 @@ void GraphDocumentComponent::showMidiMappings()
         e->setAttribute ("ParameterIndex", param+" ("+String(paramIndex)+")");
         e->setAttribute ("Channel", channel);
         e->setAttribute ("Controller", controller);
+        e->setAttribute ("Type", graph.midiMappings.getReference(i).type);
+        e->setAttribute ("Smoothing", graph.midiMappings.getReference(i).smoothing);
         xml->addChildElement (e);
     }
 
@@ -1398,8 +1453,12 @@ void GraphDocumentComponent::showMidiMappings()
         graph.midiMappings.add(CabbageMidiMapping(nodeId,
                                index,
                                e->getIntAttribute ("Channel"),
-                               e->getIntAttribute ("Controller")));
+                               e->getIntAttribute ("Controller"),
+                               e->getIntAttribute ("Type", MidiLearnTable::controller7Bit),
+                               e->getDoubleAttribute ("Smoothing")));
     }
+
+    graph.updateMidiLearnTable();
 }
 
 bool GraphDocumentComponent::doMidiMappingsMatch(int i, int channel, int controller)
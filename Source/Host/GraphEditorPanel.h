@@ -164,9 +164,30 @@ public:
         processor->suspendProcessing(suspend);
     }
 
+    //the play head advanced by the samples each callback processes
+    void setTransport(HostTransport* newTransport)
+    {
+        const ScopedLock sl (lock);
+        transport = newTransport;
+        if(transport != nullptr && sampleRate > 0)
+            transport->setSampleRate(sampleRate);
+    }
+
+    //spreads the graph over worker threads, if set
+    void setRenderer(ParallelGraphRenderer* newRenderer)
+    {
+        const ScopedLock sl (lock);
+        renderer = newRenderer;
+    }
+
 private:
     //==============================================================================
+    void processGraph (AudioSampleBuffer& buffer);
+    void renderGraph (AudioSampleBuffer& buffer, MidiBuffer& midiMessages);
+
     AudioProcessor* processor;
+    HostTransport* transport;
+    ParallelGraphRenderer* renderer;
     CriticalSection lock;
     double sampleRate;
     int blockSize;
@@ -180,7 +201,7 @@ private:
     HeapBlock<float*> channels;
     AudioSampleBuffer tempBuffer;
 
-    MidiBuffer incomingMidi;
+    MidiBuffer incomingMidi, blockMidi;
     MidiMessageCollector messageCollector;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphAudioProcessorPlayer)
@@ -453,6 +474,7 @@ public:
     //==============================================================================
     FilterGraph graph;
     void handleIncomingMidiMessage (MidiInput*, const MidiMessage&) override;
+    void learnController(int channel, int controller, int value);
     bool doMidiMappingsMatch(int i, int channel, int controller);
     void showMidiMappings();
 
@@ -528,7 +550,6 @@ private:
     MidiKeyboardComponent* keyboardComp;
     Component* statusBar;
     bool midiLearnEnabled;
-    bool addNewMapping;
     bool audioDeviceOk;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphDocumentComponent)
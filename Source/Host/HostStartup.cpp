@@ -25,6 +25,7 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "MainHostWindow.h"
 #include "InternalFilters.h"
+#include "PluginScanCache.h"
 #include "../CabbageLookAndFeel.h"
 
 #if ! (JUCE_PLUGINHOST_VST || JUCE_PLUGINHOST_VST3 || JUCE_PLUGINHOST_AU)
@@ -40,6 +41,23 @@ public:
 
     void initialise (const String& commandLine) override
     {
+        //probe a single plugin file for the plugin list's scanner, then quit.
+        //Run as: --scan-plugin <format name> <file or identifier> <output file>
+        if (commandLine.contains ("--scan-plugin"))
+        {
+            const StringArray args (getCommandLineParameterArray());
+            const int index = args.indexOf ("--scan-plugin");
+
+            AudioPluginFormatManager formatManager;
+            formatManager.addDefaultFormats();
+
+            const bool scanned = PluginScanCache::scanInThisProcess (formatManager, args[index+1], args[index+2],
+                                                                      File::getCurrentWorkingDirectory().getChildFile (args[index+3]));
+            setApplicationReturnValue (scanned ? 0 : 1);
+            quit();
+            return;
+        }
+
         // initialise our settings file..
 
         PropertiesFile::Options options;
@@ -88,6 +106,19 @@ public:
 
         LookAndFeel::setDefaultLookAndFeel (&lookAndFeel);
 
+        //time the parallel graph renderer against the serial one, then quit
+        if (commandLine.contains ("--benchmark-graph"))
+        {
+            AudioPluginFormatManager formatManager;
+            formatManager.addDefaultFormats();
+            formatManager.addFormat (new InternalPluginFormat());
+
+            const File examplesDir (appProperties->getUserSettings()->getValue ("ExamplesDir"));
+            std::cout << FilterGraph::benchmarkParallelRendering (formatManager, examplesDir, 500);
+            quit();
+            return;
+        }
+
         mainWindow = new MainHostWindow();
         mainWindow->setUsingNativeTitleBar (false);
 
@@ -0,0 +1,418 @@
+/*
+  Copyright (c) 2014 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __HOSTTRANSPORT_H__
+#define __HOSTTRANSPORT_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+// The host's play head. Its position is a count of the samples the audio
+// callback has processed, so every node sees the same sample-exact time. The
+// musical position is worked out from that count through a tempo map, once per
+// block, in beginBlock(). The audio callback then processes the number of
+// samples beginBlock() returns, calls advance() and repeats until the device
+// block is done; a block is only split when it crosses the loop end.
+//
+// Transport controls and the tempo map are changed from the message thread.
+// Everything is guarded by a SpinLock that is only ever held for a few
+// arithmetic operations. A new tempo map is built outside the lock and only
+// swapped in under it, so nothing is allocated or freed while it is held.
+//==============================================================================
+class HostTransport : public AudioPlayHead
+{
+public:
+    HostTransport()
+        : sampleRate(44100),
+          samplePosition(0),
+          playing(false),
+          looping(false),
+          loopStart(0),
+          loopEnd(0),
+          loopStartSample(0),
+          loopEndSample(0),
+          currentBar(0)
+    {
+        Array<TempoChange> changes;
+        changes.add(TempoChange(0, 60, 4, 4));
+        tempoMap = new TempoMap(changes);
+        updatePosition();
+    }
+
+    ~HostTransport() {}
+
+    //==========================================================================
+    // a change of tempo and/or time signature at a position in quarter notes.
+    // Time signature changes are expected to fall on bar lines.
+    struct TempoChange
+    {
+        TempoChange(double ppqPos=0, double beatsPerMinute=60, int num=4, int denom=4)
+            : ppq(ppqPos), bpm(beatsPerMinute), timeSigNumerator(num), timeSigDenominator(denom),
+              seconds(0), barPpq(0), barsBefore(0) {}
+
+        double ppq, bpm;
+        int timeSigNumerator, timeSigDenominator;
+
+        //worked out by updateTempoMap()
+        double seconds, barPpq;
+        int barsBefore;
+
+        double getPpqPerBar() const
+        {
+            return timeSigNumerator*4.0/timeSigDenominator;
+        }
+    };
+
+    //==========================================================================
+    // a tempo map is never changed once built, the transport swaps in a new one
+    class TempoMap : public ReferenceCountedObject
+    {
+    public:
+        typedef ReferenceCountedObjectPtr<TempoMap> Ptr;
+
+        TempoMap(const Array<TempoChange>& newChanges) : changes(newChanges)
+        {
+            update();
+        }
+
+        const Array<TempoChange>& getChanges() const
+        {
+            return changes;
+        }
+
+        const TempoChange& getChangeAtPpq(double ppq) const
+        {
+            int i = changes.size()-1;
+            while(i>0 && changes.getReference(i).ppq>ppq)
+                i--;
+            return changes.getReference(i);
+        }
+
+        const TempoChange& getChangeAtTime(double seconds) const
+        {
+            int i = changes.size()-1;
+            while(i>0 && changes.getReference(i).seconds>seconds)
+                i--;
+            return changes.getReference(i);
+        }
+
+        double ppqToSeconds(double ppq) const
+        {
+            const TempoChange& change = getChangeAtPpq(ppq);
+            return change.seconds+(ppq-change.ppq)*60.0/change.bpm;
+        }
+
+        double secondsToPpq(double seconds) const
+        {
+            const TempoChange& change = getChangeAtTime(seconds);
+            return change.ppq+(seconds-change.seconds)*change.bpm/60.0;
+        }
+
+    private:
+        //cache the start time and last bar line of each change in the map
+        void update()
+        {
+            TempoChange& first = changes.getReference(0);
+            first.ppq = first.seconds = first.barPpq = 0;
+            first.barsBefore = 0;
+
+            for(int i=1; i<changes.size(); i++)
+            {
+                const TempoChange& previous = changes.getReference(i-1);
+                TempoChange& change = changes.getReference(i);
+                change.seconds = previous.seconds+(change.ppq-previous.ppq)*60.0/previous.bpm;
+
+                if(change.timeSigNumerator!=previous.timeSigNumerator
+                   || change.timeSigDenominator!=previous.timeSigDenominator)
+                {
+                    const double bars = (change.ppq-previous.barPpq)/previous.getPpqPerBar();
+                    change.barPpq = change.ppq;
+                    change.barsBefore = previous.barsBefore+(int)std::ceil(bars-1.0e-9);
+                }
+                else
+                {
+                    change.barPpq = previous.barPpq;
+                    change.barsBefore = previous.barsBefore;
+                }
+            }
+        }
+
+        Array<TempoChange> changes;
+
+        JUCE_DECLARE_NON_COPYABLE (TempoMap)
+    };
+
+    //==========================================================================
+    // message thread
+    //==========================================================================
+    void setSampleRate(double newSampleRate)
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        if(newSampleRate<=0 || newSampleRate==sampleRate)
+            return;
+
+        const double ppq = secondsToPpq(samplePosition/sampleRate);
+        sampleRate = newSampleRate;
+        samplePosition = secondsToSamples(ppqToSeconds(ppq));
+        updateLoopSamples();
+        updatePosition();
+    }
+
+    void setPlaying(bool shouldPlay)
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        playing = shouldPlay;
+        updatePosition();
+    }
+
+    bool isPlaying()
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        return playing;
+    }
+
+    //move the play head to a position in quarter notes
+    void setPosition(double ppq)
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        samplePosition = secondsToSamples(ppqToSeconds(jmax(0.0, ppq)));
+        updatePosition();
+    }
+
+    //replace the whole map with a single tempo, keeping the current time signature
+    void setTempo(double bpm)
+    {
+        const TempoChange first = getCurrentTempoMap()->getChanges().getReference(0);
+        Array<TempoChange> newMap;
+        newMap.add(TempoChange(0, bpm, first.timeSigNumerator, first.timeSigDenominator));
+        setTempoMap(newMap);
+    }
+
+    void setTimeSignature(int numerator, int denominator)
+    {
+        Array<TempoChange> newMap(getCurrentTempoMap()->getChanges());
+        for(int i=0; i<newMap.size(); i++)
+        {
+            newMap.getReference(i).timeSigNumerator = numerator;
+            newMap.getReference(i).timeSigDenominator = denominator;
+        }
+        setTempoMap(newMap);
+    }
+
+    //add a change to the map, replacing any existing change at the same position
+    void addTempoChange(const TempoChange& change)
+    {
+        Array<TempoChange> newMap(getCurrentTempoMap()->getChanges());
+        int i = 0;
+        while(i<newMap.size() && newMap.getReference(i).ppq<change.ppq)
+            i++;
+
+        if(i<newMap.size() && newMap.getReference(i).ppq==change.ppq)
+            newMap.set(i, change);
+        else
+            newMap.insert(i, change);
+        setTempoMap(newMap);
+    }
+
+    //remove every change after the first one
+    void clearTempoChanges()
+    {
+        Array<TempoChange> newMap;
+        newMap.add(getCurrentTempoMap()->getChanges().getReference(0));
+        setTempoMap(newMap);
+    }
+
+    Array<TempoChange> getTempoMap()
+    {
+        return getCurrentTempoMap()->getChanges();
+    }
+
+    void setLoopPoints(double startPpq, double endPpq)
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        loopStart = jmax(0.0, jmin(startPpq, endPpq));
+        loopEnd = jmax(startPpq, endPpq);
+        updateLoopSamples();
+        updatePosition();
+    }
+
+    void setLooping(bool shouldLoop)
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        looping = shouldLoop;
+        updatePosition();
+    }
+
+    //==========================================================================
+    // audio thread
+    //==========================================================================
+    //work out the position for the next numSamples samples and return how many
+    //of them can be processed before the play head wraps around the loop
+    int beginBlock(int numSamples)
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        updatePosition();
+
+        if(isLoopActive() && samplePosition<loopEndSample)
+            return (int)jmin((int64)numSamples, loopEndSample-samplePosition);
+        return numSamples;
+    }
+
+    void advance(int numSamples)
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        if(!playing)
+            return;
+
+        const int64 previousPosition = samplePosition;
+        samplePosition += numSamples;
+        if(isLoopActive() && previousPosition<loopEndSample && samplePosition>=loopEndSample)
+            samplePosition = loopStartSample+(samplePosition-loopEndSample);
+    }
+
+    //==========================================================================
+    // any thread
+    //==========================================================================
+    bool getCurrentPosition(CurrentPositionInfo& result)
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        result = position;
+        return true;
+    }
+
+    double getTimeInSeconds()
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        return position.timeInSeconds;
+    }
+
+    double getPPQPosition()
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        return position.ppqPosition;
+    }
+
+    double getBpm()
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        return position.bpm;
+    }
+
+    //zero based bar number and beat within the bar, in time signature beats
+    void getBarPosition(int& bar, double& beat)
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        bar = currentBar;
+        beat = (position.ppqPosition-position.ppqPositionOfLastBarStart)*position.timeSigDenominator/4.0;
+    }
+
+private:
+    //==========================================================================
+    // message thread
+    //==========================================================================
+    TempoMap::Ptr getCurrentTempoMap()
+    {
+        const SpinLock::ScopedLockType sl(lock);
+        return tempoMap;
+    }
+
+    //the map being replaced is released after the lock, never by the audio thread
+    void setTempoMap(const Array<TempoChange>& changes)
+    {
+        TempoMap::Ptr newMap = new TempoMap(changes);
+        TempoMap::Ptr oldMap;
+        {
+            const SpinLock::ScopedLockType sl(lock);
+            const double ppq = secondsToPpq(samplePosition/sampleRate);
+            oldMap = tempoMap;
+            tempoMap = newMap;
+            samplePosition = secondsToSamples(ppqToSeconds(ppq));
+            updateLoopSamples();
+            updatePosition();
+        }
+    }
+
+    //==========================================================================
+    // all of the following are called with the lock held
+    //==========================================================================
+    double ppqToSeconds(double ppq) const
+    {
+        return tempoMap->ppqToSeconds(ppq);
+    }
+
+    double secondsToPpq(double seconds) const
+    {
+        return tempoMap->secondsToPpq(seconds);
+    }
+
+    int64 secondsToSamples(double seconds) const
+    {
+        return (int64)std::floor(seconds*sampleRate+0.5);
+    }
+
+    bool isLoopActive() const
+    {
+        return playing && looping && loopEndSample>loopStartSample;
+    }
+
+    void updateLoopSamples()
+    {
+        loopStartSample = secondsToSamples(ppqToSeconds(loopStart));
+        loopEndSample = secondsToSamples(ppqToSeconds(loopEnd));
+    }
+
+    void updatePosition()
+    {
+        const double seconds = samplePosition/sampleRate;
+        const double ppq = secondsToPpq(seconds);
+        const TempoChange& change = tempoMap->getChangeAtTime(seconds);
+        const double ppqPerBar = change.getPpqPerBar();
+        const int barsSinceChange = (int)std::floor((ppq-change.barPpq)/ppqPerBar+1.0e-9);
+
+        position.bpm = change.bpm;
+        position.timeSigNumerator = change.timeSigNumerator;
+        position.timeSigDenominator = change.timeSigDenominator;
+        position.timeInSamples = samplePosition;
+        position.timeInSeconds = seconds;
+        position.editOriginTime = 0;
+        position.ppqPosition = ppq;
+        position.ppqPositionOfLastBarStart = change.barPpq+barsSinceChange*ppqPerBar;
+        position.frameRate = AudioPlayHead::fpsUnknown;
+        position.isPlaying = playing;
+        position.isRecording = false;
+        position.ppqLoopStart = loopStart;
+        position.ppqLoopEnd = loopEnd;
+        position.isLooping = looping;
+        currentBar = change.barsBefore+barsSinceChange;
+    }
+
+    SpinLock lock;
+    TempoMap::Ptr tempoMap;
+    double sampleRate;
+    int64 samplePosition;
+    bool playing, looping;
+    double loopStart, loopEnd;
+    int64 loopStartSample, loopEndSample;
+    CurrentPositionInfo position;
+    int currentBar;
+
+    JUCE_DECLARE_NON_COPYABLE (HostTransport)
+};
+
+#endif   // __HOSTTRANSPORT_H__
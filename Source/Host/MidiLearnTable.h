@@ -0,0 +1,432 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __MIDILEARNTABLE_H__
+#define __MIDILEARNTABLE_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "AutomationEvents.h"
+
+//==============================================================================
+// Turns incoming controllers into parameter changes on the audio thread. The
+// mappings are compiled on the message thread into a 16x128 (channel x CC)
+// table, with a sorted list for NRPNs, and handed over by swapping a pointer.
+// The audio thread marks the table it is about to read and checks it is
+// still the latest before touching it, so the message thread can delete any
+// other table without ever waiting on the audio thread.
+//
+// A 14-bit mapping on CC n (0-31) takes its LSB from CC n+32. NRPNs are read
+// from CCs 99/98 and data entry 6/38. A mapping with smoothing ramps its
+// parameter to each new value over that many milliseconds, in steps of
+// rampInterval samples.
+//
+// The changes are applied by the ParallelGraphRenderer. Parameters of Cabbage
+// nodes have their channels written directly, not through the processor's
+// message queue, so every step reaches Csound at the next k-cycle.
+//==============================================================================
+class MidiLearnTable
+{
+public:
+    enum MappingType
+    {
+        controller7Bit = 0,
+        controller14Bit,
+        nrpn
+    };
+
+    struct Mapping
+    {
+        int channel, controller, type;
+        int nodeId, parameterIndex;
+        double smoothingMs;
+    };
+
+    enum { rampInterval = 32 };
+
+    MidiLearnTable() : latest(nullptr), inUse(nullptr), samplesRendered(0)
+    {
+        for(int i=0; i<16; i++)
+        {
+            controllerMsb[i].calloc(32);
+            nrpnState[i].clear();
+        }
+    }
+
+    ~MidiLearnTable()
+    {
+        latest.set(nullptr);
+        for(int i=0; i<tables.size(); i++)
+            delete tables.getUnchecked(i);
+    }
+
+    //==========================================================================
+    // message thread
+    //==========================================================================
+    void setMappings(const Array<Mapping>& mappings)
+    {
+        Table* table = new Table();
+        table->build(mappings);
+        tables.add(table);
+        latest.set(table);
+
+        //anything that isn't the latest table and that the audio thread hasn't
+        //marked can go. A table marked after this read is never used, since
+        //the audio thread then sees it is no longer the latest.
+        Table* const marked = inUse.get();
+        for(int i=tables.size(); --i>=0;)
+        {
+            Table* t = tables.getUnchecked(i);
+            if(t!=table && t!=marked)
+            {
+                tables.remove(i);
+                delete t;
+            }
+        }
+    }
+
+    //==========================================================================
+    // audio thread
+    //==========================================================================
+    //add the parameter changes for the controllers in this block
+    void renderAutomation(const MidiBuffer& midi, int numSamples, double sampleRate, AutomationEventQueue& queue)
+    {
+        Table* table = acquire();
+        if(table==nullptr)
+            return;
+
+        MidiBuffer::Iterator iterator(midi);
+        MidiMessage message;
+        int position;
+        while(iterator.getNextEvent(message, position))
+        {
+            if(position>=numSamples)
+                break;
+            if(message.isController())
+                handleController(*table, message.getChannel()-1, message.getControllerNumber(),
+                                 message.getControllerValue(), position, sampleRate, queue);
+        }
+
+        //carry on the ramps still running at the end of the block
+        const int64 blockEnd = samplesRendered+numSamples;
+        for(int i=table->ramping.size(); --i>=0;)
+        {
+            Target& target = table->targets.getReference(table->ramping.getUnchecked(i));
+            advanceRamp(target, blockEnd, queue);
+            if(!target.ramping)
+                table->ramping.remove(i);
+        }
+
+        samplesRendered = blockEnd;
+    }
+
+private:
+    //==========================================================================
+    struct Target
+    {
+        int nodeId, parameterIndex, smoothingMs;
+
+        //ramp state, only touched by the audio thread
+        float value, rampFrom, rampTo;
+        int64 rampStart, rampLength, rampEmitted;
+        bool ramping;
+    };
+
+    struct Slot
+    {
+        int firstTarget, numTargets, type;
+    };
+
+    struct NrpnEntry
+    {
+        int key, firstTarget, numTargets;
+    };
+
+    class Table
+    {
+    public:
+        void build(const Array<Mapping>& mappings)
+        {
+            for(int i=0; i<16*128; i++)
+            {
+                slots[i].firstTarget = slots[i].numTargets = 0;
+                slots[i].type = controller7Bit;
+                lsbFor[i] = -1;
+            }
+
+            //the targets of each slot are stored next to each other, in
+            //slot order
+            for(int i=0; i<mappings.size(); i++)
+                if(mappings.getReference(i).type!=nrpn)
+                    slots[getSlotIndex(mappings.getReference(i))].numTargets++;
+
+            int numControllerTargets = 0;
+            for(int s=0; s<16*128; s++)
+            {
+                slots[s].firstTarget = numControllerTargets;
+                numControllerTargets += slots[s].numTargets;
+            }
+
+            targets.insertMultiple(0, Target(), numControllerTargets);
+            HeapBlock<int> numAdded(16*128, true);
+
+            for(int i=0; i<mappings.size(); i++)
+            {
+                const Mapping& m = mappings.getReference(i);
+                if(m.type==nrpn)
+                    continue;
+
+                const int s = getSlotIndex(m);
+                targets.set(slots[s].firstTarget+numAdded[s]++, makeTarget(m));
+                if(m.type==controller14Bit && m.controller<32)
+                {
+                    slots[s].type = controller14Bit;
+                    lsbFor[s+32] = s;
+                }
+            }
+
+            Array<int> keys;
+            for(int i=0; i<mappings.size(); i++)
+                if(mappings.getReference(i).type==nrpn)
+                    keys.addIfNotAlreadyThere(getNrpnKey(mappings.getReference(i)));
+            DefaultElementComparator<int> comparator;
+            keys.sort(comparator);
+
+            for(int k=0; k<keys.size(); k++)
+            {
+                NrpnEntry entry = { keys[k], targets.size(), 0 };
+                for(int i=0; i<mappings.size(); i++)
+                    if(mappings.getReference(i).type==nrpn && getNrpnKey(mappings.getReference(i))==keys[k])
+                    {
+                        targets.add(makeTarget(mappings.getReference(i)));
+                        entry.numTargets++;
+                    }
+                nrpns.add(entry);
+            }
+
+            ramping.ensureStorageAllocated(targets.size());
+        }
+
+        const NrpnEntry* findNrpn(int key) const
+        {
+            int start = 0, end = nrpns.size();
+            while(start<end)
+            {
+                const int middle = (start+end)/2;
+                const NrpnEntry& entry = nrpns.getReference(middle);
+                if(entry.key==key)
+                    return &entry;
+                if(entry.key<key)
+                    start = middle+1;
+                else
+                    end = middle;
+            }
+            return nullptr;
+        }
+
+        static int getNrpnKey(int channel, int number)
+        {
+            return channel*16384+number;
+        }
+
+        Slot slots[16*128];
+        int lsbFor[16*128];
+        Array<NrpnEntry> nrpns;
+        Array<Target> targets;
+        Array<int> ramping;
+
+    private:
+        static int getSlotIndex(const Mapping& m)
+        {
+            return jlimit(0, 15, m.channel-1)*128+jlimit(0, 127, m.controller);
+        }
+
+        static int getNrpnKey(const Mapping& m)
+        {
+            return getNrpnKey(jlimit(0, 15, m.channel-1), jlimit(0, 16383, m.controller));
+        }
+
+        static Target makeTarget(const Mapping& m)
+        {
+            Target target;
+            target.nodeId = m.nodeId;
+            target.parameterIndex = m.parameterIndex;
+            target.smoothingMs = roundToInt(jmax(0.0, m.smoothingMs));
+            target.value = target.rampFrom = target.rampTo = -1.f;
+            target.rampStart = target.rampLength = target.rampEmitted = 0;
+            target.ramping = false;
+            return target;
+        }
+    };
+
+    //per channel NRPN parsing state
+    struct NrpnState
+    {
+        void clear()
+        {
+            numberMsb = numberLsb = -1;
+            dataMsb = 0;
+        }
+
+        int numberMsb, numberLsb, dataMsb;
+    };
+
+    //==========================================================================
+    Table* acquire()
+    {
+        for(;;)
+        {
+            Table* table = latest.get();
+            inUse.set(table);
+            if(latest.get()==table)
+                return table;
+        }
+    }
+
+    void handleController(Table& table, int channel, int controller, int value, int position,
+                          double sampleRate, AutomationEventQueue& queue)
+    {
+        if(!isPositiveAndBelow(channel, 16) || !isPositiveAndBelow(controller, 128))
+            return;
+
+        const int slotIndex = channel*128+controller;
+        const Slot& slot = table.slots[slotIndex];
+
+        if(slot.numTargets>0)
+        {
+            float normalised = value/127.f;
+            if(slot.type==controller14Bit)
+            {
+                controllerMsb[channel][controller] = value;
+                normalised = (value*128)/16383.f;
+            }
+            applyToTargets(table, slot.firstTarget, slot.numTargets, normalised, position, sampleRate, queue);
+        }
+        else if(table.lsbFor[slotIndex]>=0)
+        {
+            const int msbIndex = table.lsbFor[slotIndex];
+            const Slot& msbSlot = table.slots[msbIndex];
+            const float normalised = (controllerMsb[channel][controller-32]*128+value)/16383.f;
+            applyToTargets(table, msbSlot.firstTarget, msbSlot.numTargets, normalised, position, sampleRate, queue);
+        }
+
+        if(table.nrpns.size()==0)
+            return;
+
+        NrpnState& state = nrpnState[channel];
+        switch(controller)
+        {
+        case 99:
+            state.numberMsb = value;
+            break;
+        case 98:
+            state.numberLsb = value;
+            break;
+        case 101:
+        case 100:
+            //an RPN is being selected
+            state.clear();
+            break;
+        case 6:
+        case 38:
+            if(state.numberMsb>=0 && state.numberLsb>=0)
+            {
+                if(controller==6)
+                    state.dataMsb = value;
+
+                const int data = state.dataMsb*128+(controller==38 ? value : 0);
+                if(const NrpnEntry* entry = table.findNrpn(Table::getNrpnKey(channel, state.numberMsb*128+state.numberLsb)))
+                    applyToTargets(table, entry->firstTarget, entry->numTargets, data/16383.f, position, sampleRate, queue);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void applyToTargets(Table& table, int firstTarget, int numTargets, float value, int position,
+                        double sampleRate, AutomationEventQueue& queue)
+    {
+        const int64 now = samplesRendered+position;
+
+        for(int i=firstTarget; i<firstTarget+numTargets; i++)
+        {
+            Target& target = table.targets.getReference(i);
+
+            //jump straight to the first value, there is nothing to ramp from
+            if(target.smoothingMs==0 || target.value<0)
+            {
+                target.value = value;
+                target.ramping = false;
+                AutomationEvent event = { target.nodeId, target.parameterIndex, position, value };
+                queue.add(event);
+                continue;
+            }
+
+            //a new value part way through a ramp starts from wherever it has got to
+            if(target.ramping)
+            {
+                advanceRamp(target, now, queue);
+                if(target.ramping)
+                    target.value = target.rampFrom+(target.rampTo-target.rampFrom)
+                                   *(float)(now-target.rampStart)/(float)target.rampLength;
+            }
+
+            target.rampFrom = target.value;
+            target.rampTo = value;
+            target.rampStart = target.rampEmitted = now;
+            target.rampLength = jmax((int64)1, (int64)(target.smoothingMs*sampleRate/1000.0));
+            target.ramping = true;
+
+            //storage for every target was allocated when the table was built
+            table.ramping.addIfNotAlreadyThere(i);
+        }
+    }
+
+    //emit the ramp's steps that fall before the given sample
+    void advanceRamp(Target& target, int64 upTo, AutomationEventQueue& queue)
+    {
+        const int64 rampEnd = target.rampStart+target.rampLength;
+        int64 next = target.rampStart+((target.rampEmitted-target.rampStart)/rampInterval+1)*rampInterval;
+
+        while(jmin(next, rampEnd)<upTo && target.rampEmitted<rampEnd)
+        {
+            const int64 point = jmin(next, rampEnd);
+            const float proportion = (float)(point-target.rampStart)/(float)target.rampLength;
+            target.value = target.rampFrom+(target.rampTo-target.rampFrom)*proportion;
+            target.rampEmitted = point;
+
+            AutomationEvent event = { target.nodeId, target.parameterIndex, (int)(point-samplesRendered), target.value };
+            queue.add(event);
+            next += rampInterval;
+        }
+
+        if(target.rampEmitted>=rampEnd)
+            target.ramping = false;
+    }
+
+    Array<Table*> tables;
+    Atomic<Table*> latest, inUse;
+    int64 samplesRendered;
+    HeapBlock<int> controllerMsb[16];
+    NrpnState nrpnState[16];
+
+    JUCE_DECLARE_NON_COPYABLE (MidiLearnTable)
+};
+
+#endif   // __MIDILEARNTABLE_H__
@@ -0,0 +1,189 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __NODELOADPROFILER_H__
+#define __NODELOADPROFILER_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+// Time spent in each node's processBlock, as a fraction of the time a block
+// lasts. The renderer times a node only while profiling is enabled, and the
+// figures for a node are only ever written by the thread that processed it in
+// that block. The message thread reads them without locking, so a reading can
+// be a block out of date.
+//==============================================================================
+class NodeLoadProfiler : public ChangeBroadcaster
+{
+public:
+    //1% wide bins up to the block deadline, with the last one for overruns
+    enum { numBins = 101, windowSize = 128 };
+
+    struct Stats
+    {
+        int nodeId;
+        int64 numBlocks, numOverruns;
+        double mean, max, p50, p95, p99;
+    };
+
+    //==========================================================================
+    class NodeLoad
+    {
+    public:
+        NodeLoad(int id) : nodeId(id), generation(-1)
+        {
+            clear();
+        }
+
+        void addBlock(double load, int currentGeneration)
+        {
+            if(generation!=currentGeneration)
+            {
+                clear();
+                generation = currentGeneration;
+            }
+
+            const int slot = (int)(numBlocks%windowSize);
+            recentSum += load-recent[slot];
+            recent[slot] = load;
+            numBlocks++;
+
+            max = jmax(max, load);
+            histogram[jlimit(0, (int)numBins-1, (int)(load*100.0))]++;
+        }
+
+        Stats getStats() const
+        {
+            Stats stats;
+            stats.nodeId = nodeId;
+            stats.numBlocks = numBlocks;
+            stats.numOverruns = histogram[numBins-1];
+            stats.mean = numBlocks>0 ? recentSum/jmin(numBlocks, (int64)windowSize) : 0;
+            stats.max = max;
+            stats.p50 = getPercentile(0.50);
+            stats.p95 = getPercentile(0.95);
+            stats.p99 = getPercentile(0.99);
+            return stats;
+        }
+
+        const int nodeId;
+
+    private:
+        void clear()
+        {
+            numBlocks = 0;
+            recentSum = max = 0;
+            zeromem(recent, sizeof(recent));
+            zeromem(histogram, sizeof(histogram));
+        }
+
+        //upper edge of the bin the given fraction of blocks fall within
+        double getPercentile(double fraction) const
+        {
+            const int64 target = (int64)std::ceil(numBlocks*fraction);
+            int64 count = 0;
+            for(int i=0; i<numBins; i++)
+            {
+                count += histogram[i];
+                if(count>=target && count>0)
+                    return i==numBins-1 ? max : (i+1)/100.0;
+            }
+            return 0;
+        }
+
+        int generation;
+        int64 numBlocks;
+        double recent[windowSize];
+        double recentSum, max;
+        int64 histogram[numBins];
+    };
+
+    //==========================================================================
+    NodeLoadProfiler() : enabled(0), generation(0) {}
+    ~NodeLoadProfiler() {}
+
+    void setEnabled(bool shouldBeEnabled)
+    {
+        enabled.set(shouldBeEnabled ? 1 : 0);
+        sendChangeMessage();
+    }
+
+    bool isEnabled() const
+    {
+        return enabled.get()!=0;
+    }
+
+    //the figures are cleared by the audio thread the next time each node runs
+    void reset()
+    {
+        ++generation;
+    }
+
+    int getGeneration() const
+    {
+        return generation.get();
+    }
+
+    //==========================================================================
+    // message thread
+    //==========================================================================
+    NodeLoad* getLoadForNode(int nodeId)
+    {
+        for(int i=0; i<loads.size(); i++)
+            if(loads.getUnchecked(i)->nodeId==nodeId)
+                return loads.getUnchecked(i);
+
+        return loads.add(new NodeLoad(nodeId));
+    }
+
+    //forget nodes that are no longer rendered
+    void removeNodesNotIn(const Array<int>& nodeIds)
+    {
+        for(int i=loads.size(); --i>=0;)
+            if(!nodeIds.contains(loads.getUnchecked(i)->nodeId))
+                loads.remove(i);
+    }
+
+    bool getStats(int nodeId, Stats& stats) const
+    {
+        for(int i=0; i<loads.size(); i++)
+            if(loads.getUnchecked(i)->nodeId==nodeId)
+            {
+                stats = loads.getUnchecked(i)->getStats();
+                return true;
+            }
+        return false;
+    }
+
+    Array<Stats> getAllStats() const
+    {
+        Array<Stats> stats;
+        for(int i=0; i<loads.size(); i++)
+            stats.add(loads.getUnchecked(i)->getStats());
+        return stats;
+    }
+
+private:
+    Atomic<int> enabled, generation;
+    OwnedArray<NodeLoad> loads;
+
+    JUCE_DECLARE_NON_COPYABLE (NodeLoadProfiler)
+};
+
+#endif   // __NODELOADPROFILER_H__
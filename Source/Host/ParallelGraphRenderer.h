@@ -0,0 +1,933 @@
+/*
+  Copyright (c) 2014 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __PARALLELGRAPHRENDERER_H__
+#define __PARALLELGRAPHRENDERER_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "NodeLoadProfiler.h"
+#include "AutomationEvents.h"
+#include "MidiLearnTable.h"
+#include "../Plugin/CabbagePluginProcessor.h"
+
+//==============================================================================
+// Renders an AudioProcessorGraph with its independent nodes spread over a pool
+// of worker threads. A schedule is built on the message thread from the
+// graph's nodes and connections: every node gets its own buffers, the list of
+// channels it reads and the nodes waiting on it. Each block the nodes with no
+// inputs are made ready and whichever thread finishes a node releases the
+// nodes that depend on it, carrying straight on with the first of them and
+// leaving the rest for the other threads to pick up. The audio thread works
+// alongside the pool and the block ends when every node has been processed.
+//
+// A node's inputs are always summed in connection order from buffers no other
+// node writes to, so the output does not depend on which thread ran what, and
+// is the same as rendering the schedule with no workers at all.
+//
+// Automation is gathered from every AutomationSource node at the start of each
+// block, and a node with changes in the block is processed in slices that end
+// at each change, so parameters move at the exact sample they were drawn at.
+// Cabbage nodes have the change written straight to its Csound channel, so it
+// is in place for the next k-cycle of the slice that follows.
+// Controllers in the incoming MIDI are turned into changes the same way by the
+// MidiLearnTable, if one is set, so they land at the sample they arrived on.
+//
+// Every path through the schedule is delay compensated: each node's reported
+// latency is added up along its inputs, and an audio connection from a path
+// with less latency than the slowest one into the same node is read through a
+// delay line that makes up the difference. When a latency changes the next
+// schedule's lines read their history from the lines they replace and
+// crossfade from the old delay to the new one, so recompiling a Cabbage node
+// doesn't cause a dropout. Schedules, and their lines, are built on the
+// message thread and swapped in under the callback lock, which is held for no
+// more than the swap. Delays are limited to DelayLine::maxDelaySamples, and
+// MIDI is not delayed.
+//
+// Until a schedule matching the prepared graph exists, blocks are passed on to
+// the graph's own serial render. Automation and learned controllers are still
+// applied then, but only at the start of each block. Nodes are only timed by
+// the profiler when it is enabled and the graph is rendered from a schedule.
+//==============================================================================
+class ParallelGraphRenderer : public ChangeListener,
+    private AsyncUpdater
+{
+public:
+    ParallelGraphRenderer(AudioProcessorGraph& graphToRender)
+        : graph(graphToRender), midiLearnTable(nullptr), current(nullptr), running(0), activeWorkers(0),
+          totalLatency(0)
+    {
+        setNumWorkerThreads(getDefaultNumWorkerThreads());
+        serialAutomation.ensureSize(4096);
+    }
+
+    ~ParallelGraphRenderer()
+    {
+        cancelPendingUpdate();
+        setNumWorkerThreads(0);
+    }
+
+    static int getDefaultNumWorkerThreads()
+    {
+        return jlimit(0, 8, SystemStats::getNumCpus()-1);
+    }
+
+    //==========================================================================
+    // message thread
+    //==========================================================================
+    void setNumWorkerThreads(int numThreads)
+    {
+        OwnedArray<Worker> oldWorkers;
+        {
+            const ScopedLock sl(graph.getCallbackLock());
+            oldWorkers.swapWith(workers);
+        }
+
+        for(int i=0; i<oldWorkers.size(); i++)
+        {
+            oldWorkers[i]->signalThreadShouldExit();
+            oldWorkers[i]->notify();
+            oldWorkers[i]->stopThread(1000);
+        }
+
+        OwnedArray<Worker> newWorkers;
+        for(int i=0; i<numThreads; i++)
+            newWorkers.add(new Worker(*this, i))->startThread(9);
+
+        const ScopedLock sl(graph.getCallbackLock());
+        workers.swapWith(newWorkers);
+    }
+
+    int getNumWorkerThreads() const
+    {
+        return workers.size();
+    }
+
+    NodeLoadProfiler& getProfiler()
+    {
+        return profiler;
+    }
+
+    void setMidiLearnTable(MidiLearnTable* table)
+    {
+        const ScopedLock sl(graph.getCallbackLock());
+        midiLearnTable = table;
+    }
+
+    //latency of the slowest path to the audio outputs, in samples
+    int getLatencySamples() const
+    {
+        return totalLatency.get();
+    }
+
+    //build a new schedule from the graph as it is now
+    void rebuild()
+    {
+        ScopedPointer<Schedule> newSchedule(new Schedule(graph, profiler, schedule));
+
+        {
+            const ScopedLock sl(graph.getCallbackLock());
+            schedule.swapWith(newSchedule);
+        }
+
+        //the old schedule is out of the audio thread's hands now
+        if(newSchedule!=nullptr)
+            newSchedule->releaseOlderDelayHistory();
+
+        profiler.removeNodesNotIn(schedule->getNodeIds());
+
+        totalLatency.set(schedule->getLatencySamples());
+        graph.setLatencySamples(schedule->getLatencySamples());
+    }
+
+    void changeListenerCallback(ChangeBroadcaster*)
+    {
+        triggerAsyncUpdate();
+    }
+
+    //==========================================================================
+    // audio thread, called with the graph's callback lock held
+    //==========================================================================
+    void processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
+    {
+        const int numSamples = buffer.getNumSamples();
+
+        if(schedule==nullptr || !schedule->matches(graph, numSamples))
+        {
+            //the graph has changed under us, render it the old way until the
+            //new schedule is ready
+            triggerAsyncUpdate();
+            if(schedule!=nullptr)
+                schedule->clearDelayHistory();
+            applyAutomationBeforeBlock(midiMessages, numSamples);
+            graph.processBlock(buffer, midiMessages);
+            return;
+        }
+
+        //carry on with the old delays until the new schedule is ready
+        if(schedule->haveLatenciesChanged())
+            triggerAsyncUpdate();
+
+        current = schedule;
+        current->startBlock(buffer, midiMessages, midiLearnTable);
+
+        if(current->isParallel() && workers.size()>0)
+        {
+            running.set(1);
+            for(int i=0; i<workers.size(); i++)
+                workers.getUnchecked(i)->notify();
+
+            current->render();
+
+            //wait for every worker to be out of the block before it is reused.
+            //They are usually just finishing their last node, so spin for a
+            //little while before sleeping until the last one signals.
+            running.set(0);
+            for(int spins=0; activeWorkers.get()>0; spins++)
+                if(spins>=maxJoinSpins)
+                    workersFinished.wait(1);
+        }
+        else
+            current->render();
+
+        current->finishBlock(buffer, midiMessages);
+        current = nullptr;
+    }
+
+private:
+    enum { maxJoinSpins = 1000 };
+
+    //==========================================================================
+    // a connection's signal, delayed to line up with the slowest path into
+    // its destination. Lines are only made for connections that are delayed,
+    // or fading from an old delay, and only hold enough for those delays.
+    // Input from before a line was first written is read from the line it
+    // replaced, which is no longer written to, so no history is ever copied.
+    class DelayLine : public ReferenceCountedObject
+    {
+    public:
+        typedef ReferenceCountedObjectPtr<DelayLine> Ptr;
+        enum { fadeLength = 1024, maxDelaySamples = 65536 };
+
+        DelayLine(int delaySamples, int previousDelaySamples, DelayLine* previousLine, int blockSize)
+            : older(previousLine), delay(delaySamples), previousDelay(previousDelaySamples),
+              writePos(0), numWritten(0), fadeRemaining(delay!=previousDelay ? (int)fadeLength : 0),
+              readOlder(true)
+        {
+            const int size = nextPowerOfTwo(jmax(delay, previousDelay)+jmax(1, blockSize)+1);
+            buffer.calloc(size);
+            mask = size-1;
+        }
+
+        //forget the input, for when it has stopped being written
+        void clear()
+        {
+            numWritten = 0;
+            fadeRemaining = 0;
+            readOlder = false;
+        }
+
+        //message thread, once the line can no longer be processed
+        void releaseOlderHistory()
+        {
+            older = nullptr;
+        }
+
+        //add the delayed input to the output
+        void process(const float* input, float* output, int numSamples)
+        {
+            //nothing to delay any more, so nothing to remember either
+            if(delay==0 && fadeRemaining==0)
+            {
+                FloatVectorOperations::add(output, input, numSamples);
+                numWritten = 0;
+                return;
+            }
+
+            for(int i=0; i<numSamples; i++)
+                buffer[(writePos+i)&mask] = input[i];
+            writePos = (writePos+numSamples)&mask;
+            numWritten = jmin(numWritten+numSamples, mask+1);
+
+            if(fadeRemaining==0)
+            {
+                for(int i=0; i<numSamples; i++)
+                    output[i] += read(numSamples-i+delay);
+                return;
+            }
+
+            for(int i=0; i<numSamples; i++)
+            {
+                const float previous = read(numSamples-i+previousDelay);
+                const float next = read(numSamples-i+delay);
+                const float proportion = 1.f-(float)fadeRemaining/(float)fadeLength;
+                output[i] += previous+(next-previous)*proportion;
+                if(fadeRemaining>0)
+                    fadeRemaining--;
+            }
+        }
+
+    private:
+        //the input from age samples ago, 1 being the newest
+        float read(int age) const
+        {
+            if(age<=numWritten)
+                return buffer[(writePos-age)&mask];
+
+            age -= numWritten;
+            const DelayLine* const previous = older;
+            if(readOlder && previous!=nullptr && age<=previous->numWritten)
+                return previous->buffer[(previous->writePos-age)&previous->mask];
+            return 0.f;
+        }
+
+        HeapBlock<float> buffer;
+        Ptr older;
+        const int delay, previousDelay;
+        int mask, writePos, numWritten, fadeRemaining;
+        bool readOlder;
+    };
+
+    //==========================================================================
+    struct Entry
+    {
+        struct AudioInput
+        {
+            int source, sourceChannel, destChannel, delay;
+            DelayLine* delayLine;
+        };
+
+        AudioProcessorGraph::Node::Ptr node;
+        AudioProcessor* processor;
+        CabbagePluginAudioProcessor* cabbageProcessor;
+        int ioType;
+        NodeLoadProfiler::NodeLoad* load;
+        AudioSampleBuffer buffer;
+        MidiBuffer midi, sliceMidi, outputMidi;
+        AutomationEventQueue automation;
+        Array<AudioInput> audioInputs;
+        Array<int> midiInputs;
+        Array<int> dependents;
+        int numDependencies, level;
+        int latency, inputLatency;
+        Atomic<int> pending;
+    };
+
+    //==========================================================================
+    class Schedule
+    {
+    public:
+        Schedule(AudioProcessorGraph& graph, NodeLoadProfiler& nodeLoadProfiler, const Schedule* previous)
+            : profiler(nodeLoadProfiler),
+              blockSize(graph.getBlockSize()), sampleRate(graph.getSampleRate()),
+              maxLevelWidth(0), totalLatency(0),
+              inputBuffer(nullptr), inputMidi(nullptr), numSamples(0),
+              profiling(false), profilerGeneration(0), ticksPerBlock(0),
+              delayHistoryCleared(false)
+        {
+            for(int i=0; i<graph.getNumNodes(); i++)
+            {
+                Entry* entry = entries.add(new Entry());
+                entry->node = graph.getNode(i);
+                entry->processor = entry->node->getProcessor();
+                entry->cabbageProcessor = dynamic_cast<CabbagePluginAudioProcessor*>(entry->processor);
+                entry->ioType = -1;
+                if(AudioProcessorGraph::AudioGraphIOProcessor* io = dynamic_cast<AudioProcessorGraph::AudioGraphIOProcessor*>(entry->processor))
+                    entry->ioType = io->getType();
+                entry->load = entry->ioType<0 ? profiler.getLoadForNode((int)entry->node->nodeId) : nullptr;
+
+                const int numChannels = jmax(1, entry->processor->getNumInputChannels(), entry->processor->getNumOutputChannels());
+                entry->buffer.setSize(numChannels, jmax(1, blockSize));
+                entry->midi.ensureSize(2048);
+                entry->numDependencies = entry->level = 0;
+                entry->latency = entry->ioType<0 ? jmax(0, entry->processor->getLatencySamples()) : 0;
+                entry->inputLatency = 0;
+                indexForId.set((int)entry->node->nodeId, i);
+
+                if(entry->ioType<0)
+                {
+                    entry->sliceMidi.ensureSize(2048);
+                    entry->outputMidi.ensureSize(2048);
+                    entry->automation.ensureSize(maxEventsPerNode);
+                }
+
+                if(AutomationSource* source = dynamic_cast<AutomationSource*>(entry->processor))
+                    automationSources.add(source);
+            }
+
+            automationEvents.ensureSize(maxEventsPerNode*4);
+
+            for(int i=0; i<graph.getNumConnections(); i++)
+            {
+                const AudioProcessorGraph::Connection* c = graph.getConnection(i);
+                const ConnectionKey key = { c->sourceNodeId, c->sourceChannelIndex, c->destNodeId, c->destChannelIndex };
+                connections.add(key);
+                if(!indexForId.contains((int)c->sourceNodeId) || !indexForId.contains((int)c->destNodeId))
+                    continue;
+
+                const int source = indexForId[(int)c->sourceNodeId];
+                const int destIndex = indexForId[(int)c->destNodeId];
+                Entry* dest = entries.getUnchecked(destIndex);
+
+                if(c->sourceChannelIndex==AudioProcessorGraph::midiChannelIndex)
+                    dest->midiInputs.addIfNotAlreadyThere(source);
+                else
+                {
+                    Entry::AudioInput input = { source, c->sourceChannelIndex, c->destChannelIndex, 0, nullptr };
+                    dest->audioInputs.add(input);
+                }
+
+                Array<int>& dependents = entries.getUnchecked(source)->dependents;
+                if(!dependents.contains(destIndex))
+                {
+                    dependents.add(destIndex);
+                    dest->numDependencies++;
+                }
+            }
+
+            findLevels();
+            findLatencies(previous);
+
+            readyNodes.calloc(jmax(1, entries.size()));
+            published.calloc(jmax(1, entries.size()));
+        }
+
+        //whether this schedule was built from the graph as it is now: the
+        //same nodes and the same connections, in the same order
+        bool matches(AudioProcessorGraph& graph, int samplesInBlock) const
+        {
+            if(entries.size()!=graph.getNumNodes()
+                    || connections.size()!=graph.getNumConnections()
+                    || sampleRate!=graph.getSampleRate()
+                    || samplesInBlock>blockSize)
+                return false;
+
+            for(int i=0; i<entries.size(); i++)
+                if(entries.getUnchecked(i)->node.getObject()!=graph.getNode(i))
+                    return false;
+
+            for(int i=0; i<connections.size(); i++)
+            {
+                const ConnectionKey& key = connections.getReference(i);
+                const AudioProcessorGraph::Connection* c = graph.getConnection(i);
+                if(c->sourceNodeId!=key.sourceNodeId || c->sourceChannelIndex!=key.sourceChannel
+                        || c->destNodeId!=key.destNodeId || c->destChannelIndex!=key.destChannel)
+                    return false;
+            }
+            return true;
+        }
+
+        bool isParallel() const
+        {
+            return maxLevelWidth>1;
+        }
+
+        int getLatencySamples() const
+        {
+            return totalLatency;
+        }
+
+        //a node has reported a new latency since this schedule was built
+        bool haveLatenciesChanged() const
+        {
+            for(int i=0; i<entries.size(); i++)
+            {
+                const Entry& entry = *entries.getUnchecked(i);
+                if(entry.ioType<0 && jmax(0, entry.processor->getLatencySamples())!=entry.latency)
+                    return true;
+            }
+            return false;
+        }
+
+        //the graph was rendered without this schedule, so its lines no longer
+        //hold the connections' recent input
+        void clearDelayHistory()
+        {
+            if(delayHistoryCleared)
+                return;
+            for(int i=0; i<delayLines.size(); i++)
+                delayLines.getUnchecked(i)->clear();
+            delayHistoryCleared = true;
+        }
+
+        //message thread, once this schedule has been replaced, so that each
+        //line only ever holds on to the one line before it
+        void releaseOlderDelayHistory()
+        {
+            for(int i=0; i<delayLines.size(); i++)
+                delayLines.getUnchecked(i)->releaseOlderHistory();
+        }
+
+        Array<int> getNodeIds() const
+        {
+            Array<int> nodeIds;
+            for(int i=0; i<entries.size(); i++)
+                nodeIds.add((int)entries.getUnchecked(i)->node->nodeId);
+            return nodeIds;
+        }
+
+        void startBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages, MidiLearnTable* midiLearnTable)
+        {
+            inputBuffer = &buffer;
+            inputMidi = &midiMessages;
+            numSamples = buffer.getNumSamples();
+            delayHistoryCleared = false;
+
+            profiling = profiler.isEnabled();
+            if(profiling)
+            {
+                profilerGeneration = profiler.getGeneration();
+                ticksPerBlock = numSamples/sampleRate*Time::getHighResolutionTicksPerSecond();
+            }
+
+            gatherAutomation(midiLearnTable);
+
+            head.set(0);
+            tail.set(0);
+            remaining.set(entries.size());
+            for(int i=0; i<entries.size(); i++)
+            {
+                published[i].set(0);
+                entries.getUnchecked(i)->pending.set(entries.getUnchecked(i)->numDependencies);
+            }
+
+            for(int i=0; i<entries.size(); i++)
+                if(entries.getUnchecked(i)->numDependencies==0)
+                    push(i);
+        }
+
+        //process nodes until there are none left in the block
+        void render()
+        {
+            while(remaining.get()>0)
+            {
+                int index = pop();
+                while(index>=0)
+                {
+                    process(*entries.getUnchecked(index));
+                    index = complete(*entries.getUnchecked(index));
+                }
+            }
+        }
+
+        //the device buffer is only written once every node has read from it
+        void finishBlock(AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
+        {
+            buffer.clear();
+            midiMessages.clear();
+
+            for(int i=0; i<entries.size(); i++)
+            {
+                const Entry& entry = *entries.getUnchecked(i);
+                if(entry.ioType==AudioProcessorGraph::AudioGraphIOProcessor::audioOutputNode)
+                {
+                    for(int ch=jmin(buffer.getNumChannels(), entry.buffer.getNumChannels()); --ch>=0;)
+                        buffer.addFrom(ch, 0, entry.buffer, ch, 0, numSamples);
+                }
+                else if(entry.ioType==AudioProcessorGraph::AudioGraphIOProcessor::midiOutputNode)
+                    midiMessages.addEvents(entry.midi, 0, numSamples, 0);
+            }
+        }
+
+    private:
+        enum { maxEventsPerNode = 1024 };
+
+        struct ConnectionKey
+        {
+            uint32 sourceNodeId;
+            int sourceChannel;
+            uint32 destNodeId;
+            int destChannel;
+        };
+
+        //hand each source's events to the nodes they are for
+        void gatherAutomation(MidiLearnTable* midiLearnTable)
+        {
+            for(int i=0; i<entries.size(); i++)
+                entries.getUnchecked(i)->automation.clear();
+
+            for(int s=0; s<automationSources.size(); s++)
+            {
+                automationEvents.clear();
+                automationSources.getUnchecked(s)->renderAutomation(numSamples, automationEvents);
+                distributeAutomation();
+            }
+
+            if(midiLearnTable!=nullptr)
+            {
+                automationEvents.clear();
+                midiLearnTable->renderAutomation(*inputMidi, numSamples, sampleRate, automationEvents);
+                distributeAutomation();
+            }
+        }
+
+        void distributeAutomation()
+        {
+            for(int i=0; i<automationEvents.getNumEvents(); i++)
+            {
+                const AutomationEvent& event = automationEvents.getEvent(i);
+                if(indexForId.contains(event.nodeId))
+                {
+                    Entry& target = *entries.getUnchecked(indexForId[event.nodeId]);
+                    if(target.ioType<0)
+                        target.automation.add(event);
+                }
+            }
+        }
+
+        //longest chain of nodes above each node, used to tell whether any
+        //nodes could ever run at the same time
+        void findLevels()
+        {
+            Array<int> order, pendingCount;
+            for(int i=0; i<entries.size(); i++)
+            {
+                pendingCount.add(entries.getUnchecked(i)->numDependencies);
+                if(pendingCount[i]==0)
+                    order.add(i);
+            }
+
+            for(int i=0; i<order.size(); i++)
+            {
+                const Entry& entry = *entries.getUnchecked(order[i]);
+                for(int d=0; d<entry.dependents.size(); d++)
+                {
+                    const int dependent = entry.dependents.getUnchecked(d);
+                    Entry& next = *entries.getUnchecked(dependent);
+                    next.level = jmax(next.level, entry.level+1);
+                    pendingCount.set(dependent, pendingCount[dependent]-1);
+                    if(pendingCount[dependent]==0)
+                        order.add(dependent);
+                }
+            }
+
+            HashMap<int, int> levelWidths;
+            for(int i=0; i<entries.size(); i++)
+            {
+                const int level = entries.getUnchecked(i)->level;
+                levelWidths.set(level, levelWidths[level]+1);
+                maxLevelWidth = jmax(maxLevelWidth, levelWidths[level]);
+            }
+        }
+
+        //add up the latency along every path, in dependency order, and give
+        //each audio input the delay that lines it up with the slowest one
+        void findLatencies(const Schedule* previous)
+        {
+            Array<int> order, pendingCount;
+            for(int i=0; i<entries.size(); i++)
+            {
+                pendingCount.add(entries.getUnchecked(i)->numDependencies);
+                if(pendingCount[i]==0)
+                    order.add(i);
+            }
+
+            for(int i=0; i<order.size(); i++)
+            {
+                const Entry& entry = *entries.getUnchecked(order[i]);
+                for(int d=0; d<entry.dependents.size(); d++)
+                {
+                    const int dependent = entry.dependents.getUnchecked(d);
+                    Entry& next = *entries.getUnchecked(dependent);
+                    next.inputLatency = jmax(next.inputLatency, entry.inputLatency+entry.latency);
+                    pendingCount.set(dependent, pendingCount[dependent]-1);
+                    if(pendingCount[dependent]==0)
+                        order.add(dependent);
+                }
+            }
+
+            for(int i=0; i<entries.size(); i++)
+            {
+                Entry& entry = *entries.getUnchecked(i);
+                for(int j=0; j<entry.audioInputs.size(); j++)
+                {
+                    Entry::AudioInput& input = entry.audioInputs.getReference(j);
+                    const Entry& source = *entries.getUnchecked(input.source);
+                    input.delay = jlimit(0, (int)DelayLine::maxDelaySamples,
+                                         entry.inputLatency-(source.inputLatency+source.latency));
+
+                    //a connection that is new to this schedule starts at its delay
+                    const Entry::AudioInput* old = previous!=nullptr ? previous->findAudioInput(*this, entry, input) : nullptr;
+                    const int previousDelay = old!=nullptr ? old->delay : input.delay;
+                    if(input.delay>0 || previousDelay>0)
+                        input.delayLine = delayLines.add(new DelayLine(input.delay, previousDelay,
+                                                         old!=nullptr ? old->delayLine : nullptr, blockSize));
+                }
+
+                if(entry.ioType==AudioProcessorGraph::AudioGraphIOProcessor::audioOutputNode)
+                    totalLatency = jmax(totalLatency, entry.inputLatency);
+            }
+        }
+
+        //the input in this schedule for the same connection as an input of
+        //another schedule's entry
+        const Entry::AudioInput* findAudioInput(const Schedule& other, const Entry& otherEntry, const Entry::AudioInput& otherInput) const
+        {
+            const int destId = (int)otherEntry.node->nodeId;
+            const int sourceId = (int)other.entries.getUnchecked(otherInput.source)->node->nodeId;
+            if(!indexForId.contains(destId) || !indexForId.contains(sourceId))
+                return nullptr;
+
+            const Entry& entry = *entries.getUnchecked(indexForId[destId]);
+            const int source = indexForId[sourceId];
+            for(int i=0; i<entry.audioInputs.size(); i++)
+            {
+                const Entry::AudioInput& input = entry.audioInputs.getReference(i);
+                if(input.source==source && input.sourceChannel==otherInput.sourceChannel
+                   && input.destChannel==otherInput.destChannel)
+                    return &input;
+            }
+            return nullptr;
+        }
+
+        void process(Entry& entry)
+        {
+            AudioSampleBuffer buffer(entry.buffer.getArrayOfWritePointers(), entry.buffer.getNumChannels(), numSamples);
+            buffer.clear();
+            entry.midi.clear();
+
+            switch(entry.ioType)
+            {
+            case AudioProcessorGraph::AudioGraphIOProcessor::audioInputNode:
+                for(int ch=jmin(buffer.getNumChannels(), inputBuffer->getNumChannels()); --ch>=0;)
+                    buffer.copyFrom(ch, 0, *inputBuffer, ch, 0, numSamples);
+                return;
+
+            case AudioProcessorGraph::AudioGraphIOProcessor::midiInputNode:
+                entry.midi.addEvents(*inputMidi, 0, numSamples, 0);
+                return;
+
+            default:
+                break;
+            }
+
+            for(int i=0; i<entry.audioInputs.size(); i++)
+            {
+                const Entry::AudioInput& input = entry.audioInputs.getReference(i);
+                const AudioSampleBuffer& source = entries.getUnchecked(input.source)->buffer;
+                if(input.sourceChannel>=source.getNumChannels() || input.destChannel>=buffer.getNumChannels())
+                    continue;
+
+                if(input.delayLine!=nullptr)
+                    input.delayLine->process(source.getReadPointer(input.sourceChannel),
+                                             buffer.getWritePointer(input.destChannel), numSamples);
+                else
+                    FloatVectorOperations::add(buffer.getWritePointer(input.destChannel),
+                                               source.getReadPointer(input.sourceChannel), numSamples);
+            }
+
+            for(int i=0; i<entry.midiInputs.size(); i++)
+                entry.midi.addEvents(entries.getUnchecked(entry.midiInputs.getUnchecked(i))->midi, 0, numSamples, 0);
+
+            //the output nodes are gathered in finishBlock()
+            if(entry.ioType>=0)
+                return;
+
+            if(profiling)
+            {
+                const int64 startTicks = Time::getHighResolutionTicks();
+                processAutomated(entry, buffer);
+                const int64 ticks = Time::getHighResolutionTicks()-startTicks;
+                entry.load->addBlock(ticks/jmax(1.0, ticksPerBlock), profilerGeneration);
+            }
+            else
+                processAutomated(entry, buffer);
+        }
+
+        //process the block in slices, changing parameters between them
+        void processAutomated(Entry& entry, AudioSampleBuffer& buffer)
+        {
+            const int numEvents = entry.automation.getNumEvents();
+            if(numEvents==0)
+            {
+                entry.processor->processBlock(buffer, entry.midi);
+                return;
+            }
+
+            entry.outputMidi.clear();
+            int start = 0;
+            for(int i=0; i<=numEvents; i++)
+            {
+                const int end = (i<numEvents ? jlimit(start, numSamples, entry.automation.getEvent(i).sampleOffset) : numSamples);
+                if(end>start)
+                {
+                    AudioSampleBuffer slice(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, end-start);
+                    entry.sliceMidi.clear();
+                    entry.sliceMidi.addEvents(entry.midi, start, end-start, -start);
+                    entry.processor->processBlock(slice, entry.sliceMidi);
+                    entry.outputMidi.addEvents(entry.sliceMidi, 0, end-start, start);
+                    start = end;
+                }
+
+                if(i<numEvents)
+                {
+                    const AutomationEvent& event = entry.automation.getEvent(i);
+                    if(!isPositiveAndBelow(event.parameterIndex, entry.processor->getNumParameters()))
+                        continue;
+                    if(entry.cabbageProcessor!=nullptr)
+                        entry.cabbageProcessor->directParameterChange(event.parameterIndex, event.value);
+                    else
+                        entry.processor->setParameter(event.parameterIndex, event.value);
+                }
+            }
+
+            entry.midi.swapWith(entry.outputMidi);
+        }
+
+        //release the nodes waiting on this one, returning the first that is
+        //now ready so the calling thread can carry on with it
+        int complete(Entry& entry)
+        {
+            int next = -1;
+            for(int i=0; i<entry.dependents.size(); i++)
+            {
+                const int dependent = entry.dependents.getUnchecked(i);
+                if(--(entries.getUnchecked(dependent)->pending)==0)
+                {
+                    if(next<0)
+                        next = dependent;
+                    else
+                        push(dependent);
+                }
+            }
+
+            --remaining;
+            return next;
+        }
+
+        //each node is made ready exactly once per block, so the ready list
+        //is a plain array claimed from either end with atomic counters
+        void push(int index)
+        {
+            const int slot = ++tail-1;
+            readyNodes[slot] = index;
+            published[slot].set(1);
+        }
+
+        int pop()
+        {
+            for(;;)
+            {
+                const int slot = head.get();
+                if(slot>=tail.get() || published[slot].get()==0)
+                    return -1;
+                if(head.compareAndSetBool(slot+1, slot))
+                    return readyNodes[slot];
+            }
+        }
+
+        OwnedArray<Entry> entries;
+        ReferenceCountedArray<DelayLine> delayLines;
+        HashMap<int, int> indexForId;
+        Array<AutomationSource*> automationSources;
+        AutomationEventQueue automationEvents;
+        NodeLoadProfiler& profiler;
+        const int blockSize;
+        const double sampleRate;
+        Array<ConnectionKey> connections;
+        int maxLevelWidth, totalLatency;
+
+        HeapBlock<int> readyNodes;
+        HeapBlock<Atomic<int> > published;
+        Atomic<int> head, tail, remaining;
+
+        AudioSampleBuffer* inputBuffer;
+        MidiBuffer* inputMidi;
+        int numSamples;
+
+        bool profiling;
+        int profilerGeneration;
+        double ticksPerBlock;
+        bool delayHistoryCleared;
+
+        JUCE_DECLARE_NON_COPYABLE (Schedule)
+    };
+
+    //==========================================================================
+    class Worker : public Thread
+    {
+    public:
+        Worker(ParallelGraphRenderer& r, int index)
+            : Thread("Graph worker "+String(index+1)), renderer(r) {}
+
+        void run()
+        {
+            while(!threadShouldExit())
+            {
+                wait(-1);
+
+                ++renderer.activeWorkers;
+                if(renderer.running.get()==1 && renderer.current!=nullptr)
+                    renderer.current->render();
+                if(--renderer.activeWorkers==0)
+                    renderer.workersFinished.signal();
+            }
+        }
+
+    private:
+        ParallelGraphRenderer& renderer;
+    };
+
+    void handleAsyncUpdate()
+    {
+        rebuild();
+    }
+
+    //the serial render can't split a node's block at each change, so every
+    //change that falls in the block is made before it, in sample order
+    void applyAutomationBeforeBlock(const MidiBuffer& midiMessages, int numSamples)
+    {
+        serialAutomation.clear();
+        for(int i=0; i<graph.getNumNodes(); i++)
+            if(AutomationSource* source = dynamic_cast<AutomationSource*>(graph.getNode(i)->getProcessor()))
+                source->renderAutomation(numSamples, serialAutomation);
+
+        if(midiLearnTable!=nullptr)
+            midiLearnTable->renderAutomation(midiMessages, numSamples, graph.getSampleRate(), serialAutomation);
+
+        for(int i=0; i<serialAutomation.getNumEvents(); i++)
+        {
+            const AutomationEvent& event = serialAutomation.getEvent(i);
+            AudioProcessorGraph::Node* node = graph.getNodeForId((uint32)event.nodeId);
+            if(node==nullptr || dynamic_cast<AudioProcessorGraph::AudioGraphIOProcessor*>(node->getProcessor())!=nullptr)
+                continue;
+            if(!isPositiveAndBelow(event.parameterIndex, node->getProcessor()->getNumParameters()))
+                continue;
+
+            //learned controllers included, Cabbage nodes are written to directly
+            if(CabbagePluginAudioProcessor* cabbage = dynamic_cast<CabbagePluginAudioProcessor*>(node->getProcessor()))
+                cabbage->directParameterChange(event.parameterIndex, event.value);
+            else
+                node->getProcessor()->setParameter(event.parameterIndex, event.value);
+        }
+    }
+
+    AudioProcessorGraph& graph;
+    MidiLearnTable* midiLearnTable;
+    NodeLoadProfiler profiler;
+    ScopedPointer<Schedule> schedule;
+    Schedule* volatile current;
+    AutomationEventQueue serialAutomation;
+    OwnedArray<Worker> workers;
+    Atomic<int> running, activeWorkers, totalLatency;
+    WaitableEvent workersFinished;
+
+    JUCE_DECLARE_NON_COPYABLE (ParallelGraphRenderer)
+};
+
+#endif   // __PARALLELGRAPHRENDERER_H__
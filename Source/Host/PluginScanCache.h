@@ -0,0 +1,277 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __PLUGINSCANCACHE_H__
+#define __PLUGINSCANCACHE_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../CabbageUtils.h"
+
+//==============================================================================
+// The result of probing each plugin file, keyed by format and path. An entry is
+// only trusted while the file's modification time and size are unchanged, so a
+// rescan never loads a plugin it has already seen unless the file was updated.
+// Files that crashed or hung the scanner are remembered too, so they're not
+// tried again until they change.
+//
+// Plugin binaries are probed by a copy of the host started with
+// --scan-plugin, so a plugin that crashes or never returns can only take that
+// process down. Cabbage instruments are indexed by reading the <Cabbage>
+// section of the .csd, without compiling anything.
+//
+// The cache is only touched from the message thread.
+//==============================================================================
+class PluginScanCache
+{
+public:
+    enum Status
+    {
+        scanOk = 0,
+        scanFoundNothing,
+        scanCrashed,
+        scanTimedOut
+    };
+
+    PluginScanCache(const File& file) : cacheFile(file), changed(false)
+    {
+        root = XmlDocument::parse(cacheFile);
+        if(root==nullptr || !root->hasTagName("PLUGINSCANCACHE"))
+            root = new XmlElement("PLUGINSCANCACHE");
+
+        forEachXmlChildElementWithTagName(*root, e, "FILE")
+            entries.set(getKey(e->getStringAttribute("format"), e->getStringAttribute("path")), e);
+    }
+
+    ~PluginScanCache()
+    {
+        save();
+    }
+
+    void save()
+    {
+        if(changed)
+        {
+            root->writeToFile(cacheFile, String::empty);
+            changed = false;
+        }
+    }
+
+    //returns false if the file isn't cached, or has changed since it was
+    bool lookup(const String& formatName, const File& file, Status& status, OwnedArray<PluginDescription>& types) const
+    {
+        const String key(getKey(formatName, file.getFullPathName()));
+        if(!entries.contains(key))
+            return false;
+
+        const XmlElement* e = entries[key];
+        if(e->getStringAttribute("modTime").getLargeIntValue()!=file.getLastModificationTime().toMilliseconds()
+           || e->getStringAttribute("size").getLargeIntValue()!=file.getSize())
+            return false;
+
+        status = (Status)e->getIntAttribute("status");
+        forEachXmlChildElement(*e, child)
+        {
+            PluginDescription desc;
+            if(desc.loadFromXml(*child))
+                types.add(new PluginDescription(desc));
+        }
+        return true;
+    }
+
+    void store(const String& formatName, const File& file, Status status, const OwnedArray<PluginDescription>& types)
+    {
+        const String key(getKey(formatName, file.getFullPathName()));
+        if(entries.contains(key))
+            root->removeChildElement(entries[key], true);
+
+        XmlElement* e = root->createNewChildElement("FILE");
+        e->setAttribute("format", formatName);
+        e->setAttribute("path", file.getFullPathName());
+        e->setAttribute("modTime", String(file.getLastModificationTime().toMilliseconds()));
+        e->setAttribute("size", String(file.getSize()));
+        e->setAttribute("status", (int)status);
+        for(int i=0; i<types.size(); i++)
+            e->addChildElement(types.getUnchecked(i)->createXml());
+
+        entries.set(key, e);
+        changed = true;
+    }
+
+    //==========================================================================
+    // plugin binaries
+    //==========================================================================
+    //start a copy of this executable to probe the file, giving up after
+    //timeoutMs. The job, if any, is polled so a cancelled scan kills the child.
+    static Status scanOutOfProcess(const String& formatName, const String& fileOrIdentifier, int timeoutMs,
+                                   OwnedArray<PluginDescription>& results, ThreadPoolJob* job=nullptr)
+    {
+        const File output(File::createTempFile(".pluginscan"));
+
+        StringArray args;
+        args.add(File::getSpecialLocation(File::currentExecutableFile).getFullPathName());
+        args.add("--scan-plugin");
+        args.add(formatName);
+        args.add(fileOrIdentifier);
+        args.add(output.getFullPathName());
+
+        ChildProcess child;
+        if(!child.start(args, 0))
+            return scanCrashed;
+
+        const uint32 startTime = Time::getMillisecondCounter();
+        while(!child.waitForProcessToFinish(50))
+        {
+            if((job!=nullptr && job->shouldExit())
+               || Time::getMillisecondCounter()-startTime>(uint32)timeoutMs)
+            {
+                child.kill();
+                output.deleteFile();
+                return scanTimedOut;
+            }
+        }
+
+        //the child only writes its results once it has finished probing, so a
+        //missing file means it crashed
+        ScopedPointer<XmlElement> xml(XmlDocument::parse(output));
+        output.deleteFile();
+        if(xml==nullptr || !xml->hasTagName("PLUGINSCAN"))
+            return scanCrashed;
+
+        forEachXmlChildElement(*xml, e)
+        {
+            PluginDescription desc;
+            if(desc.loadFromXml(*e))
+                results.add(new PluginDescription(desc));
+        }
+        return results.size()>0 ? scanOk : scanFoundNothing;
+    }
+
+    //the --scan-plugin side of the above. Returns false if the format is unknown.
+    static bool scanInThisProcess(AudioPluginFormatManager& formatManager, const String& formatName,
+                                  const String& fileOrIdentifier, const File& output)
+    {
+        for(int i=0; i<formatManager.getNumFormats(); i++)
+        {
+            AudioPluginFormat* format = formatManager.getFormat(i);
+            if(format->getName()!=formatName)
+                continue;
+
+            OwnedArray<PluginDescription> found;
+            format->findAllTypesForFile(found, fileOrIdentifier);
+
+            XmlElement xml("PLUGINSCAN");
+            for(int j=0; j<found.size(); j++)
+                xml.addChildElement(found.getUnchecked(j)->createXml());
+            return xml.writeToFile(output, String::empty);
+        }
+        return false;
+    }
+
+    //==========================================================================
+    // Cabbage instruments
+    //==========================================================================
+    static bool isCabbageFile(const File& file)
+    {
+        return file.hasFileExtension(".csd");
+    }
+
+    //fill in a description from the <Cabbage> section, returns false if there isn't one
+    static bool indexCabbageFile(const File& file, PluginDescription& desc)
+    {
+        const String csdText(file.loadFileAsString());
+        const String section(csdText.fromFirstOccurrenceOf("<Cabbage>", false, false)
+                             .upToFirstOccurrenceOf("</Cabbage>", false, false));
+        if(section.isEmpty())
+            return false;
+
+        StringArray lines, parameters;
+        lines.addLines(section);
+        String caption;
+        bool hasKeyboard = false;
+
+        for(int i=0; i<lines.size(); i++)
+        {
+            const String line(lines[i].upToFirstOccurrenceOf(";", false, false).trim());
+            const String type(line.upToFirstOccurrenceOf(" ", false, false).toLowerCase());
+
+            if(type=="form")
+                caption = getIdentifierText(line, "caption");
+            else if(type=="keyboard")
+                hasKeyboard = true;
+            else if(isInteractiveWidget(type))
+            {
+                //xypads and the double sliders declare a channel per parameter
+                const String channels(line.fromFirstOccurrenceOf("channel(", false, false)
+                                      .upToFirstOccurrenceOf(")", false, false));
+                StringArray names;
+                names.addTokens(channels, ",", "\"");
+                names.trim();
+                names.removeEmptyStrings();
+                for(int j=0; j<names.size(); j++)
+                    parameters.add(names[j].unquoted());
+            }
+        }
+
+        const int nchnls = cUtils::getNchnlsFromFile(csdText);
+
+        desc.name = caption.length()>2 ? caption : file.getFileNameWithoutExtension();
+        desc.descriptiveName = String(parameters.size())+" parameters"
+                               +(parameters.size()>0 ? ": "+parameters.joinIntoString(", ") : String::empty);
+        desc.pluginFormatName = "Cabbage";
+        desc.category = "Cabbage";
+        desc.manufacturerName = "CabbageAudio";
+        desc.version = String::empty;
+        desc.fileOrIdentifier = file.getFullPathName();
+        desc.lastFileModTime = file.getLastModificationTime();
+        desc.uid = file.getFullPathName().hashCode();
+        desc.isInstrument = hasKeyboard;
+        desc.numInputChannels = nchnls;
+        desc.numOutputChannels = nchnls;
+        return true;
+    }
+
+private:
+    static String getKey(const String& formatName, const String& path)
+    {
+        return formatName+":"+path;
+    }
+
+    static bool isInteractiveWidget(const String& type)
+    {
+        return type=="hslider" || type=="hslider2" || type=="hslider3"
+               || type=="vslider" || type=="vslider2" || type=="vslider3"
+               || type=="rslider" || type=="combobox" || type=="checkbox"
+               || type=="numberbox" || type=="xypad" || type=="button";
+    }
+
+    static String getIdentifierText(const String& line, const String& identifier)
+    {
+        return line.fromFirstOccurrenceOf(identifier+"(", false, false)
+               .upToFirstOccurrenceOf(")", false, false).trim().unquoted();
+    }
+
+    File cacheFile;
+    ScopedPointer<XmlElement> root;
+    HashMap<String, XmlElement*> entries;
+    bool changed;
+
+    JUCE_DECLARE_NON_COPYABLE (PluginScanCache)
+};
+
+#endif   // __PLUGINSCANCACHE_H__
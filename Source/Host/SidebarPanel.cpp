@@ -34,7 +34,8 @@ SidebarPanel::SidebarPanel(FilterGraph* graph) :
     canResize(false),
     transportControls(*this, " "),
     midiBubble(250),
-    midiLearn(false)
+    midiLearn(false),
+    nodeLoadComp(graph, " ")
 {
     setOpaque (true);
     addAndMakeVisible (concertinaPanel);
@@ -73,6 +74,13 @@ SidebarPanel::SidebarPanel(FilterGraph* graph) :
     filePanel->addProperties(singleParams);
 
     concertinaPanel.addPanel(FILE_BROWSER, filePanel, false);
+
+    PropertyPanel* loadPanel = new PropertyPanel ("DSP Load");
+    Array <PropertyComponent*> loadParams;
+    loadParams.add(&nodeLoadComp);
+    loadPanel->addProperties(loadParams);
+    concertinaPanel.addPanel(DSP_LOAD, loadPanel, false);
+
     concertinaPanel.expandPanelFully(concertinaPanel.getPanel(TRANSPORT_CONTROLS), true);
 
 }
@@ -218,7 +226,7 @@ void SidebarPanel::stopButtonPressed()
     filterGraph->setIsPlaying(false, true);
     transportControls.setTimeIsRunning(false);
     transportControls.setTimeLabel("00 : 00 : 00");
-    transportControls.setBeatsLabel("Beat 1");
+    transportControls.setBeatsLabel("Beat 1.1");
     repaint();
     stopTimer();
 }
@@ -321,16 +329,18 @@ void SidebarPanel::updateWidgetProperties()
 //--------------------------------------------------------------------
 void SidebarPanel::timerCallback()
 {
-    const int ellapsedTime = filterGraph->getTimeInSeconds();
+    const int ellapsedTime = (int)filterGraph->getTimeInSeconds();
     const int hours = (ellapsedTime / 60 / 60) % 24;
     const int minutes = (ellapsedTime / 60) % 60;
     const int seconds = ellapsedTime % 60;
     String time = String::formatted("%02d", hours)+" : "+String::formatted("%02d", minutes)+" : "+String::formatted("%02d", seconds);
     transportControls.setTimeLabel(time);
 
-    const int elaspsedQNs = filterGraph->getPPQPosition();
+    int bar;
+    double beat;
+    filterGraph->getTransport().getBarPosition(bar, beat);
 
-    String ppqPos = "Beat "+String(elaspsedQNs);
+    String ppqPos = "Beat "+String(bar+1)+"."+String((int)beat+1);
     transportControls.setBeatsLabel(String(ppqPos));
 
 }
@@ -483,7 +493,7 @@ TransportComponent::TransportComponent(SidebarPanel &ownerPanel, String name):
     beatsLabel.setLookAndFeel(standardLookAndFeel);
     beatsLabel.setColour(Label::backgroundColourId, Colours::black);
     beatsLabel.setColour(Label::textColourId, Colours::cornflowerblue);
-    beatsLabel.setText("Beat 1", dontSendNotification);
+    beatsLabel.setText("Beat 1.1", dontSendNotification);
 
 
     playButton.setLookAndFeel(&lookAndFeel);
@@ -562,4 +572,219 @@ void TransportComponent::buttonClicked (Button* button)
         else
             owner.pauseButtonPressed();
     }
-}
\ No newline at end of file
+}
+//==============================================================================
+// per node DSP load
+//==============================================================================
+NodeLoadComponent::NodeLoadComponent(FilterGraph* graph, String name):
+    PropertyComponent(name, 220),
+    filterGraph(graph),
+    sortColumn(meanColumn),
+    sortForwards(false),
+    table("loadTable", this),
+    enableButton("Profile"),
+    resetButton("Reset"),
+    exportButton("Export CSV")
+{
+    TableHeaderComponent& header = table.getHeader();
+    header.addColumn("Node", nameColumn, 90);
+    header.addColumn("Mean", meanColumn, 40);
+    header.addColumn("P95", p95Column, 40);
+    header.addColumn("P99", p99Column, 40);
+    header.addColumn("Max", maxColumn, 40);
+    header.addColumn("Over", overrunsColumn, 40);
+    header.setSortColumnId(sortColumn, sortForwards);
+
+    table.setRowHeight(16);
+    table.setColour(ListBox::backgroundColourId, Colour(20, 20, 20));
+
+    enableButton.setClickingTogglesState(true);
+    enableButton.setColour(TextButton::buttonOnColourId, Colours::lime.darker(.5f));
+
+    addAndMakeVisible(table);
+    addAndMakeVisible(enableButton);
+    addAndMakeVisible(resetButton);
+    addAndMakeVisible(exportButton);
+
+    enableButton.addListener(this);
+    resetButton.addListener(this);
+    exportButton.addListener(this);
+}
+
+NodeLoadComponent::~NodeLoadComponent()
+{
+    filterGraph->getRenderer().getProfiler().setEnabled(false);
+}
+
+void NodeLoadComponent::resized()
+{
+    const int buttonWidth = (getWidth()-20)/3;
+    enableButton.setBounds(5, 5, buttonWidth, 20);
+    resetButton.setBounds(buttonWidth+10, 5, buttonWidth, 20);
+    exportButton.setBounds(buttonWidth*2+15, 5, buttonWidth, 20);
+    table.setBounds(5, 30, getWidth()-10, getHeight()-35);
+}
+
+void NodeLoadComponent::buttonClicked (Button* button)
+{
+    NodeLoadProfiler& profiler = filterGraph->getRenderer().getProfiler();
+
+    if(button == &enableButton)
+    {
+        profiler.setEnabled(enableButton.getToggleState());
+        if(enableButton.getToggleState())
+            startTimer(500);
+        else
+            stopTimer();
+    }
+    else if(button == &resetButton)
+    {
+        profiler.reset();
+        updateRows();
+    }
+    else if(button == &exportButton)
+    {
+        FileChooser fc("Export DSP load", File::getSpecialLocation(File::userDocumentsDirectory), "*.csv", true);
+        if(fc.browseForFileToSave(true))
+            exportCSV(fc.getResult().withFileExtension(".csv"));
+    }
+}
+
+void NodeLoadComponent::timerCallback()
+{
+    updateRows();
+}
+
+//--------------------------------------------------------------------
+struct NodeLoadRowSorter
+{
+    NodeLoadRowSorter(int column, bool forwards) : columnId(column), direction(forwards ? 1 : -1) {}
+
+    template <typename Row>
+    int compareElements (const Row& first, const Row& second) const
+    {
+        return direction*compareRows(first, second);
+    }
+
+    template <typename Row>
+    int compareRows (const Row& first, const Row& second) const
+    {
+        switch(columnId)
+        {
+        case NodeLoadComponent::nameColumn:
+            return first.name.compareIgnoreCase(second.name);
+        case NodeLoadComponent::meanColumn:
+            return compareValues(first.stats.mean, second.stats.mean);
+        case NodeLoadComponent::p95Column:
+            return compareValues(first.stats.p95, second.stats.p95);
+        case NodeLoadComponent::p99Column:
+            return compareValues(first.stats.p99, second.stats.p99);
+        case NodeLoadComponent::maxColumn:
+            return compareValues(first.stats.max, second.stats.max);
+        default:
+            return compareValues((double)first.stats.numOverruns, (double)second.stats.numOverruns);
+        }
+    }
+
+    static int compareValues (double a, double b)
+    {
+        return a < b ? -1 : (a > b ? 1 : 0);
+    }
+
+    int columnId, direction;
+};
+
+void NodeLoadComponent::updateRows()
+{
+    rows.clear();
+    const Array<NodeLoadProfiler::Stats> stats = filterGraph->getRenderer().getProfiler().getAllStats();
+    for(int i=0; i<stats.size(); i++)
+    {
+        const AudioProcessorGraph::Node::Ptr node = filterGraph->getNodeForId(stats[i].nodeId);
+        if(node == nullptr)
+            continue;
+
+        Row row;
+        row.name = node->properties.getWithDefault("pluginName", node->getProcessor()->getName());
+        row.stats = stats[i];
+        rows.add(row);
+    }
+
+    NodeLoadRowSorter sorter(sortColumn, sortForwards);
+    rows.sort(sorter, true);
+    table.updateContent();
+    table.repaint();
+}
+
+int NodeLoadComponent::getNumRows()
+{
+    return rows.size();
+}
+
+void NodeLoadComponent::paintRowBackground (Graphics& g, int rowNumber, int /*width*/, int /*height*/, bool rowIsSelected)
+{
+    if(rowIsSelected)
+        g.fillAll(Colours::cornflowerblue.withAlpha(.3f));
+    else if(isPositiveAndBelow(rowNumber, rows.size()) && rows.getReference(rowNumber).stats.numOverruns>0)
+        g.fillAll(Colours::red.withAlpha(.2f));
+}
+
+//loads are shown as a percentage of the time a block lasts
+String NodeLoadComponent::getCellText (const Row& row, int columnId) const
+{
+    switch(columnId)
+    {
+    case nameColumn:
+        return row.name;
+    case meanColumn:
+        return String(row.stats.mean*100, 1);
+    case p95Column:
+        return String(row.stats.p95*100, 1);
+    case p99Column:
+        return String(row.stats.p99*100, 1);
+    case maxColumn:
+        return String(row.stats.max*100, 1);
+    default:
+        return String(row.stats.numOverruns);
+    }
+}
+
+void NodeLoadComponent::paintCell (Graphics& g, int rowNumber, int columnId, int width, int height, bool /*rowIsSelected*/)
+{
+    if(!isPositiveAndBelow(rowNumber, rows.size()))
+        return;
+
+    g.setColour(Colours::whitesmoke);
+    g.setFont(Font(12));
+    g.drawText(getCellText(rows.getReference(rowNumber), columnId), 2, 0, width-4, height,
+               columnId==nameColumn ? Justification::centredLeft : Justification::centredRight, true);
+}
+
+void NodeLoadComponent::sortOrderChanged (int newSortColumnId, bool isForwards)
+{
+    sortColumn = newSortColumnId;
+    sortForwards = isForwards;
+    updateRows();
+}
+
+void NodeLoadComponent::exportCSV (const File& file)
+{
+    updateRows();
+
+    String csv = "node,blocks,mean %,p50 %,p95 %,p99 %,max %,overruns\n";
+    for(int i=0; i<rows.size(); i++)
+    {
+        const NodeLoadProfiler::Stats& stats = rows.getReference(i).stats;
+        csv << "\"" << rows.getReference(i).name.replace("\"", "\"\"") << "\","
+            << stats.numBlocks << ","
+            << String(stats.mean*100, 3) << ","
+            << String(stats.p50*100, 3) << ","
+            << String(stats.p95*100, 3) << ","
+            << String(stats.p99*100, 3) << ","
+            << String(stats.max*100, 3) << ","
+            << stats.numOverruns << "\n";
+    }
+
+    if(!file.replaceWithText(csv))
+        cUtils::showMessage("Could not write "+file.getFullPathName());
+}
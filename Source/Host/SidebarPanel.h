@@ -27,7 +27,8 @@
 #define TRANSPORT_CONTROLS 0
 #define PLUGIN_PARAMS 1
 #define FILE_BROWSER 2
-#define WIDGET_PROPS 3
+#define DSP_LOAD 3
+#define WIDGET_PROPS 4
 
 
 #define BUTTON_SIZE 30
@@ -84,6 +85,53 @@ private:
     ScopedPointer<LookAndFeel_V2> standardLookAndFeel;
 };
 
+//==============================================================================
+// per node DSP load, sortable by any column
+//==============================================================================
+class NodeLoadComponent : public PropertyComponent,
+    public TableListBoxModel,
+    public Button::Listener,
+    private Timer
+{
+public:
+    NodeLoadComponent(FilterGraph* graph, String name);
+    ~NodeLoadComponent();
+
+    void resized();
+    void refresh() {}
+    void buttonClicked (Button* button);
+    void timerCallback();
+
+    int getNumRows();
+    void paintRowBackground (Graphics& g, int rowNumber, int width, int height, bool rowIsSelected);
+    void paintCell (Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected);
+    void sortOrderChanged (int newSortColumnId, bool isForwards);
+
+    void exportCSV (const File& file);
+
+    enum { nameColumn=1, meanColumn, p95Column, p99Column, maxColumn, overrunsColumn };
+
+private:
+
+    struct Row
+    {
+        String name;
+        NodeLoadProfiler::Stats stats;
+    };
+
+    void updateRows();
+    String getCellText (const Row& row, int columnId) const;
+
+    FilterGraph* filterGraph;
+    Array<Row> rows;
+    int sortColumn;
+    bool sortForwards;
+    TableListBox table;
+    TextButton enableButton, resetButton, exportButton;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NodeLoadComponent);
+};
+
 //==============================================================================
 // file browser comp
 //==============================================================================
@@ -183,6 +231,7 @@ private:
     void addPluginPanel (PropertyPanel* panel);
     bool canResize;
     bool midiLearn;
+    NodeLoadComponent nodeLoadComp;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SidebarPanel);
 };
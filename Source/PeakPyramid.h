@@ -0,0 +1,283 @@
+/*
+  Copyright (C) 2014 Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef PEAKPYRAMID_H
+#define PEAKPYRAMID_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+// min/max summary of a block of samples at power-of-two resolutions. Level 0
+// holds the peaks of every blockSize samples and each level above it halves
+// the number of blocks, so the peaks of any range can be found by visiting at
+// most two blocks per level. The sample data is not copied; the caller passes
+// it in again when building, updating or querying, and may pass nullptr to
+// query at block resolution only. Level 0 can also be filled a few blocks at
+// a time when the samples themselves are never held in memory.
+//==============================================================================
+class PeakPyramid
+{
+public:
+    enum { defaultBlockSize = 16 };
+
+    PeakPyramid (int samplesPerBlock = defaultBlockSize)
+        : blockSize(jmax(1, samplesPerBlock)), numSamples(0) {}
+    ~PeakPyramid() {}
+
+    void clear()
+    {
+        levels.clear();
+        numSamples = 0;
+    }
+
+    int getNumSamples() const
+    {
+        return numSamples;
+    }
+
+    int getBlockSize() const
+    {
+        return blockSize;
+    }
+
+    int getNumBlocks() const
+    {
+        return levels.size()>0 ? levels.getUnchecked(0)->size : 0;
+    }
+
+    //level 0 peaks, getNumBlocks() of each
+    const float* getBlockMinimums() const
+    {
+        return levels.size()>0 ? levels.getUnchecked(0)->mins.getData() : nullptr;
+    }
+
+    const float* getBlockMaximums() const
+    {
+        return levels.size()>0 ? levels.getUnchecked(0)->maxs.getData() : nullptr;
+    }
+
+    //size every level for newNumSamples samples, with all peaks at zero
+    void allocate (int newNumSamples)
+    {
+        clear();
+        numSamples = jmax(0, newNumSamples);
+
+        int size = (numSamples+blockSize-1)/blockSize;
+        while(size>0)
+        {
+            Level* level = levels.add(new Level());
+            level->mins.calloc(size);
+            level->maxs.calloc(size);
+            level->size = size;
+            size = (size>1 ? size/2 : 0);
+        }
+    }
+
+    //build every level from scratch
+    void build (const float* data, int newNumSamples)
+    {
+        allocate(newNumSamples);
+        if(data==nullptr || levels.size()==0)
+        {
+            clear();
+            return;
+        }
+
+        updateLevels(data, 0, levels[0]->size);
+    }
+
+    //write already reduced level 0 peaks, then the blocks above them
+    void setBlockPeaks (int firstBlock, int numBlocks, const float* mins, const float* maxs)
+    {
+        if(levels.size()==0)
+            return;
+
+        Level& base = *levels.getUnchecked(0);
+        firstBlock = jlimit(0, base.size, firstBlock);
+        numBlocks = jmin(numBlocks, base.size-firstBlock);
+        if(numBlocks<=0)
+            return;
+
+        memcpy(base.mins+firstBlock, mins, numBlocks*sizeof(float));
+        memcpy(base.maxs+firstBlock, maxs, numBlocks*sizeof(float));
+        updateUpperLevels(firstBlock, firstBlock+numBlocks);
+    }
+
+    //recompute the blocks that cover [startSample, endSample) after the caller
+    //has changed that region of the data. A change of length needs a rebuild.
+    void update (const float* data, int newNumSamples, int startSample, int endSample)
+    {
+        if(newNumSamples!=numSamples || levels.size()==0)
+        {
+            build(data, newNumSamples);
+            return;
+        }
+
+        startSample = jlimit(0, numSamples, startSample);
+        endSample = jlimit(startSample, numSamples, endSample);
+        if(data!=nullptr && startSample<endSample)
+            updateLevels(data, startSample/blockSize, (endSample-1)/blockSize+1);
+    }
+
+    //peaks of the samples in [startSample, endSample)
+    Range<float> getMinMax (const float* data, int startSample, int endSample) const
+    {
+        startSample = jmax(0, startSample);
+        endSample = jmin(numSamples, endSample);
+        if(startSample>=endSample || levels.size()==0)
+            return Range<float>();
+
+        float low = std::numeric_limits<float>::max();
+        float high = -std::numeric_limits<float>::max();
+
+        int first = startSample/blockSize;
+        int last = endSample/blockSize;
+
+        if(data!=nullptr)
+        {
+            //partial blocks at either end are read from the raw data
+            if(first==last || startSample%blockSize!=0)
+            {
+                const int headEnd = jmin(endSample, (first+1)*blockSize);
+                include(low, high, FloatVectorOperations::findMinAndMax(data+startSample, headEnd-startSample));
+                first++;
+            }
+
+            if(last>=first && endSample%blockSize!=0)
+            {
+                const int tailStart = jmax(startSample, last*blockSize);
+                include(low, high, FloatVectorOperations::findMinAndMax(data+tailStart, endSample-tailStart));
+            }
+        }
+        else
+        {
+            //without the data, round outwards to whole blocks
+            last = (endSample+blockSize-1)/blockSize;
+        }
+
+        //walk up the levels taking the odd blocks at either end of the range
+        for(int i=0; i<levels.size() && first<last; i++)
+        {
+            const Level& level = *levels.getUnchecked(i);
+            if(first & 1)
+            {
+                include(low, high, level.mins[first], level.maxs[first]);
+                first++;
+            }
+            if(last & 1)
+            {
+                last--;
+                include(low, high, level.mins[last], level.maxs[last]);
+            }
+            first >>= 1;
+            last >>= 1;
+        }
+
+        return Range<float>(low, high);
+    }
+
+    //fill mins and maxs with the peaks of numPixels consecutive spans of
+    //samplesPerPixel samples, starting at startSample. The cost depends on the
+    //number of pixels rather than the number of samples.
+    void getPeaks (const float* data, double startSample, double samplesPerPixel,
+                   int numPixels, float* mins, float* maxs) const
+    {
+        for(int i=0; i<numPixels; i++)
+        {
+            const int start = (int)std::floor(startSample+i*samplesPerPixel);
+            const int end = jmax(start+1, (int)std::floor(startSample+(i+1)*samplesPerPixel));
+            const Range<float> peaks = getMinMax(data, start, end);
+            mins[i] = peaks.getStart();
+            maxs[i] = peaks.getEnd();
+        }
+    }
+
+    //the smallest range [start, end) outside which the two arrays are equal.
+    //Arrays of different lengths are treated as entirely changed.
+    static Range<int> findChangedRegion (const float* oldData, int oldNumSamples,
+                                         const float* newData, int newNumSamples)
+    {
+        if(oldNumSamples!=newNumSamples)
+            return Range<int>(0, newNumSamples);
+
+        int start = 0, end = newNumSamples;
+        while(start<end && oldData[start]==newData[start])
+            start++;
+        while(end>start && oldData[end-1]==newData[end-1])
+            end--;
+        return Range<int>(start, end);
+    }
+
+private:
+    struct Level
+    {
+        HeapBlock<float> mins, maxs;
+        int size;
+    };
+
+    static void include (float& low, float& high, Range<float> peaks)
+    {
+        include(low, high, peaks.getStart(), peaks.getEnd());
+    }
+
+    static void include (float& low, float& high, float min, float max)
+    {
+        low = jmin(low, min);
+        high = jmax(high, max);
+    }
+
+    //recompute level 0 blocks [first, last) from the data, then the blocks
+    //above them on every other level
+    void updateLevels (const float* data, int first, int last)
+    {
+        Level& base = *levels.getUnchecked(0);
+        for(int i=first; i<last; i++)
+        {
+            const int start = i*blockSize;
+            const Range<float> peaks = FloatVectorOperations::findMinAndMax(data+start, jmin(blockSize, numSamples-start));
+            base.mins[i] = peaks.getStart();
+            base.maxs[i] = peaks.getEnd();
+        }
+
+        updateUpperLevels(first, last);
+    }
+
+    void updateUpperLevels (int first, int last)
+    {
+        for(int l=1; l<levels.size(); l++)
+        {
+            const Level& below = *levels.getUnchecked(l-1);
+            Level& level = *levels.getUnchecked(l);
+            first /= 2;
+            last = jmin(level.size, (last+1)/2);
+            for(int i=first; i<last; i++)
+            {
+                level.mins[i] = jmin(below.mins[i*2], below.mins[i*2+1]);
+                level.maxs[i] = jmax(below.maxs[i*2], below.maxs[i*2+1]);
+            }
+        }
+    }
+
+    OwnedArray<Level> levels;
+    int blockSize, numSamples;
+
+    JUCE_DECLARE_NON_COPYABLE (PeakPyramid)
+};
+
+#endif // PEAKPYRAMID_H
@@ -152,12 +152,14 @@ CabbagePluginAudioProcessorEditor::CabbagePluginAudioProcessorEditor (CabbagePlu
     {
         if(getFilter()->getWidgetTypes()[i]=="layout")
         {
-            InsertGUIControls(getFilter()->getGUILayoutCtrls(layoutCtrlIndex));
+            if(!deferHiddenPlantWidget(true, layoutCtrlIndex))
+                InsertGUIControls(getFilter()->getGUILayoutCtrls(layoutCtrlIndex));
             layoutCtrlIndex++;
         }
         else //interactive
         {
-            InsertGUIControls(getFilter()->getGUICtrls(interactiveCtrlIndex));
+            if(!deferHiddenPlantWidget(false, interactiveCtrlIndex))
+                InsertGUIControls(getFilter()->getGUICtrls(interactiveCtrlIndex));
             interactiveCtrlIndex++;
         }
     }
@@ -387,6 +389,99 @@ void CabbagePluginAudioProcessorEditor::InsertGUIControls(CabbageGUIClass cAttr)
 }
 
 
+//==============================================================================
+// widgets in a plant that is hidden when the editor opens, either a popup plant
+// or one with visible(0), get an empty slot in comps or layoutComps so that the
+// other widgets keep their indexes. Their values stay in the processor's widget
+// model until the plant is shown and they are created.
+//==============================================================================
+bool CabbagePluginAudioProcessorEditor::deferHiddenPlantWidget(bool isLayout, int index)
+{
+    CabbageGUIClass& cAttr = isLayout ? getFilter()->getGUILayoutCtrls(index) : getFilter()->getGUICtrls(index);
+    const String type(cAttr.getStringProp(CabbageIDs::type));
+    const String plant(cAttr.getStringProp("plant"));
+    const String reltoplant(cAttr.getStringProp("reltoplant"));
+
+    //the types InsertGUIControls() creates a single component for. xypads are
+    //left out as they share automation objects with the processor
+    static StringArray deferrableTypes = StringArray::fromTokens("groupbox image keyboard label popupmenu csoundoutput "
+                                         "snapshot gentable infobutton sourcebutton filebutton recordbutton textbox transport "
+                                         "soundfiler numberbox directorylist multitab line table hslider vslider rslider "
+                                         "button checkbox combobox texteditor", false);
+
+    if(reltoplant.isNotEmpty() && hiddenPlants.contains(reltoplant) && deferrableTypes.contains(type))
+    {
+        //plants within a hidden plant are shown along with it
+        if(plant.isNotEmpty())
+            hiddenPlants.set(plant, hiddenPlants[reltoplant]);
+
+        OwnedArray<Component>& widgets = isLayout ? layoutComps : comps;
+        DeferredWidget deferred = { isLayout, index, widgets.size(), hiddenPlants[reltoplant] };
+        deferredWidgets.add(deferred);
+        widgets.add(nullptr);
+        return true;
+    }
+
+    if(plant.isNotEmpty()
+            && (cAttr.getNumProp(CabbageIDs::popup)==1 || cAttr.getNumProp(CabbageIDs::visible)==0))
+        hiddenPlants.set(plant, plant);
+    return false;
+}
+
+//==============================================================================
+// creates the widgets of a hidden plant and any plants inside it. Everything
+// from the first missing widget on is taken off the end of the array and added
+// back in order, so each new widget is created at the index it was given.
+//==============================================================================
+void CabbagePluginAudioProcessorEditor::createHiddenPlantWidgets(const String& plantName)
+{
+    if(!hiddenPlants.contains(plantName) || hiddenPlants[plantName]!=plantName)
+        return;
+
+    //layout widgets go first, so plants are there before anything inside them
+    for(int pass=0; pass<2; pass++)
+    {
+        const bool isLayout = (pass==0);
+        OwnedArray<Component>& widgets = isLayout ? layoutComps : comps;
+
+        Array<int> toCreate;
+        for(int i=0; i<deferredWidgets.size(); i++)
+            if(deferredWidgets.getReference(i).isLayout==isLayout && deferredWidgets.getReference(i).hiddenPlant==plantName)
+                toCreate.add(i);
+
+        if(toCreate.size()==0)
+            continue;
+
+        Array<Component*> tail;
+        const int firstSlot = deferredWidgets.getReference(toCreate[0]).slot;
+        while(widgets.size()>firstSlot)
+            tail.add(widgets.removeAndReturn(widgets.size()-1));
+
+        for(int t=tail.size()-1, next=0; t>=0; t--)
+        {
+            const DeferredWidget* deferred = next<toCreate.size() ? &deferredWidgets.getReference(toCreate[next]) : nullptr;
+            if(deferred!=nullptr && deferred->slot==widgets.size())
+            {
+                InsertGUIControls(isLayout ? getFilter()->getGUILayoutCtrls(deferred->index) : getFilter()->getGUICtrls(deferred->index));
+                jassert(widgets.size()==deferred->slot+1);
+                next++;
+            }
+            else
+                widgets.add(tail[t]);
+        }
+
+        for(int i=toCreate.size()-1; i>=0; i--)
+            deferredWidgets.remove(toCreate[i]);
+    }
+
+    Array<String> shownPlants;
+    for(HashMap<String, String>::Iterator i(hiddenPlants); i.next();)
+        if(i.getValue()==plantName)
+            shownPlants.add(i.getKey());
+    for(int i=0; i<shownPlants.size(); i++)
+        hiddenPlants.remove(shownPlants[i]);
+}
+
 //===========================================================================
 //WHEN IN GUI EDITOR MODE THIS CALLBACK WILL NOTIFIY THE HOST OF EVENTS
 //IT CAN ALSO BE CALLED BY OTHER GUI WIDGETS WHEN THEIR STATE CHNANGES
@@ -958,6 +1053,27 @@ void CabbagePluginAudioProcessorEditor::breakUpPlant()
 void CabbagePluginAudioProcessorEditor::populateLineNumberArray(StringArray csdArray)
 {
 #if defined(Cabbage_Build_Standalone) || defined(CABBAGE_HOST)
+    lineNumbers.clear();
+
+    //the selected widgets know which lines they were created from, so only
+    //those lines need checking
+    const int numSelected = layoutEditor->selectedCompsOrigCoordinates.size();
+    bool linesAreKnown = layoutEditor->selectedLineNumbers.size()==numSelected;
+    for(int y=0; y<numSelected && linesAreKnown; y++)
+    {
+        const int line = layoutEditor->selectedLineNumbers[y];
+        linesAreKnown = isPositiveAndBelow(line, csdArray.size())
+                        && CabbageGUIClass(csdArray[line], -99).getComponentBounds()==layoutEditor->selectedCompsOrigCoordinates[y];
+        lineNumbers.addIfNotAlreadyThere(line);
+    }
+
+    if(linesAreKnown)
+    {
+        DefaultElementComparator<int> sorter;
+        lineNumbers.sort(sorter);
+        return;
+    }
+
     lineNumbers.clear();
     for(int i=0; i<csdArray.size(); i++)
     {
@@ -1127,7 +1243,7 @@ void CabbagePluginAudioProcessorEditor::deleteComponents()
         {
             //first remove component from interactive comps vector..
             for(int y=0; y<comps.size(); y++)
-                if(cAttr.getBounds()==comps[y]->getBounds())
+                if(comps[y]!=nullptr && cAttr.getBounds()==comps[y]->getBounds())
                     comps.remove(y);
 
             //then remove abstract instance of GUI components
@@ -1140,7 +1256,7 @@ void CabbagePluginAudioProcessorEditor::deleteComponents()
         {
             //now remove component from layout comps vector..
             for(int y=0; y<layoutComps.size(); y++)
-                if(cAttr.getBounds()==layoutComps[y]->getBounds())
+                if(layoutComps[y]!=nullptr && cAttr.getBounds()==layoutComps[y]->getBounds())
                     layoutComps.remove(y);
 
             //then remove abstract instance of GUI components
@@ -1315,10 +1431,19 @@ void CabbagePluginAudioProcessorEditor::updateSizesAndPositionsOfComponents(int
         boundsForSelectComps.add(getBoundsString(le->selectedCompsNewCoordinates[y]));
     }
 
+    //only the lines that were moved are patched in the editor, and the widgets
+    //that were moved are updated in place rather than the GUI being rebuilt
+    Array<int> changedLines;
+    Array<juce::Rectangle<int> > changedBounds;
+
     //Logger::writeToLog(String(lineNumbers.size()));
     for(int i=0; i<lineNumbers.size(); i++)
     {
+        if(!isPositiveAndBelow(lineNumbers[i], csdArray.size()))
+            continue;
         csdArray.set(lineNumbers[i], replaceIdentifier(csdArray[lineNumbers[i]], "bounds", boundsForSelectComps[i]));
+        changedLines.add(lineNumbers[i]);
+        changedBounds.add(le->selectedCompsNewCoordinates[i]);
         currentLineNumber = lineNumbers[0];
     }
 
@@ -1341,6 +1466,8 @@ void CabbagePluginAudioProcessorEditor::updateSizesAndPositionsOfComponents(int
             cUtils::debug( getBoundsString(componentPanel->childBounds[y]));
             temp = replaceIdentifier(csdArray[currentLineNumber+y+off], "bounds", getBoundsString(componentPanel->childBounds[y-1]));
             csdArray.set(currentLineNumber+y+off, temp);
+            changedLines.add(currentLineNumber+y+off);
+            changedBounds.add(componentPanel->childBounds[y-1]);
             //add last curly brace
             endLine = currentLineNumber+y+off;
             tempPlantText = tempPlantText+temp+"\n";
@@ -1357,7 +1484,9 @@ void CabbagePluginAudioProcessorEditor::updateSizesAndPositionsOfComponents(int
     propsWindow->setVisible(true);
     propsWindow->toFront(true);
 #endif
-    getFilter()->updateCsoundFile(csdArray.joinIntoString("\n"));
+    for(int i=0; i<changedLines.size(); i++)
+        getFilter()->updateCsoundFileLine(changedLines[i], csdArray[changedLines[i]]);
+    getFilter()->updateWidgetBounds(changedLines, changedBounds);
     getFilter()->highlightLine(csdArray[currentLineNumber+newLine]);
     //getFilter()->setGuiEnabled(true);
     //getFilter()->setCurrentLineText(csdArray[currentLineNumber+newLine]);
@@ -1654,7 +1783,7 @@ void CabbagePluginAudioProcessorEditor::setPositionOfComponent(float left, float
         for(int y=0; y<layoutComps.size(); y++)
             if(reltoplant.isNotEmpty())
             {
-                if(layoutComps[y]->getProperties().getWithDefault(String("plant"), -99).toString().equalsIgnoreCase(reltoplant))
+                if(layoutComps[y]!=nullptr && layoutComps[y]->getProperties().getWithDefault(String("plant"), -99).toString().equalsIgnoreCase(reltoplant))
                 {
                     positionComponentWithinPlant(type, left, top, width, height, layoutComps[y], comp);
                 }
@@ -1774,7 +1903,7 @@ void CabbagePluginAudioProcessorEditor::insertComponentsFromCabbageText(StringAr
     getFilter()->updateCsoundFile(csdArray.joinIntoString("\n"));
     getFilter()->highlightLine(currentText);
     //currentLineNumber = getFilter()->getCurrentLine();
-    getFilter()->createGUI(text.joinIntoString("\n"), false);
+    getFilter()->createGUI(text.joinIntoString("\n"), false, currentLineNumber);
     CabbageGUIClass cAttr(currentText, -99);
     sendActionMessage(currentText);
     propsWindow->updateProps(cAttr);
@@ -1857,7 +1986,7 @@ void CabbagePluginAudioProcessorEditor::InsertGroupBox(CabbageGUIClass &cAttr)
         for(int y=0; y<layoutComps.size(); y++)
             if(cAttr.getStringProp("reltoplant").length()>0)
             {
-                if(layoutComps[y]->getProperties().getWithDefault(String("plant"), -99).toString().equalsIgnoreCase(cAttr.getStringProp("reltoplant")))
+                if(layoutComps[y]!=nullptr && layoutComps[y]->getProperties().getWithDefault(String("plant"), -99).toString().equalsIgnoreCase(cAttr.getStringProp("reltoplant")))
                 {
                     positionComponentWithinPlant("", left, top, width, height, layoutComps[idx], layoutComps[idx]);
                 }
@@ -1957,7 +2086,7 @@ void CabbagePluginAudioProcessorEditor::InsertImage(CabbageGUIClass &cAttr)
         for(int y=0; y<layoutComps.size(); y++)
             if(cAttr.getStringProp("reltoplant").length()>0)
             {
-                if(layoutComps[y]->getProperties().getWithDefault(String("plant"), -99).toString().equalsIgnoreCase(cAttr.getStringProp("reltoplant")))
+                if(layoutComps[y]!=nullptr && layoutComps[y]->getProperties().getWithDefault(String("plant"), -99).toString().equalsIgnoreCase(cAttr.getStringProp("reltoplant")))
                 {
                     positionComponentWithinPlant("", left, top, width, height, layoutComps[y], layoutComps[idx]);
                 }
@@ -2634,10 +2763,11 @@ void CabbagePluginAudioProcessorEditor::InsertSlider(CabbageGUIClass &cAttr)
                         cAttr.getStringProp(CabbageIDs::svgpath) :
                         globalSVGPath));
 
-
     comps.add(new CabbageSlider(cAttr));
 
     int idx = comps.size()-1;
+    //filmstrips are given relative to the .csd file
+    static_cast<CabbageSlider*>(comps[idx])->setBaseDirectory(getFilter()->getCsoundInputFile().getParentDirectory().getFullPathName());
     if(!cAttr.getStringProp(CabbageIDs::name).contains("dummy"))
     {
         setPositionOfComponent(left, top, width, height, comps[idx], cAttr.getStringProp("reltoplant"));
@@ -3412,7 +3542,7 @@ void CabbagePluginAudioProcessorEditor::InsertXYPad(CabbageGUIClass &cAttr)
             for(int y=0; y<layoutComps.size(); y++)
                 if(cAttr.getStringProp("reltoplant").length()>0)
                 {
-                    if(layoutComps[y]->getProperties().getWithDefault(String("plant"), -99).toString().equalsIgnoreCase(cAttr.getStringProp("reltoplant")))
+                    if(layoutComps[y]!=nullptr && layoutComps[y]->getProperties().getWithDefault(String("plant"), -99).toString().equalsIgnoreCase(cAttr.getStringProp("reltoplant")))
                     {
                         positionComponentWithinPlant("", left, top, width, height, layoutComps[y], comps[idx]);
                     }
@@ -3616,10 +3746,9 @@ void CabbagePluginAudioProcessorEditor::updateSize()
             {
                 String newSize = "size("+String(getWidth())+", "+String(getHeight())+")";
                 //Logger::writeToLog(newSize);
-                csdArray.set(i, replaceIdentifier(csdArray[i], "size(", newSize));
+                getFilter()->updateCsoundFileLine(i, replaceIdentifier(csdArray[i], "size(", newSize));
             }
         }
-        getFilter()->updateCsoundFile(csdArray.joinIntoString("\n"));
         getFilter()->sendActionMessage("GUI Updated, controls added, resized");
     }
 #endif
@@ -3766,17 +3895,12 @@ void CabbagePluginAudioProcessorEditor::updateGUIControls()
     if(!getFilter()->isGuiEnabled())
     {
 
-        for(int y=0; y<getFilter()->getXYAutomaterSize(); y++)
-        {
-            if(getFilter()->getXYAutomater(y))
-                getFilter()->getXYAutomater(y)->update();
-        }
-
 //don't check the whole vector here, only ones that have been updated
         for(int index=0; index<getFilter()->dirtyControls.size(); index++)
         {
             int i = getFilter()->dirtyControls[index];
-            if(i<getFilter()->getGUICtrlsSize())
+            //widgets in hidden plants may not have been created yet
+            if(i<getFilter()->getGUICtrlsSize() && comps[i]!=nullptr)
             {
                 inValue = getFilter()->getParameter(i);
                 if(getFilter()->getGUICtrls(i).getStringProp(CabbageIDs::type).contains("slider")||
@@ -3901,7 +4025,7 @@ void CabbagePluginAudioProcessorEditor::updateGUIControls()
         for(int index=0; index<(int)getFilter()->dirtyControls.size(); index++)
         {
             int i = getFilter()->dirtyControls[index];
-            if(i<getFilter()->getGUICtrlsSize())
+            if(i<getFilter()->getGUICtrlsSize() && comps[i]!=nullptr)
             {
                 if(getFilter()->getGUICtrls(i).getStringProp(CabbageIDs::identchannelmessage).isNotEmpty())
                 {
@@ -3962,6 +4086,14 @@ void CabbagePluginAudioProcessorEditor::updateGUIControls()
 //for example, table objects don't get listed by the host as a paramters. Likewise the csoundoutput widget..
         for(int i=0; i<getFilter()->getGUILayoutCtrlsSize(); i++)
         {
+            if(layoutComps[i]==nullptr)
+                continue;
+
+            //a hidden plant's widgets are created just before it's shown
+            const String identChannelMessage(getFilter()->getGUILayoutCtrls(i).getStringProp(CabbageIDs::identchannelmessage));
+            if(identChannelMessage.contains("show(1)") || identChannelMessage.contains("visible(1)"))
+                createHiddenPlantWidgets(getFilter()->getGUILayoutCtrls(i).getStringProp("plant"));
+
             //csoundoutput
             if(getFilter()->getGUILayoutCtrls(i).getStringProp(CabbageIDs::type).containsIgnoreCase("csoundoutput"))
             {
@@ -132,6 +132,18 @@ public:
     void resized();
     void setEditMode(bool on);
     void InsertGUIControls(CabbageGUIClass cAttr);
+    //widgets in plants that are hidden when the editor opens are only created
+    //once the plant is shown
+    bool deferHiddenPlantWidget(bool isLayout, int index);
+    void createHiddenPlantWidgets(const String& plantName);
+    struct DeferredWidget
+    {
+        bool isLayout;
+        int index, slot;
+        String hiddenPlant;
+    };
+    Array<DeferredWidget> deferredWidgets;
+    HashMap<String, String> hiddenPlants;
     void ksmpsYieldCallback();
     void updateSize();
     ScopedPointer<CabbagePropertiesDialog> propsWindow;
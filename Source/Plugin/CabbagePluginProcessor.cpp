@@ -88,7 +88,11 @@ CabbagePluginAudioProcessor::CabbagePluginAudioProcessor(String inputfile, bool
      firstTime(true),
      isMuted(false),
      isBypassed(false),
-     vuCounter(0)
+     vuCounter(0),
+     sleepTailSeconds(0),
+     sleepThreshold(0),
+     silentSamples(0),
+     isSleeping(false)
 {
     //suspendProcessing(true);
     codeEditor = nullptr;
@@ -113,7 +117,7 @@ CabbagePluginAudioProcessor::CabbagePluginAudioProcessor(String inputfile, bool
                 String logFileName = File(inputfile).getParentDirectory().getFullPathName()+String("/")+File(inputfile).getFileNameWithoutExtension()+String("_Log.txt");
                 logFile = File(logFileName);
                 fileLogger = new FileLogger(logFile, String("Cabbage Log.."));
-                Logger::setCurrentLogger(fileLogger);
+                installFileLogger();
             }
         }
 
@@ -170,7 +174,7 @@ CabbagePluginAudioProcessor::CabbagePluginAudioProcessor(String inputfile, bool
         csound->SetOption((char*)"-n");
         csound->SetOption((char*)"-d");
 
-        Rectangle<int> rect(Desktop::getInstance().getDisplays().getMainDisplay().userArea);
+        Rectangle<int> rect(getScreenArea());
         String screenWidth = "--omacro:SCREEN_WIDTH=\""+String(rect.getWidth())+"\"";
         csound->SetOption(screenWidth.toUTF8().getAddress());
         String screenHeight = "--omacro:SCREEN_HEIGHT=\""+String(rect.getHeight()-30)+"\"";
@@ -323,7 +327,11 @@ CabbagePluginAudioProcessor::CabbagePluginAudioProcessor(String sourcefile):
     firstTime(false),
     isMuted(false),
     isBypassed(false),
-    vuCounter(0)
+    vuCounter(0),
+    sleepTailSeconds(0),
+    sleepThreshold(0),
+    silentSamples(0),
+    isSleeping(false)
 {
 
     //If a sourcefile is not given, Cabbage plugins always try to load a csd file with the same name as the plugin library.
@@ -423,7 +431,7 @@ CabbagePluginAudioProcessor::CabbagePluginAudioProcessor(String sourcefile):
                 String logFileName = csdFile.getParentDirectory().getFullPathName()+String("/")+csdFile.getFileNameWithoutExtension()+String("_Log.txt");
                 logFile = File(logFileName);
                 fileLogger = new FileLogger(logFile, String("Cabbage Log.."));
-                Logger::setCurrentLogger(fileLogger);
+                installFileLogger();
             }
         }
 
@@ -476,7 +484,7 @@ CabbagePluginAudioProcessor::CabbagePluginAudioProcessor(String sourcefile):
     csound->SetOption((char*)"-d");
     csound->SetOption((char*)"--omacro:IS_A_PLUGIN=\"1\"");
 
-	Rectangle<int> rect(Desktop::getInstance().getDisplays().getMainDisplay().userArea);
+	Rectangle<int> rect(getScreenArea());
 	String screenWidth = "--omacro:SCREEN_WIDTH=\""+String(rect.getWidth())+"\"";
 	//cUtils::showMessage(screenWidth);
 	csound->SetOption(screenWidth.toUTF8().getAddress());
@@ -571,7 +579,9 @@ CabbagePluginAudioProcessor::~CabbagePluginAudioProcessor()
 
     deleteAndZero(lookAndFeel);
     deleteAndZero(lookAndFeelBasic);
-    Logger::setCurrentLogger (nullptr);
+    //another processor's logger may have been installed since this one's
+    if(Logger::getCurrentLogger()==fileLogger)
+        Logger::setCurrentLogger (nullptr);
     stopProcessing = true;
     removeAllChangeListeners();
 
@@ -632,6 +642,43 @@ void CabbagePluginAudioProcessor::addMacros(String csdText)
     }
 }
 
+//============================================================================
+//SCREEN SIZE FOR THE SCREEN_WIDTH AND SCREEN_HEIGHT MACROS
+//============================================================================
+//the desktop is only asked on the message thread, and never when running
+//headless as there may be no display at all. Otherwise the last size seen
+//is used, or 1024x768 if there hasn't been one.
+static bool runningHeadless = false;
+static Atomic<int> lastScreenWidth(1024), lastScreenHeight(768);
+
+void CabbagePluginAudioProcessor::setRunningHeadless(bool headless)
+{
+    runningHeadless = headless;
+}
+
+Rectangle<int> CabbagePluginAudioProcessor::getScreenArea()
+{
+    const MessageManager* messageManager = MessageManager::getInstanceWithoutCreating();
+    if(!runningHeadless && messageManager!=nullptr && messageManager->isThisTheMessageThread())
+    {
+        const Rectangle<int> area(Desktop::getInstance().getDisplays().getMainDisplay().userArea);
+        lastScreenWidth = area.getWidth();
+        lastScreenHeight = area.getHeight();
+    }
+    return Rectangle<int>(lastScreenWidth.get(), lastScreenHeight.get());
+}
+
+//============================================================================
+//the logger is global, so it's only changed on the message thread. A processor
+//built on another thread has this called again once it's put to use.
+//============================================================================
+void CabbagePluginAudioProcessor::installFileLogger()
+{
+    const MessageManager* messageManager = MessageManager::getInstanceWithoutCreating();
+    if(fileLogger!=nullptr && messageManager!=nullptr && messageManager->isThisTheMessageThread())
+        Logger::setCurrentLogger(fileLogger);
+}
+
 void CabbagePluginAudioProcessor::initAllChannels()
 {
     //init all channels with their init val, and set parameters
@@ -682,6 +729,8 @@ int CabbagePluginAudioProcessor::reCompileCsound(File file)
     csound->Reset();
     ksmpsOffset = 0;
     breakCount = 0;
+    silentSamples = 0;
+    isSleeping = false;
 
     csound->SetHostImplementedMIDIIO(true);
     csound->SetHostData(this);
@@ -706,7 +755,7 @@ int CabbagePluginAudioProcessor::reCompileCsound(File file)
     csound->SetOption((char*)"-n");
     csound->SetOption((char*)"-d");
 
-    Rectangle<int> rect(Desktop::getInstance().getDisplays().getMainDisplay().userArea);
+    Rectangle<int> rect(getScreenArea());
     String screenWidth = "--omacro:SCREEN_WIDTH=\""+String(rect.getWidth())+"\"";
     csound->SetOption(screenWidth.toUTF8().getAddress());
     String screenHeight = "--omacro:SCREEN_HEIGHT=\""+String(rect.getHeight())+"\"";
@@ -832,7 +881,7 @@ int CabbagePluginAudioProcessor::reCompileCsound(File file)
 // EDITOR FROM INFORMATION HELD IN THE GUICONTROLS VECTOR
 //===========================================================
 //maybe this should only be done at the end of a k-rate cycle..
-void CabbagePluginAudioProcessor::createGUI(String source, bool refresh)
+void CabbagePluginAudioProcessor::createGUI(String source, bool refresh, int firstSourceLine)
 {
     //clear arrays if refresh is set
     if(refresh==true)
@@ -846,6 +895,8 @@ void CabbagePluginAudioProcessor::createGUI(String source, bool refresh)
             editor->layoutComps.clear();
             editor->subPatches.clear();
             editor->popupMenus.clear();
+            editor->deferredWidgets.clear();
+            editor->hiddenPlants.clear();
         }
     }
 
@@ -879,6 +930,11 @@ void CabbagePluginAudioProcessor::createGUI(String source, bool refresh)
     csdText.removeRange(0, lineWhichCabbageSectionStarts);
     csdText.removeRange(lineWhichCabbageSectionEnds+1, 99999);
 
+    //the csd line that each entry in csdText starts on
+    Array<int> sourceLines;
+    for(int i=0; i<csdText.size(); i++)
+        sourceLines.add(firstSourceLine+lineWhichCabbageSectionStarts+i);
+
     //cUtils::debug(csdText.size());
 
     for(int i=0; i<csdText.size(); i++)
@@ -889,6 +945,7 @@ void CabbagePluginAudioProcessor::createGUI(String source, bool refresh)
         {
             temp = csdText[i+1];
             csdText.remove(i+1);
+            sourceLines.remove(i+1);
             csdText.set(i, csdText[i].replace(" \\", " ")+temp);
             //cUtils::debug(csdText[i]);
         }
@@ -898,31 +955,13 @@ void CabbagePluginAudioProcessor::createGUI(String source, bool refresh)
     {
 
         int csdLineNumber=0;
-#if (defined(Cabbage_Build_Standalone) || defined(CABBAGE_HOST)) && !defined(AndroidBuild)
-        if(!refresh)
-        {
-            StringArray fullText;
-            if(codeEditor)
-                fullText.addLines(codeEditor->getAllText());
-            else
-                fullText.addLines(csdFile.loadFileAsString());
-            for(int u=0; u<fullText.size(); u++)
-                if(csdText[i].equalsIgnoreCase(fullText[u]))
-                {
-                    csdLineNumber = u;
-                    //Logger::writeToLog("LineNumber:"+String(csdLineNumber)+"\n"+csdText[i]);
-                    u=fullText.size();
-                }
-        }
-#endif
 
         if(csdText[i].indexOfWholeWordIgnoreCase(String("</Cabbage>"))==-1)
         {
             if(csdText[i].trim().isNotEmpty())
             {
                 csdLine = csdText[i];
-                if(refresh)
-                    csdLineNumber = i;
+                csdLineNumber = sourceLines[i];
                 //tidy up string
                 csdLine = csdLine.trimStart();
                 //csdLine = csdLine.removeCharacters(" \\");
@@ -1031,6 +1070,12 @@ void CabbagePluginAudioProcessor::createGUI(String source, bool refresh)
 
                         if(cAttr.getNumProp(CabbageIDs::guirefresh)>1)
                             guiRefreshRate = cAttr.getNumProp(CabbageIDs::guirefresh);
+
+                        if(cAttr.getStringProp(CabbageIDs::type)=="form")
+                        {
+                            sleepTailSeconds = jmax(0.f, cAttr.getNumProp(CabbageIDs::sleep));
+                            sleepThreshold = Decibels::decibelsToGain(cAttr.getNumProp(CabbageIDs::sleepthreshold));
+                        }
                         //showMessage(cAttr.getStringProp("type"));
 
 
@@ -1200,7 +1245,6 @@ void CabbagePluginAudioProcessor::createGUI(String source, bool refresh)
                             widgetTypes.add("interactive");
                             //widgetTypes.add("interactive");
                             guiID++;
-                            startTimer(10);
                         }
                         else
                         {
@@ -1259,6 +1303,8 @@ void CabbagePluginAudioProcessor::createGUI(String source, bool refresh)
         {
             editor->comps.clear();
             editor->layoutComps.clear();
+            editor->deferredWidgets.clear();
+            editor->hiddenPlants.clear();
             editor->repaint();
             //((CabbagePluginAudioProcessorEditor*)getActiveEditor())->setEditMode(false);
             //editor->setEditMode(false);
@@ -1762,30 +1808,34 @@ void CabbagePluginAudioProcessor::changeListenerCallback(ChangeBroadcaster *sour
     XYPadAutomation* xyPad = dynamic_cast< XYPadAutomation*>(source);
     if(xyPad)
     {
-#ifdef Cabbage_Build_Standalone
-        setParameterNotifyingHost(xyPad->paramIndex, xyPad->getXValue());
-        setParameterNotifyingHost(xyPad->paramIndex+1, xyPad->getYValue());
-        sendChangeMessage();
-#else
-        if(xyPad->getMinimumXValue()>=0)
-            xVal = (xyPad->getXValue()/xyPad->getXRange())+(fabs(xyPad->getMinimumXValue())/xyPad->getXRange());
-        else
-            xVal = (xyPad->getXValue()/xyPad->getXRange())-(fabs(xyPad->getMinimumXValue())/xyPad->getXRange());
-
-        if(xyPad->getMinimumYValue()<=0)
-            yVal = (xyPad->getYValue()/xyPad->getYRange())+(fabs(xyPad->getMinimumYValue())/xyPad->getYRange());
-        else
-            yVal = (xyPad->getYValue()/xyPad->getYRange())-(fabs(xyPad->getMinimumYValue())/xyPad->getYRange());
-
+        getXYPadParameterValues(*xyPad, xVal, yVal);
         setParameterNotifyingHost(xyPad->paramIndex, xVal);
         setParameterNotifyingHost(xyPad->paramIndex+1, yVal);
         sendChangeMessage();
-#endif
     }
 
 
 }
 
+//the xypad's position as the values of its two parameters
+void CabbagePluginAudioProcessor::getXYPadParameterValues(XYPadAutomation& xyPad, float& xVal, float& yVal)
+{
+#ifdef Cabbage_Build_Standalone
+    xVal = xyPad.getXValue();
+    yVal = xyPad.getYValue();
+#else
+    if(xyPad.getMinimumXValue()>=0)
+        xVal = (xyPad.getXValue()/xyPad.getXRange())+(fabs(xyPad.getMinimumXValue())/xyPad.getXRange());
+    else
+        xVal = (xyPad.getXValue()/xyPad.getXRange())-(fabs(xyPad.getMinimumXValue())/xyPad.getXRange());
+
+    if(xyPad.getMinimumYValue()<=0)
+        yVal = (xyPad.getYValue()/xyPad.getYRange())+(fabs(xyPad.getMinimumYValue())/xyPad.getYRange());
+    else
+        yVal = (xyPad.getYValue()/xyPad.getYRange())-(fabs(xyPad.getMinimumYValue())/xyPad.getYRange());
+#endif
+}
+
 //==============================================================================
 // getTable data from Csound so table editor can draw table
 //==============================================================================
@@ -1958,6 +2008,41 @@ void CabbagePluginAudioProcessor::setParameter (int index, float newValue)
     //updateCabbageControls();
 }
 
+//==============================================================================
+//used by the host's graph renderer to apply automation between the slices of
+//a block. Rather than waiting for the message queue to be sent, which only
+//happens every guiRefreshRate k-cycles, the value is written straight to its
+//channel so the next k-cycle sees it. GUI and host changes still use the queue.
+void CabbagePluginAudioProcessor::directParameterChange (int index, float newValue)
+{
+#ifndef Cabbage_No_Csound
+    if(!isPositiveAndBelow(index, (int)guiCtrls.size()) || csCompileResult!=OK)
+        return;
+
+    CabbageGUIClass& guiCtrl = guiCtrls.getReference(index);
+    const String type(guiCtrl.getStringProp(CabbageIDs::type));
+
+    //string channels need the combobox's text, so they go through the queue
+    if(type==CabbageIDs::combobox && guiCtrl.getStringProp(CabbageIDs::channeltype)==CabbageIDs::stringchannel)
+    {
+        setParameter(index, newValue);
+        return;
+    }
+
+#ifndef Cabbage_Build_Standalone
+    //scaled in the same way as setParameter()
+    if(type==CabbageIDs::xypad)
+        newValue = (jmax(0.f, newValue)*guiCtrl.getNumProp(CabbageIDs::range))+guiCtrl.getNumProp(CabbageIDs::min);
+    else if(type==CabbageIDs::combobox)
+        newValue = newValue*guiCtrl.getNumProp(CabbageIDs::comborange);
+    else if(type!=CabbageIDs::checkbox && type!=CabbageIDs::button)
+        newValue = (newValue*guiCtrl.getNumProp(CabbageIDs::range))+guiCtrl.getNumProp(CabbageIDs::min);
+#endif
+
+    csound->SetChannel(guiCtrl.getStringProp(CabbageIDs::channel).toUTF8().getAddress(), newValue);
+#endif
+}
+
 //==============================================================================
 //this method gets called after a performKsmps() to update our GUI controls
 //with messages from Csound. For instance, a user might wish to change the value
@@ -2243,19 +2328,81 @@ void CabbagePluginAudioProcessor::releaseResources()
     keyboardState.reset();
 }
 //==============================================================================
-//this following callback only runs in plugin mode, and only when one of the
-//host widgets are being used
+//xypads moved by updateXYAutomation() on the audio thread only flag the change;
+//the host is told about their new values from here. Their channels are already
+//set, so nothing is queued for Csound, which could overwrite newer automation
+//from the host, and only the values that have changed are sent.
 void CabbagePluginAudioProcessor::timerCallback()
+{
+    for(int i=0; i<xyAutomation.size(); i++)
+    {
+        XYPadAutomation* xyAuto = xyAutomation[i];
+        if(xyAuto==nullptr || !xyAuto->valuesChanged.compareAndSetBool(0, 1))
+            continue;
+
+        float xVal, yVal;
+        getXYPadParameterValues(*xyAuto, xVal, yVal);
+        if(xVal!=xyAuto->lastNotifiedX)
+            sendParamChangeMessageToListeners(xyAuto->paramIndex, xVal);
+        if(yVal!=xyAuto->lastNotifiedY)
+            sendParamChangeMessageToListeners(xyAuto->paramIndex+1, yVal);
+        xyAuto->lastNotifiedX = xVal;
+        xyAuto->lastNotifiedY = yVal;
+    }
+}
+
+//==============================================================================
+//called from processBlock() before each k-period. Automated xypads are moved
+//on by one k-period and their values written straight to their channels, so
+//they keep time with the audio even when the message thread is busy or the
+//host is bouncing offline. The editor picks the new values up through
+//updateCabbageControls() like any other channel change.
+void CabbagePluginAudioProcessor::updateXYAutomation()
 {
 #ifndef Cabbage_No_Csound
-    for(int y=0; y<xyAutomation.size(); y++)
+    const double kPeriod = csdKsmps/csound->GetSr();
+    const int numAutomaters = xyAutomation.size();
+    for(int i=0; i<numAutomaters; ++i)
     {
-        if(xyAutomation[y])
-            xyAutomation[y]->update();
+        XYPadAutomation* xyAuto = xyAutomation[i];
+        float x, y;
+        if(xyAuto && xyAuto->advance(kPeriod, x, y))
+        {
+            csound->SetChannel(xyAuto->xChannel.toUTF8().getAddress(), x);
+            csound->SetChannel(xyAuto->yChannel.toUTF8().getAddress(), y);
+            xyAuto->valuesChanged = 1;
+        }
     }
 #endif
 }
 
+//==============================================================================
+//an instrument with sleep(tailSeconds) in its form stops calling PerformKsmps()
+//once its input and output have stayed below the threshold for the tail time.
+//It wakes on input above the threshold, on MIDI, while an xypad is automating,
+//or when a parameter or channel change is waiting to be sent, and carries on
+//from the k-period it left.
+bool CabbagePluginAudioProcessor::shouldSleep(float inputLevel, const MidiBuffer& midi)
+{
+    if(!isSleeping)
+        return false;
+
+    bool xyAutomationRunning = false;
+    for(int i=0; i<xyAutomation.size(); i++)
+        if(xyAutomation[i] && xyAutomation[i]->isAutomating())
+            xyAutomationRunning = true;
+
+    if(inputLevel>=sleepThreshold || !midi.isEmpty() || xyAutomationRunning
+            || messageQueue.getNumberOfOutgoingChannelMessagesInQueue()>0)
+    {
+        isSleeping = false;
+        silentSamples = 0;
+        return false;
+    }
+
+    return true;
+}
+
 //==============================================================================
 void CabbagePluginAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
 {
@@ -2294,6 +2441,19 @@ void CabbagePluginAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiB
                 midiMessages.clear();
 #endif
 
+            //the input is measured before Csound's output overwrites it. While
+            //asleep the meters keep the silence they last showed.
+            const float inputLevel = getNumInputChannels()>0 ? buffer.getMagnitude(0, numSamples) : 0.f;
+            if(shouldSleep(inputLevel, midiBuffer))
+            {
+                buffer.clear();
+                rmsLeft = rmsRight = 0;
+                //recordings carry on through the silence so they stay in time
+                if (activeWriter != 0 && !isWinXP)
+                    activeWriter->write (buffer.getArrayOfReadPointers(), numSamples);
+                return;
+            }
+
             const CriticalSection &callback_lock = getCallbackLock();
 
             for(int i=0; i<numSamples; i++, ++csndIndex)
@@ -2311,6 +2471,7 @@ void CabbagePluginAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiB
                     else
                         ++yieldCounter;
 
+                    updateXYAutomation();
                     csCompileResult = csound->PerformKsmps();
 
                     if(csCompileResult!=OK)
@@ -2343,6 +2504,16 @@ void CabbagePluginAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiB
             if (activeWriter != 0 && !isWinXP)
                 activeWriter->write (buffer.getArrayOfReadPointers(), numSamples);
 
+            if(sleepTailSeconds>0)
+            {
+                //count the samples for which input and output have both been quiet
+                if(jmax(inputLevel, buffer.getMagnitude(0, numSamples))<sleepThreshold)
+                    silentSamples += numSamples;
+                else
+                    silentSamples = 0;
+                isSleeping = silentSamples>=(int64)(sleepTailSeconds*getSampleRate());
+            }
+
             if(isMuted)
                 buffer.clear();
 
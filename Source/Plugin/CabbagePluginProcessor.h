@@ -90,6 +90,7 @@ class CabbagePluginAudioProcessor  : public AudioProcessor,
     String csoundOutput;
     String debuggerMessage;
     void changeListenerCallback(ChangeBroadcaster *source);
+    void getXYPadParameterValues(XYPadAutomation& xyPad, float& xVal, float& yVal);
     String changeMessageType;
     bool guiON;
     int currentLine;
@@ -148,7 +149,22 @@ class CabbagePluginAudioProcessor  : public AudioProcessor,
 #endif
 
     void updateCabbageControls();
+    void updateXYAutomation();
     void sendOutgoingMessagesToCsound();
+
+    static void setWidgetBounds(CabbageGUIClass& cAttr, const HashMap<int, int>& boundsForLine,
+                                const Array<Rectangle<int> >& bounds)
+    {
+        const int lineNumber = cAttr.getNumProp(CabbageIDs::lineNumber);
+        if(!boundsForLine.contains(lineNumber))
+            return;
+
+        const Rectangle<int> newBounds(bounds[boundsForLine[lineNumber]]);
+        cAttr.setNumProp(CabbageIDs::left, newBounds.getX());
+        cAttr.setNumProp(CabbageIDs::top, newBounds.getY());
+        cAttr.setNumProp(CabbageIDs::width, newBounds.getWidth());
+        cAttr.setNumProp(CabbageIDs::height, newBounds.getHeight());
+    }
     int ksmpsOffset;
     bool CS_DEBUG_MODE;
     int pos;
@@ -170,6 +186,7 @@ class CabbagePluginAudioProcessor  : public AudioProcessor,
     OwnedArray<XYPadAutomation, CriticalSection> xyAutomation;
     void updateGUIControlsKsmps(int speed);
     int guiRefreshRate;
+    bool shouldSleep(float inputLevel, const MidiBuffer& midi);
 #ifdef Cabbage_No_Csound
     std::vector<float> temp;
 #else
@@ -275,6 +292,10 @@ public:
     void createAndShowSourceEditor(LookAndFeel* looky);
     void actionListenerCallback (const String& message);
     void addMacros(String csdText);
+    //the screen size passed to Csound as SCREEN_WIDTH and SCREEN_HEIGHT
+    static Rectangle<int> getScreenArea();
+    static void setRunningHeadless(bool headless);
+    void installFileLogger();
 
 
 
@@ -351,7 +372,7 @@ public:
 
     double getTailLengthSeconds(void) const
     {
-        return 1;
+        return sleepTailSeconds>0 ? sleepTailSeconds : 1;
     }
 
     void startRecording();
@@ -369,6 +390,8 @@ public:
     int getNumParameters();
     float getParameter (int index);
     void setParameter (int index, float newValue);
+    //audio thread only, between calls to processBlock()
+    void directParameterChange (int index, float newValue);
     const String getParameterName (int index);
     const String getParameterText (int index);
     const String getInputChannelName (int channelIndex) const;
@@ -396,7 +419,8 @@ public:
     StringArray getTableStatement(int tableNum);
     const Array<double, CriticalSection> getTable(int tableNum);
     const Array<float, CriticalSection> getTableFloats(int tableNum);
-    void createGUI(String source, bool refresh);
+    //firstSourceLine is the csd line that source was inserted at, when it isn't the whole csd
+    void createGUI(String source, bool refresh, int firstSourceLine=0);
     int checkTable(int tableNum);
     MidiKeyboardState keyboardState;
     //midiBuffers
@@ -418,6 +442,11 @@ public:
     int mouseX, mouseY;
     int breakCount;
     Array<int> breakpointInstruments;
+    //idle sleep, turned on with the form's sleep() identifier
+    double sleepTailSeconds;
+    float sleepThreshold;
+    int64 silentSamples;
+    bool isSleeping;
 
 
     //==============================================================================
@@ -446,6 +475,14 @@ public:
 #endif
     }
 
+    void updateCsoundFileLine(int lineNumber, const String& text)
+    {
+#if (defined(Cabbage_Build_Standalone) || defined(CABBAGE_HOST)) && !defined(AndroidBuild)
+        if(codeEditor)
+            codeEditor->setLineText(lineNumber, text);
+#endif
+    }
+
     int saveEditorFiles()
     {
 #if defined(Cabbage_Build_Standalone) || defined(CABBAGE_HOST)
@@ -591,6 +628,20 @@ public:
         return guiCtrls.getReference(index);
     }
 
+    //moves widgets in edit mode without parsing the csd again. Widgets are
+    //matched to the bounds by the csd line they were created from
+    void updateWidgetBounds(const Array<int>& lineNumbers, const Array<Rectangle<int> >& bounds)
+    {
+        HashMap<int, int> boundsForLine;
+        for(int i=0; i<lineNumbers.size(); i++)
+            boundsForLine.set(lineNumbers[i], i);
+
+        for(int i=0; i<guiLayoutCtrls.size(); i++)
+            setWidgetBounds(guiLayoutCtrls.getReference(i), boundsForLine, bounds);
+        for(int i=0; i<guiCtrls.size(); i++)
+            setWidgetBounds(guiCtrls.getReference(i), boundsForLine, bounds);
+    }
+
     inline String getChangeMessageType()
     {
         return changeMessageType;
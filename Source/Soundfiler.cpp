@@ -54,7 +54,7 @@ public:
 // soundfiler display  component
 //==============================================================================
 
-Soundfiler::Soundfiler(int sr, Colour col, Colour fcol):	thumbnailCache (5), colour(col),														sampleRate(sr),
+Soundfiler::Soundfiler(int sr, Colour col, Colour fcol):	colour(col),														sampleRate(sr),
     currentPlayPosition(0),
     mouseDownX(0),
     mouseUpX(0),
@@ -67,9 +67,6 @@ Soundfiler::Soundfiler(int sr, Colour col, Colour fcol):	thumbnailCache (5), col
     fontcolour(fcol),
     currentPositionMarker(new DrawableRectangle())
 {
-    formatManager.registerBasicFormats();
-    thumbnail = new AudioThumbnail(2, formatManager, thumbnailCache);
-    thumbnail->addChangeListener (this);
     //setSize(400, 200);
     sampleRate = sr;
     addAndMakeVisible(scrollbar = new ScrollBar(false));
@@ -87,7 +84,6 @@ Soundfiler::Soundfiler(int sr, Colour col, Colour fcol):	thumbnailCache (5), col
 Soundfiler::~Soundfiler()
 {
     scrollbar->removeListener (this);
-    thumbnail->removeChangeListener (this);
 }
 //==============================================================================
 void Soundfiler::changeListenerCallback(ChangeBroadcaster *source)
@@ -101,7 +97,7 @@ void Soundfiler::changeListenerCallback(ChangeBroadcaster *source)
             setZoomFactor(jmax(0.0, zoom-=0.1));
     }
     repaint();
-    //Logger::writeToLog("soundfiler Change listener:"+String(thumbnail->getTotalLength()));
+    //Logger::writeToLog("soundfiler Change listener:"+String(getTotalLength()));
 }
 //==============================================================================
 void Soundfiler::resized()
@@ -122,32 +118,16 @@ void Soundfiler::setFile (const File& file)
 {
     if (! file.isDirectory())
     {
-
-        //buffer.clear();
-        //
-        //buffer.addFrom(0, 0, tableValues.getRawDataPointer(), tableValues.size());
-        //buffer.addFrom(1, 0, tableValues.getRawDataPointer(), tableValues.size());
-        AudioFormatManager format;
-        format.registerBasicFormats();
-        //registers wav and aif format (just nescearry one time if you alays use the "getInstance()" method)
-        AudioFormatReader* reader = format.createReaderFor(file);
-        //creates a reader for the result file (may file, if the result/opened file is no wav or aif)
-        if(reader) //if a reader got created
+        //the peaks come from the shared peak cache rather than reading the
+        //whole file here. They are filled in on a background thread and each
+        //batch that arrives triggers a repaint through changeListenerCallback
+        if(samplePeaks.setFile(file, this))
         {
-            AudioSampleBuffer buffer(reader->numChannels, reader->lengthInSamples);
-            buffer.clear();
-            buffer.setSize(reader->numChannels, reader->lengthInSamples);
-            reader->read(&buffer,0, buffer.getNumSamples(), 0, true, true);
-            setWaveform(buffer, reader->numChannels);
+            const Range<double> newRange (0.0, getTotalLength());
+            scrollbar->setRangeLimits (newRange);
+            setRange (newRange);
+            setZoomFactor(zoom);
         }
-
-        delete reader;
-
-
-        // thumbnail->setSource (new FileInputSource (file));
-        //    const Range<double> newRange (0.0, thumbnail->getTotalLength());
-        //    scrollbar->setRangeLimits (newRange);
-        //    setRange (newRange);
     }
     repaint(0, 0, getWidth(), getHeight());
 }
@@ -155,12 +135,13 @@ void Soundfiler::setFile (const File& file)
 //==============================================================================
 void Soundfiler::setWaveform(AudioSampleBuffer buffer, int channels)
 {
-    thumbnail->clear();
-    repaint();
-    thumbnail->reset(channels, 44100, buffer.getNumSamples());
-    //thumbnail->clear();
-    thumbnail->addBlock(0, buffer, 0, buffer.getNumSamples());
-    const Range<double> newRange (0.0, thumbnail->getTotalLength());
+    //only the regions that changed since the last update are rescanned,
+    //and only the requested channels are shown
+    if(buffer.getNumChannels()>channels && channels>0)
+        samplePeaks.setBuffer(AudioSampleBuffer(buffer.getArrayOfWritePointers(), channels, buffer.getNumSamples()));
+    else
+        samplePeaks.setBuffer(buffer);
+    const Range<double> newRange (0.0, getTotalLength());
     scrollbar->setRangeLimits (newRange);
     setRange (newRange);
     setZoomFactor(zoom);
@@ -177,9 +158,9 @@ void Soundfiler::setZoomFactor (double amount)
         zoomOut->setVisible(false);
     }
 
-    if (thumbnail->getTotalLength() > 0)
+    if (getTotalLength() > 0)
     {
-        const double newScale = jmax (0.001, thumbnail->getTotalLength() * (1.0 - jlimit (0.0, 0.99, amount)));
+        const double newScale = jmax (0.001, getTotalLength() * (1.0 - jlimit (0.0, 0.99, amount)));
         const double timeAtCentre = xToTime (getWidth() / 2.0f);
         setRange (Range<double> (timeAtCentre - newScale * 0.5, timeAtCentre + newScale * 0.5));
     }
@@ -198,19 +179,19 @@ void Soundfiler::paint (Graphics& g)
 {
     g.fillAll (Colours::black);
     g.setColour (colour);
-    //Logger::writeToLog(String(thumbnail->getTotalLength()));
-    if (thumbnail->getTotalLength() != 0.0)
+    //Logger::writeToLog(String(getTotalLength()));
+    if (getTotalLength() != 0.0)
     {
         //if(GEN01 then draw thumbnail)
         Rectangle<int> thumbArea (getLocalBounds());
         thumbArea.setHeight(getHeight()-14);
         thumbArea.setTop(10.f);
-        thumbnail->drawChannels(g, thumbArea.reduced (2),
-                                visibleRange.getStart(), visibleRange.getEnd(), .8f);
+        samplePeaks.drawChannels(g, thumbArea.reduced (2),
+                                 visibleRange.getStart()*sampleRate, visibleRange.getEnd()*sampleRate, .8f);
 
         //if(regionWidth>1){
         g.setColour(colour.contrasting(.5f).withAlpha(.7f));
-        float zoomFactor = thumbnail->getTotalLength()/visibleRange.getLength();
+        float zoomFactor = getTotalLength()/visibleRange.getLength();
         //regionWidth = (regionWidth=2 ? 2 : regionWidth*zoomFactor)
         if(showScrubber)
             g.fillRect(timeToX(currentPlayPosition), 10.f, (regionWidth==2 ? 2 : regionWidth*zoomFactor), (float)getHeight()-26.f);
@@ -228,10 +209,10 @@ void Soundfiler::paint (Graphics& g)
 //==============================================================================
 void Soundfiler::mouseWheelMove (const MouseEvent&, const MouseWheelDetails& wheel)
 {
-    if (thumbnail->getTotalLength() > 0.5)
+    if (getTotalLength() > 0.5)
     {
         double newStart = visibleRange.getStart() - wheel.deltaX * (visibleRange.getLength()) / 10.0;
-        newStart = jlimit (0.0, jmax (0.0, thumbnail->getTotalLength() - (visibleRange.getLength())), newStart);
+        newStart = jlimit (0.0, jmax (0.0, getTotalLength() - (visibleRange.getLength())), newStart);
 
         setRange (Range<double> (newStart, newStart + visibleRange.getLength()));
 
@@ -257,7 +238,7 @@ void Soundfiler::mouseDown (const MouseEvent& e)
 void Soundfiler::mouseEnter(const MouseEvent& e)
 {
     //Logger::writeToLog("mouseOver soundfiler");
-    //if(thumbnail->getTotalLength()>0.01){
+    //if(getTotalLength()>0.01){
     //	zoomIn->setVisible(true);
     //	zoomOut->setVisible(true);
     //}
@@ -277,12 +258,12 @@ void Soundfiler::mouseDrag(const MouseEvent& e)
         {
             if(e.mods.isLeftButtonDown())
             {
-                double zoomFactor = visibleRange.getLength()/thumbnail->getTotalLength();
+                double zoomFactor = visibleRange.getLength()/getTotalLength();
                 regionWidth = abs(e.getDistanceFromDragStartX())*zoomFactor;
                 //Logger::writeToLog(String(e.getDistanceFromDragStartX()));
                 if(e.getDistanceFromDragStartX()<0)
                     currentPlayPosition = jmax (0.0, xToTime (loopStart+(float)e.getDistanceFromDragStartX()));
-                float widthInTime = ((float)e.getDistanceFromDragStartX() / (float)getWidth()) * (float)thumbnail->getTotalLength();
+                float widthInTime = ((float)e.getDistanceFromDragStartX() / (float)getWidth()) * (float)getTotalLength();
                 loopLength = jmax (0.0, widthInTime*zoomFactor);
             }
             repaint();
@@ -296,14 +277,14 @@ void Soundfiler::setScrubberPos(double pos)
     if(showScrubber)
     {
         currentPositionMarker->setVisible (true);
-        pos = (pos/(thumbnail->getTotalLength()*sampleRate))*thumbnail->getTotalLength();
+        pos = pos/sampleRate;
         currentPositionMarker->setRectangle (Rectangle<float> (timeToX (pos) - 0.75f, 10,
                                              1.5f, (float) (getHeight() - scrollbar->getHeight()-10)));
 
         if(pos<0.5)
             setRange (visibleRange.movedToStartAt(0));
 
-        if(visibleRange.getEnd()<=thumbnail->getTotalLength())
+        if(visibleRange.getEnd()<=getTotalLength())
             setRange (visibleRange.movedToStartAt (jmax(0.0, pos - (visibleRange.getLength() / 2.0))));
 
     }
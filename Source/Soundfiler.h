@@ -23,6 +23,7 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "CabbageUtils.h"
 #include "CabbageLookAndFeel.h"
+#include "WaveformPeaks.h"
 
 class ZoomButton;
 //=================================================================
@@ -107,12 +108,15 @@ private:
     void changeListenerCallback(ChangeBroadcaster *source);
     ScopedPointer<ZoomButton> zoomIn, zoomOut;
 
-    AudioFormatManager formatManager;
     float sampleRate;
     float regionWidth;
     Image waveformImage;
-    AudioThumbnailCache thumbnailCache;
-    ScopedPointer<AudioThumbnail> thumbnail;
+    WaveformPeaks samplePeaks;
+    //length of the loaded sample in seconds
+    double getTotalLength() const
+    {
+        return samplePeaks.getNumSamples()/(double)sampleRate;
+    }
     Colour colour, fontcolour;
     int mouseDownX, mouseUpX;
     Rectangle<int> localBounds;
@@ -30,6 +30,31 @@
 //  and make it create an instance of the filter subclass that you're building.
 extern CabbagePluginAudioProcessor* JUCE_CALLTYPE createCabbagePluginFilter(String inputfile, bool guiOnOff, int plugType);
 
+//==============================================================================
+// the csd with every bounds() in its <Cabbage> section taken out, so saves that
+// only move or resize widgets can be told apart from ones that need Csound to be
+// recompiled. the rest of the csd is left exactly as it is.
+static String getTextWithoutBounds(const String& csdText)
+{
+    const int sectionStart = csdText.indexOf("<Cabbage>");
+    const int sectionEnd = csdText.indexOf(jmax(0, sectionStart), "</Cabbage>");
+    if(sectionStart<0 || sectionEnd<0)
+        return csdText;
+
+    String text(csdText.substring(0, sectionStart));
+    int previous = sectionStart;
+    for(int start = csdText.indexOf(previous, "bounds("); start>=0 && start<sectionEnd;
+        start = csdText.indexOf(previous, "bounds("))
+    {
+        const int end = csdText.indexOfChar(start, ')');
+        if(end<0 || end>=sectionEnd)
+            break;
+        text << csdText.substring(previous, start);
+        previous = end+1;
+    }
+    return text+csdText.substring(previous);
+}
+
 
 //==============================================================================
 StandaloneFilterWindow::StandaloneFilterWindow (const String& title,
@@ -56,9 +81,13 @@ StandaloneFilterWindow::StandaloneFilterWindow (const String& title,
     Component::addAndMakeVisible (&optionsButton);
     optionsButton.addListener (this);
     timerRunning = false;
+    isLoadingFilter = false;
+    hasPendingReset = false;
+    pendingFullReset = false;
     yAxis = 0;
     this->addKeyListener(this);
     optionsButton.setTriggeredOnMouseDown (true);
+    fileWatcher.addActionListener(this);
 
     bool alwaysontop = getPreference(appProperties, "SetAlwaysOnTop");
     setAlwaysOnTop(alwaysontop);
@@ -246,6 +275,8 @@ StandaloneFilterWindow::~StandaloneFilterWindow()
 {
 //cabbageCsoundEditor.release();
 //outputConsole.release();
+    fileWatcher.stopWatching();
+    fileWatcher.removeActionListener(this);
 #ifdef Cabbage_Named_Pipe
 // MOD - Stefano Bonetti
     if(ipConnection)
@@ -291,18 +322,6 @@ StandaloneFilterWindow::~StandaloneFilterWindow()
 void StandaloneFilterWindow::timerCallback()
 {
 
-    if(isUsingExternalEditor)
-    {
-        int64 diskTime = csdFile.getLastModificationTime().toMilliseconds();
-        int64 tempTime = lastSaveTime.toMilliseconds();
-        if(diskTime>tempTime)
-        {
-            resetFilter(false);
-            lastSaveTime = csdFile.getLastModificationTime();
-            //csdFile.replaceWithText(File(csdFile.getFullPathName()).loadFileAsString());
-        }
-    }
-
     //cout << csdFile.getLastModificationTime().toString(true, true, false, false);
     if(cabbageDance)
     {
@@ -452,6 +471,17 @@ void StandaloneFilterWindow::actionListenerCallback (const String& message)
         exportPlugin(String("VST"), false);
     }
 
+    //the csd, or a file it includes, was changed by an external editor
+    else if(message == "csdFileChanged:orchestra")
+    {
+        resetFilter(false);
+    }
+
+    else if(message == "csdFileChanged:gui")
+    {
+        filter->createGUI(csdFile.loadFileAsString(), true);
+    }
+
     else if(message.contains("fileUpdateGUI"))
     {
         filter->createGUI(cabbageCsoundEditor->getText(), true);
@@ -565,45 +595,142 @@ void StandaloneFilterWindow::deleteFilter()
     filter = nullptr;
 }
 
+//==============================================================================
+// Compiles the current csd, and readies it to be played, on a background thread
+// so that the instrument that is already running carries on while it loads
+//==============================================================================
+class FilterLoaderThread : public Thread
+{
+public:
+    FilterLoaderThread(const File& file, CrossfadingProcessorPlayer& p, bool prepare)
+        : Thread("Cabbage filter loader"), csdFile(file), player(p), shouldPrepare(prepare), isPrepared(false)
+    {}
+
+    void run()
+    {
+        filter = createCabbagePluginFilter(csdFile.getFullPathName(), false, AUDIO_PLUGIN);
+
+        //if the device doesn't have enough channels open it will need restarting
+        if(shouldPrepare && filter->getNumOutputChannels()<=player.getNumOutputChannels()
+                && filter->getNumInputChannels()<=player.getNumInputChannels())
+            isPrepared = player.prepareIncomingProcessor(filter);
+    }
+
+    File csdFile;
+    CrossfadingProcessorPlayer& player;
+    bool shouldPrepare, isPrepared;
+    ScopedPointer<CabbagePluginAudioProcessor> filter;
+};
+
+CabbagePluginAudioProcessor* StandaloneFilterWindow::loadFilter(bool& isPrepared)
+{
+    const bool canSwap = getPreference(appProperties, "UseCabbageIO") && deviceManager->getCurrentAudioDevice()!=nullptr;
+    FilterLoaderThread loader(csdFile, player, canSwap);
+    //read here so the loader thread never has to ask the desktop
+    CabbagePluginAudioProcessor::getScreenArea();
+    loader.startThread();
+
+    //keep the message loop going, but not the mouse or keyboard, while Csound compiles
+    Component dummyModalComp;
+    dummyModalComp.enterModalState();
+    while(loader.isThreadRunning())
+        MessageManager::getInstance()->runDispatchLoopUntil(20);
+    dummyModalComp.exitModalState(0);
+
+    //the new filter couldn't install its log file from the loader thread.
+    //The old one only clears the logger when it's deleted if it's still its own.
+    loader.filter->installFileLogger();
+    isPrepared = loader.isPrepared;
+    return loader.filter.release();
+}
+
+//==============================================================================
+// fades from the current filter to one that's already been prepared, without
+// touching the audio device
+//==============================================================================
+void StandaloneFilterWindow::swapFilter(CabbagePluginAudioProcessor* newFilter)
+{
+    player.startCrossfade(0.05);
+    const uint32 timeOut = Time::getMillisecondCounter()+1000;
+    while(player.isCrossfading() && Time::getMillisecondCounter()<timeOut)
+        Thread::sleep(5);
+    player.finishCrossfade();
+
+    if (filter != nullptr && getContentComponent() != nullptr)
+    {
+        filter->editorBeingDeleted (dynamic_cast <AudioProcessorEditor*> (getContentComponent()));
+        clearContentComponent();
+    }
+
+    filter = newFilter;
+    filter->addChangeListener(this);
+    filter->addActionListener(this);
+}
+
 //==============================================================================
 // Reset filter
 //==============================================================================
 void StandaloneFilterWindow::resetFilter(bool shouldResetFilter)
 {
 //first we check that the audio device is up and running ok
+    //loadFilter runs the message loop, so a change to the csd can arrive
+    //while it does. It's run again once this load has finished.
+    if(isLoadingFilter)
+    {
+        hasPendingReset = true;
+        pendingFullReset = pendingFullReset || shouldResetFilter;
+        return;
+    }
+
     stopTimer();
 
-    filter->stopProcessing=true;
     deviceManager->addAudioCallback (&player);
     deviceManager->addMidiInputCallback (String::empty, &player);
 
     if(shouldResetFilter)
     {
-        deviceManager->closeAudioDevice();
-        deleteFilter();
+        //the new filter is built while the old one keeps playing
+        isLoadingFilter = true;
+        bool isPrepared = false;
+        ScopedPointer<CabbagePluginAudioProcessor> newFilter(loadFilter(isPrepared));
+        isLoadingFilter = false;
 
-        PropertySet* const globalSettings = getGlobalSettings();
-        ScopedPointer<XmlElement> savedState;
-        if (globalSettings != nullptr)
-            savedState = globalSettings->getXmlValue ("audioSetup");
+        if(isPrepared)
+            swapFilter(newFilter.release());
+        else
+        {
+            filter->stopProcessing=true;
+            deviceManager->closeAudioDevice();
+            deleteFilter();
+
+            filter = newFilter.release();
+            filter->addChangeListener(this);
+            filter->addActionListener(this);
+        }
 
-        filter = createCabbagePluginFilter(csdFile.getFullPathName(), false, AUDIO_PLUGIN);
-        filter->addChangeListener(this);
-        filter->addActionListener(this);
         if(cabbageCsoundEditor)
         {
             cabbageCsoundEditor->setName(csdFile.getFileName());
             cabbageCsoundEditor->textEditor->editor[0]->loadContent(csdFile.loadFileAsString());
         }
 
-        deviceManager->initialise(filter->getNumInputChannels(),
-                                  filter->getNumOutputChannels(), savedState, false);
+        if(!isPrepared)
+        {
+            PropertySet* const globalSettings = getGlobalSettings();
+            ScopedPointer<XmlElement> savedState;
+            if (globalSettings != nullptr)
+                savedState = globalSettings->getXmlValue ("audioSetup");
+
+            deviceManager->initialise(filter->getNumInputChannels(),
+                                      filter->getNumOutputChannels(), savedState, false);
+        }
 
         //filter->createGUI(csdFile.loadFileAsString(), true);
     }
     else
     {
         //deviceManager->closeAudioDevice();
+        filter->stopProcessing=true;
         filter->createGUI(csdFile.loadFileAsString(), true);
         filter->reCompileCsound(csdFile);
 
@@ -645,6 +772,8 @@ void StandaloneFilterWindow::resetFilter(bool shouldResetFilter)
 
 
     startTimer(500);
+    updateFileWatcher();
+    compiledTextWithoutBounds = getTextWithoutBounds(csdFile.loadFileAsString());
 
     if(cabbageCsoundEditor)
     {
@@ -668,6 +797,12 @@ void StandaloneFilterWindow::resetFilter(bool shouldResetFilter)
         }
     }
 
+    if(hasPendingReset)
+    {
+        const bool fullReset = pendingFullReset;
+        hasPendingReset = pendingFullReset = false;
+        resetFilter(fullReset);
+    }
 }
 
 //==============================================================================
@@ -896,7 +1031,7 @@ void StandaloneFilterWindow::buttonClicked (Button*)
         subMenu.clear();
         subMenu.addItem(11, TRANS("Effects"));
         subMenu.addItem(12, TRANS("Synths"));
-#ifdef WIN32
+#if defined(WIN32) || defined(LINUX)
         m.addSubMenu("Batch Convert (Multiple)", subMenu);
         subMenu.clear();
         subMenu.addItem(13, TRANS("Effects"));
@@ -1417,9 +1552,21 @@ void StandaloneFilterWindow::buttonClicked (Button*)
         }
     }
     isUsingExternalEditor = getPreference(appProperties, "ExternalEditor");
+    updateFileWatcher();
     repaint();
 }
 
+//==============================================================================
+// with an external editor the csd is reloaded whenever it's saved
+//==============================================================================
+void StandaloneFilterWindow::updateFileWatcher()
+{
+    if(isUsingExternalEditor && csdFile.existsAsFile())
+        fileWatcher.watch(csdFile);
+    else
+        fileWatcher.stopWatching();
+}
+
 
 //=================
 // setup window dimensions etc..
@@ -1496,7 +1643,6 @@ void StandaloneFilterWindow::openFile(String _csdfile)
     {
         csdFile = File(_csdfile);
         originalCsdFile = csdFile;
-        lastSaveTime = csdFile.getLastModificationTime();
         csdFile.getParentDirectory().setAsCurrentWorkingDirectory();
         resetFilter(true);
     }
@@ -1509,7 +1655,6 @@ void StandaloneFilterWindow::openFile(String _csdfile)
         {
             csdFile = openFC.getResult();
             originalCsdFile = openFC.getResult();
-            lastSaveTime = csdFile.getLastModificationTime();
             csdFile.getParentDirectory().setAsCurrentWorkingDirectory();
             if(csdFile.getFileExtension()==(".vst"))
             {
@@ -1533,7 +1678,6 @@ void StandaloneFilterWindow::openFile(String _csdfile)
         {
             csdFile = File(selectedFile[0]);//openFC.getResult();
             csdFile.getParentDirectory().setAsCurrentWorkingDirectory();
-            lastSaveTime = csdFile.getLastModificationTime();
             resetFilter(true);
             cabbageCsoundEditor->setText(csdFile.loadFileAsString(), csdFile.getFullPathName());
             cabbageCsoundEditor->textEditor->setAllText(csdFile.loadFileAsString());
@@ -1554,16 +1698,23 @@ void StandaloneFilterWindow::openFile(String _csdfile)
 
 void StandaloneFilterWindow::saveFile()
 {
+    const String csdText(cabbageCsoundEditor->getText());
     if(csdFile.hasWriteAccess())
     {
-        csdFile.replaceWithText(cabbageCsoundEditor->getText());
+        csdFile.replaceWithText(csdText);
     }
     else
     {
         showMessage("no write access..");
         return;
     }
-    resetFilter(false);
+
+    //if widgets were only moved or resized, the GUI is rebuilt but Csound
+    //doesn't need to be recompiled
+    if(filter->compiledOk()==OK && getTextWithoutBounds(csdText)==compiledTextWithoutBounds)
+        filter->createGUI(csdText, true);
+    else
+        resetFilter(false);
     RecentlyOpenedFilesList recentFiles;
     recentFiles.restoreFromString (appProperties->getUserSettings()->getValue ("recentlyOpenedFiles"));
     recentFiles.addFile (csdFile);
@@ -1851,179 +2002,48 @@ int StandaloneFilterWindow::exportPlugin(String type, bool saveAs, String fileNa
 //==============================================================================
 int StandaloneFilterWindow::setUniquePluginID(File binFile, File csdFile, bool AU)
 {
-    String newID;
-    StringArray csdText;
-    csdText.addLines(csdFile.loadFileAsString());
-    //read contents of csd file to find pluginID
-    for(int i=0; i<csdText.size(); i++)
-    {
-        StringArray tokes;
-        tokes.addTokens(csdText[i].trimEnd(), ", ", "\"");
-        if(tokes[0].equalsIgnoreCase(String("form")))
-        {
-            CabbageGUIClass cAttr(csdText[i].trimEnd(), 0);
-            if(cAttr.getStringProp(CabbageIDs::pluginid).length()!=4)
-            {
-                m_ShowMessage("Your plugin ID is not the right size. It MUST be 4 characters long. Some hosts may not be able to load your plugin", lookAndFeel);
-                //return 0;
-            }
-            else
-            {
-                newID = cAttr.getStringProp(CabbageIDs::pluginid);
-                i = csdText.size();
-            }
-        }
-    }
-
-    size_t file_size;
-    const char *pluginID;
-    //if(!AU)
-    pluginID = "YROR";
-    //else
-    //	pluginID = "RORY";
-
-
-    long loc;
-    //showMessage(binFile.getFullPathName(), lookAndFeel);
-    fstream mFile(binFile.getFullPathName().toUTF8(), ios_base::in | ios_base::out | ios_base::binary);
-
-    if(mFile.is_open())
-    {
-        mFile.seekg (0, ios::end);
-        file_size = mFile.tellg();
-        unsigned char* buffer = (unsigned char*)malloc(sizeof(unsigned char)*file_size);
-        //set plugin ID, do this a few times in case the plugin ID appear in more than one place.
-        for(int r=0; r<10; r++)
-        {
-            mFile.seekg (0, ios::beg);
-            mFile.read((char*)&buffer[0], file_size);
-            loc = cabbageFindPluginID(buffer, file_size, pluginID);
-            if (loc < 0)
-            {
-                //showMessage(String("Internel Cabbage Error: The pluginID was not found"));
-                break;
-            }
-            else
-            {
-                //showMessage(newID);
-                mFile.seekg (loc, ios::beg);
-                mFile.write(newID.toUTF8(), 4);
-            }
-        }
-        //set plugin name based on .csd file
-        const char *pluginName = "CabbageEffectNam";
-        String plugLibName = csdFile.getFileNameWithoutExtension();
-        if(plugLibName.length()<16)
-            for(int y=plugLibName.length(); y<16; y++)
-                plugLibName.append(String(" "), 1);
-
-        mFile.seekg (0, ios::beg);
-        buffer = (unsigned char*)malloc(sizeof(unsigned char)*file_size);
-        mFile.read((char*)&buffer[0], file_size);
-        loc = cabbageFindPluginID(buffer, file_size, pluginName);
-        if (loc < 0)
-            m_ShowMessage("Plugin name could not be set?!?", lookAndFeel);
-        else
-        {
-            //showMessage("plugin name set!");
-            mFile.seekg (loc, ios::beg);
-            mFile.write(csdFile.getFileNameWithoutExtension().toUTF8(), 16);
-        }
-        //#endif
-
-    }
-    else
-        m_ShowMessage("File could not be opened", lookAndFeel);
+    const String newID(PluginTemplate::getPluginId(csdFile.loadFileAsString()));
+    if(newID.length()!=4)
+        m_ShowMessage("Your plugin ID is not the right size. It MUST be 4 characters long. Some hosts may not be able to load your plugin", lookAndFeel);
 
-    mFile.close();
+    const String error(PluginTemplate::patchFile(binFile, newID, PluginTemplate::getPluginName(csdFile)));
+    if(error.isNotEmpty())
+        m_ShowMessage(error, lookAndFeel);
     return 1;
 }
 
-long StandaloneFilterWindow::cabbageFindPluginID(unsigned char *buf, size_t len, const char *s)
-{
-    long i, j;
-    int slen = strlen(s);
-    long imax = len - slen - 1;
-    long ret = -1;
-    int match;
-
-    for(i=0; i<imax; i++)
-    {
-        match = 1;
-        for (j=0; j<slen; j++)
-        {
-            if (buf[i+j] != s[j])
-            {
-                match = 0;
-                break;
-            }
-        }
-        if (match)
-        {
-            ret = i;
-            break;
-        }
-    }
-    //return position of plugin ID
-    return ret;
-}
-
 //==============================================================================
 // Batch process multiple csd files to convert them to plugins libs.
 //==============================================================================
 void StandaloneFilterWindow::batchProcess(String type, bool dir)
 {
-    File thisFile(File::getSpecialLocation(File::currentApplicationFile));
-#ifdef WIN32
+#if defined(WIN32) || defined(LINUX)
     FileChooser saveFC(String("Select files..."), File::nonexistent, String("*.csd;"), UseNativeDialogue);
-    String VST;
 
     Array<File> files;
     if(dir)
     {
         if (saveFC.browseForDirectory())
-        {
-            if(type.contains("VSTi"))
-                VST = thisFile.getParentDirectory().getFullPathName() + String("\\CabbagePluginSynth.dat");
-            else if(type.contains(String("VST")))
-                VST = thisFile.getParentDirectory().getFullPathName() + String("\\CabbagePluginEffect.dat");
             saveFC.getResult().findChildFiles(files, 2, true, "*.csd;");
-        }
     }
-    else
-    {
-        if (saveFC.browseForMultipleFilesToOpen())
-        {
-            if(type.contains("VSTi"))
-                VST = thisFile.getParentDirectory().getFullPathName() + String("\\CabbagePluginSynth.dat");
-            else if(type.contains(String("VST")))
-                VST = thisFile.getParentDirectory().getFullPathName() + String("\\CabbagePluginEffect.dat");
-            else if(type.contains(String("AU")))
-            {
-                showMessage("This feature only works on computers running OSX");
-            }
-            files = saveFC.getResults();
-        }
-    }
-    File VSTData(VST);
-    if(!VSTData.exists())
+    else if (saveFC.browseForMultipleFilesToOpen())
+        files = saveFC.getResults();
+
+    if(files.size()==0)
+        return;
+
+    BatchPluginExporter exporter(type);
+    if(!exporter.canExport())
         m_ShowMessage("Cannot find plugin libs", &getLookAndFeel());
     else
     {
-
-
-
-        for(int i=0; i<files.size(); i++)
-        {
-            File dll(files.getReference(i).withFileExtension(".dll").getFullPathName());
-            //showMessage(dll.getFullPathName());
-            if(!VSTData.copyFileTo(dll))
-                showMessage("problem moving plugin lib");
-            setUniquePluginID(dll, files.getReference(i), false);
-        }
-        m_ShowMessage("Batch Convertion Complete", &getLookAndFeel());
+        exporter.exportFiles(files);
+        const StringArray errors(exporter.getErrors());
+        if(errors.size()>0)
+            m_ShowMessage("Some instruments could not be converted:\n\n"+errors.joinIntoString("\n"), &getLookAndFeel());
+        else
+            m_ShowMessage("Batch Convertion Complete", &getLookAndFeel());
     }
-
 #endif
 }
 
@@ -25,6 +25,9 @@
 #include "../Plugin/CabbagePluginProcessor.h"
 #include "../Plugin/CabbagePluginEditor.h"
 #include "../CabbageAudioDeviceSelectorComponent.h"
+#include "CsdFileWatcher.h"
+#include "CrossfadingProcessorPlayer.h"
+#include "PluginExporter.h"
 
 extern ApplicationProperties* appProperties;
 extern PropertySet* defaultPropSet;
@@ -96,7 +99,6 @@ public:
     //=================================================================
     void resetFilter(bool shouldResetFilter);
     void saveState();
-    long cabbageFindPluginID(unsigned char *buf, size_t len, const char *s);
     void loadState();
     virtual void showAudioSettingsDialog();
     virtual PropertySet* getGlobalSettings();
@@ -145,7 +147,8 @@ private:
     AudioDeviceManager::AudioDeviceSetup audioDeviceSetup;
     bool updateEditorOutputConsole;
     bool isUsingExternalEditor;
-    Time lastSaveTime;
+    CsdFileWatcher fileWatcher;
+    void updateFileWatcher();
     void openTextEditor();
     bool standaloneMode;
     bool cabbageDance;
@@ -161,9 +164,13 @@ private:
     void sendMessageToWinXound(String messageType, String message);
     void sendMessageToWinXound(String messageType, int value);
     void batchProcess(String pluginType, bool dir);
-    AudioProcessorPlayer player;
+    CrossfadingProcessorPlayer player;
     TextButton optionsButton;
     void deleteFilter();
+    CabbagePluginAudioProcessor* loadFilter(bool& isPrepared);
+    void swapFilter(CabbagePluginAudioProcessor* newFilter);
+    bool isLoadingFilter, hasPendingReset, pendingFullReset;
+    String compiledTextWithoutBounds;
     File csdFile, originalCsdFile;
     bool isGUIOn;
     int currentLine;
@@ -0,0 +1,211 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __CROSSFADINGPROCESSORPLAYER_H__
+#define __CROSSFADINGPROCESSORPLAYER_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+// An AudioProcessorPlayer that can swap in a new processor without stopping
+// the audio device. The new processor is prepared on whatever thread calls
+// prepareIncomingProcessor(), then startCrossfade() fades from the playing
+// processor to it on the audio thread. Once isCrossfading() returns false,
+// finishCrossfade() releases the old one so it can be deleted.
+//==============================================================================
+class CrossfadingProcessorPlayer : public AudioIODeviceCallback,
+    public MidiInputCallback
+{
+public:
+    CrossfadingProcessorPlayer()
+        : active(0), sampleRate(0), numInputChannels(0), numOutputChannels(0),
+          fadeLength(0), fadePosition(0), fading(false)
+    {}
+
+    ~CrossfadingProcessorPlayer()
+    {
+        setProcessor(nullptr);
+    }
+
+    //play a processor straight away, cancelling any crossfade
+    void setProcessor(AudioProcessor* processorToPlay)
+    {
+        {
+            const ScopedLock sl(lock);
+            fading = false;
+        }
+        players[1-active].setProcessor(nullptr);
+        players[active].setProcessor(processorToPlay);
+    }
+
+    AudioProcessor* getCurrentProcessor() const
+    {
+        return players[active].getCurrentProcessor();
+    }
+
+    int getNumOutputChannels() const
+    {
+        return numOutputChannels;
+    }
+
+    int getNumInputChannels() const
+    {
+        return numInputChannels;
+    }
+
+    //can be called from a background thread. Returns false if the device isn't
+    //running, in which case there is nothing to fade from
+    bool prepareIncomingProcessor(AudioProcessor* processor)
+    {
+        int incoming;
+        {
+            const ScopedLock sl(lock);
+            if(sampleRate<=0 || fading || processor==nullptr)
+                return false;
+            incoming = 1-active;
+        }
+
+        //the audio thread doesn't touch this player until the fade starts
+        players[incoming].setProcessor(processor);
+        return true;
+    }
+
+    void startCrossfade(double seconds)
+    {
+        const ScopedLock sl(lock);
+        if(players[1-active].getCurrentProcessor()==nullptr)
+            return;
+
+        fadeLength = jmax(1, roundToInt(seconds*sampleRate));
+        fadePosition = 0;
+        fading = true;
+    }
+
+    bool isCrossfading() const
+    {
+        return fading;
+    }
+
+    //completes the swap even if the device stopped mid fade, and releases the
+    //old processor
+    void finishCrossfade()
+    {
+        {
+            const ScopedLock sl(lock);
+            if(fading)
+            {
+                active = 1-active;
+                fading = false;
+            }
+        }
+        players[1-active].setProcessor(nullptr);
+    }
+
+    //==========================================================================
+    void audioDeviceIOCallback(const float** inputChannelData, int numInputs,
+                               float** outputChannelData, int numOutputs, int numSamples)
+    {
+        const ScopedLock sl(lock);
+        if(!fading)
+        {
+            players[active].audioDeviceIOCallback(inputChannelData, numInputs, outputChannelData, numOutputs, numSamples);
+            return;
+        }
+
+        //sized in audioDeviceAboutToStart(). A bigger block than the device
+        //said it would send switches straight over rather than allocate.
+        if(numOutputs>fadeBuffer.getNumChannels() || numSamples>fadeBuffer.getNumSamples())
+        {
+            active = 1-active;
+            fading = false;
+            players[active].audioDeviceIOCallback(inputChannelData, numInputs, outputChannelData, numOutputs, numSamples);
+            return;
+        }
+
+        players[1-active].audioDeviceIOCallback(inputChannelData, numInputs,
+                                                fadeBuffer.getArrayOfWritePointers(), numOutputs, numSamples);
+        players[active].audioDeviceIOCallback(inputChannelData, numInputs, outputChannelData, numOutputs, numSamples);
+
+        AudioSampleBuffer output(outputChannelData, numOutputs, numSamples);
+        const int numFading = jmin(numSamples, fadeLength-fadePosition);
+        const float startGain = fadePosition/(float)fadeLength;
+        const float endGain = (fadePosition+numFading)/(float)fadeLength;
+
+        for(int i=0; i<numOutputs; i++)
+        {
+            output.applyGainRamp(i, 0, numFading, 1.f-startGain, 1.f-endGain);
+            if(numFading<numSamples)
+                output.clear(i, numFading, numSamples-numFading);
+
+            fadeBuffer.applyGainRamp(i, 0, numFading, startGain, endGain);
+            output.addFrom(i, 0, fadeBuffer, i, 0, numSamples);
+        }
+
+        fadePosition += numFading;
+        if(fadePosition>=fadeLength)
+        {
+            active = 1-active;
+            fading = false;
+        }
+    }
+
+    void audioDeviceAboutToStart(AudioIODevice* device)
+    {
+        players[0].audioDeviceAboutToStart(device);
+        players[1].audioDeviceAboutToStart(device);
+
+        const ScopedLock sl(lock);
+        sampleRate = device->getCurrentSampleRate();
+        numInputChannels = device->getActiveInputChannels().countNumberOfSetBits();
+        numOutputChannels = device->getActiveOutputChannels().countNumberOfSetBits();
+        fadeBuffer.setSize(numOutputChannels, device->getCurrentBufferSizeSamples());
+    }
+
+    void audioDeviceStopped()
+    {
+        players[0].audioDeviceStopped();
+        players[1].audioDeviceStopped();
+
+        const ScopedLock sl(lock);
+        sampleRate = 0;
+    }
+
+    //during a fade both processors get the incoming midi
+    void handleIncomingMidiMessage(MidiInput* source, const MidiMessage& message)
+    {
+        const ScopedLock sl(lock);
+        players[active].handleIncomingMidiMessage(source, message);
+        if(fading)
+            players[1-active].handleIncomingMidiMessage(source, message);
+    }
+
+private:
+    AudioProcessorPlayer players[2];
+    CriticalSection lock;
+    AudioSampleBuffer fadeBuffer;
+    int active;
+    double sampleRate;
+    int numInputChannels, numOutputChannels;
+    int fadeLength, fadePosition;
+    volatile bool fading;
+
+    JUCE_DECLARE_NON_COPYABLE (CrossfadingProcessorPlayer)
+};
+
+#endif   // __CROSSFADINGPROCESSORPLAYER_H__
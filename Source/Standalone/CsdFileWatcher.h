@@ -0,0 +1,287 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __CSDFILEWATCHER_H__
+#define __CSDFILEWATCHER_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../CabbageGUIClass.h"
+
+#if JUCE_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+//==============================================================================
+// Watches a csd, and every file it pulls in with #include or include(), for
+// changes made by an external editor. On Linux the files' folders are watched
+// with inotify, elsewhere the modification times are polled.
+//
+// When a file changes its text is compared with what was last loaded, and the
+// owner gets one of these action messages:
+//   "csdFileChanged:gui"        only the <Cabbage> section changed
+//   "csdFileChanged:orchestra"  anything else did, including an included file
+// Saves that don't change anything send nothing.
+//==============================================================================
+class CsdFileWatcher : public ActionBroadcaster,
+    private AsyncUpdater,
+    private Timer
+{
+public:
+    CsdFileWatcher() {}
+
+    ~CsdFileWatcher()
+    {
+        stopWatching();
+    }
+
+    void watch(const File& file)
+    {
+        stopWatching();
+        csdFile = file;
+        takeSnapshot();
+        startWatching();
+    }
+
+    void stopWatching()
+    {
+        stopTimer();
+#if JUCE_LINUX
+        watcherThread = nullptr;
+#endif
+        cancelPendingUpdate();
+        csdFile = File::nonexistent;
+        includes.clear();
+    }
+
+    bool isWatching(const File& file) const
+    {
+        return csdFile==file;
+    }
+
+    //the <Cabbage> section and everything else of a csd
+    static String getCabbageSection(const String& csdText)
+    {
+        return csdText.fromFirstOccurrenceOf("<Cabbage>", false, false)
+               .upToFirstOccurrenceOf("</Cabbage>", false, false);
+    }
+
+    static String getOrchestraText(const String& csdText)
+    {
+        return csdText.upToFirstOccurrenceOf("<Cabbage>", false, false)
+               +csdText.fromFirstOccurrenceOf("</Cabbage>", false, false);
+    }
+
+    //files named by #include in the orchestra or include() in the Cabbage section
+    static Array<File> findIncludedFiles(const File& csd, const String& csdText)
+    {
+        Array<File> files;
+        const File dir(csd.getParentDirectory());
+        StringArray lines;
+        lines.addLines(csdText);
+
+        for(int i=0; i<lines.size(); i++)
+        {
+            const String line(lines[i].trim());
+            if(line.startsWith("#include"))
+            {
+                const String name(line.fromFirstOccurrenceOf("#include", false, false).trim()
+                                  .removeCharacters("\"|"));
+                if(name.isNotEmpty())
+                    files.addIfNotAlreadyThere(dir.getChildFile(name));
+            }
+            else if(line.contains("include("))
+            {
+                CabbageGUIClass cAttr(line, -99);
+                for(int y=0; y<cAttr.getStringArrayProp(CabbageIDs::include).size(); y++)
+                    files.addIfNotAlreadyThere(dir.getChildFile(cAttr.getStringArrayPropValue(CabbageIDs::include, y)
+                                               .unquoted()));
+            }
+        }
+        return files;
+    }
+
+private:
+    struct WatchedFile
+    {
+        File file;
+        Time modTime;
+        String text;
+    };
+
+    void takeSnapshot()
+    {
+        const String csdText(csdFile.loadFileAsString());
+        csdModTime = csdFile.getLastModificationTime();
+        guiText = getCabbageSection(csdText);
+        orchestraText = getOrchestraText(csdText);
+
+        includes.clear();
+        const Array<File> files(findIncludedFiles(csdFile, csdText));
+        for(int i=0; i<files.size(); i++)
+        {
+            WatchedFile include = { files[i], files[i].getLastModificationTime(), files[i].loadFileAsString() };
+            includes.add(include);
+        }
+    }
+
+    Array<File> getWatchedFiles() const
+    {
+        Array<File> files;
+        files.add(csdFile);
+        for(int i=0; i<includes.size(); i++)
+            files.addIfNotAlreadyThere(includes.getReference(i).file);
+        return files;
+    }
+
+    void startWatching()
+    {
+#if JUCE_LINUX
+        watcherThread = new InotifyThread(*this, getWatchedFiles());
+        if(watcherThread->isValid())
+        {
+            watcherThread->startThread(3);
+            return;
+        }
+        watcherThread = nullptr;
+#endif
+        startTimer(500);
+    }
+
+    //polling, for when inotify isn't there
+    void timerCallback()
+    {
+        bool anyChanged = csdFile.getLastModificationTime()!=csdModTime;
+        for(int i=0; i<includes.size() && !anyChanged; i++)
+            anyChanged = includes.getReference(i).file.getLastModificationTime()!=includes.getReference(i).modTime;
+
+        if(anyChanged)
+            handleAsyncUpdate();
+    }
+
+    void handleAsyncUpdate()
+    {
+        const String csdText(csdFile.loadFileAsString());
+        const bool guiChanged = getCabbageSection(csdText)!=guiText;
+        bool orchestraChanged = getOrchestraText(csdText)!=orchestraText;
+
+        for(int i=0; i<includes.size() && !orchestraChanged; i++)
+            orchestraChanged = includes.getReference(i).file.loadFileAsString()!=includes.getReference(i).text;
+
+        const Array<File> previousFiles(getWatchedFiles());
+        takeSnapshot();
+
+        //the csd may now include different files
+        if(getWatchedFiles()!=previousFiles)
+        {
+            stopTimer();
+#if JUCE_LINUX
+            watcherThread = nullptr;
+#endif
+            startWatching();
+        }
+
+        if(orchestraChanged)
+            sendActionMessage("csdFileChanged:orchestra");
+        else if(guiChanged)
+            sendActionMessage("csdFileChanged:gui");
+    }
+
+#if JUCE_LINUX
+    //==========================================================================
+    // Watches the folders rather than the files, as many editors save by
+    // writing a new file and renaming it over the old one.
+    //==========================================================================
+    class InotifyThread : public Thread
+    {
+    public:
+        InotifyThread(CsdFileWatcher& w, const Array<File>& filesToWatch)
+            : Thread("csd file watcher"), owner(w), fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+        {
+            for(int i=0; i<filesToWatch.size() && fd>=0; i++)
+            {
+                const String dir(filesToWatch[i].getParentDirectory().getFullPathName());
+                files.add(filesToWatch[i].getFullPathName());
+                if(directories.contains(dir))
+                    continue;
+
+                const int wd = inotify_add_watch(fd, dir.toUTF8(), IN_CLOSE_WRITE | IN_MOVED_TO);
+                if(wd>=0)
+                    watches.set(wd, dir);
+                directories.add(dir);
+            }
+        }
+
+        ~InotifyThread()
+        {
+            stopThread(1000);
+            if(fd>=0)
+                ::close(fd);
+        }
+
+        bool isValid() const
+        {
+            return fd>=0 && watches.size()>0;
+        }
+
+        void run()
+        {
+            char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+            while(!threadShouldExit())
+            {
+                pollfd p = { fd, POLLIN, 0 };
+                if(poll(&p, 1, 250)<=0)
+                    continue;
+
+                const ssize_t length = ::read(fd, buffer, sizeof(buffer));
+                for(const char* ptr=buffer; length>0 && ptr<buffer+length;)
+                {
+                    const inotify_event* event = (const inotify_event*)ptr;
+                    if(event->len>0 && watches.contains(event->wd)
+                       && files.contains(watches[event->wd]+"/"+String::fromUTF8(event->name)))
+                        owner.triggerAsyncUpdate();
+
+                    ptr += sizeof(inotify_event)+event->len;
+                }
+            }
+        }
+
+    private:
+        CsdFileWatcher& owner;
+        const int fd;
+        HashMap<int, String> watches;
+        StringArray files, directories;
+
+        JUCE_DECLARE_NON_COPYABLE (InotifyThread)
+    };
+
+    ScopedPointer<InotifyThread> watcherThread;
+#endif
+
+    File csdFile;
+    Time csdModTime;
+    String guiText, orchestraText;
+    Array<WatchedFile> includes;
+
+    JUCE_DECLARE_NON_COPYABLE (CsdFileWatcher)
+};
+
+#endif   // __CSDFILEWATCHER_H__
@@ -0,0 +1,488 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __HEADLESSHOST_H__
+#define __HEADLESSHOST_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Plugin/CabbagePluginProcessor.h"
+
+extern CabbagePluginAudioProcessor* JUCE_CALLTYPE createCabbagePluginFilter(String inputfile, bool guiOnOff, int plugType);
+
+//==============================================================================
+// An audio device that needs no hardware. Input is read from a sound file, or
+// is silent, and output is written to a sound file, or thrown away. In real
+// time the blocks are paced by the high resolution clock, sleeping for most of
+// each block and spinning for the last millisecond. Given a length it runs
+// offline instead, rendering as fast as it can and sending a change message
+// once it's done.
+//==============================================================================
+class FileAudioIODevice : public AudioIODevice,
+    public ChangeBroadcaster,
+    private Thread
+{
+public:
+    FileAudioIODevice(const String& deviceName, const File& input, const File& output, double secondsToRender)
+        : AudioIODevice(deviceName, "File"),
+          Thread("File audio device"),
+          inputFile(input),
+          outputFile(output),
+          lengthSeconds(secondsToRender),
+          sampleRate(44100),
+          bufferSize(512),
+          numInputs(0),
+          numOutputs(0),
+          deviceIsOpen(false),
+          finished(false),
+          callback(nullptr)
+    {
+        formatManager.registerBasicFormats();
+    }
+
+    ~FileAudioIODevice()
+    {
+        close();
+    }
+
+    StringArray getOutputChannelNames()
+    {
+        return getChannelNames("Output");
+    }
+
+    StringArray getInputChannelNames()
+    {
+        return getChannelNames("Input");
+    }
+
+    Array<double> getAvailableSampleRates()
+    {
+        const double rates[] = { 22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000 };
+        return Array<double>(rates, numElementsInArray(rates));
+    }
+
+    Array<int> getAvailableBufferSizes()
+    {
+        Array<int> sizes;
+        for(int size=16; size<=8192; size*=2)
+            sizes.add(size);
+        return sizes;
+    }
+
+    int getDefaultBufferSize()
+    {
+        return 512;
+    }
+
+    String open(const BigInteger& inputChannels, const BigInteger& outputChannels,
+                double newSampleRate, int newBufferSize)
+    {
+        close();
+
+        sampleRate = newSampleRate>0 ? newSampleRate : 44100;
+        bufferSize = newBufferSize>0 ? newBufferSize : getDefaultBufferSize();
+        activeInputs = inputChannels;
+        activeOutputs = outputChannels;
+        numInputs = inputChannels.countNumberOfSetBits();
+        numOutputs = outputChannels.countNumberOfSetBits();
+
+        if(inputFile.existsAsFile())
+        {
+            reader = formatManager.createReaderFor(inputFile);
+            if(reader==nullptr)
+                return "Couldn't read "+inputFile.getFullPathName();
+        }
+
+        if(outputFile!=File::nonexistent)
+        {
+            outputFile.deleteFile();
+            ScopedPointer<FileOutputStream> stream(outputFile.createOutputStream());
+            WavAudioFormat wavFormat;
+            if(stream!=nullptr)
+                writer = wavFormat.createWriterFor(stream, sampleRate, jmax(1, numOutputs), 24, StringPairArray(), 0);
+            if(writer==nullptr)
+                return "Couldn't write to "+outputFile.getFullPathName();
+            stream.release();
+        }
+
+        inputBuffer.setSize(jmax(1, numInputs), bufferSize);
+        outputBuffer.setSize(jmax(1, numOutputs), bufferSize);
+        readPosition = 0;
+        deviceIsOpen = true;
+        return String::empty;
+    }
+
+    void close()
+    {
+        stop();
+        writer = nullptr;
+        reader = nullptr;
+        deviceIsOpen = false;
+    }
+
+    bool isOpen()
+    {
+        return deviceIsOpen;
+    }
+
+    void start(AudioIODeviceCallback* newCallback)
+    {
+        if(!deviceIsOpen || newCallback==nullptr || isThreadRunning())
+            return;
+
+        callback = newCallback;
+        callback->audioDeviceAboutToStart(this);
+        finished = false;
+        startThread(isOffline() ? 5 : 9);
+    }
+
+    void stop()
+    {
+        stopThread(2000);
+        if(callback!=nullptr)
+        {
+            callback->audioDeviceStopped();
+            callback = nullptr;
+        }
+    }
+
+    bool isPlaying()
+    {
+        return isThreadRunning();
+    }
+
+    String getLastError()
+    {
+        return String::empty;
+    }
+
+    int getCurrentBufferSizeSamples()
+    {
+        return bufferSize;
+    }
+
+    double getCurrentSampleRate()
+    {
+        return sampleRate;
+    }
+
+    int getCurrentBitDepth()
+    {
+        return 32;
+    }
+
+    BigInteger getActiveOutputChannels() const
+    {
+        return activeOutputs;
+    }
+
+    BigInteger getActiveInputChannels() const
+    {
+        return activeInputs;
+    }
+
+    int getOutputLatencyInSamples()
+    {
+        return 0;
+    }
+
+    int getInputLatencyInSamples()
+    {
+        return 0;
+    }
+
+    bool isOffline() const
+    {
+        return lengthSeconds>0;
+    }
+
+    bool hasFinished() const
+    {
+        return finished;
+    }
+
+private:
+    void run()
+    {
+        const int64 samplesToRender = isOffline() ? (int64)(lengthSeconds*sampleRate) : 0;
+        const double blockMs = 1000.0*bufferSize/sampleRate;
+        double nextBlockTime = Time::getMillisecondCounterHiRes();
+        int64 samplesDone = 0;
+
+        while(!threadShouldExit())
+        {
+            inputBuffer.clear();
+            if(reader!=nullptr)
+            {
+                //reading past the end of the file gives silence
+                reader->read(&inputBuffer, 0, bufferSize, readPosition, true, true);
+                readPosition += bufferSize;
+            }
+
+            outputBuffer.clear();
+            callback->audioDeviceIOCallback(inputBuffer.getArrayOfReadPointers(), numInputs,
+                                            outputBuffer.getArrayOfWritePointers(), numOutputs, bufferSize);
+
+            const int numToWrite = isOffline() ? (int)jmin((int64)bufferSize, samplesToRender-samplesDone) : bufferSize;
+            if(writer!=nullptr)
+                writer->writeFromAudioSampleBuffer(outputBuffer, 0, numToWrite);
+            samplesDone += numToWrite;
+
+            if(isOffline())
+            {
+                if(samplesDone>=samplesToRender)
+                {
+                    finished = true;
+                    sendChangeMessage();
+                    return;
+                }
+                continue;
+            }
+
+            nextBlockTime += blockMs;
+            double now = Time::getMillisecondCounterHiRes();
+
+            //if we've fallen more than a block behind, don't try to catch up
+            if(now>nextBlockTime+blockMs)
+                nextBlockTime = now;
+
+            for(; now<nextBlockTime && !threadShouldExit(); now = Time::getMillisecondCounterHiRes())
+            {
+                if(nextBlockTime-now>2)
+                    Thread::sleep((int)(nextBlockTime-now)-1);
+                else
+                    Thread::yield();
+            }
+        }
+    }
+
+    StringArray getChannelNames(const String& prefix) const
+    {
+        StringArray names;
+        for(int i=1; i<=8; i++)
+            names.add(prefix+" "+String(i));
+        return names;
+    }
+
+    const File inputFile, outputFile;
+    const double lengthSeconds;
+    double sampleRate;
+    int bufferSize, numInputs, numOutputs;
+    BigInteger activeInputs, activeOutputs;
+    bool deviceIsOpen;
+    volatile bool finished;
+    AudioIODeviceCallback* callback;
+
+    AudioFormatManager formatManager;
+    ScopedPointer<AudioFormatReader> reader;
+    ScopedPointer<AudioFormatWriter> writer;
+    int64 readPosition;
+    AudioSampleBuffer inputBuffer, outputBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE (FileAudioIODevice)
+};
+
+//==============================================================================
+// makes the device above available to an AudioDeviceManager as type "File",
+// with a single device called "Null"
+//==============================================================================
+class FileAudioIODeviceType : public AudioIODeviceType
+{
+public:
+    FileAudioIODeviceType(const File& input, const File& output, double secondsToRender)
+        : AudioIODeviceType("File"),
+          inputFile(input),
+          outputFile(output),
+          lengthSeconds(secondsToRender)
+    {
+    }
+
+    void scanForDevices() {}
+
+    StringArray getDeviceNames(bool /*wantInputNames*/) const
+    {
+        return StringArray("Null");
+    }
+
+    int getDefaultDeviceIndex(bool /*forInput*/) const
+    {
+        return 0;
+    }
+
+    int getIndexOfDevice(AudioIODevice* device, bool /*asInput*/) const
+    {
+        return dynamic_cast<FileAudioIODevice*>(device)!=nullptr ? 0 : -1;
+    }
+
+    bool hasSeparateInputsAndOutputs() const
+    {
+        return false;
+    }
+
+    AudioIODevice* createDevice(const String& outputDeviceName, const String& inputDeviceName)
+    {
+        if(outputDeviceName!="Null" && inputDeviceName!="Null")
+            return nullptr;
+        return new FileAudioIODevice("Null", inputFile, outputFile, lengthSeconds);
+    }
+
+private:
+    const File inputFile, outputFile;
+    const double lengthSeconds;
+
+    JUCE_DECLARE_NON_COPYABLE (FileAudioIODeviceType)
+};
+
+//==============================================================================
+// Runs a csd with no windows at all: just the processor, an audio device and
+// any MIDI inputs asked for. Started with
+//
+//   --headless file.csd [--device type/name] [--null] [--input in.wav]
+//              [--output out.wav] [--offline seconds] [--rate hz]
+//              [--block samples] [--midi-input name|all]
+//
+// --null, --input, --output and --offline all use the File device. Without
+// --device or --null the system's default device is used.
+//==============================================================================
+class HeadlessHost : private ChangeListener
+{
+public:
+    HeadlessHost() {}
+
+    ~HeadlessHost()
+    {
+        deviceManager.removeAudioCallback(&player);
+        deviceManager.removeMidiInputCallback(String::empty, &player);
+        player.setProcessor(nullptr);
+        deviceManager.closeAudioDevice();
+        processor = nullptr;
+    }
+
+    static bool isHeadless(const StringArray& args)
+    {
+        return args.contains("--headless");
+    }
+
+    static String getUsage()
+    {
+        return "usage: cabbage --headless file.csd [--device type/name] [--null] [--input in.wav]\n"
+               "                [--output out.wav] [--offline seconds] [--rate hz] [--block samples]\n"
+               "                [--midi-input name|all]\n";
+    }
+
+    //returns an error, or an empty string once the instrument is running
+    String start(const StringArray& args)
+    {
+        const File csdFile(File::getCurrentWorkingDirectory().getChildFile(getOption(args, "--headless").unquoted()));
+        if(!csdFile.existsAsFile())
+            return getUsage();
+
+        const File inputFile(getFileOption(args, "--input"));
+        const File outputFile(getFileOption(args, "--output"));
+        const double offlineSeconds = getOption(args, "--offline").getDoubleValue();
+        String device(getOption(args, "--device").unquoted());
+
+        const bool useFileDevice = args.contains("--null") || device.upToFirstOccurrenceOf("/", false, false)=="File"
+                                   || inputFile!=File::nonexistent || outputFile!=File::nonexistent || offlineSeconds>0;
+
+        CabbagePluginAudioProcessor::setRunningHeadless(true);
+        processor = createCabbagePluginFilter(csdFile.getFullPathName(), false, AUDIO_PLUGIN);
+        if(processor==nullptr || processor->getCompileStatus()!=OK)
+            return "Csound couldn't compile "+csdFile.getFullPathName()+"\n";
+
+        //the File device is the only type created when it's used, so no
+        //hardware is ever touched
+        if(useFileDevice)
+        {
+            deviceManager.addAudioDeviceType(new FileAudioIODeviceType(inputFile, outputFile, offlineSeconds));
+            device = "File/Null";
+        }
+        else
+            deviceManager.getAvailableDeviceTypes();
+
+        XmlElement setup("DEVICESETUP");
+        if(device.isNotEmpty())
+        {
+            setup.setAttribute("deviceType", device.upToFirstOccurrenceOf("/", false, false));
+            setup.setAttribute("audioDeviceName", device.fromFirstOccurrenceOf("/", false, false));
+        }
+        setup.setAttribute("audioDeviceRate", args.contains("--rate") ? getOption(args, "--rate").getDoubleValue()
+                           : processor->getCsoundSamplingRate());
+        setup.setAttribute("audioDeviceBufferSize", args.contains("--block") ? getOption(args, "--block").getIntValue() : 512);
+
+        const String midiInput(getOption(args, "--midi-input").unquoted());
+        const StringArray midiDevices(MidiInput::getDevices());
+        for(int i=0; i<midiDevices.size(); i++)
+            if(midiInput=="all" || midiInput==midiDevices[i])
+                setup.createNewChildElement("MIDIINPUT")->setAttribute("name", midiDevices[i]);
+
+        //the player is attached before the device starts, as an offline render
+        //may otherwise be over before it's heard anything
+        processor->setNonRealtime(useFileDevice && offlineSeconds>0);
+        player.setProcessor(processor);
+        deviceManager.addMidiInputCallback(String::empty, &player);
+        deviceManager.addAudioCallback(&player);
+
+        const String error(deviceManager.initialise(processor->getNumInputChannels(), processor->getNumOutputChannels(),
+                           &setup, false));
+        AudioIODevice* const audioDevice = deviceManager.getCurrentAudioDevice();
+        if(audioDevice==nullptr)
+            return "Couldn't open the audio device: "+error+"\n";
+
+        //a short render may already be over, before there was anyone to tell
+        if(FileAudioIODevice* fileDevice = dynamic_cast<FileAudioIODevice*>(audioDevice))
+        {
+            fileDevice->addChangeListener(this);
+            changeListenerCallback(fileDevice);
+        }
+
+        std::cout << "Running " << csdFile.getFullPathName() << " on " << deviceManager.getCurrentAudioDeviceType()
+                  << "/" << audioDevice->getName() << " at " << audioDevice->getCurrentSampleRate() << " Hz, "
+                  << audioDevice->getCurrentBufferSizeSamples() << " sample blocks\n";
+        return String::empty;
+    }
+
+private:
+    //an offline render has finished
+    void changeListenerCallback(ChangeBroadcaster* source)
+    {
+        if(FileAudioIODevice* fileDevice = dynamic_cast<FileAudioIODevice*>(source))
+            if(fileDevice->hasFinished())
+                JUCEApplication::quit();
+    }
+
+    static String getOption(const StringArray& args, const String& name)
+    {
+        const int index = args.indexOf(name);
+        return index>=0 ? args[index+1] : String::empty;
+    }
+
+    static File getFileOption(const StringArray& args, const String& name)
+    {
+        const String path(getOption(args, name).unquoted());
+        return path.isNotEmpty() ? File::getCurrentWorkingDirectory().getChildFile(path) : File::nonexistent;
+    }
+
+    ScopedPointer<CabbagePluginAudioProcessor> processor;
+    AudioDeviceManager deviceManager;
+    AudioProcessorPlayer player;
+
+    JUCE_DECLARE_NON_COPYABLE (HeadlessHost)
+};
+
+#endif   // __HEADLESSHOST_H__
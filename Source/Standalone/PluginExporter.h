@@ -0,0 +1,417 @@
+/*
+  Copyright (c) 2015 - Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef __PLUGINEXPORTER_H__
+#define __PLUGINEXPORTER_H__
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../CabbageGUIClass.h"
+
+//==============================================================================
+// One of the plugin libraries that Cabbage ships with. Exported plugins are
+// copies of it with the plugin ID and name placeholders overwritten. The
+// library is mapped into memory once, and a single pass over it finds every
+// placeholder, so any number of plugins can then be written from it, on any
+// number of threads.
+//==============================================================================
+class PluginTemplate
+{
+public:
+    PluginTemplate(const File& library)
+        : map(library, MemoryMappedFile::readOnly)
+    {
+        if(isValid())
+            findPlaceholders((const uint8*)map.getData(), (int64)map.getSize());
+    }
+
+    bool isValid() const
+    {
+        return map.getData()!=nullptr;
+    }
+
+    //the places the 4 character plugin ID, and the 16 character name, are written
+    const Array<int64>& getIdOffsets() const
+    {
+        return idOffsets;
+    }
+
+    const Array<int64>& getNameOffsets() const
+    {
+        return nameOffsets;
+    }
+
+    //writes a copy of the library, with the ID and name patched in if given
+    bool writeCopy(const File& destination, const String& pluginId, const String& pluginName) const
+    {
+        destination.deleteFile();
+        FileOutputStream out(destination);
+        if(out.failedToOpen() || !isValid())
+            return false;
+
+        Array<Patch> patches(getPatches(pluginId, pluginName));
+        const char* const data = (const char*)map.getData();
+        int64 position = 0;
+
+        for(int i=0; i<patches.size(); i++)
+        {
+            //a placeholder that overlaps the one before it has already been written over
+            if(patches[i].offset<position)
+                continue;
+            out.write(data+position, (size_t)(patches[i].offset-position));
+            out.write(patches[i].text.getData(), patches[i].text.getSize());
+            position = patches[i].offset+patches[i].text.getSize();
+        }
+
+        out.write(data+position, (size_t)((int64)map.getSize()-position));
+        out.flush();
+        return out.getStatus().wasOk();
+    }
+
+    //patches a library that has already been copied into place, and returns
+    //an error if it couldn't be
+    static String patchFile(const File& library, const String& pluginId, const String& pluginName)
+    {
+        Array<Patch> patches;
+        bool foundName;
+        {
+            //the mapping has to be gone before the file is written to on Windows
+            const PluginTemplate original(library);
+            if(!original.isValid())
+                return "File could not be opened";
+            foundName = original.getNameOffsets().size()>0;
+            patches = original.getPatches(pluginId, pluginName);
+        }
+
+        FileOutputStream out(library);
+        if(out.failedToOpen())
+            return "File could not be opened";
+
+        for(int i=0; i<patches.size(); i++)
+        {
+            out.setPosition(patches[i].offset);
+            out.write(patches[i].text.getData(), patches[i].text.getSize());
+        }
+        out.flush();
+        return foundName ? String::empty : "Plugin name could not be set?!?";
+    }
+
+    //the plugin ID set with form's pluginID() identifier
+    static String getPluginId(const String& csdText)
+    {
+        StringArray csdLines;
+        csdLines.addLines(csdText);
+        for(int i=0; i<csdLines.size(); i++)
+        {
+            StringArray tokes;
+            tokes.addTokens(csdLines[i].trimEnd(), ", ", "\"");
+            if(tokes[0].equalsIgnoreCase("form"))
+            {
+                CabbageGUIClass cAttr(csdLines[i].trimEnd(), 0);
+                return cAttr.getStringProp(CabbageIDs::pluginid);
+            }
+        }
+        return String::empty;
+    }
+
+    //plugin names are written into a 16 byte placeholder, see addPatch()
+    static String getPluginName(const File& csdFile)
+    {
+        return csdFile.getFileNameWithoutExtension();
+    }
+
+private:
+    struct Patch
+    {
+        int64 offset;
+        MemoryBlock text;
+    };
+
+    Array<Patch> getPatches(const String& pluginId, const String& pluginName) const
+    {
+        Array<Patch> patches;
+        //IDs are 4 bytes, so anything but 4 ASCII characters is left alone
+        if(pluginId.length()==4 && pluginId.getNumBytesAsUTF8()==4)
+            for(int i=0; i<idOffsets.size(); i++)
+                addPatch(patches, idOffsets[i], pluginId, 4);
+
+        //only the first name placeholder was ever written
+        if(pluginName.isNotEmpty() && nameOffsets.size()>0)
+            addPatch(patches, nameOffsets[0], pluginName, 16);
+        return patches;
+    }
+
+    //the text is cut at a character boundary to fit the placeholder's bytes,
+    //and padded out to them with spaces
+    static void addPatch(Array<Patch>& patches, int64 offset, const String& text, int numBytes)
+    {
+        Patch patch = { offset, MemoryBlock((size_t)numBytes) };
+        patch.text.fillWith(' ');
+
+        CharPointer_UTF8 source(text.toUTF8());
+        size_t used = 0;
+        while(!source.isEmpty())
+        {
+            const size_t charBytes = CharPointer_UTF8::getBytesRequiredFor(*source);
+            if(used+charBytes>(size_t)numBytes)
+                break;
+            CharPointer_UTF8 start(source);
+            ++source;
+            patch.text.copyFrom(start.getAddress(), (int)used, charBytes);
+            used += charBytes;
+        }
+
+        int index = 0;
+        while(index<patches.size() && patches.getReference(index).offset<offset)
+            index++;
+        patches.insert(index, patch);
+    }
+
+    //both placeholders start with different bytes, so one pass that only
+    //compares at those bytes finds all of them
+    void findPlaceholders(const uint8* data, int64 size)
+    {
+        static const char* const pluginIdPlaceholder = "YROR";
+        static const char* const pluginNamePlaceholder = "CabbageEffectNam";
+        const uint8 idStart = (uint8)pluginIdPlaceholder[0];
+        const uint8 nameStart = (uint8)pluginNamePlaceholder[0];
+
+        for(int64 i=0; i<size; i++)
+        {
+            if(data[i]==idStart && i+4<=size && memcmp(data+i, pluginIdPlaceholder, 4)==0)
+                idOffsets.add(i);
+            else if(data[i]==nameStart && i+16<=size && memcmp(data+i, pluginNamePlaceholder, 16)==0)
+                nameOffsets.add(i);
+        }
+    }
+
+    MemoryMappedFile map;
+    Array<int64> idOffsets, nameOffsets;
+
+    JUCE_DECLARE_NON_COPYABLE (PluginTemplate)
+};
+
+//==============================================================================
+// Exports many csd files as plugins at once, one per thread pool job. Can be
+// run from the command line with
+//
+//   --export VST|VSTi|LV2-fx|LV2-ins file.csd|folder ... [--output folder]
+//            [--jobs threads]
+//
+// Folders are searched for csd files. Without --output each plugin is written
+// next to its csd, as the Export menu does.
+//==============================================================================
+class BatchPluginExporter
+{
+public:
+    BatchPluginExporter(const String& pluginType, const File& outputFolder = File::nonexistent)
+        : type(pluginType), outputDir(outputFolder), numExported(0)
+    {
+        library = new PluginTemplate(getTemplateFor(type));
+    }
+
+    static bool isExportCommand(const StringArray& args)
+    {
+        return args.contains("--export");
+    }
+
+    static File getTemplateFor(const String& type)
+    {
+        const File appDir(File::getSpecialLocation(File::currentExecutableFile).getParentDirectory());
+#ifdef WIN32
+        return appDir.getChildFile(type.contains("VSTi") ? "CabbagePluginSynth.dat" : "CabbagePluginEffect.dat");
+#else
+        if(type.contains("LV2-ins"))
+            return appDir.getChildFile("CabbagePluginSynthLV2.so");
+        else if(type.contains("LV2"))
+            return appDir.getChildFile("CabbagePluginEffectLV2.so");
+        return appDir.getChildFile(type.contains("VSTi") ? "CabbagePluginSynth.so" : "CabbagePluginEffect.so");
+#endif
+    }
+
+    bool canExport() const
+    {
+        return library->isValid();
+    }
+
+    //blocks until every file has been exported, and returns the number that were
+    int exportFiles(const Array<File>& csdFiles, int numThreads = SystemStats::getNumCpus())
+    {
+        ThreadPool pool(jmax(1, numThreads));
+        for(int i=0; i<csdFiles.size(); i++)
+            pool.addJob(new ExportJob(*this, csdFiles[i]), true);
+
+        while(pool.getNumJobs()>0)
+            Thread::sleep(10);
+        return numExported.get();
+    }
+
+    StringArray getErrors() const
+    {
+        const ScopedLock sl(lock);
+        return errors;
+    }
+
+    //exports everything named on the command line and returns the exit code
+    static int runFromCommandLine(const StringArray& args)
+    {
+        const String type(getOption(args, "--export"));
+        const String outputPath(getOption(args, "--output").unquoted());
+        const File outputFolder(outputPath.isNotEmpty() ? File::getCurrentWorkingDirectory().getChildFile(outputPath)
+                                : File::nonexistent);
+
+        Array<File> files;
+        for(int i=0; i<args.size(); i++)
+        {
+            //every option takes a value
+            if(args[i].startsWith("--"))
+            {
+                i++;
+                continue;
+            }
+
+            const File file(File::getCurrentWorkingDirectory().getChildFile(args[i].unquoted()));
+            if(file.isDirectory())
+                file.findChildFiles(files, File::findFiles, true, "*.csd");
+            else if(file.hasFileExtension(".csd"))
+                files.add(file);
+        }
+
+        BatchPluginExporter exporter(type, outputFolder);
+        if(type.isEmpty() || files.size()==0 || !exporter.canExport())
+        {
+            std::cerr << "usage: cabbage --export VST|VSTi|LV2-fx|LV2-ins file.csd|folder ... [--output folder] [--jobs threads]\n";
+            if(type.isNotEmpty() && !exporter.canExport())
+                std::cerr << "can't find " << getTemplateFor(type).getFullPathName() << "\n";
+            return 1;
+        }
+
+        if(outputFolder!=File::nonexistent)
+            outputFolder.createDirectory();
+
+        const int numThreads = args.contains("--jobs") ? getOption(args, "--jobs").getIntValue() : SystemStats::getNumCpus();
+        const int numExported = exporter.exportFiles(files, numThreads);
+        const StringArray errors(exporter.getErrors());
+        for(int i=0; i<errors.size(); i++)
+            std::cerr << errors[i] << "\n";
+
+        std::cout << "Exported " << numExported << " of " << files.size() << " instruments as " << type << "\n";
+        return errors.size()>0 ? 1 : 0;
+    }
+
+private:
+    class ExportJob : public ThreadPoolJob
+    {
+    public:
+        ExportJob(BatchPluginExporter& e, const File& file)
+            : ThreadPoolJob("Plugin export"), exporter(e), csdFile(file) {}
+
+        JobStatus runJob()
+        {
+            const String error(exporter.exportPlugin(csdFile));
+            if(error.isNotEmpty())
+                exporter.addError(csdFile.getFullPathName()+": "+error);
+            else
+                ++exporter.numExported;
+            return jobHasFinished;
+        }
+
+    private:
+        BatchPluginExporter& exporter;
+        const File csdFile;
+    };
+
+    //returns an error, or an empty string once the plugin has been written
+    String exportPlugin(const File& csdFile) const
+    {
+        const String csdText(csdFile.loadFileAsString());
+        const String filename(csdFile.getFileNameWithoutExtension());
+        const File folder(outputDir!=File::nonexistent ? outputDir : csdFile.getParentDirectory());
+
+        if(type.contains("LV2"))
+        {
+            const File bundle(folder.getChildFile(filename+".lv2"));
+            bundle.createDirectory();
+            const File dll(bundle.getChildFile(filename+".so"));
+            if(!library->writeCopy(dll, String::empty, String::empty))
+                return "can't write "+dll.getFullPathName();
+            bundle.getChildFile(filename+".csd").replaceWithText(csdText);
+            return generateTtl(bundle, dll, filename);
+        }
+
+#ifdef WIN32
+        const File dll(folder.getChildFile(filename+".dll"));
+#else
+        const File dll(folder.getChildFile(filename+".so"));
+#endif
+        const String pluginId(PluginTemplate::getPluginId(csdText));
+        if(!library->writeCopy(dll, pluginId, PluginTemplate::getPluginName(csdFile)))
+            return "can't write "+dll.getFullPathName();
+
+        const File pluginCsd(dll.withFileExtension(".csd"));
+        if(pluginCsd!=csdFile)
+            pluginCsd.replaceWithText(csdText);
+
+        if(pluginId.length()!=4)
+            return "the plugin ID must be 4 characters long, so it wasn't set";
+        return String::empty;
+    }
+
+    //the ttl generator writes to the working directory, so only one plugin can
+    //be doing it at a time
+    static String generateTtl(const File& bundle, const File& dll, const String& filename)
+    {
+        typedef void (*TTL_Generator_Function)(const char* basename);
+        static CriticalSection ttlLock;
+        const ScopedLock sl(ttlLock);
+
+        DynamicLibrary lib(dll.getFullPathName());
+        TTL_Generator_Function genFunc = (TTL_Generator_Function)lib.getFunction("lv2_generate_ttl");
+        if(!genFunc)
+            return "can't generate LV2 data";
+
+        File oldCWD(File::getCurrentWorkingDirectory());
+        bundle.setAsCurrentWorkingDirectory();
+        (genFunc)(filename.toRawUTF8());
+        oldCWD.setAsCurrentWorkingDirectory();
+        return String::empty;
+    }
+
+    void addError(const String& error)
+    {
+        const ScopedLock sl(lock);
+        errors.add(error);
+    }
+
+    static String getOption(const StringArray& args, const String& name)
+    {
+        const int index = args.indexOf(name);
+        return index>=0 ? args[index+1] : String::empty;
+    }
+
+    const String type;
+    const File outputDir;
+    ScopedPointer<PluginTemplate> library;
+    Atomic<int> numExported;
+    CriticalSection lock;
+    StringArray errors;
+
+    JUCE_DECLARE_NON_COPYABLE (BatchPluginExporter)
+};
+
+#endif   // __PLUGINEXPORTER_H__
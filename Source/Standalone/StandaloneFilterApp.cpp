@@ -1,4 +1,6 @@
 #include "CabbageStandaloneDialog.h"
+#include "HeadlessHost.h"
+#include "PluginExporter.h"
 #include "../CabbageGUIClass.h"
 #include "../CabbageUtils.h"
 #include "../CabbageLookAndFeel.h"
@@ -67,6 +69,37 @@ public:
         defaultPropSet->setValue("windowX", 100);
         defaultPropSet->setValue("windowY", 100);
         appProperties->getUserSettings()->setFallbackPropertySet(defaultPropSet);
+
+        //time control painting with and without the sprite cache, then quit
+        if(commandLineParameters.contains("--benchmark-controls"))
+        {
+            std::cout << CabbageLookAndFeel::benchmarkControlRendering(200, 100);
+            quit();
+            return;
+        }
+
+        //export csd files as plugins, then quit
+        if(BatchPluginExporter::isExportCommand(getCommandLineParameterArray()))
+        {
+            setApplicationReturnValue(BatchPluginExporter::runFromCommandLine(getCommandLineParameterArray()));
+            quit();
+            return;
+        }
+
+        //no windows, just the instrument and an audio device
+        if(HeadlessHost::isHeadless(getCommandLineParameterArray()))
+        {
+            headlessHost = new HeadlessHost();
+            const String error(headlessHost->start(getCommandLineParameterArray()));
+            if(error.isNotEmpty())
+            {
+                std::cerr << error;
+                setApplicationReturnValue(1);
+                quit();
+            }
+            return;
+        }
+
         filterWindow = new StandaloneFilterWindow (String("Cabbage"), Colours::black, getCommandLineParameters());
         filterWindow->setTitleBarButtonsRequired (DocumentWindow::allButtons, false);
         filterWindow->setVisible (true);
@@ -78,6 +111,7 @@ public:
     void shutdown()
     {
         filterWindow = 0;// = nullptr;
+        headlessHost = nullptr;
         if(appProperties==nullptr)
             cUtils::debug("null");
         appProperties->closeFiles();
@@ -105,6 +139,7 @@ public:
 
 private:
     ScopedPointer<StandaloneFilterWindow> filterWindow;
+    ScopedPointer<HeadlessHost> headlessHost;
 };
 
 START_JUCE_APPLICATION (CabbageStandalone)
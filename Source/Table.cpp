@@ -208,6 +208,7 @@ void TableManager::setGridColour(Colour col)
         tables[i]->gridColour = col;
         if(col.getAlpha()==0x00)
             tables[i]->drawGrid = false;
+        tables[i]->repaint();
     }
 }
 
@@ -513,8 +514,7 @@ void TableManager::bringTableToFront(int ftNumber)
 //==============================================================================
 // GenTable display  component
 //==============================================================================
-GenTable::GenTable():	thumbnailCache (5),
-    currentPlayPosition(0),
+GenTable::GenTable():	currentPlayPosition(0),
     mouseDownX(0),
     mouseUpX(0),
     drawWaveform(false),
@@ -537,9 +537,13 @@ GenTable::GenTable():	thumbnailCache (5),
     zoomButtonsOffset(10),
     drawGrid(false),
     shouldFill(true),
+    traceThickness(1.f),
+    layerScale(1.f),
+    gridLayerKey(0),
+    waveformLayerKey(0),
+    waveformVersion(0),
     vuGradient(Colours::yellow, 0.f, 0.f, Colours::red, getWidth(), getHeight(), false)
 {
-    thumbnail=nullptr;
     addAndMakeVisible(scrollbar = new ScrollBar(false));
     scrollbar->setRangeLimits (visibleRange);
     scrollbar->setAutoHide (false);
@@ -558,8 +562,6 @@ GenTable::GenTable():	thumbnailCache (5),
 GenTable::~GenTable()
 {
     scrollbar->removeListener (this);
-    if(thumbnail)
-        thumbnail->removeChangeListener (this);
 }
 //==============================================================================
 void GenTable::addTable(int sr, const Colour col, int igen, Array<float> ampRange)
@@ -577,14 +579,7 @@ void GenTable::addTable(int sr, const Colour col, int igen, Array<float> ampRang
 
     //set up table according to type of GEN used to create it
     if(genRoutine==1)
-    {
-        formatManager.registerBasicFormats();
-        thumbnail = new AudioThumbnail(2, formatManager, thumbnailCache);
-        thumbnail->addChangeListener (this);
         setZoomFactor (0.0);
-    }
-    else
-        setBufferedToImage(true);
 
 
 }
@@ -759,16 +754,13 @@ void GenTable::setWaveform(AudioSampleBuffer buffer)
     {
         tableSize = buffer.getNumSamples();
         genRoutine=1;
-        thumbnail->clear();
-        repaint();
-        thumbnail->reset(buffer.getNumChannels(), 44100, buffer.getNumSamples());
-        thumbnail->addBlock(0, buffer, 0, buffer.getNumSamples());
-        const Range<double> newRange (0.0, thumbnail->getTotalLength());
+        //only the regions that changed since the last update are rescanned
+        samplePeaks.setBuffer(buffer);
+        const Range<double> newRange (0.0, getSampleLength());
         scrollbar->setRangeLimits (newRange);
         setRange (newRange);
         //setZoomFactor(zoom);
-        //Logger::writeToLog("updating waveform:Length "+String(thumbnail->getTotalLength()));
-        repaint();
+        repaintWaveformLayer();
     }
 }
 
@@ -776,14 +768,10 @@ void GenTable::setWaveform(Array<float, CriticalSection> buffer, bool updateRang
 {
     if(genRoutine != 1)
     {
-        waveformBuffer.clear();
+        const Range<int> changed = PeakPyramid::findChangedRegion(waveformBuffer.getRawDataPointer(), waveformBuffer.size(),
+                                                                  buffer.getRawDataPointer(), buffer.size());
         waveformBuffer = buffer;
-
-        for(int i=0; i<buffer.size(); i++)
-        {
-            //cUtils::debug(String(i)+":"+String(buffer[i]));
-        }
-
+        tablePeaks.update(waveformBuffer.getRawDataPointer(), waveformBuffer.size(), changed.getStart(), changed.getEnd());
 
         //waveformBuffer.swapWith(buffer);
         tableSize = waveformBuffer.size();
@@ -800,14 +788,11 @@ void GenTable::setWaveform(Array<float, CriticalSection> buffer, bool updateRang
 
         if(minMax.getLength()==0)
         {
-            minMax = findMinMax(buffer);
+            minMax = tablePeaks.getMinMax(waveformBuffer.getRawDataPointer(), 0, waveformBuffer.size());
             handleViewer->minMax = minMax;
         }
 
-        //if(genRoutine==2 && qsteps==1)
-        //	drawGridImage(true, getWidth(), getHeight(), 0.0);
-
-        repaint();
+        repaintWaveformLayer();
     }
 
 }
@@ -893,9 +878,9 @@ void GenTable::setZoomFactor (double amount)
     zoom = amount;
     if(genRoutine==1)
     {
-        if (thumbnail->getTotalLength() > 0)
+        if (getSampleLength() > 0)
         {
-            const double newScale = jmax (0.001, thumbnail->getTotalLength() * (1.0 - jlimit (0.0, 0.99, amount)));
+            const double newScale = jmax (0.001, getSampleLength() * (1.0 - jlimit (0.0, 0.99, amount)));
             const double timeAtCentre = xToTime (getWidth() / 2.0f);
             if(amount!=0)
             {
@@ -904,7 +889,7 @@ void GenTable::setZoomFactor (double amount)
 
             }
             else
-                setRange (Range<double> (0, thumbnail->getTotalLength()));
+                setRange (Range<double> (0, getSampleLength()));
         }
     }
     else
@@ -935,14 +920,12 @@ const Image GenTable::drawGridImage(bool redraw, double width, double height, do
 
         //g.setColour(Colours::red);
         //draw grid image
+        //every element shares one of two toggle images
+        const Image onImage = cUtils::drawToggleImage(widthOfGridElement-3.f, height, true, colour, true, "");
+        const Image offImage = cUtils::drawToggleImage(widthOfGridElement-3.f, height, false, colour, true, "");
         for(double i=0; i<waveformBuffer.size(); i++)
         {
-            g.drawImageAt(cUtils::drawToggleImage(widthOfGridElement-3.f,
-                                                  height,
-                                                  (waveformBuffer[i]>0.0 ? true : false),
-                                                  colour,
-                                                  true,
-                                                  ""),
+            g.drawImageAt((waveformBuffer[i]>0.0 ? onImage : offImage),
                           i*(widthOfGridElement)+2,
                           1.f);
         }
@@ -1030,24 +1013,92 @@ void GenTable::setRange(Range<double> newRange, bool isScrolling)
     repaint();
 }
 //==============================================================================
+// GenTable is drawn from two cached layers, the background grid and the
+// waveform. Each layer is only re-rendered when something it depends on
+// changes. The scrubber and edit handles are child components sitting on top,
+// so moving them only repaints a small area which is blitted from the layers.
+//==============================================================================
 void GenTable::paint (Graphics& g)
 {
-    g.fillAll (backgroundColour);
     //set thumbArea, this is the area of the painted image
     thumbArea = getLocalBounds();
     thumbArea.setHeight(getHeight()-paintFooterHeight);
-    float prevY=0, prevX=0, currY=0, currX=0;
-    const double scrollingResolution = (zoom == 0 ? 1 : 0.1);
+    numPixelsPerIndex = ((double)thumbArea.getWidth() / visibleLength);
+
+    const float scale = jmax(1.f, g.getInternalContext().getPhysicalPixelScaleFactor());
+    const int imageWidth = jmax(1, roundToInt(getWidth()*scale));
+    const int imageHeight = jmax(1, roundToInt(getHeight()*scale));
+
+    if(scale!=layerScale || backgroundImage.getWidth()!=imageWidth || backgroundImage.getHeight()!=imageHeight)
+    {
+        layerScale = scale;
+        backgroundImage = Image(Image::ARGB, imageWidth, imageHeight, true);
+        waveformImage = Image(Image::ARGB, imageWidth, imageHeight, true);
+        gridLayerKey = waveformLayerKey = 0;
+    }
+
+    const int64 newGridKey = getGridLayerKey();
+    if(newGridKey!=gridLayerKey)
+    {
+        backgroundImage.clear(backgroundImage.getBounds());
+        Graphics layer(backgroundImage);
+        layer.addTransform(AffineTransform::scale(layerScale));
+        drawGridLayer(layer);
+        gridLayerKey = newGridKey;
+    }
+
+    const int64 newWaveformKey = getWaveformLayerKey();
+    if(newWaveformKey!=waveformLayerKey)
+    {
+        waveformImage.clear(waveformImage.getBounds());
+        Graphics layer(waveformImage);
+        layer.addTransform(AffineTransform::scale(layerScale));
+        drawWaveformLayer(layer);
+        waveformLayerKey = newWaveformKey;
+    }
+
+    g.drawImage(backgroundImage, 0, 0, getWidth(), getHeight(), 0, 0, imageWidth, imageHeight, false);
+    g.drawImage(waveformImage, 0, 0, getWidth(), getHeight(), 0, 0, imageWidth, imageHeight, false);
+}
+
+//==============================================================================
+int64 GenTable::getGridLayerKey() const
+{
+    String key;
+    key << getWidth() << "|" << getHeight() << "|" << paintFooterHeight << "|" << (int)showScroll << "|"
+        << backgroundColour.toString() << "|" << gridColour.toString() << "|" << (int)drawGrid << "|"
+        << qsteps << "|" << tableSize << "|" << numPixelsPerIndex;
+    return key.hashCode64();
+}
+
+int64 GenTable::getWaveformLayerKey() const
+{
+    String key;
+    key << getWidth() << "|" << getHeight() << "|" << paintFooterHeight << "|" << (int)showScroll << "|"
+        << colour.toString() << "|" << traceThickness << "|" << (int)shouldFill << "|"
+        << qsteps << "|" << tableSize << "|" << genRoutine << "|" << minMax.getStart() << "|" << minMax.getEnd() << "|"
+        << visibleRange.getStart() << "|" << visibleRange.getEnd() << "|" << visibleStart << "|" << visibleEnd << "|"
+        << handleViewer->getX() << "|" << handleViewer->getWidth() << "|" << waveformVersion;
+    return key.hashCode64();
+}
+
+void GenTable::repaintWaveformLayer()
+{
+    waveformVersion++;
+    repaint();
+}
+
+//==============================================================================
+void GenTable::drawGridLayer(Graphics& g)
+{
+    g.fillAll (backgroundColour);
     const bool interp = (getWidth()<tableSize ? true : false);
     const double thumbHeight = thumbArea.getHeight()-(showScroll==true? 10 : 0);//scrollbar thickness
-    numPixelsPerIndex = ((double)thumbArea.getWidth() / visibleLength);
-    Path vuPath;
 
     //don't draw a grid when the table itself is a grid
     if(drawGrid==true && qsteps!=1)
     {
         g.setColour(gridColour);
-        //g.drawImageAt(backgroundImage, 0, 0, true);
         const double divisors = (getWidth()>300 ? 20.0 : 10.0);
         for(float i=0; i<getWidth(); i+=(interp ? getWidth()/divisors : numPixelsPerIndex))
             g.drawVerticalLine(i+1, 0, thumbHeight);
@@ -1059,94 +1110,110 @@ void GenTable::paint (Graphics& g)
 
         g.drawHorizontalLine(thumbHeight-.5, 1, getWidth());
     }
+}
 
-    //if gen01 then use an audio thumbnail class
+//==============================================================================
+void GenTable::drawWaveformLayer(Graphics& g)
+{
+    const double thumbHeight = thumbArea.getHeight()-(showScroll==true? 10 : 0);//scrollbar thickness
+
+    //gen01 and large tables are drawn from their peak pyramids, one column per pixel
     if(genRoutine==1 || waveformBuffer.size()>MAX_TABLE_SIZE)
     {
         g.setColour (colour);
-        thumbnail->drawChannels(g, thumbArea.reduced (2), visibleRange.getStart(), visibleRange.getEnd(), .8f);
-        g.setColour(colour.contrasting(.5f).withAlpha(.7f));
-        float zoomFactor = thumbnail->getTotalLength()/visibleRange.getLength();
-        regionWidth = (regionWidth=2 ? 2 : regionWidth*zoomFactor);
+        samplePeaks.drawChannels(g, thumbArea.reduced (2), visibleRange.getStart()*sampleRate,
+                                 visibleRange.getEnd()*sampleRate, .8f);
+        return;
     }
-    //else draw the waveform directly onto this component
-    //edit handles get placed on the handleViewer, which is placed on top of this component
-    else
-    {
-        vuPath.startNewSubPath(0, thumbArea.getHeight()+5.f);
 
-        //if drawing VU meter then we don't need a high resolution for the drawing.
-        float incr = (tableSize<=2 ? 1 : visibleLength/((double)thumbArea.getWidth()));
-        prevY = ampToPixel(thumbHeight, minMax, waveformBuffer[0]);
-        float midPoint;
-        bool drawTrace=true;
+    //when qsteps == 1 the table is drawn as a grid of toggles
+    if(qsteps==1)
+    {
+        g.drawImageAt(drawGridImage(true, handleViewer->getWidth(), thumbHeight-4, handleViewer->getX()), 0, 0, false);
+        return;
+    }
 
-        if(genRoutine==7 || genRoutine==5 || genRoutine==2 || genRoutine==27)
+    //if table is size of two or less draw as a VU meter using a path.
+    if(tableSize<=2)
+    {
+        Path vuPath;
+        vuPath.startNewSubPath(0, thumbArea.getHeight()+5.f);
+        float prevX = 0;
+        const float prevY = ampToPixel(thumbHeight, minMax, waveformBuffer[0]);
+        for(double i=visibleStart; i<=visibleEnd; i++)
         {
-            midPoint = ampToPixel(thumbHeight, minMax, minMax.getStart());
-            drawTrace= false;
+            vuPath.addRectangle(prevX, prevY, prevX+numPixelsPerIndex, thumbHeight);
+            prevX = jmax(0.0, (i-visibleStart)*numPixelsPerIndex);
         }
+        vuPath.lineTo(prevX, thumbArea.getHeight());
+        vuPath.closeSubPath();
+        g.setGradientFill(vuGradient);
+        g.fillPath(vuPath);
+        return;
+    }
 
-        else
-            midPoint = ampToPixel(thumbHeight, minMax, minMax.getLength()/2.f-minMax.getEnd());
-
-        int gridIndex=ceil(visibleStart);
-        float lineDepth=1;
-        for(double i=visibleStart; i<=visibleEnd; i+=incr)
+    //the trace and its fill are built as single paths, one peak pair per pixel
+    //when the table is wider than the display
+    const float incr = visibleLength/((double)thumbArea.getWidth());
+    float midPoint;
+    if(genRoutine==7 || genRoutine==5 || genRoutine==2 || genRoutine==27)
+        midPoint = ampToPixel(thumbHeight, minMax, minMax.getStart());
+    else
+        midPoint = ampToPixel(thumbHeight, minMax, minMax.getLength()/2.f-minMax.getEnd());
+
+    Path trace, fill;
+    float prevX = 0, prevY = ampToPixel(thumbHeight, minMax, waveformBuffer[0]);
+    trace.startNewSubPath(prevX, prevY);
+    fill.startNewSubPath(prevX, midPoint);
+    fill.lineTo(prevX, prevY);
+
+    if(incr>1.f)
+    {
+        //several indices share each pixel, so trace their peaks rather than
+        //whichever index happens to land on the pixel
+        const int numPixels = thumbArea.getWidth();
+        HeapBlock<float> mins(numPixels), maxs(numPixels);
+        tablePeaks.getPeaks(waveformBuffer.getRawDataPointer(), visibleStart, incr, numPixels, mins, maxs);
+        for(int x=0; x<numPixels; x++)
         {
-            //when qsteps == 1 we draw a grid
-            if(qsteps==1)
+            const float maxY = ampToPixel(thumbHeight, minMax, maxs[x]);
+            const float minY = ampToPixel(thumbHeight, minMax, mins[x]);
+            trace.lineTo(x, maxY);
+            fill.lineTo(x, maxY);
+            if(minY!=maxY)
             {
-                if(cUtils::compDouble(i, gridIndex))
-                {
-                    gridIndex++;
-                    g.drawImageAt(drawGridImage(true, handleViewer->getWidth(), thumbHeight-4, handleViewer->getX()), 0, 0, false);
-                }
-            }
-
-            else
-            {
-                //minMax is the range of the current waveforms amplitude
-
-                currY = ampToPixel(thumbHeight, minMax, waveformBuffer[i]);
-                if(tableSize<=2)
-                {
-                    //if table is size of two or less draw as a VU meter using a path.
-                    vuPath.addRectangle(prevX, prevY, prevX+numPixelsPerIndex, thumbHeight);
-                    //vuPath.lineTo(prevX+numPixelsPerIndex, prevY);
-                }
-                else
-                {
-                    if(shouldFill)
-                    {
-                        g.setColour(colour.withAlpha(.2f));
-                        g.drawVerticalLine(prevX, (prevY<midPoint ? prevY : midPoint),  (prevY>midPoint ? prevY : midPoint));
-                    }
-                    if(traceThickness>0)
-                    {
-                        g.setColour(colour);
-                        //draw trace
-                        currX = jmax(0.0, (i-visibleStart)*numPixelsPerIndex);
-                        g.drawLine(prevX, prevY, currX, currY, traceThickness);
-                    }
-                }
-
-                prevX = jmax(0.0, (i-visibleStart)*numPixelsPerIndex);
-                prevY = currY;
-
+                trace.lineTo(x, minY);
+                fill.lineTo(x, minY);
             }
+            prevX = x;
+        }
+    }
+    else
+    {
+        for(double i=visibleStart; i<=visibleEnd; i+=incr)
+        {
+            const float currX = jmax(0.0, (i-visibleStart)*numPixelsPerIndex);
+            const float currY = ampToPixel(thumbHeight, minMax, waveformBuffer[i]);
+            trace.lineTo(currX, currY);
+            fill.lineTo(currX, currY);
+            prevX = currX;
         }
     }
 
-    vuPath.lineTo(prevX, thumbArea.getHeight());
-    vuPath.closeSubPath();
+    fill.lineTo(prevX, midPoint);
+    fill.closeSubPath();
 
-    if(tableSize<=2)
+    if(shouldFill)
     {
-        g.setGradientFill(vuGradient);
-        g.fillPath(vuPath);
+        g.setColour(colour.withAlpha(.2f));
+        g.fillPath(fill);
     }
 
+    if(traceThickness>0)
+    {
+        g.setColour(colour);
+        g.strokePath(trace, PathStrokeType(traceThickness));
+    }
 }
 
 //==============================================================================
@@ -1199,11 +1266,11 @@ void GenTable::mouseDrag(const MouseEvent& e)
         {
             if(e.mods.isLeftButtonDown())
             {
-                double zoomFactor = visibleRange.getLength()/thumbnail->getTotalLength();
+                double zoomFactor = visibleRange.getLength()/getSampleLength();
                 regionWidth = abs(e.getDistanceFromDragStartX())*zoomFactor;
                 if(e.getDistanceFromDragStartX()<0)
                     currentPlayPosition = jmax (0.0, xToTime (loopStart+(float)e.getDistanceFromDragStartX()));
-                float widthInTime = ((float)e.getDistanceFromDragStartX() / (float)getWidth()) * (float)thumbnail->getTotalLength();
+                float widthInTime = ((float)e.getDistanceFromDragStartX() / (float)getWidth()) * (float)getSampleLength();
                 loopLength = jmax (0.0, widthInTime*zoomFactor);
             }
             repaint();
@@ -1234,8 +1301,7 @@ void GenTable::setScrubberPos(double pos)
         currentPositionMarker->setVisible (true);
 
         //assign time values in seconds to pos..
-        double timePos = pos*thumbnail->getTotalLength()*sampleRate;
-        timePos = (timePos/(thumbnail->getTotalLength()*sampleRate))*thumbnail->getTotalLength();
+        const double timePos = pos*getSampleLength();
         //set position of scrubber rectangle
         currentPositionMarker->setRectangle (juce::Rectangle<float> (timeToX (timePos) - 0.75f, 0,
                                              1.5f, (float) (getHeight() - 20)));
@@ -1243,12 +1309,15 @@ void GenTable::setScrubberPos(double pos)
         if(this->showScroll)
         {
             //take care of scrolling...
-            if(timePos<thumbnail->getTotalLength()/25.f)
+            if(timePos<getSampleLength()/25.f)
             {
-                setRange (visibleRange.movedToStartAt(0));
+                //only re-range when the view actually moves, otherwise the
+                //waveform layer would be rebuilt on every scrubber update
+                if(visibleRange.getStart()!=0)
+                    setRange (visibleRange.movedToStartAt(0));
                 newRangeStart = 0;
             }
-            else if(visibleRange.getEnd()<=thumbnail->getTotalLength() && zoom>0.0)
+            else if(visibleRange.getEnd()<=getSampleLength() && zoom>0.0)
             {
                 setRange (visibleRange.movedToStartAt (jmax(0.0, timePos - (visibleRange.getLength() / 2.0))));
                 newRangeStart = jmax(0.0, timePos - (visibleRange.getLength() / 2.0));
@@ -1270,7 +1339,10 @@ void GenTable::setScrubberPos(double pos)
         if(this->showScroll)
         {
             if(timePos<(waveformLengthSeconds)/25.f)
-                setRange (visibleRange.movedToStartAt(0));
+            {
+                if(visibleRange.getStart()!=0)
+                    setRange (visibleRange.movedToStartAt(0));
+            }
             else if(visibleRange.getEnd()<=waveformLengthSeconds && zoom>0.0)
                 setRange (visibleRange.movedToStartAt (jmax(0.0, timePos - (visibleRange.getLength()/2.0))));
         }
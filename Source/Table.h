@@ -26,6 +26,7 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "CabbageUtils.h"
 #include "CabbageLookAndFeel.h"
+#include "WaveformPeaks.h"
 
 class RoundButton;
 class HandleViewer;
@@ -218,13 +219,24 @@ public:
     void setVUGradient(ColourGradient grad)
     {
         vuGradient=grad;
+        repaintWaveformLayer();
     }
 
 private:
     void drawBackgroundGrid();
+    void drawGridLayer(Graphics& g);
+    void drawWaveformLayer(Graphics& g);
+    int64 getGridLayerKey() const;
+    int64 getWaveformLayerKey() const;
+    void repaintWaveformLayer();
     Image backgroundImage;
     bool shouldFill;
     float traceThickness;
+    //cached layers are keyed on everything they depend on, waveformVersion
+    //is bumped whenever the table data itself changes
+    float layerScale;
+    int64 gridLayerKey, waveformLayerKey;
+    int waveformVersion;
     bool paintCachedImage;
     String coordinates;
     double newRangeStart;
@@ -255,12 +267,15 @@ private:
     void scrollBarMoved (ScrollBar* scrollBarThatHasMoved, double newRangeStart);
     void changeListenerCallback(ChangeBroadcaster *source);
     ScopedPointer<HandleViewer> handleViewer;
-    AudioFormatManager formatManager;
     double sampleRate;
     float regionWidth;
     Image waveformImage;
-    AudioThumbnailCache thumbnailCache;
-    ScopedPointer<AudioThumbnail> thumbnail;
+    WaveformPeaks samplePeaks;
+    //length in seconds of a GEN01 or large table
+    double getSampleLength() const
+    {
+        return samplePeaks.getNumSamples()/sampleRate;
+    }
     Colour colour, fontcolour;
     int mouseDownX, mouseUpX;
     juce::Rectangle<int> localBounds;
@@ -276,17 +291,13 @@ private:
     double visibleLength, visibleStart, visibleEnd, maxAmp;
     Range<float> minMax;
 
-    Range<float> findMinMax(Array<float, CriticalSection> buffer)
+    PeakPyramid tablePeaks;
+
+    Range<float> findMinMax(Array<float, CriticalSection>& buffer)
     {
-        float min=buffer[0],max=buffer[0];
-        for(int i=0; i<buffer.size(); i++)
-        {
-            if(buffer[i]>max)
-                max=buffer[i];
-            if(buffer[i]<min)
-                min=buffer[i];
-        }
-        return Range<float>(min, max);
+        if(buffer.size()==0)
+            return Range<float>();
+        return FloatVectorOperations::findMinAndMax(buffer.getRawDataPointer(), buffer.size());
     }
 
 };
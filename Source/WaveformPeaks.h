@@ -0,0 +1,561 @@
+/*
+  Copyright (C) 2014 Rory Walsh
+
+  Cabbage is free software; you can redistribute it
+  and/or modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  Cabbage is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with Csound; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+  02111-1307 USA
+*/
+
+#ifndef WAVEFORMPEAKS_H
+#define WAVEFORMPEAKS_H
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "PeakPyramid.h"
+
+//==============================================================================
+// peaks of an audio file on disk. The pyramids are sized as soon as the file
+// header has been read and are filled in by the PeakFileCache thread, which
+// broadcasts a change every so often so that waveforms can be drawn as the
+// scan progresses.
+//==============================================================================
+class PeakFile : public ReferenceCountedObject,
+    public ChangeBroadcaster
+{
+public:
+    typedef ReferenceCountedObjectPtr<PeakFile> Ptr;
+    enum { samplesPerBlock = 256 };
+
+    PeakFile (const File& audioFile, int numChannels, int64 length, double rate)
+        : file(audioFile),
+          fileSize(audioFile.getSize()),
+          modificationTime(audioFile.getLastModificationTime().toMilliseconds()),
+          numSamples((int)jmin(length, (int64)std::numeric_limits<int>::max())),
+          sampleRate(rate)
+    {
+        for(int i=0; i<numChannels; i++)
+            channels.add(new PeakPyramid(samplesPerBlock))->allocate(numSamples);
+    }
+
+    ~PeakFile() {}
+
+    const File& getFile() const
+    {
+        return file;
+    }
+
+    //true if the file on disk is still the one these peaks were taken from
+    bool matches (const File& other) const
+    {
+        return other==file && other.getSize()==fileSize
+               && other.getLastModificationTime().toMilliseconds()==modificationTime;
+    }
+
+    int getNumChannels() const
+    {
+        return channels.size();
+    }
+
+    int getNumSamples() const
+    {
+        return numSamples;
+    }
+
+    double getSampleRate() const
+    {
+        return sampleRate;
+    }
+
+    bool isFullyLoaded() const
+    {
+        return numSamplesLoaded.get()>=numSamples;
+    }
+
+    Range<float> getMinMax (int channel, int startSample, int endSample) const
+    {
+        const ScopedLock sl(lock);
+        if(isPositiveAndBelow(channel, channels.size()))
+            return channels[channel]->getMinMax(nullptr, startSample, endSample);
+        return Range<float>();
+    }
+
+    void getPeaks (int channel, double startSample, double samplesPerPixel,
+                   int numPixels, float* mins, float* maxs) const
+    {
+        const ScopedLock sl(lock);
+        if(isPositiveAndBelow(channel, channels.size()))
+            channels[channel]->getPeaks(nullptr, startSample, samplesPerPixel, numPixels, mins, maxs);
+    }
+
+    //name of the cache file, which changes whenever the audio file does
+    String getCacheFileName() const
+    {
+        String key;
+        key << file.getFullPathName() << "|" << fileSize << "|" << modificationTime << "|" << sampleRate;
+        return String::toHexString(key.hashCode64())+".peaks";
+    }
+
+private:
+    friend class PeakFileCache;
+    enum { cacheMagic = 0x4b504243, cacheVersion = 2 };
+
+    bool loadFrom (const File& cacheFile)
+    {
+        ScopedPointer<FileInputStream> in(cacheFile.createInputStream());
+        if(in==nullptr
+                || in->readInt()!=cacheMagic
+                || in->readInt()!=cacheVersion
+                || in->readString()!=file.getFullPathName()
+                || in->readInt64()!=fileSize
+                || in->readInt64()!=modificationTime
+                || in->readDouble()!=sampleRate
+                || in->readInt()!=channels.size()
+                || in->readInt()!=numSamples
+                || in->readInt()!=samplesPerBlock)
+            return false;
+
+        const int numBlocks = (numSamples+samplesPerBlock-1)/samplesPerBlock;
+        const int numBytes = numBlocks*sizeof(float);
+        HeapBlock<float> mins(numBlocks), maxs(numBlocks);
+        for(int i=0; i<channels.size(); i++)
+        {
+            if(in->read(mins, numBytes)!=numBytes || in->read(maxs, numBytes)!=numBytes)
+                return false;
+
+            const ScopedLock sl(lock);
+            channels[i]->setBlockPeaks(0, numBlocks, mins, maxs);
+        }
+
+        numSamplesLoaded = numSamples;
+        sendChangeMessage();
+        return true;
+    }
+
+    bool saveTo (const File& cacheFile) const
+    {
+        if(!cacheFile.getParentDirectory().createDirectory())
+            return false;
+
+        TemporaryFile temp(cacheFile);
+        {
+            ScopedPointer<FileOutputStream> out(temp.getFile().createOutputStream());
+            if(out==nullptr)
+                return false;
+
+            out->writeInt(cacheMagic);
+            out->writeInt(cacheVersion);
+            out->writeString(file.getFullPathName());
+            out->writeInt64(fileSize);
+            out->writeInt64(modificationTime);
+            out->writeDouble(sampleRate);
+            out->writeInt(channels.size());
+            out->writeInt(numSamples);
+            out->writeInt(samplesPerBlock);
+
+            const ScopedLock sl(lock);
+            for(int i=0; i<channels.size(); i++)
+            {
+                const int numBytes = channels[i]->getNumBlocks()*sizeof(float);
+                out->write(channels[i]->getBlockMinimums(), numBytes);
+                out->write(channels[i]->getBlockMaximums(), numBytes);
+            }
+            out->flush();
+        }
+        return temp.overwriteTargetFileWithTemporary();
+    }
+
+    //reads the whole audio file a chunk at a time, filling in the pyramids
+    bool scan (Thread& thread)
+    {
+        AudioFormatManager formats;
+        formats.registerBasicFormats();
+        ScopedPointer<AudioFormatReader> reader(formats.createReaderFor(file));
+        if(reader==nullptr)
+            return false;
+
+        const int blocksPerChunk = 1024;
+        const int chunkSize = blocksPerChunk*samplesPerBlock;
+        AudioSampleBuffer chunk(jmax(1, channels.size()), chunkSize);
+        HeapBlock<float> mins(blocksPerChunk), maxs(blocksPerChunk);
+        uint32 lastNotification = Time::getMillisecondCounter();
+
+        for(int start=0; start<numSamples; start+=chunkSize)
+        {
+            if(thread.threadShouldExit())
+                return false;
+
+            const int num = jmin(chunkSize, numSamples-start);
+            reader->read(&chunk, 0, num, start, true, true);
+
+            const int numBlocks = (num+samplesPerBlock-1)/samplesPerBlock;
+            for(int i=0; i<channels.size(); i++)
+            {
+                const float* data = chunk.getReadPointer(i);
+                for(int b=0; b<numBlocks; b++)
+                {
+                    const int offset = b*samplesPerBlock;
+                    const Range<float> peaks = FloatVectorOperations::findMinAndMax(data+offset, jmin((int)samplesPerBlock, num-offset));
+                    mins[b] = peaks.getStart();
+                    maxs[b] = peaks.getEnd();
+                }
+
+                const ScopedLock sl(lock);
+                channels[i]->setBlockPeaks(start/samplesPerBlock, numBlocks, mins, maxs);
+            }
+
+            numSamplesLoaded = start+num;
+
+            //redraw a few times a second while the scan is under way
+            if(Time::getMillisecondCounter()-lastNotification>100)
+            {
+                sendChangeMessage();
+                lastNotification = Time::getMillisecondCounter();
+            }
+        }
+
+        sendChangeMessage();
+        return true;
+    }
+
+    File file;
+    int64 fileSize, modificationTime;
+    int numSamples;
+    double sampleRate;
+    OwnedArray<PeakPyramid> channels;
+    CriticalSection lock;
+    Atomic<int> numSamplesLoaded;
+
+    JUCE_DECLARE_NON_COPYABLE (PeakFile)
+};
+
+//==============================================================================
+// one per process, shared through a SharedResourcePointer. Each audio file is
+// only scanned once; its peaks are kept in memory while any widget shows it
+// and are written to the cache directory so that the next session can load
+// them instead of reading the audio again.
+//==============================================================================
+class PeakFileCache : private Thread
+{
+public:
+    PeakFileCache() : Thread("Cabbage peak cache")
+    {
+        startThread(3);
+    }
+
+    ~PeakFileCache()
+    {
+        signalThreadShouldExit();
+        notify();
+        stopThread(4000);
+    }
+
+    static File getCacheDirectory()
+    {
+        return File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile("Cabbage").getChildFile("PeakCache");
+    }
+
+    //returns straight away with the file's length and channel count known;
+    //the peaks follow from the background thread. nullptr if the file can't
+    //be read as audio.
+    PeakFile::Ptr getPeakFile (const File& audioFile)
+    {
+        const ScopedLock sl(lock);
+        for(int i=files.size(); --i>=0;)
+        {
+            PeakFile* peakFile = files.getObjectPointerUnchecked(i);
+            if(peakFile->matches(audioFile))
+                return peakFile;
+            //no longer shown anywhere
+            if(peakFile->getReferenceCount()==1)
+                files.remove(i);
+        }
+
+        AudioFormatManager formats;
+        formats.registerBasicFormats();
+        ScopedPointer<AudioFormatReader> reader(formats.createReaderFor(audioFile));
+        if(reader==nullptr)
+            return nullptr;
+
+        PeakFile::Ptr peakFile = new PeakFile(audioFile, reader->numChannels, reader->lengthInSamples, reader->sampleRate);
+        files.add(peakFile);
+        pending.add(peakFile);
+        notify();
+        return peakFile;
+    }
+
+private:
+    void run()
+    {
+        while(!threadShouldExit())
+        {
+            PeakFile::Ptr next;
+            {
+                const ScopedLock sl(lock);
+                if(pending.size()>0)
+                    next = pending.removeAndReturn(0);
+            }
+
+            if(next==nullptr)
+            {
+                wait(-1);
+                continue;
+            }
+
+            const File cacheFile = getCacheDirectory().getChildFile(next->getCacheFileName());
+            if(next->loadFrom(cacheFile))
+                cacheFile.setLastModificationTime(Time::getCurrentTime());
+            else if(next->scan(*this) && next->saveTo(cacheFile))
+                pruneCacheDirectory();
+        }
+    }
+
+    //peak files that haven't been used for a month are removed, then the
+    //least recently used ones until the directory is back under its limit
+    static void pruneCacheDirectory()
+    {
+        Array<File> cacheFiles;
+        getCacheDirectory().findChildFiles(cacheFiles, File::findFiles, false, "*.peaks");
+        LeastRecentlyUsedFirst sorter;
+        cacheFiles.sort(sorter);
+
+        const Time oldest = Time::getCurrentTime()-RelativeTime::days(maxCacheDays);
+        int64 totalSize = 0;
+        for(int i=0; i<cacheFiles.size(); i++)
+            totalSize += cacheFiles.getReference(i).getSize();
+
+        for(int i=0; i<cacheFiles.size(); i++)
+        {
+            const File& cacheFile = cacheFiles.getReference(i);
+            if(totalSize<=maxCacheBytes && cacheFile.getLastModificationTime()>=oldest)
+                break;
+            const int64 size = cacheFile.getSize();
+            if(cacheFile.deleteFile())
+                totalSize -= size;
+        }
+    }
+
+    struct LeastRecentlyUsedFirst
+    {
+        static int compareElements (const File& first, const File& second)
+        {
+            const int64 a = first.getLastModificationTime().toMilliseconds();
+            const int64 b = second.getLastModificationTime().toMilliseconds();
+            return a<b ? -1 : (a>b ? 1 : 0);
+        }
+    };
+
+    enum { maxCacheDays = 30, maxCacheBytes = 256*1024*1024 };
+
+    CriticalSection lock;
+    ReferenceCountedArray<PeakFile> files, pending;
+
+    JUCE_DECLARE_NON_COPYABLE (PeakFileCache)
+};
+
+//==============================================================================
+// peaks for each channel of either a sample buffer or an audio file, drawn
+// the same way as an AudioThumbnail
+//==============================================================================
+class WaveformPeaks
+{
+public:
+    WaveformPeaks() : fileListener(nullptr)
+    {
+        formatManager.registerBasicFormats();
+    }
+
+    ~WaveformPeaks()
+    {
+        clear();
+    }
+
+    //when the new buffer has the same shape as the old one only the region of
+    //each channel that differs is copied and rescanned
+    void setBuffer (const AudioSampleBuffer& newBuffer)
+    {
+        releaseFile();
+        const int numSamples = newBuffer.getNumSamples();
+        if(newBuffer.getNumChannels()!=channels.size() || numSamples!=buffer.getNumSamples())
+        {
+            buffer = newBuffer;
+            channels.clear();
+            for(int i=0; i<buffer.getNumChannels(); i++)
+                channels.add(new PeakPyramid())->build(buffer.getReadPointer(i), numSamples);
+            return;
+        }
+
+        for(int i=0; i<channels.size(); i++)
+        {
+            const Range<int> changed = PeakPyramid::findChangedRegion(buffer.getReadPointer(i), numSamples,
+                                      newBuffer.getReadPointer(i), numSamples);
+            if(!changed.isEmpty())
+            {
+                buffer.copyFrom(i, changed.getStart(), newBuffer.getReadPointer(i, changed.getStart()), changed.getLength());
+                channels[i]->update(buffer.getReadPointer(i), numSamples, changed.getStart(), changed.getEnd());
+            }
+        }
+    }
+
+    //shows an audio file without reading it into memory. Its peaks come from
+    //the shared cache and listener is told each time more of them arrive.
+    bool setFile (const File& file, ChangeListener* listener)
+    {
+        clear();
+        peakFile = peakCache->getPeakFile(file);
+        if(peakFile==nullptr)
+            return false;
+
+        fileListener = listener;
+        if(fileListener!=nullptr)
+            peakFile->addChangeListener(fileListener);
+        return true;
+    }
+
+    void clear()
+    {
+        releaseFile();
+        buffer.setSize(0, 0);
+        channels.clear();
+    }
+
+    int getNumChannels() const
+    {
+        return peakFile!=nullptr ? peakFile->getNumChannels() : channels.size();
+    }
+
+    int getNumSamples() const
+    {
+        return peakFile!=nullptr ? peakFile->getNumSamples() : buffer.getNumSamples();
+    }
+
+    Range<float> getMinMax (int channel, int startSample, int endSample) const
+    {
+        if(peakFile!=nullptr)
+            return peakFile->getMinMax(channel, startSample, endSample);
+        if(isPositiveAndBelow(channel, channels.size()))
+            return channels[channel]->getMinMax(buffer.getReadPointer(channel), startSample, endSample);
+        return Range<float>();
+    }
+
+    //draws each channel in its own horizontal strip of area
+    void drawChannels (Graphics& g, const juce::Rectangle<int>& area, double startSample,
+                       double endSample, float verticalZoomFactor)
+    {
+        const int numChannels = getNumChannels();
+        for(int i=0; i<numChannels; i++)
+        {
+            const int y1 = roundToInt((i*area.getHeight())/numChannels);
+            const int y2 = roundToInt(((i+1)*area.getHeight())/numChannels);
+            drawChannel(g, juce::Rectangle<int>(area.getX(), area.getY()+y1, area.getWidth(), y2-y1),
+                        startSample, endSample, i, verticalZoomFactor);
+        }
+    }
+
+    void drawChannel (Graphics& g, const juce::Rectangle<int>& area, double startSample,
+                      double endSample, int channel, float verticalZoomFactor)
+    {
+        const juce::Rectangle<int> clip(g.getClipBounds().getIntersection(area));
+        if(clip.isEmpty() || !isPositiveAndBelow(channel, getNumChannels()) || endSample<=startSample)
+            return;
+
+        //only the pixels inside the clip region are looked up
+        const double samplesPerPixel = (endSample-startSample)/area.getWidth();
+        const double clipStart = startSample+(clip.getX()-area.getX())*samplesPerPixel;
+        const int numPixels = clip.getWidth();
+        HeapBlock<float> mins(numPixels), maxs(numPixels);
+
+        if(peakFile==nullptr)
+            channels[channel]->getPeaks(buffer.getReadPointer(channel), clipStart, samplesPerPixel, numPixels, mins, maxs);
+        else if(samplesPerPixel>=PeakFile::samplesPerBlock)
+            peakFile->getPeaks(channel, clipStart, samplesPerPixel, numPixels, mins, maxs);
+        else
+            getPeaksFromFile(channel, clipStart, samplesPerPixel, numPixels, mins, maxs);
+
+        const float topY = (float)area.getY();
+        const float bottomY = (float)area.getBottom();
+        const float midY = (topY+bottomY)*.5f;
+        const float vscale = verticalZoomFactor*(bottomY-topY)*.5f;
+
+        RectangleList<float> waveform;
+        waveform.ensureStorageAllocated(numPixels);
+        for(int i=0; i<numPixels; i++)
+        {
+            if(mins[i]!=0.f || maxs[i]!=0.f)
+            {
+                const float top = jmax(midY-maxs[i]*vscale-.3f, topY);
+                const float bottom = jmin(midY-mins[i]*vscale+.3f, bottomY);
+                waveform.addWithoutMerging(juce::Rectangle<float>((float)(clip.getX()+i), top, 1.f, bottom-top));
+            }
+        }
+        g.fillRectList(waveform);
+    }
+
+private:
+    void releaseFile()
+    {
+        if(peakFile!=nullptr && fileListener!=nullptr)
+            peakFile->removeChangeListener(fileListener);
+        peakFile = nullptr;
+        fileListener = nullptr;
+        fileReader = nullptr;
+        fileRegion = Range<int>();
+    }
+
+    //zoomed in closer than the cached blocks, so the visible samples are
+    //read from the file itself
+    void getPeaksFromFile (int channel, double startSample, double samplesPerPixel,
+                           int numPixels, float* mins, float* maxs)
+    {
+        const int numSamples = peakFile->getNumSamples();
+        const Range<int> region(jlimit(0, numSamples, (int)std::floor(startSample)),
+                                jlimit(0, numSamples, (int)std::ceil(startSample+numPixels*samplesPerPixel)+1));
+
+        if(region!=fileRegion)
+        {
+            if(fileReader==nullptr)
+                fileReader = formatManager.createReaderFor(peakFile->getFile());
+            if(fileReader==nullptr)
+                return;
+
+            fileBuffer.setSize(peakFile->getNumChannels(), jmax(1, region.getLength()), false, false, true);
+            fileReader->read(&fileBuffer, 0, region.getLength(), region.getStart(), true, true);
+            fileRegion = region;
+        }
+
+        const float* data = fileBuffer.getReadPointer(channel);
+        for(int i=0; i<numPixels; i++)
+        {
+            const int start = jlimit(0, fileRegion.getLength(), (int)std::floor(startSample+i*samplesPerPixel)-fileRegion.getStart());
+            const int end = jlimit(start, fileRegion.getLength(), (int)std::floor(startSample+(i+1)*samplesPerPixel)-fileRegion.getStart());
+            const Range<float> peaks = (end>start ? FloatVectorOperations::findMinAndMax(data+start, end-start)
+                                        : start<fileRegion.getLength() ? Range<float>(data[start], data[start]) : Range<float>());
+            mins[i] = peaks.getStart();
+            maxs[i] = peaks.getEnd();
+        }
+    }
+
+    AudioSampleBuffer buffer;
+    OwnedArray<PeakPyramid> channels;
+
+    SharedResourcePointer<PeakFileCache> peakCache;
+    PeakFile::Ptr peakFile;
+    ChangeListener* fileListener;
+    AudioFormatManager formatManager;
+    ScopedPointer<AudioFormatReader> fileReader;
+    AudioSampleBuffer fileBuffer;
+    Range<int> fileRegion;
+
+    JUCE_DECLARE_NON_COPYABLE (WaveformPeaks)
+};
+
+#endif // WAVEFORMPEAKS_H
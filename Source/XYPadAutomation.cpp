@@ -4,11 +4,14 @@
 XYPadAutomation::XYPadAutomation()
 {
     ballPathDirection = 1;
-    timerInterval = 50;
+    ballPathLength = 0;
+    currentPointAlongPath = 0;
+    xValueIncrement = yValueIncrement = 0;
 
     selectedToggle = 0;
     speedSliderValue = 0;
     isAutomationOn = false;
+    lastNotifiedX = lastNotifiedY = std::numeric_limits<float>::max();
     updateCounter = 0;
     paramIndex = 0;
     creationCounter = 0;
@@ -43,7 +46,18 @@ void XYPadAutomation::setBallPath (Path path)
 {
     AffineTransform transform = AffineTransform::translation((ballSize/2)*-1, (ballSize/2)*-1);
     path.applyTransform(transform);
+
+    const float length = path.getLength();
+    Array<Point<float> > points;
+    points.ensureStorageAllocated((int)length+2);
+    for(float distance=0; distance<length; distance+=1.f)
+        points.add(path.getPointAlongPath(distance));
+    points.add(path.getPointAlongPath(length));
+
+    const SpinLock::ScopedLockType sl(automationLock);
     ballPath = path;
+    ballPathPoints.swapWith(points);
+    ballPathLength = length;
 }
 
 bool XYPadAutomation::isAutomating()
@@ -53,6 +67,7 @@ bool XYPadAutomation::isAutomating()
 
 void XYPadAutomation::setMinMaxValues (float xMinimum, float xMaximum, float yMinimum, float yMaximum)
 {
+    const SpinLock::ScopedLockType sl(automationLock);
     xMin = xMinimum;
     yMin = yMinimum;
     xMax = xMaximum;
@@ -76,7 +91,7 @@ float XYPadAutomation::getMinimumYValue()
 
 void XYPadAutomation::cancelAutomation()
 {
-    stopTimer();
+    const SpinLock::ScopedLockType sl(automationLock);
     isAutomationOn = false;
     xValueIncrement = yValueIncrement = 0;
 }
@@ -101,12 +116,14 @@ void XYPadAutomation::updateIncrements()
 
 void XYPadAutomation::setSpeedSliderValue(float sliderValue)
 {
+    const SpinLock::ScopedLockType sl(automationLock);
     speedSliderValue = sliderValue;
     updateCounter = 0; //reset our counter
 }
 
 void XYPadAutomation::beginAutomation(int selectedToggleButton)
 {
+    const SpinLock::ScopedLockType sl(automationLock);
     selectedToggle = selectedToggleButton;
     currentPointAlongPath = ballPath.getLength(); //ball begins traversing at the end of the path, rather than the start
 
@@ -125,66 +142,84 @@ void XYPadAutomation::beginAutomation(int selectedToggleButton)
     //initialising
     xValue = ((endDragPos.getX()/(float)availableBounds.getWidth()) * xRange) + xMin;
     yValue = ((1 - (endDragPos.getY()/(float)availableBounds.getHeight())) * yRange) + yMin; //inverting y axis
-    startTimer (timerInterval);
     isAutomationOn = true;
 }
 
-void XYPadAutomation::update()
+//==============================================================================
+// called by the processor on the audio thread before each k-period. Moves the
+// ball on by elapsedSeconds and returns its new position in x and y. Returns
+// false if nothing is automating, or if the message thread is changing the
+// automation at that moment, in which case the ball simply moves on next time.
+//==============================================================================
+bool XYPadAutomation::advance(double elapsedSeconds, float& x, float& y)
 {
-    if (isAutomating())
+    const GenericScopedTryLock<SpinLock> sl(automationLock);
+    if (!sl.isLocked() || !isAutomationOn)
+        return false;
+
+    const float steps = (float)(elapsedSeconds*stepsPerSecond);
+    if (selectedToggle == 0)   //first automation type
     {
-        updateCounter = 0;
-        if (selectedToggle == 0)   //first automation type
+        xValue += xValueIncrement*(10*speedSliderValue)*steps;
+        yValue += yValueIncrement*(10*speedSliderValue)*steps;
+
+        // If a border is hit then the increment value should be reversed...
+        if (xValue <= xMin)
+        {
+            xValue = xMin;
+            xValueIncrement*=-1;
+        }
+        else if (xValue >= xMax)
+        {
+            xValue = xMax;
+            xValueIncrement*=-1;
+        }
+        if (yValue <= yMin)
         {
-            xValue += xValueIncrement*(10*speedSliderValue);
-            yValue += yValueIncrement*(10*speedSliderValue);
-
-            // If a border is hit then the increment value should be reversed...
-            if (xValue <= xMin)
-            {
-                xValue = xMin;
-                xValueIncrement*=-1;
-            }
-            else if (xValue >= xMax)
-            {
-                xValue = xMax;
-                xValueIncrement*=-1;
-            }
-            if (yValue <= yMin)
-            {
-                yValue = yMin;
-                yValueIncrement*=-1;
-            }
-            else if (yValue >= yMax)
-            {
-                yValue = yMax;
-                yValueIncrement*=-1;
-            }
+            yValue = yMin;
+            yValueIncrement*=-1;
         }
-        else if (selectedToggle == 1)    //2nd automation type
+        else if (yValue >= yMax)
         {
-            Point<float> pt = ballPath.getPointAlongPath(currentPointAlongPath, AffineTransform::identity);
-            xValue = (((pt.getX()/(float)availableBounds.getWidth()) * xRange) + xMin);
-            yValue = ((pt.getY()/(float)availableBounds.getHeight()) * yRange);
-            yValue = ((yRange-yValue) + yMin); //inverting and adding yMin
-            currentPointAlongPath += ballPathDirection*(10*speedSliderValue);
-            if (currentPointAlongPath > ballPath.getLength())
-            {
-                currentPointAlongPath = ballPath.getLength();
-                ballPathDirection *= -1;
-            }
-            else if (currentPointAlongPath < 0)
-            {
-                currentPointAlongPath = 0;
-                ballPathDirection *= -1;
-            }
+            yValue = yMax;
+            yValueIncrement*=-1;
         }
     }
+    else if (selectedToggle == 1)    //2nd automation type
+    {
+        Point<float> pt = getPointAlongBallPath(currentPointAlongPath);
+        xValue = (((pt.getX()/(float)availableBounds.getWidth()) * xRange) + xMin);
+        yValue = ((pt.getY()/(float)availableBounds.getHeight()) * yRange);
+        yValue = ((yRange-yValue) + yMin); //inverting and adding yMin
+        currentPointAlongPath += ballPathDirection*(10*speedSliderValue)*steps;
+        if (currentPointAlongPath > ballPathLength)
+        {
+            currentPointAlongPath = ballPathLength;
+            ballPathDirection *= -1;
+        }
+        else if (currentPointAlongPath < 0)
+        {
+            currentPointAlongPath = 0;
+            ballPathDirection *= -1;
+        }
+    }
+
+    x = xValue;
+    y = yValue;
+    return true;
 }
 
-void XYPadAutomation::timerCallback()
+Point<float> XYPadAutomation::getPointAlongBallPath(float distance) const
 {
-    sendChangeMessage();
+    if (ballPathPoints.size() == 0)
+        return Point<float>();
+
+    const int index = jlimit(0, ballPathPoints.size()-1, (int)distance);
+    const int next = jmin(index+1, ballPathPoints.size()-1);
+    const float proportion = jlimit(0.f, 1.f, distance-index);
+    const Point<float> p1 = ballPathPoints.getUnchecked(index);
+    const Point<float> p2 = ballPathPoints.getUnchecked(next);
+    return p1+(p2-p1)*proportion;
 }
 
 Point<float> XYPadAutomation::getStartHandle()
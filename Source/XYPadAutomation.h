@@ -24,10 +24,11 @@
 
 
 //==============================================================================
-// XYPad Automation class. Allows plugin editor to close while maintining automation
+// XYPad Automation class. Allows plugin editor to close while maintining automation.
+// The ball is moved by the processor on the audio thread once every k-period and
+// the editor only reads the position back for display.
 //==============================================================================
-class XYPadAutomation	:	public Timer,
-    public ChangeBroadcaster
+class XYPadAutomation	:	public ChangeBroadcaster
 {
 public:
     XYPadAutomation();
@@ -47,7 +48,7 @@ public:
     bool isAutomating();
     void setSpeedSliderValue(float sliderValue);
     void setBoundsForAutomation(Rectangle<int> bounds);
-    void timerCallback();
+    bool advance(double elapsedSeconds, float& x, float& y);
     Point<float> getStartHandle();
     Point<float> getEndHandle();
     float getXValue();
@@ -59,11 +60,15 @@ public:
     int getSelectedToggle();
     float getSpeedSliderValue();
     String xChannel, yChannel;
-    void update();
     int updateCounter;
     int paramIndex;
     int creationCounter;
     bool isAutomationOn;
+    //set by the audio thread when the ball moves, cleared once the new
+    //values have been passed on to the host from the message thread
+    Atomic<int> valuesChanged;
+    //the parameter values the host was last told about
+    float lastNotifiedX, lastNotifiedY;
 
     float getYRange()
     {
@@ -76,8 +81,12 @@ public:
     }
 
 private:
+    //the automation speeds were tuned for one step every 20ms
+    enum { stepsPerSecond = 50 };
+    Point<float> getPointAlongBallPath(float distance) const;
+
+    SpinLock automationLock;
     float xValue, yValue;
-    int timerInterval, minTimerInterval;
     float xValueIncrement, yValueIncrement;
     float speedSliderValue, speedValue;
     Rectangle<int> availableBounds;
@@ -86,6 +95,10 @@ private:
     float xOut, yOut;
     int selectedToggle;
     Path ballPath;
+    //ballPath sampled once per unit of length, so the audio thread never
+    //has to walk the path itself
+    Array<Point<float> > ballPathPoints;
+    float ballPathLength;
     float currentPointAlongPath, ballPathDirection;
 
 